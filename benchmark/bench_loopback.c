@@ -0,0 +1,1096 @@
+/**
+ * @file bench_loopback.c
+ * @brief End-to-end loopback benchmark for demo_server
+ *
+ * Starts demo_server as a child process, has it create a TCP listener on
+ * 127.0.0.1 through its REPL, then drives it from nclients threads in two
+ * phases of duration_sec each:
+ *
+ *    1. Connection churn: connect, one marco/polo exchange, close, repeat.
+ *       This is the path through acceptorThread() and addClient() (and the
+ *       responder noticing the new client), so connections/s and
+ *       connect-to-first-reply latency are what a change there moves.
+ *    2. Steady requests: one connection per thread, closed-loop marco/polo.
+ *       This is the responder's path, measured as requests/s, bytes/s and
+ *       round-trip latency, plus the server's own residence time for each
+ *       request (from the timestamps in the polo reply).
+ *
+ * /w --storm, it runs an accept storm instead: nconns connections opened
+ * and immediately reset, as fast as nclients threads can, which is what a
+ * reconnect storm looks like to the server. Every one of them goes through
+ * acceptorThread(), addClient() and rmvClient() and nothing else. Reported
+ * are the accept rate, connect latency, the kernel's accept-queue overflow
+ * counters, and registry churn cost: the round-trip time a steady client
+ * sees while the client list churns under it.
+ *
+ * Results go to a JSON file, so runs before and after a change can be
+ * diffed or plotted. Both ends share the machine, so absolute numbers mean
+ * little; compare runs on the same machine.
+ *
+ * Usage: bench_loopback <demo_server-exe> [nclients] [duration_sec] [json-out] [label]
+ *        bench_loopback --storm <demo_server-exe> [nclients] [nconns] [json-out] [label]
+ */
+
+/*************************** File Header Inclusions ***************************/
+#define _POSIX_C_SOURCE 200809L // Specify atleast POSIX.1-2008 compatibility
+
+// General-Purpose Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+
+// Networking-Related Headers
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Tangential Headers
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Socket Practice (SP) Protocol
+#include "misc-practice/sp-proto.h"
+
+/***************************** Local Declarations *****************************/
+constexpr unsigned DEFAULT_NCLIENTS = 16;
+constexpr unsigned DEFAULT_DURATION_SEC = 5;
+constexpr unsigned MAX_NCLIENTS = 512; // demo_server takes at most 1'000 clients
+constexpr char DEFAULT_JSON_PATH[] = "benchmark/results/bench_loopback.json";
+constexpr unsigned DEFAULT_STORM_NCONNS = 20'000;
+constexpr unsigned MAX_STORM_NCONNS = 10'000'000;
+constexpr char DEFAULT_STORM_JSON_PATH[] = "benchmark/results/bench_accept_storm.json";
+constexpr long PROBE_INTERVAL_NS = 1'000'000; // storm probe's request pacing
+constexpr int SERVER_READY_TIMEOUT_MS = 5'000;
+constexpr int SERVER_EXIT_TIMEOUT_MS = 2'000;
+// What demo_server prints once the listener and its threads are up
+constexpr char SERVER_READY_STR[] = "Successfully created listening context.";
+
+enum Phase
+{
+   PHASE_CONNECT,
+   PHASE_REQUESTS,
+   PHASE_STORM,
+};
+
+/**
+ * @brief Growable array of latency samples, in ns
+ */
+struct Samples
+{
+   uint64_t * ns;
+   size_t len;
+   size_t cap;
+};
+
+struct Worker
+{
+   pthread_t tid;
+   enum Phase phase;
+   in_port_t port; // network byte order
+   unsigned duration_sec;
+   pthread_barrier_t * start_line;
+   atomic_long * conns_left; // storm: connections still to be opened
+   const atomic_bool * stop; // if set, run until this is, not for duration_sec
+   uint64_t nops;    // connections (churn, storm) or requests (steady)
+   uint64_t nerrors;
+   uint64_t nbytes;  // sent + received
+   struct Samples latency;
+   struct Samples residence;
+};
+
+struct PhaseResult
+{
+   uint64_t nops;
+   uint64_t nerrors;
+   uint64_t nbytes;
+   double elapsed_sec;
+   struct Samples latency;
+   struct Samples residence;
+};
+
+struct StormResult
+{
+   struct PhaseResult conns;
+   struct PhaseResult probe; // the steady client running alongside the storm
+   double accept_elapsed_sec; // until the server had accepted every connection
+   long long listen_overflows; // -1 if /proc/net/netstat couldn't be read
+   long long listen_drops;
+};
+
+struct Server
+{
+   pid_t pid;
+   int stdin_fd;
+   int stdout_fd;
+   pthread_t drainer;
+};
+
+static bool startServer( struct Server * server, const char * exe, in_port_t port );
+static void stopServer( struct Server * server );
+static void * drainThread( void * arg );
+static in_port_t pickFreePort( void );
+
+static bool runPhase( enum Phase phase,
+                      in_port_t port,
+                      unsigned nclients,
+                      unsigned duration_sec,
+                      struct PhaseResult * result );
+static bool runStorm( in_port_t port,
+                      unsigned nclients,
+                      unsigned nconns,
+                      struct StormResult * result );
+static void startWorkers( struct Worker * workers, unsigned nworkers );
+static bool joinWorkers( struct Worker * workers, unsigned nworkers, struct PhaseResult * result );
+static void * workerThread( void * arg );
+static bool readListenStats( long long * overflows, long long * drops );
+static int connectLoopback( in_port_t port );
+static bool marcoPolo( int sfd, uint64_t seq, uint64_t * rtt_ns, uint64_t * residence_ns );
+static bool recvExact( int sfd, uint8_t * buf, size_t len );
+
+static bool addSample( struct Samples * samples, uint64_t ns );
+static bool mergeSamples( struct Samples * dst, const struct Samples * src );
+static int cmpU64( const void * a, const void * b );
+static double percentileUs( const struct Samples * sorted, double pct );
+static void writeLatencyJson( FILE * f, const char * name, struct Samples * samples );
+static bool writeStormJson( const char * path,
+                            const char * label,
+                            const char * server_exe,
+                            unsigned nclients,
+                            unsigned nconns,
+                            struct StormResult * storm );
+static bool writeJson( const char * path,
+                       const char * label,
+                       const char * server_exe,
+                       unsigned nclients,
+                       unsigned duration_sec,
+                       struct PhaseResult * churn,
+                       struct PhaseResult * steady );
+static uint64_t monotonicNs( void );
+static bool parseUnsigned( const char * str, unsigned min, unsigned max, unsigned * val );
+
+/******************************* Main Function ********************************/
+int main( int argc, char * argv[] )
+{
+   const bool storm = (argc > 1 && strcmp(argv[1], "--storm") == 0);
+   const int argi = storm ? 2 : 1; // first positional argument
+   if ( argc - argi < 1 || argc - argi > 5 )
+   {
+      fprintf( stderr,
+               "Usage: %s <demo_server-exe> [nclients] [duration_sec] [json-out] [label]\n"
+               "       %s --storm <demo_server-exe> [nclients] [nconns] [json-out] [label]\n"
+               "\tnclients: concurrent client connections (default %u, max %u)\n"
+               "\tduration_sec: length of each phase (default %u)\n"
+               "\tnconns: connections to open in the storm (default %u)\n"
+               "\tjson-out: results file (default %s, or %s /w --storm)\n"
+               "\tlabel: free-form tag stored /w the results, e.g. a commit hash\n",
+               argv[0], argv[0], DEFAULT_NCLIENTS, MAX_NCLIENTS, DEFAULT_DURATION_SEC,
+               DEFAULT_STORM_NCONNS, DEFAULT_JSON_PATH, DEFAULT_STORM_JSON_PATH );
+      return 1;
+   }
+
+   const char * server_exe = argv[argi];
+   unsigned nclients = DEFAULT_NCLIENTS;
+   unsigned duration_sec = DEFAULT_DURATION_SEC;
+   unsigned nconns = DEFAULT_STORM_NCONNS;
+   const char * json_path = (argc > argi + 3) ? argv[argi + 3]
+                            : (storm ? DEFAULT_STORM_JSON_PATH : DEFAULT_JSON_PATH);
+   const char * label = (argc > argi + 4) ? argv[argi + 4] : "";
+   bool valid_args = !(argc > argi + 1 && !parseUnsigned(argv[argi + 1], 1, MAX_NCLIENTS, &nclients));
+   if ( argc > argi + 2 )
+   {
+      valid_args = valid_args
+                   && (storm ? parseUnsigned(argv[argi + 2], 1, MAX_STORM_NCONNS, &nconns)
+                             : parseUnsigned(argv[argi + 2], 1, 3'600, &duration_sec));
+   }
+   if ( !valid_args )
+   {
+      fprintf(stderr, "Error: Invalid client count, duration or connection count.\n");
+      return 1;
+   }
+
+   // A client the server has dropped shouldn't kill the benchmark
+   signal(SIGPIPE, SIG_IGN);
+
+   in_port_t port = pickFreePort();
+   if ( 0 == port )
+      return 1;
+
+   struct Server server;
+   if ( !startServer(&server, server_exe, port) )
+      return 1;
+
+   bool ok;
+   if ( storm )
+   {
+      printf( "demo_server up on 127.0.0.1:%u; accept storm of %u connections from %u clients\n",
+              ntohs(port), nconns, nclients );
+
+      struct StormResult result = {0};
+      ok = runStorm(port, nclients, nconns, &result);
+
+      stopServer(&server);
+
+      if ( ok )
+      {
+         printf( "Accept storm: %.1f accepts/s, %.1f connects/s (%llu errors)\n"
+                 "Listen queue overflows: %lld, drops: %lld\n",
+                 (double)result.conns.nops / result.accept_elapsed_sec,
+                 (double)result.conns.nops / result.conns.elapsed_sec,
+                 (unsigned long long)result.conns.nerrors,
+                 result.listen_overflows, result.listen_drops );
+
+         ok = writeStormJson( json_path, label, server_exe, nclients, nconns, &result );
+         if ( ok )
+            printf("Results written to %s\n", json_path);
+      }
+
+      free(result.conns.latency.ns);
+      free(result.conns.residence.ns);
+      free(result.probe.latency.ns);
+      free(result.probe.residence.ns);
+   }
+   else
+   {
+      printf( "demo_server up on 127.0.0.1:%u; %u clients, %u s per phase\n",
+              ntohs(port), nclients, duration_sec );
+
+      struct PhaseResult churn = {0};
+      struct PhaseResult steady = {0};
+      ok = runPhase(PHASE_CONNECT, port, nclients, duration_sec, &churn)
+           && runPhase(PHASE_REQUESTS, port, nclients, duration_sec, &steady);
+
+      stopServer(&server);
+
+      if ( ok )
+      {
+         printf( "Connection churn: %.1f conn/s (%llu errors)\n"
+                 "Steady requests:  %.1f req/s, %.2f MB/s (%llu errors)\n",
+                 (double)churn.nops / churn.elapsed_sec, (unsigned long long)churn.nerrors,
+                 (double)steady.nops / steady.elapsed_sec,
+                 (double)steady.nbytes / steady.elapsed_sec / 1e6,
+                 (unsigned long long)steady.nerrors );
+
+         ok = writeJson( json_path, label, server_exe, nclients, duration_sec, &churn, &steady );
+         if ( ok )
+            printf("Results written to %s\n", json_path);
+      }
+
+      free(churn.latency.ns);
+      free(churn.residence.ns);
+      free(steady.latency.ns);
+      free(steady.residence.ns);
+   }
+
+   return ok ? 0 : 1;
+}
+
+/*********************** Local Function Implementations ***********************/
+
+/**
+ * @brief Fork/exec demo_server /w pipes on its stdin/stdout, and create a
+ *        listener on 127.0.0.1:port through its REPL
+ *
+ * @return true once the server reports the listening context created
+ */
+static bool startServer( struct Server * server, const char * exe, in_port_t port )
+{
+   int to_server[2];
+   int from_server[2];
+   if ( pipe(to_server) != 0 || pipe(from_server) != 0 )
+   {
+      fprintf(stderr, "Error: pipe() failed, errno: %s (%d)\n", strerror(errno), errno);
+      return false;
+   }
+
+   pid_t pid = fork();
+   if ( pid < 0 )
+   {
+      fprintf(stderr, "Error: fork() failed, errno: %s (%d)\n", strerror(errno), errno);
+      return false;
+   }
+   if ( 0 == pid )
+   {
+      dup2(to_server[0], STDIN_FILENO);
+      dup2(from_server[1], STDOUT_FILENO);
+      close(to_server[0]);
+      close(to_server[1]);
+      close(from_server[0]);
+      close(from_server[1]);
+      execl(exe, exe, (char *)nullptr);
+      fprintf(stderr, "Error: Unable to run %s, errno: %s (%d)\n", exe, strerror(errno), errno);
+      _exit(127);
+   }
+
+   close(to_server[0]);
+   close(from_server[1]);
+   server->pid = pid;
+   server->stdin_fd = to_server[1];
+   server->stdout_fd = from_server[0];
+
+   char cmd[64];
+   int cmd_len = snprintf(cmd, sizeof cmd, "tcp-create 127.0.0.1:%u\n", ntohs(port));
+   assert(cmd_len > 0 && (size_t)cmd_len < sizeof cmd);
+   if ( write(server->stdin_fd, cmd, (size_t)cmd_len) != cmd_len )
+   {
+      fprintf(stderr, "Error: Unable to send command to demo_server.\n");
+      stopServer(server);
+      return false;
+   }
+
+   // Read the server's output until it says it's ready (or gives up). Output
+   // is scanned as one growing string, since the ready line can arrive split
+   // across reads.
+   char out[4'096];
+   size_t out_len = 0;
+   uint64_t deadline = monotonicNs() + (uint64_t)SERVER_READY_TIMEOUT_MS * 1'000'000u;
+   bool ready = false;
+   while ( !ready && monotonicNs() < deadline )
+   {
+      struct pollfd pfd = { .fd = server->stdout_fd, .events = POLLIN };
+      int timeout_ms = (int)((deadline - monotonicNs()) / 1'000'000u) + 1;
+      if ( poll(&pfd, 1, timeout_ms) <= 0 )
+         continue;
+
+      if ( out_len == sizeof(out) - 1 )
+      {
+         // Keep just enough of the tail to still catch a split ready line
+         size_t keep = sizeof(SERVER_READY_STR);
+         memmove(out, out + out_len - keep, keep);
+         out_len = keep;
+      }
+      ssize_t nbytes = read(server->stdout_fd, out + out_len, sizeof(out) - 1 - out_len);
+      if ( nbytes <= 0 )
+         break; // server exited
+      out_len += (size_t)nbytes;
+      out[out_len] = '\0';
+      ready = (strstr(out, SERVER_READY_STR) != nullptr);
+   }
+
+   if ( !ready )
+   {
+      fprintf(stderr, "Error: demo_server didn't create its listener on port %u.\n", ntohs(port));
+      stopServer(server);
+      return false;
+   }
+
+   // The server keeps printing (prompts, and a lot more in debug builds), so
+   // keep its stdout drained or it'll block on a full pipe mid-benchmark
+   int retcode = pthread_create(&server->drainer, nullptr, drainThread, server);
+   if ( retcode != 0 )
+   {
+      fprintf(stderr, "Error: pthread_create() returned: %d : %s\n", retcode, strerror(retcode));
+      server->drainer = pthread_self();
+      stopServer(server);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Close the server's stdin (which ends its REPL), and make sure it
+ *        goes away even if it doesn't exit on its own
+ */
+static void stopServer( struct Server * server )
+{
+   close(server->stdin_fd);
+
+   int status;
+   pid_t reaped = 0;
+   for ( int waited_ms = 0; waited_ms < SERVER_EXIT_TIMEOUT_MS && reaped == 0; waited_ms += 10 )
+   {
+      reaped = waitpid(server->pid, &status, WNOHANG);
+      if ( 0 == reaped )
+         nanosleep(&(struct timespec){ .tv_nsec = 10'000'000L }, nullptr);
+   }
+   if ( 0 == reaped )
+   {
+      fprintf(stderr, "Warning: demo_server didn't exit; killing it.\n");
+      kill(server->pid, SIGKILL);
+      waitpid(server->pid, &status, 0);
+   }
+
+   // With the server gone, its stdout hits EOF and the drainer returns
+   if ( !pthread_equal(server->drainer, pthread_self()) )
+      pthread_join(server->drainer, nullptr);
+   close(server->stdout_fd);
+}
+
+static void * drainThread( void * arg )
+{
+   const struct Server * server = arg;
+   char buf[4'096];
+   while ( read(server->stdout_fd, buf, sizeof buf) > 0 );
+   return nullptr;
+}
+
+/**
+ * @brief Have the kernel pick an unused loopback port
+ * @note The port is free when this returns, not necessarily when the server
+ *       binds it, but nothing else on a benchmark box should race for it.
+ * @return port in network byte order, or 0 on failure
+ */
+static in_port_t pickFreePort( void )
+{
+   int sfd = socket(AF_INET, SOCK_STREAM, 0);
+   if ( sfd < 0 )
+      return 0;
+
+   struct sockaddr_in addr = { .sin_family = AF_INET,
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+                               .sin_port = 0 };
+   socklen_t addr_len = sizeof addr;
+   if ( bind(sfd, (struct sockaddr *)&addr, sizeof addr) != 0
+        || getsockname(sfd, (struct sockaddr *)&addr, &addr_len) != 0 )
+   {
+      fprintf(stderr, "Error: Unable to find a free port, errno: %s (%d)\n", strerror(errno), errno);
+      close(sfd);
+      return 0;
+   }
+
+   close(sfd);
+   return addr.sin_port;
+}
+
+/**
+ * @brief Run one phase on nclients threads, and gather their results
+ */
+static bool runPhase( enum Phase phase,
+                      in_port_t port,
+                      unsigned nclients,
+                      unsigned duration_sec,
+                      struct PhaseResult * result )
+{
+   struct Worker * workers = calloc(nclients, sizeof(struct Worker));
+   if ( nullptr == workers )
+      return false;
+
+   // Workers and this thread all start the clock together, once every
+   // worker is set up (connected and warmed up, for the steady phase)
+   pthread_barrier_t start_line;
+   pthread_barrier_init(&start_line, nullptr, nclients + 1);
+
+   for ( unsigned i = 0; i < nclients; i++ )
+   {
+      workers[i] = (struct Worker){ .phase = phase,
+                                    .port = port,
+                                    .duration_sec = duration_sec,
+                                    .start_line = &start_line };
+   }
+   startWorkers(workers, nclients);
+
+   pthread_barrier_wait(&start_line);
+   uint64_t start_ns = monotonicNs();
+
+   bool ok = joinWorkers(workers, nclients, result);
+   result->elapsed_sec = (double)(monotonicNs() - start_ns) / 1e9;
+
+   pthread_barrier_destroy(&start_line);
+   free(workers);
+   return ok;
+}
+
+/**
+ * @brief Accept storm on nclients threads, /w one more steady client running
+ *        alongside as a probe of how the churn affects everyone else
+ */
+static bool runStorm( in_port_t port,
+                      unsigned nclients,
+                      unsigned nconns,
+                      struct StormResult * result )
+{
+   struct Worker * workers = calloc(nclients + 1, sizeof(struct Worker));
+   if ( nullptr == workers )
+      return false;
+
+   atomic_long conns_left = nconns;
+   atomic_bool stop = false;
+   pthread_barrier_t start_line;
+   pthread_barrier_init(&start_line, nullptr, nclients + 2); // + probe + this thread
+
+   for ( unsigned i = 0; i < nclients; i++ )
+   {
+      workers[i] = (struct Worker){ .phase = PHASE_STORM,
+                                    .port = port,
+                                    .start_line = &start_line,
+                                    .conns_left = &conns_left };
+   }
+   struct Worker * probe = &workers[nclients];
+   *probe = (struct Worker){ .phase = PHASE_REQUESTS,
+                             .port = port,
+                             .start_line = &start_line,
+                             .stop = &stop };
+   startWorkers(workers, nclients + 1);
+
+   long long overflows_before;
+   long long drops_before;
+   bool have_listen_stats = readListenStats(&overflows_before, &drops_before);
+
+   pthread_barrier_wait(&start_line);
+   uint64_t start_ns = monotonicNs();
+
+   bool ok = joinWorkers(workers, nclients, &result->conns);
+   result->conns.elapsed_sec = (double)(monotonicNs() - start_ns) / 1e9;
+
+   // The accept queue is FIFO, so once a fresh connection gets an answer,
+   // the acceptor has taken (and added) every storm connection before it
+   int sfd = connectLoopback(port);
+   uint64_t rtt_ns;
+   uint64_t residence_ns;
+   if ( sfd < 0 || !marcoPolo(sfd, 0, &rtt_ns, &residence_ns) )
+   {
+      fprintf(stderr, "Error: demo_server stopped answering after the storm.\n");
+      ok = false;
+   }
+   result->accept_elapsed_sec = (double)(monotonicNs() - start_ns) / 1e9;
+   if ( sfd >= 0 )
+      close(sfd);
+
+   atomic_store(&stop, true);
+   ok = joinWorkers(probe, 1, &result->probe) && ok;
+   result->probe.elapsed_sec = result->accept_elapsed_sec;
+
+   long long overflows_after;
+   long long drops_after;
+   have_listen_stats = have_listen_stats && readListenStats(&overflows_after, &drops_after);
+   result->listen_overflows = have_listen_stats ? overflows_after - overflows_before : -1;
+   result->listen_drops = have_listen_stats ? drops_after - drops_before : -1;
+
+   pthread_barrier_destroy(&start_line);
+   free(workers);
+   return ok;
+}
+
+static void startWorkers( struct Worker * workers, unsigned nworkers )
+{
+   for ( unsigned i = 0; i < nworkers; i++ )
+   {
+      int retcode = pthread_create(&workers[i].tid, nullptr, workerThread, &workers[i]);
+      if ( retcode != 0 )
+      {
+         // The start line's barrier would never fill; there's no way to
+         // release the workers already waiting on it, so give up on the run
+         fprintf( stderr,
+                  "Error: pthread_create() returned: %d : %s\n"
+                  "Only %u of %u client threads started.\n",
+                  retcode, strerror(retcode), i, nworkers );
+         exit(1);
+      }
+   }
+}
+
+/**
+ * @brief Wait for the workers, and add their results onto result
+ * @return false if their latency samples couldn't be merged
+ */
+static bool joinWorkers( struct Worker * workers, unsigned nworkers, struct PhaseResult * result )
+{
+   bool ok = true;
+   for ( unsigned i = 0; i < nworkers; i++ )
+   {
+      pthread_join(workers[i].tid, nullptr);
+      result->nops += workers[i].nops;
+      result->nerrors += workers[i].nerrors;
+      result->nbytes += workers[i].nbytes;
+      ok = ok && mergeSamples(&result->latency, &workers[i].latency)
+              && mergeSamples(&result->residence, &workers[i].residence);
+      free(workers[i].latency.ns);
+      free(workers[i].residence.ns);
+   }
+
+   if ( !ok )
+      fprintf(stderr, "Error: Out of memory for latency samples.\n");
+   return ok;
+}
+
+static void * workerThread( void * arg )
+{
+   struct Worker * w = arg;
+   constexpr uint64_t MARCO_MSG_SZ = SP_HDR_SZ + SP_MARCO_PAYLOAD_SZ;
+   constexpr uint64_t POLO_MSG_SZ = SP_HDR_SZ + SP_POLO_PAYLOAD_SZ;
+   uint64_t seq = 0;
+   uint64_t rtt_ns;
+   uint64_t residence_ns;
+
+   // Steady phase: connect and get past the server's first-contact delay (a
+   // new client waits for the responder to re-read its client list) before
+   // the clock starts, so only steady-state requests are measured
+   int sfd = -1;
+   if ( PHASE_REQUESTS == w->phase )
+   {
+      sfd = connectLoopback(w->port);
+      if ( sfd < 0 || !marcoPolo(sfd, seq++, &rtt_ns, &residence_ns) )
+         w->nerrors++;
+   }
+
+   pthread_barrier_wait(w->start_line);
+   uint64_t deadline = monotonicNs() + (uint64_t)w->duration_sec * 1'000'000'000u;
+   if ( w->nerrors > 0 )
+   {
+      if ( sfd >= 0 )
+         close(sfd);
+      return nullptr;
+   }
+
+   for ( ;; )
+   {
+      bool keep_going;
+      if ( PHASE_STORM == w->phase )
+         keep_going = atomic_fetch_sub(w->conns_left, 1) > 0;
+      else if ( nullptr != w->stop )
+         keep_going = !atomic_load(w->stop);
+      else
+         keep_going = monotonicNs() < deadline;
+      if ( !keep_going )
+         break;
+
+      if ( PHASE_STORM == w->phase )
+      {
+         uint64_t t0 = monotonicNs();
+         sfd = connectLoopback(w->port);
+         uint64_t t1 = monotonicNs();
+         if ( sfd < 0 )
+         {
+            w->nerrors++;
+            continue;
+         }
+
+         // Reset rather than close, so the storm doesn't leave a TIME_WAIT
+         // socket (and a used-up ephemeral port) behind for every connection.
+         // The server sees ECONNRESET instead of EOF; both drop the client.
+         setsockopt( sfd, SOL_SOCKET, SO_LINGER,
+                     &(struct linger){ .l_onoff = 1, .l_linger = 0 }, sizeof(struct linger) );
+         close(sfd);
+         sfd = -1;
+
+         w->nops++;
+         if ( !addSample(&w->latency, t1 - t0) )
+            break;
+      }
+      else if ( PHASE_CONNECT == w->phase )
+      {
+         uint64_t t0 = monotonicNs();
+         sfd = connectLoopback(w->port);
+         bool ok = sfd >= 0 && marcoPolo(sfd, seq++, &rtt_ns, &residence_ns);
+         uint64_t t1 = monotonicNs();
+         if ( sfd >= 0 )
+            close(sfd);
+         sfd = -1;
+
+         if ( !ok )
+         {
+            w->nerrors++;
+            continue;
+         }
+         w->nops++;
+         w->nbytes += MARCO_MSG_SZ + POLO_MSG_SZ;
+         if ( !addSample(&w->latency, t1 - t0) || !addSample(&w->residence, residence_ns) )
+            break;
+      }
+      else
+      {
+         if ( !marcoPolo(sfd, seq++, &rtt_ns, &residence_ns) )
+         {
+            w->nerrors++;
+            break; // connection's unusable now
+         }
+         w->nops++;
+         w->nbytes += MARCO_MSG_SZ + POLO_MSG_SZ;
+         if ( !addSample(&w->latency, rtt_ns) || !addSample(&w->residence, residence_ns) )
+            break;
+
+         // The storm's probe is there to sample latency, not to add load of
+         // its own (nor to burn through the responder's MAX_THREAD_REPS)
+         if ( nullptr != w->stop )
+            nanosleep( &(struct timespec){ .tv_nsec = PROBE_INTERVAL_NS }, nullptr );
+      }
+   }
+
+   if ( sfd >= 0 )
+      close(sfd);
+   return nullptr;
+}
+
+/**
+ * @brief Read the kernel's accept-queue counters from /proc/net/netstat
+ *
+ * ListenOverflows counts connections that completed the handshake while the
+ * accept queue was full; ListenDrops counts every SYN or handshake the
+ * listener dropped, overflows included. Both are per network namespace, not
+ * per socket, so anything else listening on the box shows up in them too.
+ *
+ * @return false if the counters aren't available (e.g. not Linux)
+ */
+static bool readListenStats( long long * overflows, long long * drops )
+{
+   *overflows = -1;
+   *drops = -1;
+
+   FILE * f = fopen("/proc/net/netstat", "r");
+   if ( nullptr == f )
+      return false;
+
+   // The file is pairs of lines: "TcpExt: <names...>" then "TcpExt: <values...>"
+   char * names = nullptr;
+   size_t names_cap = 0;
+   char * values = nullptr;
+   size_t values_cap = 0;
+   bool found = false;
+   while ( !found && getline(&names, &names_cap, f) > 0 )
+   {
+      if ( strncmp(names, "TcpExt:", sizeof("TcpExt:") - 1) == 0 )
+         found = getline(&values, &values_cap, f) > 0;
+   }
+   fclose(f);
+
+   if ( found )
+   {
+      char * names_save;
+      char * values_save;
+      for ( char * name = strtok_r(names, " \n", &names_save),
+                 * value = strtok_r(values, " \n", &values_save);
+            name != nullptr && value != nullptr;
+            name = strtok_r(nullptr, " \n", &names_save),
+            value = strtok_r(nullptr, " \n", &values_save) )
+      {
+         if ( strcmp(name, "ListenOverflows") == 0 )
+            *overflows = strtoll(value, nullptr, 10);
+         else if ( strcmp(name, "ListenDrops") == 0 )
+            *drops = strtoll(value, nullptr, 10);
+      }
+   }
+
+   free(names);
+   free(values);
+   return *overflows >= 0 && *drops >= 0;
+}
+
+/**
+ * @return connected socket, or -1
+ */
+static int connectLoopback( in_port_t port )
+{
+   int sfd = socket(AF_INET, SOCK_STREAM, 0);
+   if ( sfd < 0 )
+      return -1;
+
+   // Small request/reply messages; don't let Nagle hold them back
+   setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+
+   struct sockaddr_in addr = { .sin_family = AF_INET,
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+                               .sin_port = port };
+   int retcode;
+   do {
+      retcode = connect(sfd, (struct sockaddr *)&addr, sizeof addr);
+   } while ( retcode != 0 && EINTR == errno );
+
+   if ( retcode != 0 )
+   {
+      close(sfd);
+      return -1;
+   }
+   return sfd;
+}
+
+/**
+ * @brief One marco request and its polo reply
+ *
+ * @param[out] rtt_ns : round-trip time, as seen by this client
+ * @param[out] residence_ns : time the request spent inside the server
+ */
+static bool marcoPolo( int sfd, uint64_t seq, uint64_t * rtt_ns, uint64_t * residence_ns )
+{
+   uint8_t msg[SP_HDR_SZ + SP_MARCO_PAYLOAD_SZ];
+   spPackHdr( msg, &(struct SpMsgHdr){ .magic = SP_MAGIC,
+                                       .cmd = UCMD_MARCO,
+                                       .flags = SP_FLAG_NONE,
+                                       .len = SP_MARCO_PAYLOAD_SZ } );
+   uint64_t tx_ns = monotonicNs();
+   spPackMarco( msg + SP_HDR_SZ, &(struct SpMarco){ .seq = seq, .client_tx_ns = tx_ns } );
+
+   size_t sent = 0;
+   while ( sent < sizeof msg )
+   {
+      ssize_t nbytes = send(sfd, msg + sent, sizeof(msg) - sent, MSG_NOSIGNAL);
+      if ( nbytes < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         return false;
+      }
+      sent += (size_t)nbytes;
+   }
+
+   uint8_t reply[SP_HDR_SZ + SP_POLO_PAYLOAD_SZ];
+   if ( !recvExact(sfd, reply, SP_HDR_SZ) )
+      return false;
+
+   struct SpMsgHdr hdr;
+   spUnpackHdr(reply, &hdr);
+   if ( hdr.magic != SP_MAGIC || hdr.cmd != UCMD_MARCO
+        || hdr.flags != SP_FLAG_REPLY || hdr.len != SP_POLO_PAYLOAD_SZ
+        || !recvExact(sfd, reply + SP_HDR_SZ, SP_POLO_PAYLOAD_SZ) )
+      return false;
+
+   *rtt_ns = monotonicNs() - tx_ns;
+
+   struct SpPolo polo;
+   spUnpackPolo(reply + SP_HDR_SZ, &polo);
+   if ( polo.seq != seq )
+      return false;
+   *residence_ns = polo.server_tx_ns - polo.server_rx_ns;
+
+   return true;
+}
+
+static bool recvExact( int sfd, uint8_t * buf, size_t len )
+{
+   size_t got = 0;
+   while ( got < len )
+   {
+      ssize_t nbytes = recv(sfd, buf + got, len - got, 0);
+      if ( nbytes < 0 && EINTR == errno )
+         continue;
+      if ( nbytes <= 0 )
+         return false;
+      got += (size_t)nbytes;
+   }
+   return true;
+}
+
+static bool addSample( struct Samples * samples, uint64_t ns )
+{
+   if ( samples->len == samples->cap )
+   {
+      size_t new_cap = (0 == samples->cap) ? 4'096 : 2 * samples->cap;
+      uint64_t * new_ns = realloc(samples->ns, new_cap * sizeof(uint64_t));
+      if ( nullptr == new_ns )
+         return false;
+      samples->ns = new_ns;
+      samples->cap = new_cap;
+   }
+   samples->ns[samples->len++] = ns;
+   return true;
+}
+
+static bool mergeSamples( struct Samples * dst, const struct Samples * src )
+{
+   if ( 0 == src->len )
+      return true;
+
+   uint64_t * new_ns = realloc(dst->ns, (dst->len + src->len) * sizeof(uint64_t));
+   if ( nullptr == new_ns )
+      return false;
+   memcpy(new_ns + dst->len, src->ns, src->len * sizeof(uint64_t));
+   dst->ns = new_ns;
+   dst->len += src->len;
+   dst->cap = dst->len;
+   return true;
+}
+
+static int cmpU64( const void * a, const void * b )
+{
+   uint64_t lhs = *(const uint64_t *)a;
+   uint64_t rhs = *(const uint64_t *)b;
+   return (lhs > rhs) - (lhs < rhs);
+}
+
+/**
+ * @brief Nearest-rank percentile
+ * @param[in] sorted : non-empty, ascending samples
+ */
+static double percentileUs( const struct Samples * sorted, double pct )
+{
+   assert(sorted->len > 0);
+   size_t rank = (size_t)(pct / 100.0 * (double)sorted->len + 0.999'999);
+   if ( rank < 1 )
+      rank = 1;
+   if ( rank > sorted->len )
+      rank = sorted->len;
+   return (double)sorted->ns[rank - 1] / 1e3;
+}
+
+static void writeLatencyJson( FILE * f, const char * name, struct Samples * samples )
+{
+   if ( 0 == samples->len )
+   {
+      fprintf(f, "      \"%s\": null", name);
+      return;
+   }
+
+   qsort(samples->ns, samples->len, sizeof(uint64_t), cmpU64);
+   double sum = 0.0;
+   for ( size_t i = 0; i < samples->len; i++ )
+      sum += (double)samples->ns[i];
+
+   fprintf( f,
+            "      \"%s\": { \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+            "\"p99\": %.3f, \"p99.9\": %.3f, \"max\": %.3f }",
+            name,
+            sum / (double)samples->len / 1e3,
+            percentileUs(samples, 50.0),
+            percentileUs(samples, 90.0),
+            percentileUs(samples, 99.0),
+            percentileUs(samples, 99.9),
+            (double)samples->ns[samples->len - 1] / 1e3 );
+}
+
+static bool writeStormJson( const char * path,
+                            const char * label,
+                            const char * server_exe,
+                            unsigned nclients,
+                            unsigned nconns,
+                            struct StormResult * storm )
+{
+   FILE * f = fopen(path, "w");
+   if ( nullptr == f )
+   {
+      fprintf(stderr, "Error: Unable to open %s, errno: %s (%d)\n", path, strerror(errno), errno);
+      return false;
+   }
+
+   fprintf( f,
+            "{\n"
+            "   \"benchmark\": \"accept_storm\",\n"
+            "   \"label\": \"%s\",\n"
+            "   \"server\": \"%s\",\n"
+            "   \"timestamp\": %lld,\n"
+            "   \"nclients\": %u,\n"
+            "   \"nconns\": %u,\n",
+            label, server_exe, (long long)time(nullptr), nclients, nconns );
+
+   fprintf( f,
+            "   \"connections\": {\n"
+            "      \"total\": %llu,\n"
+            "      \"errors\": %llu,\n"
+            "      \"connect_elapsed_sec\": %.3f,\n"
+            "      \"connects_per_sec\": %.1f,\n"
+            "      \"accept_elapsed_sec\": %.3f,\n"
+            "      \"accepts_per_sec\": %.1f,\n",
+            (unsigned long long)storm->conns.nops, (unsigned long long)storm->conns.nerrors,
+            storm->conns.elapsed_sec, (double)storm->conns.nops / storm->conns.elapsed_sec,
+            storm->accept_elapsed_sec, (double)storm->conns.nops / storm->accept_elapsed_sec );
+   writeLatencyJson(f, "connect_us", &storm->conns.latency);
+   fprintf(f, "\n   },\n");
+
+   if ( storm->listen_overflows >= 0 )
+   {
+      fprintf( f,
+               "   \"listen_overflows\": %lld,\n"
+               "   \"listen_drops\": %lld,\n",
+               storm->listen_overflows, storm->listen_drops );
+   }
+   else
+   {
+      fprintf(f, "   \"listen_overflows\": null,\n   \"listen_drops\": null,\n");
+   }
+
+   fprintf( f,
+            "   \"registry_churn\": {\n"
+            "      \"probe_requests\": %llu,\n"
+            "      \"probe_errors\": %llu,\n",
+            (unsigned long long)storm->probe.nops, (unsigned long long)storm->probe.nerrors );
+   writeLatencyJson(f, "probe_rtt_us", &storm->probe.latency);
+   fprintf(f, "\n   }\n}\n");
+
+   bool ok = !ferror(f);
+   ok = (fclose(f) == 0) && ok;
+   if ( !ok )
+      fprintf(stderr, "Error: Failed writing %s.\n", path);
+   return ok;
+}
+
+/**
+ * @note label and server_exe are written as-is; keep JSON-special characters
+ *       (quotes, backslashes) out of them
+ */
+static bool writeJson( const char * path,
+                       const char * label,
+                       const char * server_exe,
+                       unsigned nclients,
+                       unsigned duration_sec,
+                       struct PhaseResult * churn,
+                       struct PhaseResult * steady )
+{
+   FILE * f = fopen(path, "w");
+   if ( nullptr == f )
+   {
+      fprintf(stderr, "Error: Unable to open %s, errno: %s (%d)\n", path, strerror(errno), errno);
+      return false;
+   }
+
+   fprintf( f,
+            "{\n"
+            "   \"benchmark\": \"loopback\",\n"
+            "   \"label\": \"%s\",\n"
+            "   \"server\": \"%s\",\n"
+            "   \"timestamp\": %lld,\n"
+            "   \"nclients\": %u,\n"
+            "   \"duration_sec\": %u,\n",
+            label, server_exe, (long long)time(nullptr), nclients, duration_sec );
+
+   fprintf( f,
+            "   \"connections\": {\n"
+            "      \"total\": %llu,\n"
+            "      \"errors\": %llu,\n"
+            "      \"elapsed_sec\": %.3f,\n"
+            "      \"per_sec\": %.1f,\n",
+            (unsigned long long)churn->nops, (unsigned long long)churn->nerrors,
+            churn->elapsed_sec, (double)churn->nops / churn->elapsed_sec );
+   writeLatencyJson(f, "connect_to_first_reply_us", &churn->latency);
+   fprintf(f, "\n   },\n");
+
+   fprintf( f,
+            "   \"requests\": {\n"
+            "      \"total\": %llu,\n"
+            "      \"errors\": %llu,\n"
+            "      \"elapsed_sec\": %.3f,\n"
+            "      \"per_sec\": %.1f,\n"
+            "      \"bytes_per_sec\": %.1f,\n",
+            (unsigned long long)steady->nops, (unsigned long long)steady->nerrors,
+            steady->elapsed_sec, (double)steady->nops / steady->elapsed_sec,
+            (double)steady->nbytes / steady->elapsed_sec );
+   writeLatencyJson(f, "rtt_us", &steady->latency);
+   fprintf(f, ",\n");
+   writeLatencyJson(f, "server_residence_us", &steady->residence);
+   fprintf(f, "\n   }\n}\n");
+
+   bool ok = !ferror(f);
+   ok = (fclose(f) == 0) && ok;
+   if ( !ok )
+      fprintf(stderr, "Error: Failed writing %s.\n", path);
+   return ok;
+}
+
+static uint64_t monotonicNs( void )
+{
+   struct timespec ts;
+   int retcode = clock_gettime(CLOCK_MONOTONIC, &ts);
+   assert(retcode == 0); // CLOCK_MONOTONIC is always supported on POSIX.1-2008
+   (void)retcode;
+   return (uint64_t)ts.tv_sec * 1'000'000'000u + (uint64_t)ts.tv_nsec;
+}
+
+static bool parseUnsigned( const char * str, unsigned min, unsigned max, unsigned * val )
+{
+   char * end;
+   errno = 0;
+   unsigned long parsed = strtoul(str, &end, 10);
+   if ( 0 != errno || end == str || *end != '\0' || parsed < min || parsed > max )
+      return false;
+   *val = (unsigned)parsed;
+   return true;
+}
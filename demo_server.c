@@ -5,12 +5,16 @@
 
 /*************************** File Header Inclusions ***************************/
 #define _POSIX_C_SOURCE 200809L // Specify atleast POSIX.1-2008 compatibility
+#ifdef __linux__
+#define _GNU_SOURCE // CPU affinity, for the per-core mode
+#endif
 
 // General-Purpose Headers
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
@@ -27,23 +31,293 @@
 // Tangential Headers
 #include <signal.h>
 #include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
 #include <stdatomic.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/tcp.h> // struct tcp_info, which glibc hides under strict POSIX
+#include <linux/errqueue.h> // zero-copy send completions
+#endif
+
+// Socket Practice (SP) Protocol
+#include "misc-practice/sp-proto.h"
+#include "misc-practice/sp-stats.h"
+#include "misc-practice/sp-trace.h"
+#include "misc-practice/sp-flightrec.h"
+#include "misc-practice/sp-wsdeque.h"
+#include "misc-practice/sp-spsc.h"
+// get-addr-info's lookups (unity build, like the demos; pulls in resolver_cache.c)
+#include "misc-practice/async_resolver.c"
 
 /***************************** Local Declarations *****************************/
 constexpr size_t MAX_CLIENTS = 1'000;
 constexpr size_t MAX_SERVERS = 1'000;
 constexpr size_t MAX_THREAD_REPS = 1'000'000;
-constexpr int STREAM_LISTEN_QUEUE_SZ = 5;
+// A short accept queue overflows under reconnect storms: the kernel finishes
+// handshakes faster than the acceptor gets scheduled, and every SYN dropped
+// on overflow costs that client a 1 s retransmit. Let the kernel cap it.
+constexpr int STREAM_LISTEN_QUEUE_SZ = SOMAXCONN;
 // Honestly, 1 second is too long, but let's optimize later
 constexpr time_t MAX_MTX_LOCK_WAIT_SEC = 1;
 constexpr time_t MAX_MTX_PRINTF_LOCK_WAIT_SEC = 3;
+// How long the responder waits on its clients before re-reading the client
+// list, which is how it notices newly accepted clients
+constexpr int RESPONDER_POLL_TIMEOUT_MS = 250;
+// Replies a client's socket won't take yet get queued (see sendMsg()), and
+// nothing more is read from it until they're out. A client that lets this
+// much pile up isn't reading its replies, and gets dropped.
+constexpr size_t CLIENT_MAX_TX_QUEUED_SZ = 64 * 1'024;
+
+// Multiplexed listeners (tcp-create-mux, udp-create; see muxInit()): any
+// number of them, all served by a fixed set of event-loop workers. Building
+// /w -DMUX_NWORKERS=0 (the default) starts one worker per online CPU.
+#ifndef MUX_NWORKERS
+#define MUX_NWORKERS 0
+#endif
+constexpr size_t MUX_MAX_WORKERS = 64;
+constexpr size_t MUX_QUEUE_CAP = 64; // must be a power of two
+// A worker's poll set starts out this big, and doubles whenever it fills up
+constexpr size_t MUX_INITIAL_NENTRIES = 64;
+
+// Request executor (see execInit()). Building /w -DEXEC_NWORKERS=0 (the
+// default) starts one worker per online CPU, but no fewer than
+// EXEC_MIN_WORKERS: a worker waiting on DNS isn't using its CPU, and one
+// stuck lookup shouldn't hold up every other on a small box.
+#ifndef EXEC_NWORKERS
+#define EXEC_NWORKERS 0
+#endif
+constexpr size_t EXEC_MIN_WORKERS = 4;
+constexpr size_t EXEC_MAX_WORKERS = 64;
+// A responder has at most one task per client in flight, so its deque can't
+// fill up
+constexpr size_t EXEC_DEQUE_CAP = 1'024;
+// Every worker's deque, plus every responder's and event-loop worker's
+constexpr size_t EXEC_MAX_DEQUES = EXEC_MAX_WORKERS + MAX_SERVERS + MUX_MAX_WORKERS;
+
+static_assert(EXEC_DEQUE_CAP >= MAX_CLIENTS, "A responder's deque must fit all of its clients");
+
+// Thread-per-core mode (tcp-create-percore): one worker pinned to each CPU
+// we're allowed on, each /w its own SO_REUSEPORT listener and everything else
+// it needs, talking to the REPL only through a pair of SPSC queues
+constexpr size_t PERCORE_QUEUE_CAP = 8;
+constexpr time_t PERCORE_START_TIMEOUT_SEC = 5;
+// Each resolver thread hands a core's finished lookups back through a queue
+// of its own (see onAddrInfoResolved()). A core has at most one lookup out
+// per client, so these never fill up.
+constexpr size_t PERCORE_LOOKUP_QUEUE_CAP = 1'024;
+static_assert(PERCORE_LOOKUP_QUEUE_CAP >= MAX_CLIENTS, "Every client may have a lookup out");
+
+// Zero-copy sends (see sendMsg()): a reply at least this big goes out /w
+// MSG_ZEROCOPY, straight from a buffer the kernel pins, instead of being
+// copied into the socket buffer first. Under ~10 KB the pinning and the
+// completion notification cost more than the copy they save.
+// NOTE: This is OFF in a default build. No SP reply can exceed SP_MAX_MSG_SZ
+//       (1'032 bytes), so zcEnable() and the rest of the zero-copy path never
+//       run unless the server is built /w a smaller -DZEROCOPY_MIN_SZ (e.g.,
+//       -DZEROCOPY_MIN_SZ=1 to exercise it). Nothing is set up on a socket
+//       until its first reply that qualifies, so leaving it compiled in is free.
+#ifndef ZEROCOPY_MIN_SZ
+#define ZEROCOPY_MIN_SZ 16'384
+#endif
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define ZEROCOPY_SUPPORTED 1
+#else
+#define ZEROCOPY_SUPPORTED 0
+#endif
+constexpr size_t ZC_MIN_SZ = ZEROCOPY_MIN_SZ;
+// Past this many replies the kernel hasn't let go of yet (e.g., a client
+// that stopped reading), a client's replies get copied again
+constexpr size_t ZC_MAX_INFLIGHT = 64;
+// Buffers a client keeps around for its next zero-copy replies
+constexpr size_t ZC_MAX_FREE_TXBUFS = 4;
+// Closing a socket doesn't stop the kernel sending what's queued on it, out
+// of our buffers, but nobody's left to hear when it's done. So buffers still
+// in flight when their client goes away sit out this long before being freed.
+constexpr uint64_t ZC_ORPHAN_GRACE_NS = 10'000'000'000u;
+
+// Threads per-core contexts' get-addr-info lookups get carried out on (see
+// dispatchGetAddrInfo()), since cores have no executor to block instead. They
+// spend nearly all their time waiting on DNS servers, so a few go a long way.
+constexpr size_t RESOLVER_NWORKERS = 4;
+
+// Commands worth a trip to the executor: ones that can block or take a while.
+// The rest cost less to carry out on the spot than the hand-off would.
+static const bool ExecOffloadCmd[UCMD_UNKNOWN + 1] = { [UCMD_GETADDRINFO] = true };
 
 static volatile sig_atomic_t bUserEndedSession = false;
 
-static pthread_mutex_t mtxPrintf = PTHREAD_MUTEX_INITIALIZER;
+// Shared by every per-core context; ResolverUp is false if it couldn't be
+// started, in which case their get-addr-info blocks on getaddrinfo() itself
+static struct AsyncResolver Resolver;
+static bool ResolverUp;
+// Set by dispatchGetAddrInfo() when the rest of the client's requests have to
+// wait for its lookup to come back
+static thread_local bool tlsSuspended;
+// The per-core worker this thread is, if it's one
+static thread_local struct CoreShard * tlsCore;
+// Which of every core's lookups_done queues this resolver thread posts to
+// (-1 until its first), handed out in the order they first need one
+static thread_local int tlsResolverLane = -1;
+static _Atomic size_t ResolverNLanes;
+
+// Live counters, published in shared memory (see sp-stats.h). Contexts[i]'s
+// counters are StatsShm->ctxs[i]. Only the REPL (main thread) touches these
+// two arrays' bookkeeping; the context threads only count.
+static struct SpStatsShm * StatsShm;
+static char StatsShmName[sizeof SP_STATS_SHM_PREFIX + 3 * sizeof(pid_t)];
+static struct StreamContext * Contexts[MAX_SERVERS];
+static size_t NContexts;
+// The counter slot of whichever context thread this is (nullptr for the REPL)
+static thread_local struct SpStatsSlot * tlsStats;
+
+static_assert(MAX_SERVERS <= SP_STATS_MAX_CTXS, "Every context needs a stats entry");
+static_assert(EXEC_MAX_WORKERS <= SP_STATS_MAX_EXEC_WORKERS, "Every executor worker needs a stats slot");
+
+// Log-linear latency histogram: every power of two is split into
+// LAT_HIST_NSUB linear sub-buckets, so a bucket is at most 1/LAT_HIST_NSUB
+// (6.25%) wider than the values in it, from 1 ns up to LAT_HIST_MAX_NS.
+constexpr unsigned LAT_HIST_SUB_BITS = 4;
+constexpr uint64_t LAT_HIST_NSUB = 1u << LAT_HIST_SUB_BITS;
+// Samples past ~18 minutes get clamped into the last bucket
+constexpr unsigned LAT_HIST_MAX_BITS = 40;
+constexpr uint64_t LAT_HIST_MAX_NS = (1ull << LAT_HIST_MAX_BITS) - 1;
+constexpr size_t LAT_HIST_NBUCKETS = (LAT_HIST_MAX_BITS - LAT_HIST_SUB_BITS + 1) * LAT_HIST_NSUB;
+
+struct LatencyHist
+{
+   _Atomic uint64_t counts[LAT_HIST_NBUCKETS];
+};
+
+// Service time of every command in sp-cmds.h (+ anything unrecognized),
+// written only by the thread it belongs to: a context's responder, or an
+// executor worker
+struct CmdLatency
+{
+   struct LatencyHist cmds[UCMD_UNKNOWN + 1];
+};
+
+// Lock profiling: how long threads wait for and hold each ProfMutex, and
+// from where. Owner tracking (who holds a lock, and since when) is always
+// on, since it's what a lock timeout gets reported /w; building /w
+// -DLOCK_PROFILING=0 drops the timing and histograms.
+#ifndef LOCK_PROFILING
+#define LOCK_PROFILING 1
+#endif
+#define PROF_STR_(x) #x
+#define PROF_STR(x) PROF_STR_(x)
+// Where a lock gets taken, as a string literal: "demo_server.c:123"
+#define PROF_SITE __FILE__ ":" PROF_STR(__LINE__)
+constexpr size_t LOCKPROF_MAX_SITES = 8;
+
+struct LockSiteStats
+{
+   // A PROF_SITE literal, nullptr if the slot's unused. Published /w release
+   // semantics, since the report command reads it without holding the lock.
+   _Atomic(const char *) site;
+   _Atomic uint64_t nacquired;
+   _Atomic uint64_t ncontended;
+   _Atomic uint64_t wait_ns;
+   _Atomic uint64_t hold_ns;
+};
+
+/**
+ * @brief A mutex that knows who holds it, and (/w LOCK_PROFILING) how it's
+ *        being fought over
+ *
+ * All the bookkeeping is done while holding the mutex itself, so it needs no
+ * synchronization of its own. The atomics are only there for readers that
+ * don't hold it: the report command, and a waiter that timed out.
+ */
+struct ProfMutex
+{
+   pthread_mutex_t mtx;
+   const char * name;
+   time_t max_wait_sec;
+   // Current owner. owner_name points at the owning thread's tlsThreadName.
+   _Atomic(const char *) owner_name;
+   _Atomic(const char *) owner_site;
+   _Atomic uint64_t owner_since_ns;
+#if LOCK_PROFILING
+   _Atomic uint64_t nacquired;
+   _Atomic uint64_t ncontended; // acquisitions that had to wait
+   _Atomic uint64_t ntimeouts;
+   struct LatencyHist wait;
+   struct LatencyHist hold;
+   struct LockSiteStats sites[LOCKPROF_MAX_SITES];
+   _Atomic uint64_t nsites_overflowed; // acquisitions from sites past the table
+#endif
+};
+
+static struct ProfMutex mtxPrintf = { .mtx = PTHREAD_MUTEX_INITIALIZER,
+                                      .name = "mtxPrintf",
+                                      .max_wait_sec = MAX_MTX_PRINTF_LOCK_WAIT_SEC };
+// TX buffers whose clients went away while they were in flight, oldest first
+// (see zcRelease())
+static struct ProfMutex mtxZcOrphans = { .mtx = PTHREAD_MUTEX_INITIALIZER,
+                                         .name = "mtxZcOrphans",
+                                         .max_wait_sec = MAX_MTX_LOCK_WAIT_SEC };
+static struct TxBuf * ZcOrphans;
+static struct TxBuf * ZcOrphansTail;
+// What this thread shows up as when it holds a lock (or in a flight recording)
+static thread_local char tlsThreadName[FR_THREAD_NAME_SZ] = "main";
+
+// Flight recorder (see sp-flightrec.h): every thread gets a ring of its
+// latest events, which only it writes, /w plain stores. Rings are never
+// freed, so a dump also shows what threads that already exited last did.
+constexpr size_t FR_RING_NEVENTS = 4'096; // must be a power of two
+// The REPL, an acceptor and a responder per context, and the executor's and
+// event loop's workers
+constexpr size_t FR_MAX_RINGS = 1 + 2 * MAX_SERVERS + EXEC_MAX_WORKERS + MUX_MAX_WORKERS;
+
+struct FrRing
+{
+   char name[FR_THREAD_NAME_SZ];
+   _Atomic uint64_t head; // total events ever recorded
+   struct FrEvent events[FR_RING_NEVENTS];
+};
+
+static_assert((FR_RING_NEVENTS & (FR_RING_NEVENTS - 1)) == 0, "Ring indexing masks the head");
+
+static struct FrRing * _Atomic FrRings[FR_MAX_RINGS];
+static atomic_size_t FrNRings;
+// Built up front, since the crash handler can't call snprintf()
+static char FrDumpPath[sizeof FR_DUMP_PREFIX + 3 * sizeof(pid_t) + sizeof FR_DUMP_SUFFIX];
+static thread_local struct FrRing * tlsRing;
+
+struct ExecWorker
+{
+   pthread_t thread;
+   struct SpWsDeque deque;
+   // Only the worker itself writes these
+   _Atomic uint64_t nrun;          // tasks run
+   _Atomic uint64_t nstolen;       // ... of which were taken off another thread's deque
+   _Atomic uint64_t nsteal_aborts; // steals lost to another thread
+   _Atomic uint64_t busy_ns;       // time spent running tasks
+   // Service times of the requests it's carried out, whichever context they
+   // came in on. printLatency() merges them /w the contexts' own.
+   struct CmdLatency * latency;
+   struct CmdLatency * latency_base; // see StreamContext's
+};
+
+static struct ExecWorker * ExecWorkers;
+static size_t ExecNWorkers;
+// Every deque there is to steal from: the workers' own, then the responders'
+static struct SpWsDeque * _Atomic ExecDeques[EXEC_MAX_DEQUES];
+static atomic_size_t ExecNDeques;
+// Tasks submitted but not yet claimed. A worker only goes looking for a task
+// once it's claimed one of these, so it knows there's one out there to find.
+static sem_t ExecNPending;
+// This thread's deque, if it has one; tasks it submits go there
+static thread_local struct SpWsDeque * tlsDeque;
+// This thread's ExecWorkers[] entry, if it's an executor worker
+static thread_local struct ExecWorker * tlsWorker;
 
 // Some errors shouldn't abort the program, but we will still return a code
 // indicating something went wrong. To account for a possible accumulation
@@ -61,15 +335,101 @@ enum MainRetCode
    MAINRC_FAILED_CLOSE            = 0x0040,
 };
 
+// A unit of work for the executor: run(arg), on whichever worker gets to it
+struct ExecTask
+{
+   void (*run)(void * arg);
+   void * arg;
+};
+
+// A reply's bytes, for as long as the kernel may still be reading them (see
+// sendMsg())
+struct TxBuf
+{
+   struct TxBuf * next;
+   // The kernel numbers a socket's zero-copy sends from 0 up, and this reply
+   // went out in sends first_id through first_id + nids - 1 (more than one
+   // if it went out in pieces)
+   uint32_t first_id;
+   uint32_t nids;
+   uint32_t npending; // of those, how many the kernel hasn't reported done
+   uint64_t orphaned_ns; // when its client went away /w it still in flight
+   uint8_t data[SP_MAX_MSG_SZ];
+};
+
+enum ZcState
+{
+   ZC_UNTRIED, // SO_ZEROCOPY not asked for yet
+   ZC_ON,
+   ZC_UNSUPPORTED,
+};
+
+// A client's zero-copy sends. Owned like the rest of the client: by whoever
+// serves it, or by the worker while it's busy.
+struct ZcTx
+{
+   enum ZcState state;
+   uint32_t next_id; // what the kernel will number the next zero-copy send
+   struct TxBuf * inflight; // oldest first
+   struct TxBuf * inflight_tail;
+   size_t ninflight;
+   struct TxBuf * free;
+   size_t nfree;
+};
+
 struct Client
 {
    int sfd; // socket descriptor of server socket communicating /w this client
    in_addr_t addr;
    in_port_t port;
+   struct StreamContext * ctx; // the context this client talks to
+   // Set by the responder when it hands the client's requests off to the
+   // executor, and cleared (/w release semantics) by the worker once it's done
+   // /w them. While it's set, only that worker touches the client.
+   atomic_bool busy;
+   bool drop; // the worker's verdict: hang up on this client
+   // Carries out its requests; run by the executor, or right away by the
+   // thread that read them
+   struct ExecTask task;
+   uint64_t rx_ns; // when the requests being worked on came off the socket
+   // The get-addr-info being looked up (see dispatchGetAddrInfo()), and its
+   // reply. On a per-core context, the resolver callback fills the reply in
+   // for the core to send.
+   uint64_t lookup_start_ns;
+   bool lookup_failed;
+   size_t lookup_reply_len;
+   char lookup_reply[SP_MAX_PAYLOAD_SZ];
+   // A UDP listener has a single client, standing for the socket itself,
+   // which replies to whoever sent the request being worked on. Requests it
+   // offloads each get their own copy of it (struct DgramRequest), so it
+   // never goes busy itself; it only counts them, since they use its socket.
+   bool dgram;
+   struct sockaddr_in peer;
+   _Atomic size_t ndgrams_out;
+   struct ZcTx zc;
+   // Bytes received but not yet forming a complete SP message, or (while
+   // busy) not yet carried out, from rx_off on
+   size_t rx_len;
+   size_t rx_off;
+   uint8_t rx_buf[SP_MAX_MSG_SZ];
+   // Reply bytes the socket wouldn't take yet, oldest first, sent once it's
+   // writable again (nullptr until needed)
+   uint8_t * tx_buf;
+   size_t tx_len;
+   size_t tx_cap;
    // linked-list of clients makes arbitrary insertion/removal somewhat easier
    struct Client * next;
 };
 
+// An offloaded datagram: a copy of its listener's client, /w the request
+// and whoever sent it, for the executor to carry out while the listener
+// goes on reading
+struct DgramRequest
+{
+   struct Client client;
+   struct Client * listener;
+};
+
 struct ClientList
 {
    struct Client * head;
@@ -82,17 +442,141 @@ struct StreamContext
    atomic_bool enabled;
    pthread_t acceptor;
    pthread_t responder;
-   pthread_mutex_t mtx;
+   struct ProfMutex mtx;
    int listening_sfd; // socket descriptor
    struct in_addr listening_addr;
    in_port_t listening_port;
    struct ClientList clients;
+   struct SpStatsCtx * stats; // this context's entry in StatsShm
+   struct CmdLatency * latency;
+   // Counts as of the last latency reset, which only the REPL touches.
+   // Resetting by subtracting a snapshot means the responder never has to
+   // coordinate /w the REPL.
+   struct CmdLatency * latency_base;
+   // The responder's deque, which workers steal its clients' requests from
+   struct SpWsDeque deque;
+   // Workers poke this pipe when they hand a client back, so the responder
+   // puts it back in its poll set right away. -1 if there's none.
+   int wake_pipe[2];
+   int cpu; // what it's pinned to in per-core mode, -1 otherwise
+   struct CoreShard * core; // the per-core worker serving it, if any
+   int sock_type; // SOCK_STREAM, or SOCK_DGRAM for a multiplexed UDP listener
+   // The event-loop worker serving it, if it's multiplexed (nullptr if not),
+   // and how many of that worker's poll entries are its, listener included.
+   // Only that worker touches mux_nentries.
+   struct MuxWorker * mux;
+   size_t mux_nentries;
+};
+
+// Messages between the REPL and a per-core worker (struct SpSpscMsg types)
+enum CoreMsgType
+{
+   CORE_MSG_UP,     // core -> REPL: serving, ptr = its StreamContext
+   CORE_MSG_FAILED, // core -> REPL: couldn't get going, arg = errno; it's exiting
+   CORE_MSG_STOP,   // REPL -> core: close everything and exit
+};
+
+// The REPL's handle on a per-core worker. Everything the worker serves /w
+// lives in its own StreamContext, which it allocates itself, but which the
+// REPL frees after joining it, since Contexts[] points at it once it's up.
+struct CoreShard
+{
+   int cpu;
+   pthread_t thread;
+   struct in_addr addr;
+   in_port_t port;
+   struct SpStatsCtx * stats; // claimed by the REPL, since it owns StatsShm's bookkeeping
+   struct StreamContext * ctx; // set by the worker when it reports CORE_MSG_UP
+   struct SpSpscQueue to_core;
+   struct SpSpscQueue from_core;
+   // get-addr-info lookups the resolver threads are done /w, one queue per
+   // resolver thread so that each has a single producer. Every push is
+   // followed by a poke at the context's wake-up pipe.
+   struct SpSpscQueue lookups_done[RESOLVER_NWORKERS];
+   // Lookups out on the resolver. Each callback drops it as the very last
+   // thing it does, so once it's 0 none of them can touch the core's clients
+   // or its pipe any more.
+   _Atomic size_t nlookups_out;
+};
+
+static struct CoreShard * CoreShards[MAX_SERVERS];
+static size_t NCoreShards;
+
+// Messages between the REPL and an event-loop worker (struct SpSpscMsg types)
+enum MuxMsgType
+{
+   MUX_MSG_ADD,  // REPL -> worker: start serving ptr (a StreamContext)
+   MUX_MSG_RMV,  // REPL -> worker: close ptr's listener and all of its clients
+   MUX_MSG_DONE, // worker -> REPL: ptr's closed, and its slot free to reuse
+   MUX_MSG_STOP, // REPL -> worker: close everything and exit
+};
+
+enum MuxEntryKind
+{
+   MUX_ENT_WAKE,     // the worker's wake-up pipe
+   MUX_ENT_LISTENER, // a TCP listener
+   MUX_ENT_DGRAM,    // a UDP listener, served through its one client
+   MUX_ENT_CLIENT,   // a TCP client
+};
+
+// What one of a worker's pollfds is for
+struct MuxEntry
+{
+   enum MuxEntryKind kind;
+   struct StreamContext * ctx;
+   struct Client * client; // MUX_ENT_DGRAM and MUX_ENT_CLIENT only
+};
+
+// A worker's poll set: pfds[i] is for ents[i], and [0] is the wake-up pipe
+struct MuxPollSet
+{
+   struct pollfd * pfds;
+   struct MuxEntry * ents;
+   size_t n;
+   size_t cap;
+};
+
+struct MuxWorker
+{
+   pthread_t thread;
+   struct SpSpscQueue inbox;  // from the REPL
+   struct SpSpscQueue outbox; // to the REPL
+   // The REPL pokes this after pushing onto inbox, and executor workers do
+   // after handing a client back
+   int wake_pipe[2];
+   struct SpWsDeque deque;
+   // Only the worker itself writes these. The REPL balances new listeners on
+   // the first two.
+   _Atomic size_t nlisteners;
+   _Atomic size_t nclients;
+   _Atomic uint64_t nloops;
+   _Atomic uint64_t nready; // pollfds ready, summed over the loops
 };
 
+static struct MuxWorker * MuxWorkers;
+static size_t MuxNWorkers;
+
 static void handleSIGINT(int sig_num);
+static void handleCrashSignal(int sig_num);
 
 static void * acceptorThread(void * arg);
 static void * responderThread(void * arg);
+static bool startPerCore(struct in_addr addr, in_port_t port);
+static void stopPerCore(void);
+static void coreShardFree(struct CoreShard * shard);
+static void * coreThread(void * arg);
+static void coreResumeLookups(struct CoreShard * shard);
+
+static bool muxInit(void);
+static bool muxCreate(int sock_type, struct in_addr addr, in_port_t port);
+static bool muxDestroy(size_t ctx_idx, int sock_type);
+static void muxStop(void);
+static void muxSend(struct MuxWorker * worker, enum MuxMsgType type, void * ptr);
+static void muxReap(struct MuxWorker * worker);
+static void * muxWorkerThread(void * arg);
+static bool muxPollSetAdd( struct MuxPollSet * set, int fd, struct MuxEntry ent );
+static void muxPollSetRmv( struct MuxPollSet * set, size_t i );
+static void printMux(void);
 
 static bool addClient( struct StreamContext * ctx,
                        const struct Client * client_info );
@@ -100,6 +584,75 @@ static bool rmvClient( struct StreamContext * ctx,
                        in_addr_t ip,
                        in_port_t port );
 
+static bool serviceClient( struct StreamContext * ctx, struct Client * client );
+static void serviceDatagram( struct StreamContext * ctx, struct Client * client );
+static bool serveRequests( struct Client * client );
+static void runClientRequests(void * arg);
+static void runDatagramRequest(void * arg);
+static void recordDispatch( struct Client * client,
+                            uint8_t cmd,
+                            uint64_t dispatch_ns,
+                            bool dispatched );
+static bool dispatchMsg( struct Client * client,
+                         const struct SpMsgHdr * hdr,
+                         const uint8_t * payload,
+                         uint64_t rx_ns );
+static bool dispatchInetPton( struct Client * client, const uint8_t * payload, size_t len );
+static bool dispatchGetAddrInfo( struct Client * client, const uint8_t * payload, size_t len );
+static void onAddrInfoResolved( int gai_retcode, const struct addrinfo * result, void * user_arg );
+static void setLookupReply( struct Client * client, int gai_retcode, const struct addrinfo * list );
+static bool sendLookupReply( struct Client * client );
+static bool sendMsg( struct Client * client,
+                     enum UserCmdCode cmd,
+                     uint8_t flags,
+                     const void * payload,
+                     size_t payload_len );
+static bool clientQueueTx( struct Client * client, const uint8_t * bytes, size_t len );
+static bool clientFlushTx( struct Client * client );
+static void clientRelease( struct Client * client );
+static int acceptNonBlocking( int listening_sfd, struct sockaddr_in * peer, socklen_t * peer_len );
+static bool zcEnable( struct Client * client );
+static struct TxBuf * zcGetTxBuf( struct Client * client );
+static void zcPutTxBuf( struct Client * client, struct TxBuf * buf );
+static void zcReap( struct Client * client );
+static void zcComplete( struct Client * client, uint32_t lo, uint32_t hi, bool copied );
+static void zcRelease( struct Client * client );
+static uint64_t monotonicNs(void);
+
+static bool statsInit(void);
+static void statsDeinit(void);
+static void printStats(void);
+
+static size_t latHistBucket(uint64_t ns);
+static uint64_t latHistBucketMaxNs(size_t bucket);
+static void latHistRecord(struct LatencyHist * hist, uint64_t ns);
+static void cmdLatencyMerge( uint64_t merged[UCMD_UNKNOWN + 1][LAT_HIST_NBUCKETS],
+                             const struct CmdLatency * curr,
+                             struct CmdLatency * base,
+                             bool reset );
+static uint64_t latHistPercentileNs( const uint64_t counts[LAT_HIST_NBUCKETS],
+                                     uint64_t total,
+                                     double percentile );
+static void printLatency(bool reset);
+
+static void profMutexInit(struct ProfMutex * pm, const char * name, time_t max_wait_sec);
+static void profMutexDeinit(struct ProfMutex * pm);
+static bool profLock(struct ProfMutex * pm, const char * site);
+static bool profUnlock(struct ProfMutex * pm);
+static void printLockProfile(const struct ProfMutex * pm);
+static void printLocks(void);
+
+static void frInit(void);
+static void frThreadStart(void);
+static inline void frRecord(enum FrEventType type, uint16_t aux, int32_t a, uint64_t b);
+static bool frDump(int signo);
+
+static bool execInit(void);
+static bool execRegisterDeque(struct SpWsDeque * dq);
+static void execSubmit(struct ExecTask * task);
+static void * execWorkerThread(void * arg);
+static void printExecutor(void);
+
 #ifndef NDEBUG
 bool isFullyNumeric(char * str, size_t len);
 bool isNullTerminated(char * str, size_t max_len);
@@ -131,21 +684,42 @@ int main( int argc, char * argv[] )
       main_retcode |= MAINRC_SIGINT_REGISTRATION_ERR;
    }
 
+   if ( !statsInit() )
+      return EXIT_FAILURE;
+   frInit();
+   if ( !execInit() )
+      fprintf(stderr, "Warning: No executor workers. Responders will carry out requests themselves.\n");
+   if ( !muxInit() )
+      fprintf(stderr, "Warning: No event-loop workers, so no tcp-create-mux or udp-create.\n");
+   if ( !resolverCacheInit(RC_DEFAULT_TTL_SEC, RC_DEFAULT_NEGATIVE_TTL_SEC) )
+      fprintf(stderr, "Warning: No resolver cache. Every get-addr-info will go to DNS.\n");
+   ResolverUp = asyncResolverInit(&Resolver, RESOLVER_NWORKERS);
+   if ( !ResolverUp )
+      fprintf(stderr, "Warning: No resolver threads. Per-core get-addr-info will block its core.\n");
+
    printf( "Hello! This is the REPL for a demo IPv4-only server.\n"
            "Here is a brief list of the available commands (case-insensitive):\n"
            "\t- udp-create [ip_address : port]\n"
            "\t- udp-listen [timeout in seconds]\n"
            "\t- udp-print-msgs\n"
            "\t- udp-socks\n"
-           "\t- udp-close sock_id\n"
+           "\t- udp-close ctx_id\n"
            "\t- udp-close-all\n"
            "\t- tcp-create-listener [ip_address : port]\n"
            "\t- tcp-begin-accepting\n"
            "\t- tcp-stop-accepting\n"
-           "\t- tcp-close sock_id\n"
+           "\t- tcp-close ctx_id\n"
            "\t- tcp-print-msgs\n"
            "\t- tcp-close-all\n"
-           "\t- close-all\n" );
+           "\t- tcp-create-percore [ip_address : port]\n"
+           "\t- tcp-create-mux [ip_address : port]\n"
+           "\t- close-all\n"
+           "\t- stats\n"
+           "\t- latency [reset]\n"
+           "\t- locks\n"
+           "\t- flightrec\n"
+           "\t- executor\n"
+           "\t- mux\n" );
 
    constexpr size_t NMAX = 1'000;
    size_t nreps = 0;
@@ -192,10 +766,91 @@ int main( int argc, char * argv[] )
          break;
       }
 
-      else if ( strncmp( buf, "tcp-create", (sizeof("tcp-create") - 1) ) == 0 )
+      else if ( strncmp( buf, "stats", (sizeof("stats") - 1) ) == 0 )
+      {
+         printStats();
+      }
+
+      else if ( strncmp( buf, "latency", (sizeof("latency") - 1) ) == 0 )
+      {
+         const char * cmd_arg = buf + sizeof("latency") - 1;
+         while ( ' ' == *cmd_arg )
+            ++cmd_arg;
+         if ( *cmd_arg != '\0' && strcmp(cmd_arg, "reset") != 0 )
+         {
+            fprintf(stderr, "Error: Usage: latency [reset]\n");
+            continue;
+         }
+         printLatency('\0' != *cmd_arg);
+      }
+
+      else if ( strncmp( buf, "locks", (sizeof("locks") - 1) ) == 0 )
+      {
+         printLocks();
+      }
+
+      else if ( strncmp( buf, "flightrec", (sizeof("flightrec") - 1) ) == 0 )
+      {
+         if ( frDump(0) )
+            printf("Flight recorder dumped to %s\n", FrDumpPath);
+         else
+            fprintf( stderr, "Error: Failed to dump the flight recorder to %s: %s (%d)\n",
+                     FrDumpPath, strerror(errno), errno );
+      }
+
+      else if ( strncmp( buf, "executor", (sizeof("executor") - 1) ) == 0 )
+      {
+         printExecutor();
+      }
+
+      else if ( strncmp( buf, "mux", (sizeof("mux") - 1) ) == 0 )
+      {
+         printMux();
+      }
+
+      else if ( strncmp( buf, "tcp-close ", (sizeof("tcp-close ") - 1) ) == 0
+                || strncmp( buf, "udp-close ", (sizeof("udp-close ") - 1) ) == 0 )
+      {
+         // Only multiplexed contexts can be closed so far
+         int sock_type = ('u' == buf[0]) ? SOCK_DGRAM : SOCK_STREAM;
+         const char * cmd_arg = buf + sizeof("tcp-close ") - 1;
+         char * end_ptr = nullptr;
+         unsigned long ctx_idx = strtoul(cmd_arg, &end_ptr, 10);
+         if ( end_ptr == cmd_arg || *end_ptr != '\0' )
+         {
+            fprintf(stderr, "Error: Usage: %.9s ctx_id\n", buf);
+            continue;
+         }
+         if ( muxDestroy(ctx_idx, sock_type) )
+            printf("Closed context %lu.\n", ctx_idx);
+      }
+
+      else if ( strncmp( buf, "tcp-create", (sizeof("tcp-create") - 1) ) == 0
+                || strncmp( buf, "udp-create", (sizeof("udp-create") - 1) ) == 0 )
       {
+         // Same arguments, but one context per CPU instead, or a context
+         // served by the event-loop workers
+         bool percore = strncmp( buf, "tcp-create-percore",
+                                 (sizeof("tcp-create-percore") - 1) ) == 0;
+         bool mux_tcp = strncmp( buf, "tcp-create-mux", (sizeof("tcp-create-mux") - 1) ) == 0;
+         bool mux_udp = strncmp( buf, "udp-create", (sizeof("udp-create") - 1) ) == 0;
+         const char * cmd_name = percore ? "tcp-create-percore"
+                                 : mux_tcp ? "tcp-create-mux"
+                                 : mux_udp ? "udp-create"
+                                 : "tcp-create";
+
+         // Multiplexed contexts can take over a closed one's slot, so
+         // muxCreate() checks for room itself
+         if ( !mux_tcp && !mux_udp && NContexts >= MAX_SERVERS )
+         {
+            fprintf( stderr,
+                     "Error: Already running the max of %zu listening contexts.\n",
+                     MAX_SERVERS );
+            continue;
+         }
+
          // Attempt to parse out command arguments ip_addr:port
-         char * cmd_arg_ptr = buf + sizeof("tcp-create") - 1;
+         char * cmd_arg_ptr = buf + strlen(cmd_name);
          char * cmd_str_end = memchr(buf, '\0', sizeof buf);
          assert(cmd_str_end != nullptr);
          assert( (cmd_str_end - buf) < (ptrdiff_t)(sizeof buf) );
@@ -291,6 +946,27 @@ int main( int argc, char * argv[] )
                 cmd_arg_addr,
                 cmd_arg_port );
 
+         if ( percore || mux_tcp || mux_udp )
+         {
+            // These make their own listening sockets
+            struct in_addr numerical_addr;
+            if ( inet_pton(AF_INET, cmd_arg_addr, &numerical_addr) != 1 )
+            {
+               fprintf( stderr,
+                        "Error: Invalid IPv4 address: %s\n"
+                        "Please try again.\n",
+                        cmd_arg_addr );
+               continue;
+            }
+            in_port_t port = htons( (in_port_t)strtol(cmd_arg_port, nullptr, 10) );
+
+            if ( percore && startPerCore(numerical_addr, port) )
+               printf("Successfully created per-core listening contexts.\n");
+            else if ( !percore && muxCreate(mux_udp ? SOCK_DGRAM : SOCK_STREAM, numerical_addr, port) )
+               printf("Successfully created multiplexed listening context.\n");
+            continue;
+         }
+
          // Attempt to create socket
          int sfd_listening = socket(AF_INET, SOCK_STREAM, 0);
          if ( sfd_listening < 0 )
@@ -418,13 +1094,39 @@ int main( int argc, char * argv[] )
             continue;
          }
 
+         ctx->latency = calloc(1, sizeof *ctx->latency);
+         ctx->latency_base = calloc(1, sizeof *ctx->latency_base);
+         if ( nullptr == ctx->latency || nullptr == ctx->latency_base )
+         {
+            fprintf( stderr,
+                     "Error: Failed to allocate latency histograms.\n"
+                     "Socket will be closed. Please try again.\n" );
+            free(ctx->latency);
+            free(ctx->latency_base);
+            free(ctx);
+            close(sfd_listening);
+            continue;
+         }
+
          ctx->listening_sfd = sfd_listening;
          ctx->listening_addr = numerical_addr;
          ctx->listening_port = port;
+         ctx->cpu = -1;
+         ctx->sock_type = SOCK_STREAM;
+
+         // Claim the next stats entry. It only gets published (counted in
+         // nctxs) once the context is fully up.
+         ctx->stats = &StatsShm->ctxs[NContexts];
+         memset(ctx->stats, 0x00, sizeof *ctx->stats);
+         ctx->stats->addr = numerical_addr.s_addr;
+         ctx->stats->port = port;
 
          // Create thread objects and point the thread fcns to their respective
          // local fcns, each of which take this stream context ptr as an arg.
-         pthread_mutex_init(&ctx->mtx, nullptr); // default mutex attributes
+         // Enable the context before the threads start, since they exit as soon
+         // as they see it disabled.
+         profMutexInit(&ctx->mtx, "ctx->mtx", MAX_MTX_LOCK_WAIT_SEC);
+         ctx->enabled = true; // strictest memory ordering seq_cst is fine here
          retcode = pthread_create( &ctx->acceptor,
                                    nullptr, // default thread attributes
                                    acceptorThread,
@@ -437,6 +1139,9 @@ int main( int argc, char * argv[] )
                      "Socket will be closed and context freed. Please try again.\n",
                      retcode, strerror(retcode) );
 
+            profMutexDeinit(&ctx->mtx);
+            free(ctx->latency);
+            free(ctx->latency_base);
             free(ctx);
 
             size_t close_nreps = 0;
@@ -466,6 +1171,26 @@ int main( int argc, char * argv[] )
                      "Socket will be closed and context freed. Please try again.\n",
                      retcode, strerror(retcode) );
 
+            // The acceptor's already running /w ctx, so it has to be gone
+            // before anything's freed. Shutting the listener down kicks it out
+            // of accept(), and it exits once it sees the context disabled.
+            ctx->enabled = false;
+            shutdown(sfd_listening, SHUT_RD);
+            pthread_join(ctx->acceptor, nullptr);
+
+            // Anyone it let in meanwhile has nobody to answer them
+            for ( struct Client * curr = ctx->clients.head, * next = nullptr;
+                  curr != nullptr;
+                  curr = next )
+            {
+               next = curr->next;
+               close(curr->sfd);
+               free(curr);
+            }
+
+            profMutexDeinit(&ctx->mtx);
+            free(ctx->latency);
+            free(ctx->latency_base);
             free(ctx);
 
             size_t close_nreps = 0;
@@ -483,7 +1208,8 @@ int main( int argc, char * argv[] )
             continue;
          }
 
-         ctx->enabled = true; // strictest memory ordering seq_cst is fine here
+         Contexts[NContexts++] = ctx;
+         atomic_store_explicit(&StatsShm->nctxs, (uint32_t)NContexts, memory_order_release);
 
          printf("Successfully created listening context.\n");
       }
@@ -515,6 +1241,13 @@ int main( int argc, char * argv[] )
    }
    puts("");
 
+   stopPerCore();
+   muxStop();
+   // Lets the lookups already out finish, and their callbacks reply
+   if ( ResolverUp )
+      asyncResolverShutdown(&Resolver);
+   statsDeinit();
+
    return main_retcode;
 }
 
@@ -529,10 +1262,37 @@ static void handleSIGINT(int sig_num)
    bUserEndedSession = true;
 }
 
+/**
+ * @brief Dump the flight recorder on the way down, then die the way we would
+ *        have anyways (core dump included)
+ */
+static void handleCrashSignal(int sig_num)
+{
+   // Only the first crashing thread dumps; any others just die
+   static atomic_flag dumping = ATOMIC_FLAG_INIT;
+   if ( !atomic_flag_test_and_set(&dumping) )
+   {
+      static const char dumped[] = "Fatal signal. Flight recorder dumped to ";
+      static const char failed[] = "Fatal signal. Failed to dump flight recorder to ";
+      bool ok = frDump(sig_num);
+      // Only async-signal-safe calls from here on
+      ssize_t rc = write(STDERR_FILENO, ok ? dumped : failed, (ok ? sizeof dumped : sizeof failed) - 1);
+      rc = write(STDERR_FILENO, FrDumpPath, strlen(FrDumpPath));
+      rc = write(STDERR_FILENO, "\n", 1);
+      (void)rc;
+   }
+
+   // SA_RESETHAND already put the default action back
+   raise(sig_num);
+}
+
 static void * acceptorThread(void * arg)
 {
    struct StreamContext * ctx = arg;
    static size_t nreps = 0;
+   tlsStats = &ctx->stats->slots[SP_STATS_SLOT_ACCEPTOR];
+   snprintf(tlsThreadName, sizeof tlsThreadName, "acceptor:%u", ntohs(ctx->listening_port));
+   frThreadStart();
 
    while ( ctx->enabled && nreps < MAX_THREAD_REPS )
    {
@@ -543,24 +1303,20 @@ static void * acceptorThread(void * arg)
          // it precedes a blocking call - accept(). The only other time I'd care
          // to mutex-lock around a printf is if I care about a specific sequence
          // of printf's going through.
-         struct timespec lock_timeout;
-         int retcode = clock_gettime(CLOCK_REALTIME, &lock_timeout);
-         if ( retcode == 0 )
+         bool locked = profLock(&mtxPrintf, PROF_SITE);
+         assert(locked); // Really shouldn't fail to acquire lock here
+         if ( locked )
          {
-            lock_timeout.tv_sec += MAX_MTX_PRINTF_LOCK_WAIT_SEC;
-
-            retcode = pthread_mutex_timedlock(&mtxPrintf, &lock_timeout);
-            assert(retcode == 0); // Really shouldn't fail to acquire lock here
-
             printf("\n\nIn acceptor thread. Iteration: %zu\n\n", nreps++);
 
-            retcode = pthread_mutex_unlock(&mtxPrintf);
-            assert(retcode == 0); // Shouldn't fail to unlock either
+            bool unlocked = profUnlock(&mtxPrintf);
+            assert(unlocked); // Shouldn't fail to unlock either
+            (void)unlocked;
          }
          else
          {
-            printf( "\n\nclock_gettime() failed for some reason. Still gonna print,\n"
-                    "it just won't come out immediately.\n"
+            printf( "\n\nCouldn't get the printf lock. Still gonna print,\n"
+                    "it just might come out jumbled.\n"
                     "In acceptor thread. Iteration: %zu\n\n", nreps++);
          }
       }
@@ -571,8 +1327,13 @@ static void * acceptorThread(void * arg)
       int new_conn_sfd = accept( ctx->listening_sfd,
                                  (struct sockaddr *)&client_info,
                                  &client_info_len );
+      if ( new_conn_sfd < 0 && !ctx->enabled )
+         break; // the listener got shut down under us, on purpose
       if ( new_conn_sfd < 0 )
       {
+         spStatAdd(tlsStats, SP_STAT_ACCEPT_ERRORS, 1);
+         SP_PROBE1(accept_error, errno);
+         frRecord(FR_ACCEPT_ERROR, 0, errno, 0);
          // TODO: Handle accept() error
          fprintf( stderr,
                   "Error: accept() returned: %d, errno: %s (%d)\n",
@@ -587,16 +1348,37 @@ static void * acceptorThread(void * arg)
          return nullptr;
       }
 
+      spStatAdd(tlsStats, SP_STAT_ACCEPTS, 1);
+      SP_PROBE3(accept, new_conn_sfd, client_info.sin_addr.s_addr, client_info.sin_port);
+      frRecord( FR_ACCEPT, 0, new_conn_sfd,
+                (uint64_t)client_info.sin_addr.s_addr << 32 | client_info.sin_port );
+
       struct Client new_client;
       new_client.sfd  = new_conn_sfd;
       new_client.addr = client_info.sin_addr.s_addr;
       new_client.port = client_info.sin_port;
+      new_client.rx_len = 0;
+      new_client.rx_off = 0;
+      new_client.busy = false;
+      new_client.drop = false;
+      new_client.dgram = false;
+      new_client.zc = (struct ZcTx){0};
+      new_client.tx_buf = nullptr;
+      new_client.tx_len = 0;
+      new_client.tx_cap = 0;
       new_client.next = nullptr;
 
       bool addedSuccessfully = addClient(ctx, &new_client);
       if ( !addedSuccessfully )
       {
-         // TODO: Log lib error and handle this awkward failed client addition
+         // TODO: Log lib error
+         // Nobody else knows about this socket, so drop the connection rather
+         // than leak the fd (which a reconnect storm against a full registry
+         // would otherwise do once per attempt).
+         close(new_conn_sfd);
+         spStatAdd(tlsStats, SP_STAT_ACCEPTS_REJECTED, 1);
+         frRecord(FR_ACCEPT_REJECT, 0, new_conn_sfd, 0);
+         continue;
       }
 
 #ifndef NDEBUG
@@ -616,106 +1398,3065 @@ static void * acceptorThread(void * arg)
 #endif
    }
 
+   frRecord(FR_THREAD_EXIT, 0, 0, nreps);
    printf("Exiting acceptor thread... Performed %zu iterations.\n", nreps);
 
    return nullptr;
 }
 
+/**
+ * @brief Wait on every client of the context and answer their SP requests
+ * @note The responder is the only thread that removes clients from the list,
+ *       and the acceptor only ever appends, so the client pointers gathered
+ *       under the lock stay valid after it is released.
+ */
 static void * responderThread(void * arg)
 {
-   // TODO
    struct StreamContext * ctx = arg;
-   static size_t nreps = 0;
+   size_t nreps = 0;
+   tlsStats = &ctx->stats->slots[SP_STATS_SLOT_RESPONDER];
+   snprintf(tlsThreadName, sizeof tlsThreadName, "responder:%u", ntohs(ctx->listening_port));
+   frThreadStart();
 
-   while ( ctx->enabled && nreps < MAX_THREAD_REPS )
+   // Requests go to the executor through a deque of our own, which its
+   // workers steal from. Without one, they get carried out right here.
+   if ( ExecNWorkers > 0 && spWsDequeInit(&ctx->deque, EXEC_DEQUE_CAP) )
+   {
+      if ( execRegisterDeque(&ctx->deque) )
+         tlsDeque = &ctx->deque;
+      else
+         spWsDequeDeinit(&ctx->deque);
+   }
+   if ( pipe(ctx->wake_pipe) != 0
+        || fcntl(ctx->wake_pipe[0], F_SETFL, O_NONBLOCK) != 0
+        || fcntl(ctx->wake_pipe[1], F_SETFL, O_NONBLOCK) != 0 )
+   {
+      fprintf( stderr,
+               "Warning: Couldn't set up the responder's wake-up pipe: %s (%d)\n"
+               "Clients will be slower to get serviced again after each request.\n",
+               strerror(errno), errno );
+      ctx->wake_pipe[0] = -1;
+      ctx->wake_pipe[1] = -1;
+   }
+
+   while ( ctx->enabled && nreps++ < MAX_THREAD_REPS )
    {
 #ifndef NDEBUG
-      if ( /*nreps % 10 == 0*/ true )
+      if ( nreps % 100 == 0 )
       {
          // I'm only concerned to mutex-lock around the printf here because
-         // it precedes a blocking call - accept(). The only other time I'd care
+         // it precedes a blocking call - poll(). The only other time I'd care
          // to mutex-lock around a printf is if I care about a specific sequence
          // of printf's going through.
-         struct timespec lock_timeout;
-         int retcode = clock_gettime(CLOCK_REALTIME, &lock_timeout);
-         if ( retcode == 0 )
+         bool locked = profLock(&mtxPrintf, PROF_SITE);
+         assert(locked); // Really shouldn't fail to acquire lock
+         if ( locked )
          {
-            lock_timeout.tv_sec += MAX_MTX_PRINTF_LOCK_WAIT_SEC;
-
-            retcode = pthread_mutex_timedlock(&mtxPrintf, &lock_timeout);
-            assert(retcode == 0); // Really shouldn't fail to acquire lock
+            printf("\n\nIn responder thread. Iteration: %zu\n\n", nreps);
 
-            printf("\n\nIn responder thread. Iteration: %zu\n\n", nreps++);
-
-            retcode = pthread_mutex_unlock(&mtxPrintf);
-            assert(retcode == 0); // Also shouldn't fail to unlock
+            bool unlocked = profUnlock(&mtxPrintf);
+            assert(unlocked); // Also shouldn't fail to unlock
+            (void)unlocked;
          }
          else
          {
-            printf( "\n\nclock_gettime() failed for some reason. Still gonna print,\n"
-                    "it just won't come out immediately.\n"
-                    "In responder thread. Iteration: %zu\n\n", nreps++);
+            printf( "\n\nCouldn't get the printf lock. Still gonna print,\n"
+                    "it just might come out jumbled.\n"
+                    "In responder thread. Iteration: %zu\n\n", nreps);
          }
       }
 #endif
 
-      unsigned int seconds_remaining = sleep(10);
-      if ( seconds_remaining > 0 )
+      // Snapshot the client list into a pollfd set, minus the clients a
+      // worker has. The wake-up pipe goes after the clients.
+      static thread_local struct pollfd pfds[MAX_CLIENTS + 1];
+      static thread_local struct Client * pclients[MAX_CLIENTS];
+      static thread_local struct Client * pdropped[MAX_CLIENTS];
+      nfds_t npfds = 0;
+      size_t ndropped = 0;
+
+      bool locked = profLock(&ctx->mtx, PROF_SITE);
+      assert(locked); // profLock() already reported who held it
+      if ( !locked )
+         break;
+
+      for ( struct Client * curr = ctx->clients.head;
+            curr != nullptr && npfds < MAX_CLIENTS;
+            curr = curr->next )
+      {
+         if ( atomic_load_explicit(&curr->busy, memory_order_acquire) )
+            continue;
+         if ( curr->drop )
+         {
+            pdropped[ndropped++] = curr;
+            continue;
+         }
+         // Clients /w replies queued get read from again once those are out
+         pfds[npfds] = (struct pollfd){ .fd = curr->sfd,
+                                        .events = curr->tx_len > 0 ? POLLOUT : POLLIN };
+         pclients[npfds] = curr;
+         npfds++;
+      }
+
+      bool unlocked = profUnlock(&ctx->mtx);
+      assert(unlocked);
+      (void)unlocked;
+
+      // Clients a worker gave up on (hung up mid-reply, etc.)
+      for ( size_t i = 0; i < ndropped; ++i )
+      {
+         bool removed = rmvClient(ctx, pdropped[i]->addr, pdropped[i]->port);
+         assert(removed); // only the responder removes clients
+         if ( removed )
+            spStatAdd(tlsStats, SP_STAT_CLIENTS_DROPPED, 1);
+      }
+
+      nfds_t nclient_pfds = npfds;
+      if ( ctx->wake_pipe[0] >= 0 )
+         pfds[npfds++] = (struct pollfd){ .fd = ctx->wake_pipe[0], .events = POLLIN };
+
+      if ( 0 == npfds )
       {
-         // sleep() was interrupted by a signal, and I'll just take that for
-         // now as a prompt to stop the thread
+         // Nobody to talk to yet. Nap for as long as poll() would've waited.
+         nanosleep( &(struct timespec){ .tv_nsec = RESPONDER_POLL_TIMEOUT_MS * 1'000'000L },
+                    nullptr );
+         continue;
+      }
+
+      int nready = poll(pfds, npfds, RESPONDER_POLL_TIMEOUT_MS);
+      if ( nready < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+
+         frRecord(FR_POLL_ERROR, 0, errno, 0);
+         fprintf( stderr,
+                  "Error: poll() returned: %d, errno: %s (%d)\n",
+                  nready, strerror(errno), errno );
          break;
       }
+      if ( nready > 0 )
+      {
+         spStatAdd(tlsStats, SP_STAT_POLL_WAKEUPS, 1);
+         spStatAdd(tlsStats, SP_STAT_POLL_READY, (uint64_t)nready);
+      }
+
+      if ( nclient_pfds < npfds && pfds[nclient_pfds].revents != 0 )
+      {
+         // Just a wake-up call; the clients handed back get picked up on
+         // the next snapshot
+         nready--;
+         uint8_t drain[64];
+         while ( read(ctx->wake_pipe[0], drain, sizeof drain) > 0 );
+      }
+
+      for ( nfds_t i = 0; i < nclient_pfds && nready > 0; ++i )
+      {
+         if ( 0 == pfds[i].revents )
+            continue;
+         nready--;
+
+         if ( !serviceClient(ctx, pclients[i]) )
+         {
+            // Client hung up or misbehaved. Either way, we're done /w it.
+            bool removed = rmvClient(ctx, pclients[i]->addr, pclients[i]->port);
+            assert(removed); // only the responder removes clients
+            if ( removed )
+               spStatAdd(tlsStats, SP_STAT_CLIENTS_DROPPED, 1);
+         }
+      }
    }
 
+   frRecord(FR_THREAD_EXIT, 0, 0, nreps);
    printf("Exiting responder thread... Performed %zu iterations.\n", nreps);
 
    return nullptr;
 }
 
-static bool addClient( struct StreamContext * ctx,
-                       const struct Client * client_info )
+/**
+ * @brief Start a per-core context on every CPU we're allowed to run on, all
+ *        listening on addr:port
+ *
+ * Each core's worker accepts and serves its own connections, which the kernel
+ * spreads across their SO_REUSEPORT listeners. Nothing it touches while
+ * serving is shared /w another core: no client list mutex, no printf mutex,
+ * no executor. The REPL only ever talks to it through its SPSC queues. The
+ * one thing shared is the resolver that get-addr-info lookups go out to, and
+ * it hands them back through SPSC queues too.
+ *
+ * @return false if any core failed to start, in which case none are left running
+ */
+static bool startPerCore(struct in_addr addr, in_port_t port)
 {
-   assert(ctx != nullptr);
-   assert(client_info != nullptr);
-   assert( ctx->clients.head != nullptr
-           || (ctx->clients.head == nullptr && ctx->clients.len == 0) );
-   assert(client_info->sfd >= 0);
-   assert(client_info->next == nullptr);
-
-   if ( ctx->clients.len >= MAX_CLIENTS )
+#ifdef __linux__
+   cpu_set_t allowed;
+   if ( sched_getaffinity(0, sizeof allowed, &allowed) != 0 )
    {
-      fprintf( stderr, "Clientelle is full! %zu is the max.\n"
-                       "Please close a connection first.\n", MAX_CLIENTS);
+      fprintf(stderr, "Error: sched_getaffinity() failed: %s (%d)\n", strerror(errno), errno);
       return false;
    }
-
-   // It is assumed that the client object is temporary and we need to
-   // dynamically allocate a client object here to then place in the client list
-   struct Client * new_client = malloc( sizeof(struct Client) );
-   if ( nullptr == new_client )
+   size_t ncores = (size_t)CPU_COUNT(&allowed);
+   if ( NContexts + ncores > MAX_SERVERS )
    {
-      // TODO: Log error in library log that user can choose to read/print from?
+      fprintf( stderr,
+               "Error: %zu more contexts (one per core) would be over the max of %zu.\n",
+               ncores, MAX_SERVERS );
       return false;
    }
-   *new_client = *client_info;
 
-   // Add to shared list
-   struct timespec lock_timeout;
-   int retcode = clock_gettime(CLOCK_REALTIME, &lock_timeout);
-   if ( retcode != 0 )
+   // Start them all...
+   struct CoreShard * shards[CPU_SETSIZE];
+   size_t nstarted = 0;
+   for ( int cpu = 0; cpu < CPU_SETSIZE && nstarted < ncores; ++cpu )
    {
-      // TODO: Log error in library log that user can choose to read/print from?
-      return false;
+      if ( !CPU_ISSET(cpu, &allowed) )
+         continue;
+
+      struct CoreShard * shard = calloc(1, sizeof *shard);
+      if ( nullptr == shard )
+         break;
+      if ( !spSpscInit(&shard->to_core, PERCORE_QUEUE_CAP) )
+      {
+         free(shard);
+         break;
+      }
+      if ( !spSpscInit(&shard->from_core, PERCORE_QUEUE_CAP) )
+      {
+         spSpscDeinit(&shard->to_core);
+         free(shard);
+         break;
+      }
+      shard->cpu = cpu;
+      shard->addr = addr;
+      shard->port = port;
+      // Contexts[i]'s counters are StatsShm->ctxs[i], so claim them in order
+      shard->stats = &StatsShm->ctxs[NContexts + nstarted];
+      memset(shard->stats, 0x00, sizeof *shard->stats);
+      shard->stats->addr = addr.s_addr;
+      shard->stats->port = port;
+
+      // Pinned from the get-go, so that even its stack is faulted in on its
+      // own NUMA node
+      cpu_set_t pin;
+      CPU_ZERO(&pin);
+      CPU_SET(cpu, &pin);
+      pthread_attr_t attr;
+      int retcode = pthread_attr_init(&attr);
+      if ( 0 == retcode )
+      {
+         retcode = pthread_attr_setaffinity_np(&attr, sizeof pin, &pin);
+         if ( 0 == retcode )
+            retcode = pthread_create(&shard->thread, &attr, coreThread, shard);
+         pthread_attr_destroy(&attr);
+      }
+      if ( retcode != 0 )
+      {
+         fprintf( stderr, "Error: Failed to start the worker for core %d: %s (%d)\n",
+                  cpu, strerror(retcode), retcode );
+         spSpscDeinit(&shard->to_core);
+         spSpscDeinit(&shard->from_core);
+         free(shard);
+         break;
+      }
+      shards[nstarted++] = shard;
    }
-   lock_timeout.tv_sec += MAX_MTX_LOCK_WAIT_SEC;
-   retcode = pthread_mutex_timedlock(&ctx->mtx, &lock_timeout);
-   // Pretty much any reason the timed mutex lock fails is cause for redesign
-   // (e.g., different timeout, excessively long critical section elsewhere,
-   // etc.), so call assert() to indicate this failure and abort.
-   assert(retcode == 0); // FIXME: It'd be good to print out _who_ owned the lock at failure...
 
-   if ( 0 == ctx->clients.len )
+   // ... and hear back from each
+   bool all_up = (nstarted == ncores);
+   struct StreamContext * ctxs[CPU_SETSIZE];
+   uint64_t deadline_ns = monotonicNs() + (uint64_t)PERCORE_START_TIMEOUT_SEC * 1'000'000'000u;
+   for ( size_t i = 0; i < nstarted; ++i )
+   {
+      struct SpSpscMsg msg;
+      while ( !spSpscPop(&shards[i]->from_core, &msg) )
+      {
+         if ( monotonicNs() > deadline_ns )
+         {
+            msg = (struct SpSpscMsg){ .type = CORE_MSG_FAILED, .arg = ETIMEDOUT };
+            break;
+         }
+         nanosleep(&(struct timespec){ .tv_nsec = 1'000'000L }, nullptr);
+      }
+      if ( CORE_MSG_UP == msg.type )
+      {
+         ctxs[i] = msg.ptr;
+      }
+      else
+      {
+         fprintf( stderr, "Error: Core %d failed to start serving: %s (%d)\n",
+                  shards[i]->cpu, strerror(msg.arg), msg.arg );
+         all_up = false;
+         ctxs[i] = nullptr;
+      }
+   }
+
+   if ( !all_up )
+   {
+      // All or nothing, so the contexts stay in step /w their stats entries
+      for ( size_t i = 0; i < nstarted; ++i )
+      {
+         // Even the ones that failed or timed out: a late one may yet come up
+         bool pushed = spSpscPush(&shards[i]->to_core, &(struct SpSpscMsg){ .type = CORE_MSG_STOP });
+         assert(pushed); // the core never gets sent anything else
+         (void)pushed;
+         pthread_join(shards[i]->thread, nullptr);
+         coreShardFree(shards[i]);
+      }
+      return false;
+   }
+
+   for ( size_t i = 0; i < nstarted; ++i )
+   {
+      Contexts[NContexts++] = ctxs[i];
+      CoreShards[NCoreShards++] = shards[i];
+   }
+   atomic_store_explicit(&StatsShm->nctxs, (uint32_t)NContexts, memory_order_release);
+   printf("Started %zu per-core contexts.\n", nstarted);
+   return true;
+#else
+   (void)addr;
+   (void)port;
+   fprintf(stderr, "Error: Per-core mode needs Linux (SO_REUSEPORT + CPU affinity).\n");
+   return false;
+#endif
+}
+
+/**
+ * @brief Have every per-core worker close up shop, and wait for them to
+ *
+ * @note Frees their contexts, which Contexts[] still points at, so this is
+ *       only for when the session's ending.
+ */
+static void stopPerCore(void)
+{
+   for ( size_t i = 0; i < NCoreShards; ++i )
+   {
+      bool pushed = spSpscPush(&CoreShards[i]->to_core, &(struct SpSpscMsg){ .type = CORE_MSG_STOP });
+      assert(pushed); // the core never gets sent anything else
+      (void)pushed;
+   }
+   for ( size_t i = 0; i < NCoreShards; ++i )
+   {
+      pthread_join(CoreShards[i]->thread, nullptr);
+      coreShardFree(CoreShards[i]);
+   }
+   NCoreShards = 0;
+}
+
+/**
+ * @brief Free a shard whose worker has been joined, and the context it was
+ *        serving, if it got that far
+ */
+static void coreShardFree(struct CoreShard * shard)
+{
+   if ( shard->ctx != nullptr )
+   {
+      free(shard->ctx->latency);
+      free(shard->ctx->latency_base);
+      free(shard->ctx);
+   }
+   spSpscDeinit(&shard->to_core);
+   spSpscDeinit(&shard->from_core);
+   for ( size_t i = 0; i < RESOLVER_NWORKERS; ++i )
+      spSpscDeinit(&shard->lookups_done[i]);
+   free(shard);
+}
+
+/**
+ * @brief A per-core worker: accept on our own listener shard and serve those
+ *        clients, all from this one thread
+ *
+ * @note Linux puts a page on the NUMA node of whichever CPU first touches it,
+ *       so everything here is allocated from this (already pinned) thread,
+ *       and large allocations are left untouched until they're needed. The
+ *       client table in particular only gets faulted in as clients come and
+ *       go, and only ever by this core. The exception is the stats entry: it
+ *       lives in the shared StatsShm segment, several contexts' to a page,
+ *       and the REPL zeroes it, so it's on whichever node that page landed.
+ *       Still, no other core writes to its cache lines.
+ *
+ * @note Once it's reported CORE_MSG_UP, the context is the REPL's to free
+ *       (see coreShardFree()), even if we bail out early on a poll() failure:
+ *       Contexts[] points at it from then on.
+ */
+static void * coreThread(void * arg)
+{
+   struct CoreShard * shard = arg;
+   tlsCore = shard;
+   snprintf(tlsThreadName, sizeof tlsThreadName, "core:%d", shard->cpu);
+   frThreadStart();
+
+   int listening_sfd = -1;
+   struct StreamContext * ctx = calloc(1, sizeof *ctx);
+   // The client table doubles as the pool of receive buffers: each client's
+   // lives in its slot, and free slots are handed out LIFO, so a new client
+   // gets the buffer that's most likely still in this core's cache
+   struct Client * slots = calloc(MAX_CLIENTS, sizeof *slots);
+   size_t * free_slots = calloc(MAX_CLIENTS, sizeof *free_slots);
+   // [0] is the listener, [1, npfds) are clients[], and [npfds] the wake-up
+   // pipe while polling
+   struct pollfd * pfds = calloc(MAX_CLIENTS + 2, sizeof *pfds);
+   struct Client ** clients = calloc(MAX_CLIENTS + 1, sizeof *clients);
+   if ( ctx != nullptr )
+   {
+      ctx->wake_pipe[0] = -1;
+      ctx->wake_pipe[1] = -1;
+      ctx->latency = calloc(1, sizeof *ctx->latency);
+      ctx->latency_base = calloc(1, sizeof *ctx->latency_base);
+   }
+   bool lookups_done_ok = true;
+   for ( size_t i = 0; i < RESOLVER_NWORKERS; ++i )
+      lookups_done_ok = spSpscInit(&shard->lookups_done[i], PERCORE_LOOKUP_QUEUE_CAP) && lookups_done_ok;
+   if ( nullptr == ctx || nullptr == slots || nullptr == free_slots || nullptr == pfds
+        || nullptr == clients || nullptr == ctx->latency || nullptr == ctx->latency_base
+        || !lookups_done_ok )
+   {
+      int alloc_errno = ENOMEM;
+      bool pushed = spSpscPush( &shard->from_core,
+                                &(struct SpSpscMsg){ .type = CORE_MSG_FAILED, .arg = alloc_errno } );
+      assert(pushed);
+      (void)pushed;
+      goto cleanup;
+   }
+
+   ctx->cpu = shard->cpu;
+   ctx->core = shard;
+   ctx->sock_type = SOCK_STREAM;
+   ctx->listening_addr = shard->addr;
+   ctx->listening_port = shard->port;
+   ctx->stats = shard->stats;
+   profMutexInit(&ctx->mtx, "ctx->mtx (unused per-core)", MAX_MTX_LOCK_WAIT_SEC);
+   tlsStats = &ctx->stats->slots[SP_STATS_SLOT_RESPONDER];
+
+   // Resolver threads poke this after handing back a lookup
+   if ( pipe(ctx->wake_pipe) != 0
+        || fcntl(ctx->wake_pipe[0], F_SETFL, O_NONBLOCK) != 0
+        || fcntl(ctx->wake_pipe[1], F_SETFL, O_NONBLOCK) != 0 )
+   {
+      int pipe_errno = errno;
+      bool pushed = spSpscPush( &shard->from_core,
+                                &(struct SpSpscMsg){ .type = CORE_MSG_FAILED, .arg = pipe_errno } );
+      assert(pushed);
+      (void)pushed;
+      goto cleanup;
+   }
+
+   // Our shard of the listener. SO_INCOMING_CPU steers connections whose
+   // packets this CPU handles to this listener, when the NIC's queues line up.
+   listening_sfd = socket(AF_INET, SOCK_STREAM, 0);
+   int listen_errno = 0;
+   if ( listening_sfd < 0
+        || setsockopt(listening_sfd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) != 0
+        || setsockopt(listening_sfd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) != 0
+        || bind( listening_sfd,
+                 (struct sockaddr *)&(struct sockaddr_in){ .sin_family = AF_INET,
+                                                           .sin_port = shard->port,
+                                                           .sin_addr = shard->addr },
+                 sizeof(struct sockaddr_in) ) != 0
+        || listen(listening_sfd, STREAM_LISTEN_QUEUE_SZ) != 0
+        || fcntl(listening_sfd, F_SETFL, O_NONBLOCK) != 0 )
+   {
+      listen_errno = errno;
+   }
+   if ( listen_errno != 0 )
+   {
+      bool pushed = spSpscPush( &shard->from_core,
+                                &(struct SpSpscMsg){ .type = CORE_MSG_FAILED, .arg = listen_errno } );
+      assert(pushed);
+      (void)pushed;
+      goto cleanup;
+   }
+#ifdef SO_INCOMING_CPU
+   setsockopt(listening_sfd, SOL_SOCKET, SO_INCOMING_CPU, &shard->cpu, sizeof shard->cpu);
+#endif
+   ctx->listening_sfd = listening_sfd;
+   ctx->enabled = true;
+
+   for ( size_t i = 0; i < MAX_CLIENTS; ++i )
+      free_slots[i] = MAX_CLIENTS - 1 - i; // slot 0 on top
+   size_t nfree = MAX_CLIENTS;
+   pfds[0] = (struct pollfd){ .fd = listening_sfd, .events = POLLIN };
+   nfds_t npfds = 1;
+
+   shard->ctx = ctx;
+   bool pushed = spSpscPush(&shard->from_core, &(struct SpSpscMsg){ .type = CORE_MSG_UP, .ptr = ctx });
+   assert(pushed);
+   (void)pushed;
+
+   size_t nreps = 0;
+   for ( ;; )
+   {
+      struct SpSpscMsg msg;
+      if ( spSpscPop(&shard->to_core, &msg) && CORE_MSG_STOP == msg.type )
+         break;
+      nreps++;
+
+      // Clients waiting on a get-addr-info lookup sit out until it's done
+      // (poll() skips negative fds), and ones /w replies queued get read from
+      // again once those are out
+      for ( nfds_t i = 1; i < npfds; ++i )
+      {
+         struct Client * client = clients[i];
+         pfds[i].fd = atomic_load_explicit(&client->busy, memory_order_relaxed) ? -1 : client->sfd;
+         pfds[i].events = client->tx_len > 0 ? POLLOUT : POLLIN;
+      }
+      pfds[npfds] = (struct pollfd){ .fd = ctx->wake_pipe[0], .events = POLLIN };
+
+      int nready = poll(pfds, npfds + 1, RESPONDER_POLL_TIMEOUT_MS);
+      if ( nready < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         frRecord(FR_POLL_ERROR, 0, errno, 0);
+         fprintf(stderr, "Error: poll() failed on core %d: %s (%d)\n", shard->cpu, strerror(errno), errno);
+         break;
+      }
+      if ( 0 == nready )
+         continue;
+      spStatAdd(tlsStats, SP_STAT_POLL_WAKEUPS, 1);
+      spStatAdd(tlsStats, SP_STAT_POLL_READY, (uint64_t)nready);
+
+      // Lookups handed back: their replies go out, and their clients' other
+      // requests get carried out, right here
+      if ( pfds[npfds].revents != 0 )
+      {
+         uint8_t drain[64];
+         while ( read(ctx->wake_pipe[0], drain, sizeof drain) > 0 );
+         coreResumeLookups(shard);
+      }
+
+      // Clients next, since accepting reshuffles the tail of the set. One
+      // whose lookup's reply couldn't be sent goes now, not on its next event.
+      for ( nfds_t i = 1; i < npfds; ++i )
+      {
+         struct Client * client = clients[i];
+         bool keep = !client->drop;
+         if ( pfds[i].revents != 0 )
+            keep = serviceClient(ctx, client) && !client->drop;
+         if ( keep )
+            continue;
+
+         frRecord(FR_CLIENT_RMV, 0, client->sfd, npfds - 2);
+         SP_PROBE2(client_rmv, client->sfd, npfds - 2);
+         clientRelease(client);
+         if ( close(client->sfd) != 0 )
+            frRecord(FR_CLOSE_ERROR, 0, client->sfd, (uint64_t)errno);
+         spStatAdd(tlsStats, SP_STAT_CLIENTS_DROPPED, 1);
+         free_slots[nfree++] = (size_t)(client - slots);
+
+         // Fill the hole /w the last entry, and look at that one next
+         npfds--;
+         pfds[i] = pfds[npfds];
+         clients[i] = clients[npfds];
+         i--;
+      }
+
+      if ( pfds[0].revents != 0 )
+      {
+         for ( ;; )
+         {
+            struct sockaddr_in client_info;
+            socklen_t client_info_len = sizeof client_info;
+            int new_conn_sfd = acceptNonBlocking(listening_sfd, &client_info, &client_info_len);
+            if ( new_conn_sfd < 0 )
+            {
+               if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+               {
+                  spStatAdd(tlsStats, SP_STAT_ACCEPT_ERRORS, 1);
+                  SP_PROBE1(accept_error, errno);
+                  frRecord(FR_ACCEPT_ERROR, 0, errno, 0);
+               }
+               break;
+            }
+            spStatAdd(tlsStats, SP_STAT_ACCEPTS, 1);
+            SP_PROBE3(accept, new_conn_sfd, client_info.sin_addr.s_addr, client_info.sin_port);
+            frRecord( FR_ACCEPT, 0, new_conn_sfd,
+                      (uint64_t)client_info.sin_addr.s_addr << 32 | client_info.sin_port );
+
+            if ( 0 == nfree )
+            {
+               close(new_conn_sfd);
+               spStatAdd(tlsStats, SP_STAT_ACCEPTS_REJECTED, 1);
+               frRecord(FR_ACCEPT_REJECT, 0, new_conn_sfd, 0);
+               continue;
+            }
+
+            struct Client * client = &slots[free_slots[--nfree]];
+            client->sfd = new_conn_sfd;
+            client->addr = client_info.sin_addr.s_addr;
+            client->port = client_info.sin_port;
+            client->ctx = ctx;
+            client->busy = false;
+            client->drop = false;
+            client->zc = (struct ZcTx){0};
+            client->rx_len = 0;
+            client->rx_off = 0;
+            client->tx_buf = nullptr;
+            client->tx_len = 0;
+            client->tx_cap = 0;
+            client->next = nullptr;
+            pfds[npfds] = (struct pollfd){ .fd = new_conn_sfd, .events = POLLIN };
+            clients[npfds] = client;
+            npfds++;
+            SP_PROBE2(client_add, new_conn_sfd, npfds - 1);
+            frRecord(FR_CLIENT_ADD, 0, new_conn_sfd, npfds - 1);
+         }
+      }
+   }
+
+   ctx->enabled = false;
+   // Lookups still out write into their clients and poke our pipe, so wait
+   // for the last of their callbacks. What they hand back goes unanswered.
+   while ( atomic_load_explicit(&shard->nlookups_out, memory_order_acquire) > 0 )
+      nanosleep(&(struct timespec){ .tv_nsec = 1'000'000L }, nullptr);
+   for ( nfds_t i = 1; i < npfds; ++i )
+   {
+      clientRelease(clients[i]);
+      close(clients[i]->sfd);
+   }
+   frRecord(FR_THREAD_EXIT, 0, 0, nreps);
+
+cleanup:
+   if ( listening_sfd >= 0 )
+      close(listening_sfd);
+   if ( ctx != nullptr && ctx->wake_pipe[0] >= 0 )
+   {
+      close(ctx->wake_pipe[0]);
+      close(ctx->wake_pipe[1]);
+   }
+   if ( ctx != nullptr && nullptr == shard->ctx )
+   {
+      free(ctx->latency);
+      free(ctx->latency_base);
+      free(ctx);
+   }
+   free(slots);
+   free(free_slots);
+   free(pfds);
+   free(clients);
+   return nullptr;
+}
+
+/**
+ * @brief Start the event-loop workers that multiplexed listeners get spread
+ *        across
+ *
+ * However many listeners there are, TCP or UDP, they and their clients all
+ * share these few threads, each polling everything it's been given. So a
+ * listener only costs its socket and its StreamContext, not two threads
+ * (and their stacks) like a tcp-create context does.
+ *
+ * @return false if no workers could be started
+ */
+static bool muxInit(void)
+{
+   long nworkers = MUX_NWORKERS;
+   if ( nworkers <= 0 )
+      nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+   if ( nworkers <= 0 )
+      nworkers = 1;
+   if ( (size_t)nworkers > MUX_MAX_WORKERS )
+      nworkers = MUX_MAX_WORKERS;
+
+   MuxWorkers = calloc((size_t)nworkers, sizeof *MuxWorkers);
+   if ( nullptr == MuxWorkers )
+   {
+      fprintf(stderr, "Error: Failed to allocate %ld event-loop workers.\n", nworkers);
+      return false;
+   }
+
+   for ( size_t i = 0; i < (size_t)nworkers; ++i )
+   {
+      struct MuxWorker * worker = &MuxWorkers[i];
+      if ( !spSpscInit(&worker->inbox, MUX_QUEUE_CAP) )
+         break;
+      if ( !spSpscInit(&worker->outbox, MUX_QUEUE_CAP) )
+      {
+         spSpscDeinit(&worker->inbox);
+         break;
+      }
+      if ( pipe(worker->wake_pipe) != 0
+           || fcntl(worker->wake_pipe[0], F_SETFL, O_NONBLOCK) != 0
+           || fcntl(worker->wake_pipe[1], F_SETFL, O_NONBLOCK) != 0 )
+      {
+         fprintf( stderr, "Error: Couldn't set up event-loop worker %zu's wake-up pipe: %s (%d)\n",
+                  i, strerror(errno), errno );
+         spSpscDeinit(&worker->inbox);
+         spSpscDeinit(&worker->outbox);
+         break;
+      }
+      int retcode = pthread_create(&worker->thread, nullptr, muxWorkerThread, worker);
+      if ( retcode != 0 )
+      {
+         fprintf( stderr, "Error: Failed to create event-loop worker %zu: %s (%d)\n",
+                  i, strerror(retcode), retcode );
+         close(worker->wake_pipe[0]);
+         close(worker->wake_pipe[1]);
+         spSpscDeinit(&worker->inbox);
+         spSpscDeinit(&worker->outbox);
+         break;
+      }
+      MuxNWorkers++;
+   }
+
+   if ( 0 == MuxNWorkers )
+   {
+      free(MuxWorkers);
+      MuxWorkers = nullptr;
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief Open a listener on addr:port, and hand it to the least loaded
+ *        event-loop worker
+ *
+ * @param[in] sock_type : SOCK_STREAM or SOCK_DGRAM
+ */
+static bool muxCreate(int sock_type, struct in_addr addr, in_port_t port)
+{
+   if ( 0 == MuxNWorkers )
+   {
+      fprintf(stderr, "Error: No event-loop workers to serve the listener.\n");
+      return false;
+   }
+
+   // Take over a closed multiplexed context's slot (and stats entry) if
+   // there is one, so listeners coming and going don't use up MAX_SERVERS
+   for ( size_t i = 0; i < MuxNWorkers; ++i )
+      muxReap(&MuxWorkers[i]);
+   size_t ctx_idx = NContexts;
+   for ( size_t i = 0; i < NContexts; ++i )
+   {
+      if ( Contexts[i]->mux != nullptr && Contexts[i]->listening_sfd < 0 )
+      {
+         ctx_idx = i;
+         break;
+      }
+   }
+   if ( ctx_idx >= MAX_SERVERS )
+   {
+      fprintf( stderr, "Error: Already running the max of %zu listening contexts.\n",
+               MAX_SERVERS );
+      return false;
+   }
+
+   int sfd = socket(AF_INET, sock_type, 0);
+   if ( sfd < 0 )
+   {
+      fprintf(stderr, "Error: Failed to create socket: %s (%d)\n", strerror(errno), errno);
+      return false;
+   }
+   if ( setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) != 0
+        || bind( sfd,
+                 (struct sockaddr *)&(struct sockaddr_in){ .sin_family = AF_INET,
+                                                           .sin_port = port,
+                                                           .sin_addr = addr },
+                 sizeof(struct sockaddr_in) ) != 0
+        || (SOCK_STREAM == sock_type && listen(sfd, STREAM_LISTEN_QUEUE_SZ) != 0)
+        || fcntl(sfd, F_SETFL, O_NONBLOCK) != 0 )
+   {
+      fprintf( stderr,
+               "Error: Failed to set up the listening socket: %s (%d)\n"
+               "Socket will be closed. Please try again.\n",
+               strerror(errno), errno );
+      close(sfd);
+      return false;
+   }
+
+   struct StreamContext * ctx;
+   if ( ctx_idx < NContexts )
+   {
+      // Closed, so no worker has it anymore
+      ctx = Contexts[ctx_idx];
+      memset(ctx->latency, 0x00, sizeof *ctx->latency);
+      memset(ctx->latency_base, 0x00, sizeof *ctx->latency_base);
+   }
+   else
+   {
+      ctx = calloc(1, sizeof *ctx);
+      if ( ctx != nullptr )
+      {
+         ctx->latency = calloc(1, sizeof *ctx->latency);
+         ctx->latency_base = calloc(1, sizeof *ctx->latency_base);
+      }
+      if ( nullptr == ctx || nullptr == ctx->latency || nullptr == ctx->latency_base )
+      {
+         fprintf(stderr, "Error: Failed to allocate context.\nSocket will be closed. Please try again.\n");
+         if ( ctx != nullptr )
+         {
+            free(ctx->latency);
+            free(ctx->latency_base);
+         }
+         free(ctx);
+         close(sfd);
+         return false;
+      }
+      // Never locked; the worker's the only one who touches the context's
+      // clients
+      profMutexInit(&ctx->mtx, "ctx->mtx (multiplexed)", MAX_MTX_LOCK_WAIT_SEC);
+   }
+
+   // Whoever has the fewest sockets to look after
+   struct MuxWorker * worker = &MuxWorkers[0];
+   size_t min_load = SIZE_MAX;
+   for ( size_t i = 0; i < MuxNWorkers; ++i )
+   {
+      size_t load = atomic_load_explicit(&MuxWorkers[i].nlisteners, memory_order_relaxed)
+                    + atomic_load_explicit(&MuxWorkers[i].nclients, memory_order_relaxed);
+      if ( load < min_load )
+      {
+         min_load = load;
+         worker = &MuxWorkers[i];
+      }
+   }
+
+   ctx->listening_sfd = sfd;
+   ctx->listening_addr = addr;
+   ctx->listening_port = port;
+   ctx->cpu = -1;
+   ctx->sock_type = sock_type;
+   ctx->mux = worker;
+   ctx->mux_nentries = 0;
+   // Executor workers wake the context's worker when they hand a client back
+   ctx->wake_pipe[0] = worker->wake_pipe[0];
+   ctx->wake_pipe[1] = worker->wake_pipe[1];
+   ctx->stats = &StatsShm->ctxs[ctx_idx];
+   memset(ctx->stats, 0x00, sizeof *ctx->stats);
+   ctx->stats->addr = addr.s_addr;
+   ctx->stats->port = port;
+   ctx->enabled = true;
+
+   muxSend(worker, MUX_MSG_ADD, ctx);
+
+   if ( ctx_idx == NContexts )
+   {
+      Contexts[NContexts++] = ctx;
+      atomic_store_explicit(&StatsShm->nctxs, (uint32_t)NContexts, memory_order_release);
+   }
+   printf("Context %zu is on event-loop worker %zu.\n", ctx_idx, (size_t)(worker - MuxWorkers));
+   return true;
+}
+
+/**
+ * @brief Close multiplexed context ctx_idx, its listener and its clients,
+ *        once its worker's done /w them
+ *
+ * Waits on any of its clients' requests still on the executor, so this can
+ * take as long as the slowest of those.
+ */
+static bool muxDestroy(size_t ctx_idx, int sock_type)
+{
+   struct StreamContext * ctx = (ctx_idx < NContexts) ? Contexts[ctx_idx] : nullptr;
+   if ( nullptr == ctx || nullptr == ctx->mux || ctx->sock_type != sock_type
+        || ctx->listening_sfd < 0 )
+   {
+      fprintf( stderr, "Error: Context %zu isn't an open multiplexed %s context.\n",
+               ctx_idx, (SOCK_DGRAM == sock_type) ? "UDP" : "TCP" );
+      return false;
+   }
+
+   muxSend(ctx->mux, MUX_MSG_RMV, ctx);
+   while ( ctx->listening_sfd >= 0 )
+   {
+      nanosleep(&(struct timespec){ .tv_nsec = 1'000'000L }, nullptr);
+      muxReap(ctx->mux);
+   }
+   return true;
+}
+
+/**
+ * @brief Have every event-loop worker close everything it has and exit, and
+ *        wait for them to
+ */
+static void muxStop(void)
+{
+   for ( size_t i = 0; i < MuxNWorkers; ++i )
+      muxSend(&MuxWorkers[i], MUX_MSG_STOP, nullptr);
+   for ( size_t i = 0; i < MuxNWorkers; ++i )
+   {
+      struct MuxWorker * worker = &MuxWorkers[i];
+      pthread_join(worker->thread, nullptr);
+      close(worker->wake_pipe[0]);
+      close(worker->wake_pipe[1]);
+      spSpscDeinit(&worker->inbox);
+      spSpscDeinit(&worker->outbox);
+      // The worker's deque stays registered /w the executor, like a responder's
+   }
+   MuxNWorkers = 0;
+}
+
+/**
+ * @brief REPL only: queue a message for an event-loop worker, and wake it
+ */
+static void muxSend(struct MuxWorker * worker, enum MuxMsgType type, void * ptr)
+{
+   // The REPL waits for every MUX_MSG_RMV to be done /w, so a full inbox
+   // means a burst of creates; the worker drains it every loop
+   while ( !spSpscPush(&worker->inbox, &(struct SpSpscMsg){ .type = type, .ptr = ptr }) )
+      nanosleep(&(struct timespec){ .tv_nsec = 1'000'000L }, nullptr);
+   ssize_t rc = write(worker->wake_pipe[1], "", 1); // a full pipe's already a wake-up
+   (void)rc;
+}
+
+/**
+ * @brief REPL only: mark the contexts a worker's done closing as closed
+ */
+static void muxReap(struct MuxWorker * worker)
+{
+   struct SpSpscMsg msg;
+   while ( spSpscPop(&worker->outbox, &msg) )
+   {
+      assert(MUX_MSG_DONE == msg.type);
+      struct StreamContext * ctx = msg.ptr;
+      ctx->listening_sfd = -1; // the worker already closed it
+   }
+}
+
+/**
+ * @brief An event-loop worker: accept on, and serve the clients of, every
+ *        listener the REPL's given it, all from one poll set
+ *
+ * Nothing here blocks except poll(): listeners and accepted sockets are
+ * non-blocking, replies a client's socket won't take yet wait on the client
+ * for POLLOUT, and requests that could block go to the executor like a
+ * responder's do. A client /w a request out on the executor sits out of the
+ * poll set until the executor hands it back.
+ */
+static void * muxWorkerThread(void * arg)
+{
+   struct MuxWorker * self = arg;
+   snprintf(tlsThreadName, sizeof tlsThreadName, "mux:%zu", (size_t)(self - MuxWorkers));
+   frThreadStart();
+
+   if ( ExecNWorkers > 0 && spWsDequeInit(&self->deque, EXEC_DEQUE_CAP) )
+   {
+      if ( execRegisterDeque(&self->deque) )
+         tlsDeque = &self->deque;
+      else
+         spWsDequeDeinit(&self->deque);
+   }
+
+   struct MuxPollSet set = {0};
+   bool added = muxPollSetAdd(&set, self->wake_pipe[0], (struct MuxEntry){ .kind = MUX_ENT_WAKE });
+   if ( !added )
+   {
+      fprintf(stderr, "Error: Event-loop worker %zu is out of memory.\n", (size_t)(self - MuxWorkers));
+      return nullptr;
+   }
+
+   bool stopping = false;
+   uint64_t nloops = 0;
+   for ( ;; )
+   {
+      struct SpSpscMsg msg;
+      while ( spSpscPop(&self->inbox, &msg) )
+      {
+         struct StreamContext * ctx = msg.ptr;
+         if ( MUX_MSG_STOP == msg.type )
+         {
+            stopping = true;
+         }
+         else if ( MUX_MSG_RMV == msg.type )
+         {
+            // Its entries get closed below, as each is free to be
+            atomic_store(&ctx->enabled, false);
+         }
+         else if ( MUX_MSG_ADD == msg.type )
+         {
+            struct Client * client = nullptr;
+            if ( SOCK_DGRAM == ctx->sock_type )
+            {
+               client = calloc(1, sizeof *client);
+               if ( client != nullptr )
+               {
+                  client->sfd = ctx->listening_sfd;
+                  client->ctx = ctx;
+                  client->dgram = true;
+               }
+            }
+            struct MuxEntry ent = { .kind = client ? MUX_ENT_DGRAM : MUX_ENT_LISTENER,
+                                    .ctx = ctx,
+                                    .client = client };
+            if ( (SOCK_DGRAM == ctx->sock_type && nullptr == client)
+                 || !muxPollSetAdd(&set, ctx->listening_sfd, ent) )
+            {
+               fprintf( stderr, "Error: Event-loop worker %zu is out of memory; closing context.\n",
+                        (size_t)(self - MuxWorkers) );
+               free(client);
+               atomic_store(&ctx->enabled, false);
+               close(ctx->listening_sfd);
+               bool pushed = spSpscPush(&self->outbox, &(struct SpSpscMsg){ .type = MUX_MSG_DONE, .ptr = ctx });
+               assert(pushed); // the REPL reaps before every create
+               (void)pushed;
+               continue;
+            }
+            ctx->mux_nentries = 1;
+            atomic_fetch_add_explicit(&self->nlisteners, 1, memory_order_relaxed);
+         }
+      }
+
+      // Close whatever's done /w, and take clients out on the executor out
+      // of the poll set (poll() skips negative fds)
+      for ( size_t i = 1; i < set.n; ++i )
+      {
+         struct MuxEntry * ent = &set.ents[i];
+         struct Client * client = ent->client;
+         if ( client != nullptr && atomic_load_explicit(&client->busy, memory_order_acquire) )
+         {
+            set.pfds[i].fd = -1;
+            continue;
+         }
+         bool closing = stopping || !atomic_load_explicit(&ent->ctx->enabled, memory_order_relaxed);
+         if ( MUX_ENT_DGRAM == ent->kind )
+         {
+            client->drop = false; // one peer's failed send is no reason to close the socket
+            // Its datagrams out on the executor still need the socket and context
+            if ( closing && atomic_load_explicit(&client->ndgrams_out, memory_order_acquire) > 0 )
+            {
+               set.pfds[i].fd = -1;
+               continue;
+            }
+         }
+         if ( !closing && !(MUX_ENT_CLIENT == ent->kind && client->drop) )
+         {
+            set.pfds[i].fd = client ? client->sfd : ent->ctx->listening_sfd;
+            set.pfds[i].events = client && client->tx_len > 0 ? POLLOUT : POLLIN;
+            continue;
+         }
+
+         struct StreamContext * ctx = ent->ctx;
+         if ( MUX_ENT_CLIENT == ent->kind )
+         {
+            tlsStats = &ctx->stats->slots[SP_STATS_SLOT_RESPONDER];
+            SP_PROBE2(client_rmv, client->sfd, ctx->mux_nentries - 2);
+            frRecord(FR_CLIENT_RMV, 0, client->sfd, ctx->mux_nentries - 2);
+            clientRelease(client);
+            if ( close(client->sfd) != 0 )
+               frRecord(FR_CLOSE_ERROR, 0, client->sfd, (uint64_t)errno);
+            spStatAdd(tlsStats, SP_STAT_CLIENTS_DROPPED, 1);
+            atomic_fetch_sub_explicit(&self->nclients, 1, memory_order_relaxed);
+         }
+         else
+         {
+            close(ctx->listening_sfd);
+            atomic_fetch_sub_explicit(&self->nlisteners, 1, memory_order_relaxed);
+         }
+         free(client);
+         muxPollSetRmv(&set, i--);
+
+         if ( 0 == --ctx->mux_nentries && !stopping )
+         {
+            bool pushed = spSpscPush(&self->outbox, &(struct SpSpscMsg){ .type = MUX_MSG_DONE, .ptr = ctx });
+            assert(pushed); // the REPL waits on each one
+            (void)pushed;
+         }
+      }
+      if ( stopping && 1 == set.n )
+         break;
+
+      int nready = poll(set.pfds, set.n, RESPONDER_POLL_TIMEOUT_MS);
+      if ( nready < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         frRecord(FR_POLL_ERROR, 0, errno, 0);
+         fprintf(stderr, "Error: poll() failed: %s (%d)\n", strerror(errno), errno);
+         break;
+      }
+      atomic_store_explicit(&self->nloops, ++nloops, memory_order_relaxed);
+      if ( 0 == nready )
+         continue;
+      atomic_fetch_add_explicit(&self->nready, (uint64_t)nready, memory_order_relaxed);
+
+      // Accepting grows the set; the new entries get polled next time round
+      size_t nentries = set.n;
+      for ( size_t i = 0; i < nentries; ++i )
+      {
+         if ( 0 == set.pfds[i].revents )
+            continue;
+
+         struct MuxEntry ent = set.ents[i];
+         if ( MUX_ENT_WAKE == ent.kind )
+         {
+            uint8_t drain[64];
+            while ( read(self->wake_pipe[0], drain, sizeof drain) > 0 );
+         }
+         else if ( MUX_ENT_DGRAM == ent.kind )
+         {
+            tlsStats = &ent.ctx->stats->slots[SP_STATS_SLOT_RESPONDER];
+            serviceDatagram(ent.ctx, ent.client);
+         }
+         else if ( MUX_ENT_CLIENT == ent.kind )
+         {
+            tlsStats = &ent.ctx->stats->slots[SP_STATS_SLOT_RESPONDER];
+            if ( !serviceClient(ent.ctx, ent.client) )
+               ent.client->drop = true; // closed on the next pass
+         }
+         else
+         {
+            struct StreamContext * ctx = ent.ctx;
+            tlsStats = &ctx->stats->slots[SP_STATS_SLOT_ACCEPTOR];
+            for ( ;; )
+            {
+               struct sockaddr_in client_info;
+               socklen_t client_info_len = sizeof client_info;
+               int new_conn_sfd = acceptNonBlocking(ctx->listening_sfd, &client_info, &client_info_len);
+               if ( new_conn_sfd < 0 )
+               {
+                  if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+                  {
+                     spStatAdd(tlsStats, SP_STAT_ACCEPT_ERRORS, 1);
+                     SP_PROBE1(accept_error, errno);
+                     frRecord(FR_ACCEPT_ERROR, 0, errno, 0);
+                  }
+                  break;
+               }
+               spStatAdd(tlsStats, SP_STAT_ACCEPTS, 1);
+               SP_PROBE3(accept, new_conn_sfd, client_info.sin_addr.s_addr, client_info.sin_port);
+               frRecord( FR_ACCEPT, 0, new_conn_sfd,
+                         (uint64_t)client_info.sin_addr.s_addr << 32 | client_info.sin_port );
+
+               struct Client * client = nullptr;
+               if ( ctx->mux_nentries - 1 < MAX_CLIENTS )
+                  client = malloc(sizeof *client);
+               if ( client != nullptr )
+               {
+                  client->sfd = new_conn_sfd;
+                  client->addr = client_info.sin_addr.s_addr;
+                  client->port = client_info.sin_port;
+                  client->ctx = ctx;
+                  client->busy = false;
+                  client->drop = false;
+                  client->dgram = false;
+                  client->zc = (struct ZcTx){0};
+                  client->rx_len = 0;
+                  client->rx_off = 0;
+                  client->tx_buf = nullptr;
+                  client->tx_len = 0;
+                  client->tx_cap = 0;
+                  client->next = nullptr;
+               }
+               if ( nullptr == client
+                    || !muxPollSetAdd( &set, new_conn_sfd,
+                                       (struct MuxEntry){ .kind = MUX_ENT_CLIENT,
+                                                          .ctx = ctx,
+                                                          .client = client } ) )
+               {
+                  free(client);
+                  close(new_conn_sfd);
+                  spStatAdd(tlsStats, SP_STAT_ACCEPTS_REJECTED, 1);
+                  frRecord(FR_ACCEPT_REJECT, 0, new_conn_sfd, 0);
+                  continue;
+               }
+               ctx->mux_nentries++;
+               atomic_fetch_add_explicit(&self->nclients, 1, memory_order_relaxed);
+               SP_PROBE2(client_add, new_conn_sfd, ctx->mux_nentries - 1);
+               frRecord(FR_CLIENT_ADD, 0, new_conn_sfd, ctx->mux_nentries - 1);
+            }
+         }
+      }
+   }
+
+   frRecord(FR_THREAD_EXIT, 0, 0, nloops);
+   free(set.pfds);
+   free(set.ents);
+   return nullptr;
+}
+
+/**
+ * @return false if the set couldn't grow to fit it
+ */
+static bool muxPollSetAdd( struct MuxPollSet * set, int fd, struct MuxEntry ent )
+{
+   if ( set->n == set->cap )
+   {
+      size_t cap = set->cap ? 2 * set->cap : MUX_INITIAL_NENTRIES;
+      struct pollfd * pfds = realloc(set->pfds, cap * sizeof *pfds);
+      if ( nullptr == pfds )
+         return false;
+      set->pfds = pfds;
+      struct MuxEntry * ents = realloc(set->ents, cap * sizeof *ents);
+      if ( nullptr == ents )
+         return false;
+      set->ents = ents;
+      set->cap = cap;
+   }
+   set->pfds[set->n] = (struct pollfd){ .fd = fd, .events = POLLIN };
+   set->ents[set->n] = ent;
+   set->n++;
+   return true;
+}
+
+/**
+ * @brief Remove entry i, by moving the last one into its place
+ */
+static void muxPollSetRmv( struct MuxPollSet * set, size_t i )
+{
+   assert(i > 0 && i < set->n); // the wake-up pipe stays
+   set->n--;
+   set->pfds[i] = set->pfds[set->n];
+   set->ents[i] = set->ents[set->n];
+}
+
+/**
+ * @brief Print how the multiplexed listeners and their clients are spread
+ *        across the event-loop workers
+ */
+static void printMux(void)
+{
+   if ( 0 == MuxNWorkers )
+   {
+      printf("No event-loop workers.\n");
+      return;
+   }
+
+   printf("Event loop: %zu workers\n", MuxNWorkers);
+   printf( "   %-10s %10s %10s %12s %10s\n",
+           "worker", "listeners", "clients", "loops", "ready/loop" );
+   for ( size_t i = 0; i < MuxNWorkers; ++i )
+   {
+      const struct MuxWorker * worker = &MuxWorkers[i];
+      uint64_t nloops = atomic_load_explicit(&worker->nloops, memory_order_relaxed);
+      uint64_t nready = atomic_load_explicit(&worker->nready, memory_order_relaxed);
+      printf( "   %-10zu %10zu %10zu %12" PRIu64 " %10.2f\n",
+              i,
+              atomic_load_explicit(&worker->nlisteners, memory_order_relaxed),
+              atomic_load_explicit(&worker->nclients, memory_order_relaxed),
+              nloops, nloops ? (double)nready / (double)nloops : 0.0 );
+   }
+}
+
+/**
+ * @brief Read whatever a client has sent, and carry out any SP messages that
+ *        completed: right here if they're all cheap, else on the executor
+ *
+ * @return false if the client should be dropped (hung up, socket error, or
+ *         protocol violation), true otherwise
+ */
+static bool serviceClient( struct StreamContext * ctx, struct Client * client )
+{
+   assert(client != nullptr);
+   assert(client->ctx == ctx);
+   assert(!client->busy);
+   assert(client->rx_len < sizeof client->rx_buf);
+
+   // Zero-copy completions wake us up too (POLLERR), /w nothing to recv()
+   if ( client->zc.ninflight > 0 )
+      zcReap(client);
+
+   // Until the client's taken the replies queued for it, read nothing more
+   if ( client->tx_len > 0 )
+   {
+      if ( !clientFlushTx(client) )
+         return false;
+      if ( client->tx_len > 0 )
+         return true;
+   }
+
+   ssize_t nbytes = recv( client->sfd,
+                          client->rx_buf + client->rx_len,
+                          sizeof(client->rx_buf) - client->rx_len,
+                          MSG_DONTWAIT );
+   // Timestamp as close to the bytes coming off the socket as possible
+   uint64_t rx_ns = monotonicNs();
+   if ( 0 == nbytes )
+      return false; // orderly shutdown by the client
+   if ( nbytes < 0 )
+      return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+
+   client->rx_len += (size_t)nbytes;
+   spStatAdd(tlsStats, SP_STAT_BYTES_IN, (uint64_t)nbytes);
+
+   // Vet every complete message's header here, so a misbehaving client gets
+   // dropped right away instead of after a trip through the executor
+   size_t nmsgs = 0;
+   bool offload = false;
+   for ( size_t offset = 0; client->rx_len - offset >= SP_HDR_SZ; )
+   {
+      struct SpMsgHdr hdr;
+      spUnpackHdr(client->rx_buf + offset, &hdr);
+      if ( hdr.magic != SP_MAGIC || hdr.len > SP_MAX_PAYLOAD_SZ )
+      {
+         spStatAdd(tlsStats, SP_STAT_MSG_ERRORS, 1);
+         frRecord(FR_MSG_ERROR, 0, client->sfd, (uint64_t)hdr.magic << 32 | hdr.len);
+         return false;
+      }
+
+      if ( client->rx_len - offset < SP_HDR_SZ + hdr.len )
+         break; // rest of the message hasn't arrived yet
+      offset += SP_HDR_SZ + hdr.len;
+      nmsgs++;
+      offload |= ExecOffloadCmd[hdr.cmd < UCMD_UNKNOWN ? hdr.cmd : UCMD_UNKNOWN];
+   }
+   if ( 0 == nmsgs )
+      return true;
+   spStatAdd(tlsStats, SP_STAT_MSGS_IN, nmsgs);
+
+   client->rx_ns = rx_ns;
+   client->task = (struct ExecTask){ .run = runClientRequests, .arg = client };
+   atomic_store_explicit(&client->busy, true, memory_order_relaxed);
+   if ( offload )
+      execSubmit(&client->task);
+   else
+      runClientRequests(client);
+
+   return true;
+}
+
+/**
+ * @brief Read one datagram off a UDP listener, and carry out the SP request
+ *        in it, right here or on the executor
+ *
+ * Each datagram has to be exactly one SP message. Anything else is counted
+ * as a malformed message and ignored, since other peers share the socket.
+ */
+static void serviceDatagram( struct StreamContext * ctx, struct Client * client )
+{
+   assert(client != nullptr && client->dgram);
+   assert(client->ctx == ctx);
+   assert(!client->busy);
+
+   socklen_t peer_len = sizeof client->peer;
+   // MSG_TRUNC: get the datagram's real length, so an oversized one is noticed
+   ssize_t nbytes = recvfrom( client->sfd, client->rx_buf, sizeof client->rx_buf,
+                              MSG_DONTWAIT | MSG_TRUNC,
+                              (struct sockaddr *)&client->peer, &peer_len );
+   uint64_t rx_ns = monotonicNs();
+   if ( nbytes < 0 )
+      return; // nothing there after all, or an ICMP error from an earlier reply
+   spStatAdd( tlsStats, SP_STAT_BYTES_IN,
+              (uint64_t)((size_t)nbytes < sizeof client->rx_buf ? (size_t)nbytes
+                                                                 : sizeof client->rx_buf) );
+
+   struct SpMsgHdr hdr = {0};
+   if ( (size_t)nbytes >= SP_HDR_SZ )
+      spUnpackHdr(client->rx_buf, &hdr);
+   if ( (size_t)nbytes < SP_HDR_SZ || (size_t)nbytes > sizeof client->rx_buf
+        || hdr.magic != SP_MAGIC || hdr.len != (size_t)nbytes - SP_HDR_SZ )
+   {
+      spStatAdd(tlsStats, SP_STAT_MSG_ERRORS, 1);
+      frRecord(FR_MSG_ERROR, 0, client->sfd, (uint64_t)hdr.magic << 32 | hdr.len);
+      return;
+   }
+   spStatAdd(tlsStats, SP_STAT_MSGS_IN, 1);
+
+   client->rx_len = (size_t)nbytes;
+   client->rx_off = 0;
+   client->rx_ns = rx_ns;
+   struct DgramRequest * request = nullptr;
+   if ( ExecOffloadCmd[hdr.cmd < UCMD_UNKNOWN ? hdr.cmd : UCMD_UNKNOWN] )
+      request = malloc(sizeof *request); // out of memory: just carry it out here
+   if ( request != nullptr )
+   {
+      // Other peers' datagrams keep being read while this one's out
+      request->client = *client;
+      request->listener = client;
+      atomic_store_explicit(&request->client.busy, true, memory_order_relaxed);
+      request->client.task = (struct ExecTask){ .run = runDatagramRequest, .arg = request };
+      atomic_fetch_add_explicit(&client->ndgrams_out, 1, memory_order_relaxed);
+      execSubmit(&request->client.task);
+   }
+   else
+   {
+      client->task = (struct ExecTask){ .run = runClientRequests, .arg = client };
+      atomic_store_explicit(&client->busy, true, memory_order_relaxed);
+      runClientRequests(client);
+   }
+}
+
+/**
+ * @brief Carry out, in order, every complete request a client has buffered,
+ *        then hand the client back to its responder
+ *
+ * On a per-core context, a get-addr-info that has to wait on DNS stops this
+ * short, and the client stays busy until its core gets the lookup back and
+ * carries on from there (see coreResumeLookups()).
+ *
+ * @return false if it was stopped short
+ */
+static bool serveRequests( struct Client * client )
+{
+   struct StreamContext * ctx = client->ctx;
+   assert(client->busy);
+   if ( tlsWorker != nullptr )
+      tlsStats = &ctx->stats->slots[SP_STATS_SLOT_EXECUTOR + (size_t)(tlsWorker - ExecWorkers)];
+
+   while ( !client->drop && client->rx_len - client->rx_off >= SP_HDR_SZ )
+   {
+      struct SpMsgHdr hdr;
+      spUnpackHdr(client->rx_buf + client->rx_off, &hdr);
+      assert(hdr.magic == SP_MAGIC && hdr.len <= SP_MAX_PAYLOAD_SZ); // vetted by serviceClient()
+      if ( client->rx_len - client->rx_off < SP_HDR_SZ + hdr.len )
+         break; // rest of the message hasn't arrived yet
+
+      // Consumed before it's carried out, since that may hand the client off
+      const uint8_t * payload = client->rx_buf + client->rx_off + SP_HDR_SZ;
+      client->rx_off += SP_HDR_SZ + hdr.len;
+
+      SP_PROBE3(dispatch_start, client->sfd, hdr.cmd, hdr.len);
+      uint64_t dispatch_ns = monotonicNs();
+      bool dispatched = dispatchMsg(client, &hdr, payload, client->rx_ns);
+      if ( tlsSuspended )
+      {
+         tlsSuspended = false;
+         return false;
+      }
+      recordDispatch(client, hdr.cmd, monotonicNs() - dispatch_ns, dispatched);
+      if ( !dispatched )
+         client->drop = true;
+   }
+
+   // Shift any partial message to the front of the buffer
+   if ( client->rx_off > 0 && !client->drop )
+   {
+      memmove(client->rx_buf, client->rx_buf + client->rx_off, client->rx_len - client->rx_off);
+      client->rx_len -= client->rx_off;
+      client->rx_off = 0;
+   }
+
+   // The client's the responder's again (and may get freed) from here on
+   atomic_store_explicit(&client->busy, false, memory_order_release);
+   if ( tlsWorker != nullptr && ctx->wake_pipe[1] >= 0 )
+   {
+      ssize_t rc = write(ctx->wake_pipe[1], "", 1); // a full pipe's already a wake-up
+      (void)rc;
+   }
+   return true;
+}
+
+/**
+ * @brief An ExecTask's run: carry out a client's buffered requests
+ *
+ * Runs as an executor task, or directly on the responder for cheap requests.
+ */
+static void runClientRequests(void * arg)
+{
+   serveRequests(arg);
+}
+
+/**
+ * @brief Count how long a request took to carry out, and trace it
+ */
+static void recordDispatch( struct Client * client,
+                            uint8_t cmd,
+                            uint64_t dispatch_ns,
+                            bool dispatched )
+{
+   size_t cmd_idx = cmd < UCMD_UNKNOWN ? cmd : UCMD_UNKNOWN;
+   struct CmdLatency * latency = tlsWorker != nullptr ? tlsWorker->latency : client->ctx->latency;
+   latHistRecord(&latency->cmds[cmd_idx], dispatch_ns);
+   SP_PROBE4(dispatch_done, client->sfd, cmd, dispatch_ns, dispatched);
+   frRecord(dispatched ? FR_DISPATCH : FR_DISPATCH_FAIL, cmd, client->sfd, dispatch_ns);
+}
+
+/**
+ * @brief Carry out an offloaded datagram's request, then let its listener know
+ *        it's done /w the socket
+ */
+static void runDatagramRequest(void * arg)
+{
+   struct DgramRequest * request = arg;
+   struct Client * listener = request->listener;
+   int wake_fd = request->client.ctx->wake_pipe[1];
+   serveRequests(&request->client);
+   free(request);
+
+   // The listener (and its context) may be gone as soon as this drops, so
+   // nothing of theirs gets touched after it
+   atomic_fetch_sub_explicit(&listener->ndgrams_out, 1, memory_order_release);
+   if ( tlsWorker != nullptr && wake_fd >= 0 )
+   {
+      ssize_t rc = write(wake_fd, "", 1); // its worker may be waiting to close it
+      (void)rc;
+   }
+}
+
+/**
+ * @brief Carry out one SP request and send its reply
+ *
+ * @param[in] rx_ns : CLOCK_MONOTONIC time the request was read off the socket
+ *
+ * @return false if the reply couldn't be sent
+ */
+static bool dispatchMsg( struct Client * client,
+                         const struct SpMsgHdr * hdr,
+                         const uint8_t * payload,
+                         uint64_t rx_ns )
+{
+   assert(client != nullptr && hdr != nullptr);
+
+   if ( hdr->flags & SP_FLAG_REPLY )
+      return true; // clients have no business sending replies; ignore
+
+   switch ( (enum UserCmdCode)hdr->cmd )
+   {
+      case UCMD_MARCO:
+      {
+         if ( hdr->len != SP_MARCO_PAYLOAD_SZ )
+         {
+            static const char errmsg[] = "marco: malformed payload";
+            return sendMsg( client, UCMD_MARCO, SP_FLAG_REPLY | SP_FLAG_ERROR,
+                            errmsg, sizeof(errmsg) - 1 );
+         }
+
+         struct SpMarco marco;
+         spUnpackMarco(payload, &marco);
+
+         uint8_t polo_buf[SP_POLO_PAYLOAD_SZ];
+         spPackPolo( polo_buf, &(struct SpPolo){ .seq = marco.seq,
+                                                 .client_tx_ns = marco.client_tx_ns,
+                                                 .server_rx_ns = rx_ns,
+                                                 .server_tx_ns = monotonicNs() } );
+         return sendMsg(client, UCMD_MARCO, SP_FLAG_REPLY, polo_buf, sizeof polo_buf);
+      }
+
+      case UCMD_INET_PTON:
+         return dispatchInetPton(client, payload, hdr->len);
+
+      case UCMD_GETADDRINFO:
+         return dispatchGetAddrInfo(client, payload, hdr->len);
+
+      case UCMD_UNKNOWN:
+         // fallthrough
+      default:
+      {
+         static const char errmsg[] = "command not supported by this server";
+         return sendMsg( client, (enum UserCmdCode)hdr->cmd,
+                         SP_FLAG_REPLY | SP_FLAG_ERROR,
+                         errmsg, sizeof(errmsg) - 1 );
+      }
+   }
+}
+
+/**
+ * @brief inet-pton: convert the IPv4 or IPv6 address string in the payload,
+ *        and reply /w the address in network byte order (4 or 16 bytes)
+ */
+static bool dispatchInetPton( struct Client * client, const uint8_t * payload, size_t len )
+{
+   char addrstr[INET6_ADDRSTRLEN];
+   uint8_t addr[sizeof(struct in6_addr)];
+   if ( len > 0 && len < sizeof addrstr )
+   {
+      memcpy(addrstr, payload, len);
+      addrstr[len] = '\0';
+      if ( 1 == inet_pton(AF_INET, addrstr, addr) )
+         return sendMsg(client, UCMD_INET_PTON, SP_FLAG_REPLY, addr, sizeof(struct in_addr));
+      if ( 1 == inet_pton(AF_INET6, addrstr, addr) )
+         return sendMsg(client, UCMD_INET_PTON, SP_FLAG_REPLY, addr, sizeof(struct in6_addr));
+   }
+
+   static const char errmsg[] = "inet-pton: not an IPv4 or IPv6 address";
+   return sendMsg( client, UCMD_INET_PTON, SP_FLAG_REPLY | SP_FLAG_ERROR,
+                   errmsg, sizeof(errmsg) - 1 );
+}
+
+/**
+ * @brief get-addr-info: resolve the payload's "<node> [service]" and reply
+ *        /w one "address port" line per result, as many as fit
+ *
+ * @note Blocks for as long as the lookup takes (a DNS round trip, or a few
+ *       timeouts' worth), which is what the executor is there to absorb.
+ *       Answers still in the resolver cache come back right away. A per-core
+ *       context has no executor, so its lookups go out to the resolver
+ *       threads instead, and the client's requests pick up where they left
+ *       off once the reply's out.
+ */
+static bool dispatchGetAddrInfo( struct Client * client, const uint8_t * payload, size_t len )
+{
+   assert(len <= SP_MAX_PAYLOAD_SZ);
+   char query[SP_MAX_PAYLOAD_SZ + 1];
+   memcpy(query, payload, len);
+   query[len] = '\0';
+
+   char * node = query;
+   while ( ' ' == *node )
+      ++node;
+   char * service = strchr(node, ' ');
+   if ( service != nullptr )
+   {
+      *service++ = '\0';
+      while ( ' ' == *service )
+         ++service;
+      if ( '\0' == *service )
+         service = nullptr;
+   }
+   if ( '\0' == *node )
+   {
+      static const char errmsg[] = "get-addr-info: usage: <node> [service]";
+      return sendMsg( client, UCMD_GETADDRINFO, SP_FLAG_REPLY | SP_FLAG_ERROR,
+                      errmsg, sizeof(errmsg) - 1 );
+   }
+
+   const struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+   client->lookup_start_ns = monotonicNs();
+   struct CoreShard * core = client->ctx->core;
+   if ( core != nullptr && ResolverUp )
+   {
+      assert(tlsCore == core);
+      atomic_fetch_add_explicit(&core->nlookups_out, 1, memory_order_relaxed);
+      enum ResolverRetCode rsv_rc = asyncResolverSubmit( &Resolver, node, service, &hints,
+                                                         onAddrInfoResolved, client );
+      if ( RSV_QUEUED == rsv_rc || RSV_COALESCED == rsv_rc )
+      {
+         tlsSuspended = true; // coreResumeLookups() picks up from here
+         return true;
+      }
+      atomic_fetch_sub_explicit(&core->nlookups_out, 1, memory_order_relaxed);
+      if ( RSV_CACHE_HIT == rsv_rc )
+         return sendLookupReply(client); // the callback's already set it
+      if ( RSV_INVALID_INPUT == rsv_rc )
+      {
+         static const char errmsg[] = "get-addr-info: node or service too long";
+         return sendMsg( client, UCMD_GETADDRINFO, SP_FLAG_REPLY | SP_FLAG_ERROR,
+                         errmsg, sizeof(errmsg) - 1 );
+      }
+      // Too many lookups out (or shutting down): look this one up ourselves
+   }
+
+   struct CachedResult * cached = nullptr;
+   if ( resolverCacheLookup(node, service, &hints, &cached) != RC_MISS )
+   {
+      setLookupReply(client, cached->gai_retcode, cached->list);
+      resolverCacheRelease(cached);
+      return sendLookupReply(client);
+   }
+
+   struct addrinfo * results = nullptr;
+   int gai_rc = getaddrinfo(node, service, &hints, &results);
+   if ( gai_rc != 0 )
+      results = nullptr;
+   cached = resolverCacheInsert(node, service, &hints, gai_rc, results);
+   setLookupReply(client, gai_rc, results);
+   if ( results != nullptr )
+      freeaddrinfo(results);
+   resolverCacheRelease(cached);
+   return sendLookupReply(client);
+}
+
+/**
+ * @brief Resolver callback for a per-core get-addr-info lookup: stash the
+ *        reply, and hand the client back to its core to send it
+ *
+ * Runs on a resolver thread, or on the core itself for a cache hit, in which
+ * case dispatchGetAddrInfo() sends the reply. Nothing but the reply gets
+ * written from a resolver thread: the core sends it, counts it and carries on
+ * /w the client's requests (see coreResumeLookups()).
+ */
+static void onAddrInfoResolved( int gai_retcode, const struct addrinfo * result, void * user_arg )
+{
+   struct Client * client = user_arg;
+   struct CoreShard * core = client->ctx->core;
+   setLookupReply(client, gai_retcode, result);
+   if ( tlsCore == core )
+      return;
+
+   if ( tlsResolverLane < 0 )
+      tlsResolverLane = (int)atomic_fetch_add_explicit(&ResolverNLanes, 1, memory_order_relaxed);
+   assert((size_t)tlsResolverLane < RESOLVER_NWORKERS);
+
+   // The client's the core's again once it's pushed, so nothing of its gets
+   // looked at after that
+   int wake_fd = client->ctx->wake_pipe[1];
+   bool pushed = spSpscPush(&core->lookups_done[tlsResolverLane], &(struct SpSpscMsg){ .ptr = client });
+   assert(pushed); // at most one lookup out per client
+   (void)pushed;
+   ssize_t rc = write(wake_fd, "", 1); // a full pipe's already a wake-up
+   (void)rc;
+   atomic_fetch_sub_explicit(&core->nlookups_out, 1, memory_order_release);
+}
+
+/**
+ * @brief Send the replies of the lookups the resolver threads have handed
+ *        back, and carry on /w each of those clients' remaining requests
+ */
+static void coreResumeLookups( struct CoreShard * shard )
+{
+   for ( size_t lane = 0; lane < RESOLVER_NWORKERS; ++lane )
+   {
+      struct SpSpscMsg msg;
+      while ( spSpscPop(&shard->lookups_done[lane], &msg) )
+      {
+         struct Client * client = msg.ptr;
+         bool sent = sendLookupReply(client);
+         recordDispatch(client, UCMD_GETADDRINFO, monotonicNs() - client->lookup_start_ns, sent);
+         if ( !sent )
+            client->drop = true;
+         serveRequests(client);
+      }
+   }
+}
+
+/**
+ * @brief Format a lookup's outcome into its client's get-addr-info reply: one
+ *        "<address> <port>" line per result, or the error
+ */
+static void setLookupReply( struct Client * client, int gai_retcode, const struct addrinfo * list )
+{
+   char * reply = client->lookup_reply;
+   size_t reply_cap = sizeof client->lookup_reply;
+   client->lookup_failed = (gai_retcode != 0);
+   if ( gai_retcode != 0 )
+   {
+      int errmsg_len = snprintf(reply, reply_cap, "get-addr-info: %s", gai_strerror(gai_retcode));
+      client->lookup_reply_len = errmsg_len < 0 ? 0
+                               : (size_t)errmsg_len < reply_cap ? (size_t)errmsg_len
+                                                                : reply_cap - 1;
+      return;
+   }
+
+   size_t reply_len = 0;
+   for ( const struct addrinfo * ai = list; ai != nullptr; ai = ai->ai_next )
+   {
+      const void * addr;
+      in_port_t port;
+      if ( AF_INET == ai->ai_family )
+      {
+         const struct sockaddr_in * sin = (const struct sockaddr_in *)ai->ai_addr;
+         addr = &sin->sin_addr;
+         port = sin->sin_port;
+      }
+      else if ( AF_INET6 == ai->ai_family )
+      {
+         const struct sockaddr_in6 * sin6 = (const struct sockaddr_in6 *)ai->ai_addr;
+         addr = &sin6->sin6_addr;
+         port = sin6->sin6_port;
+      }
+      else
+      {
+         continue;
+      }
+
+      char addrstr[INET6_ADDRSTRLEN];
+      if ( nullptr == inet_ntop(ai->ai_family, addr, addrstr, sizeof addrstr) )
+         continue;
+      int line_len = snprintf( reply + reply_len, reply_cap - reply_len,
+                               "%s %u\n", addrstr, ntohs(port) );
+      if ( line_len < 0 || (size_t)line_len >= reply_cap - reply_len )
+         break; // out of room; reply /w what fit
+      reply_len += (size_t)line_len;
+   }
+   client->lookup_reply_len = reply_len;
+}
+
+static bool sendLookupReply( struct Client * client )
+{
+   return sendMsg( client, UCMD_GETADDRINFO,
+                   SP_FLAG_REPLY | (client->lookup_failed ? SP_FLAG_ERROR : 0),
+                   client->lookup_reply, client->lookup_reply_len );
+}
+
+/**
+ * @brief Frame and send an SP message in full
+ *
+ * Never blocks: whatever the socket won't take right now gets queued on the
+ * client, and goes out when its socket's writable again (clientFlushTx()).
+ * Replies of at least ZC_MIN_SZ (none, in a default build) go out /w
+ * MSG_ZEROCOPY (where supported) from one of the client's TX buffers, which
+ * then stays in flight until the kernel reports it's done reading it (see
+ * zcReap()).
+ *
+ * @return true if every byte was handed to the kernel or queued for it
+ */
+static bool sendMsg( struct Client * client,
+                     enum UserCmdCode cmd,
+                     uint8_t flags,
+                     const void * payload,
+                     size_t payload_len )
+{
+   assert(payload_len <= SP_MAX_PAYLOAD_SZ);
+
+   size_t total = SP_HDR_SZ + payload_len;
+   // Replies already queued go first, so this one queues up behind them
+   bool queue = client->tx_len > 0;
+   struct TxBuf * txbuf = nullptr;
+   if ( !queue && total >= ZC_MIN_SZ && zcEnable(client) )
+      txbuf = zcGetTxBuf(client); // nullptr: too many in flight, so copy
+   int zc_flag = 0;
+#if ZEROCOPY_SUPPORTED
+   if ( txbuf != nullptr )
+      zc_flag = MSG_ZEROCOPY;
+#endif
+
+   uint8_t stack_msg[SP_MAX_MSG_SZ];
+   uint8_t * msg = txbuf ? txbuf->data : stack_msg;
+   spPackHdr( msg, &(struct SpMsgHdr){ .magic = SP_MAGIC,
+                                       .cmd = (uint8_t)cmd,
+                                       .flags = flags,
+                                       .len = (uint32_t)payload_len } );
+   if ( payload_len > 0 )
+      memcpy(msg + SP_HDR_SZ, payload, payload_len);
+
+   size_t sent = 0;
+   bool ok = true;
+   while ( !queue && sent < total )
+   {
+      // A UDP listener's replies go back to whoever sent the request
+      ssize_t nbytes = sendto( client->sfd, msg + sent, total - sent,
+                               MSG_NOSIGNAL | MSG_DONTWAIT | zc_flag,
+                               client->dgram ? (const struct sockaddr *)&client->peer : nullptr,
+                               client->dgram ? sizeof client->peer : 0 );
+      if ( nbytes < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         // Out of memory for completion notifications; copy the rest instead
+         if ( ENOBUFS == errno && zc_flag != 0 )
+         {
+            zc_flag = 0;
+            continue;
+         }
+         // Socket buffer's full. A datagram's just lost, but a stream's rest
+         // waits its turn.
+         if ( (EAGAIN == errno || EWOULDBLOCK == errno) && !client->dgram )
+         {
+            queue = true;
+            break;
+         }
+         spStatAdd(tlsStats, SP_STAT_MSG_ERRORS, 1);
+         frRecord(FR_SEND_ERROR, 0, client->sfd, (uint64_t)errno);
+         ok = false;
+         break;
+      }
+      if ( zc_flag != 0 )
+      {
+         // Every successful zero-copy send takes the socket's next ID
+         if ( 0 == txbuf->nids )
+            txbuf->first_id = client->zc.next_id;
+         txbuf->nids++;
+         client->zc.next_id++;
+         spStatAdd(tlsStats, SP_STAT_ZC_SENDS, 1);
+      }
+      sent += (size_t)nbytes;
+   }
+   if ( ok && queue && !clientQueueTx(client, msg + sent, total - sent) )
+   {
+      spStatAdd(tlsStats, SP_STAT_MSG_ERRORS, 1);
+      frRecord(FR_SEND_ERROR, 0, client->sfd, (uint64_t)ENOBUFS);
+      ok = false;
+   }
+
+   if ( txbuf != nullptr && 0 == txbuf->nids )
+   {
+      zcPutTxBuf(client, txbuf); // the kernel never saw it
+   }
+   else if ( txbuf != nullptr )
+   {
+      txbuf->npending = txbuf->nids;
+      if ( nullptr == client->zc.inflight )
+         client->zc.inflight = txbuf;
+      else
+         client->zc.inflight_tail->next = txbuf;
+      client->zc.inflight_tail = txbuf;
+      client->zc.ninflight++;
+   }
+   if ( !ok )
+      return false;
+
+   spStatAdd(tlsStats, SP_STAT_BYTES_OUT, total);
+   spStatAdd(tlsStats, SP_STAT_MSGS_OUT, 1);
+   return true;
+}
+
+/**
+ * @brief Queue reply bytes on a client whose socket won't take them yet
+ *
+ * @return false if that'd put it over CLIENT_MAX_TX_QUEUED_SZ (or we're out
+ *         of memory)
+ */
+static bool clientQueueTx( struct Client * client, const uint8_t * bytes, size_t len )
+{
+   size_t need = client->tx_len + len;
+   if ( need > CLIENT_MAX_TX_QUEUED_SZ )
+      return false;
+   if ( need > client->tx_cap )
+   {
+      size_t cap = client->tx_cap ? client->tx_cap : SP_MAX_MSG_SZ;
+      while ( cap < need )
+         cap *= 2;
+      uint8_t * buf = realloc(client->tx_buf, cap);
+      if ( nullptr == buf )
+         return false;
+      client->tx_buf = buf;
+      client->tx_cap = cap;
+   }
+   memcpy(client->tx_buf + client->tx_len, bytes, len);
+   client->tx_len = need;
+   return true;
+}
+
+/**
+ * @brief Send as much of a client's queued reply bytes as its socket takes
+ *        right now
+ *
+ * @return false if the socket failed (e.g., the client hung up)
+ */
+static bool clientFlushTx( struct Client * client )
+{
+   size_t sent = 0;
+   while ( sent < client->tx_len )
+   {
+      ssize_t nbytes = send( client->sfd, client->tx_buf + sent, client->tx_len - sent,
+                             MSG_NOSIGNAL | MSG_DONTWAIT );
+      if ( nbytes < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         if ( EAGAIN == errno || EWOULDBLOCK == errno )
+            break;
+         spStatAdd(tlsStats, SP_STAT_MSG_ERRORS, 1);
+         frRecord(FR_SEND_ERROR, 0, client->sfd, (uint64_t)errno);
+         return false;
+      }
+      sent += (size_t)nbytes;
+   }
+
+   memmove(client->tx_buf, client->tx_buf + sent, client->tx_len - sent);
+   client->tx_len -= sent;
+   return true;
+}
+
+/**
+ * @brief Let go of everything a client's holding for its socket, before the
+ *        socket gets closed
+ */
+static void clientRelease( struct Client * client )
+{
+   zcRelease(client);
+   free(client->tx_buf);
+   client->tx_buf = nullptr;
+   client->tx_len = 0;
+   client->tx_cap = 0;
+}
+
+/**
+ * @brief accept() a connection whose socket comes out non-blocking, for the
+ *        loops that must never block on any one client
+ */
+static int acceptNonBlocking( int listening_sfd, struct sockaddr_in * peer, socklen_t * peer_len )
+{
+#ifdef __linux__
+   return accept4(listening_sfd, (struct sockaddr *)peer, peer_len, SOCK_NONBLOCK);
+#else
+   int sfd = accept(listening_sfd, (struct sockaddr *)peer, peer_len);
+   if ( sfd >= 0 && fcntl(sfd, F_SETFL, O_NONBLOCK) != 0 )
+   {
+      int fcntl_errno = errno;
+      close(sfd);
+      errno = fcntl_errno;
+      return -1;
+   }
+   return sfd;
+#endif
+}
+
+/**
+ * @brief Turn on zero-copy sends for a client's socket, the first time one of
+ *        its replies is big enough to be worth it
+ *
+ * @return true if its replies can go out /w MSG_ZEROCOPY
+ */
+static bool zcEnable( struct Client * client )
+{
+   if ( ZC_UNTRIED == client->zc.state )
+   {
+      client->zc.state = ZC_UNSUPPORTED;
+#if ZEROCOPY_SUPPORTED
+      // A UDP listener's socket is shared by all its peers; not worth it
+      if ( !client->dgram
+           && 0 == setsockopt(client->sfd, SOL_SOCKET, SO_ZEROCOPY, &(int){1}, sizeof(int)) )
+         client->zc.state = ZC_ON;
+#endif
+   }
+   return ZC_ON == client->zc.state;
+}
+
+/**
+ * @return a TX buffer /w nothing in flight, or nullptr if the client already
+ *         has ZC_MAX_INFLIGHT of them in flight (or we're out of memory)
+ */
+static struct TxBuf * zcGetTxBuf( struct Client * client )
+{
+   if ( nullptr == client->zc.free && client->zc.ninflight > 0 )
+      zcReap(client);
+   if ( client->zc.ninflight >= ZC_MAX_INFLIGHT )
+      return nullptr;
+
+   struct TxBuf * buf = client->zc.free;
+   if ( buf != nullptr )
+   {
+      client->zc.free = buf->next;
+      client->zc.nfree--;
+   }
+   else
+   {
+      buf = malloc(sizeof *buf);
+      if ( nullptr == buf )
+         return nullptr;
+   }
+   buf->next = nullptr;
+   buf->nids = 0;
+   buf->npending = 0;
+   return buf;
+}
+
+/**
+ * @brief Keep a TX buffer the kernel's done /w for the client's next reply,
+ *        or free it if the client already has enough
+ */
+static void zcPutTxBuf( struct Client * client, struct TxBuf * buf )
+{
+   if ( client->zc.nfree >= ZC_MAX_FREE_TXBUFS )
+   {
+      free(buf);
+      return;
+   }
+   buf->next = client->zc.free;
+   client->zc.free = buf;
+   client->zc.nfree++;
+}
+
+/**
+ * @brief Read every zero-copy completion off the client socket's error queue,
+ *        without blocking
+ */
+static void zcReap( struct Client * client )
+{
+#if ZEROCOPY_SUPPORTED
+   while ( client->zc.ninflight > 0 )
+   {
+      // The extended error, and the address of whoever caused it, which a
+      // completion doesn't have but there has to be room for
+      alignas(struct cmsghdr) uint8_t control[CMSG_SPACE( sizeof(struct sock_extended_err)
+                                                          + sizeof(struct sockaddr_in6) )];
+      struct msghdr mh = { .msg_control = control, .msg_controllen = sizeof control };
+      if ( recvmsg(client->sfd, &mh, MSG_ERRQUEUE | MSG_DONTWAIT) < 0 )
+         break; // nothing more (or EINTR, and it'll keep till next time)
+
+      for ( struct cmsghdr * cm = CMSG_FIRSTHDR(&mh); cm != nullptr; cm = CMSG_NXTHDR(&mh, cm) )
+      {
+         if ( !(IPPROTO_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type)
+              && !(IPPROTO_IPV6 == cm->cmsg_level && IPV6_RECVERR == cm->cmsg_type) )
+            continue;
+         struct sock_extended_err serr;
+         memcpy(&serr, CMSG_DATA(cm), sizeof serr);
+         if ( serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY )
+            continue;
+         // Sends ee_info through ee_data, which the kernel may have copied
+         // after all (e.g., over loopback, or a NIC that can't scatter-gather)
+         zcComplete( client, serr.ee_info, serr.ee_data,
+                     serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED );
+      }
+   }
+#else
+   (void)client;
+#endif
+}
+
+/**
+ * @brief Retire zero-copy sends lo through hi, and give back the TX buffers
+ *        that have nothing in flight anymore
+ */
+static void zcComplete( struct Client * client, uint32_t lo, uint32_t hi, bool copied )
+{
+   // IDs wrap around, so compare offsets from lo rather than the IDs
+   uint32_t span = hi - lo;
+   if ( copied )
+      spStatAdd(tlsStats, SP_STAT_ZC_COPIED, (uint64_t)span + 1);
+
+   struct TxBuf * prev = nullptr;
+   struct TxBuf * buf = client->zc.inflight;
+   while ( buf != nullptr )
+   {
+      for ( uint32_t k = 0; k < buf->nids; ++k )
+         if ( buf->first_id + k - lo <= span )
+            buf->npending--;
+
+      struct TxBuf * next = buf->next;
+      if ( buf->npending > 0 )
+      {
+         prev = buf;
+      }
+      else
+      {
+         if ( nullptr == prev )
+            client->zc.inflight = next;
+         else
+            prev->next = next;
+         if ( client->zc.inflight_tail == buf )
+            client->zc.inflight_tail = prev;
+         client->zc.ninflight--;
+         zcPutTxBuf(client, buf);
+      }
+      buf = next;
+   }
+}
+
+/**
+ * @brief Let go of a client's TX buffers, before its socket gets closed
+ *
+ * The ones the kernel may still be reading join ZcOrphans, until
+ * ZC_ORPHAN_GRACE_NS has passed; freeing them right away could put some other
+ * reply's bytes on this connection's wire.
+ */
+static void zcRelease( struct Client * client )
+{
+   zcReap(client);
+   while ( client->zc.free != nullptr )
+   {
+      struct TxBuf * next = client->zc.free->next;
+      free(client->zc.free);
+      client->zc.free = next;
+   }
+
+   if ( client->zc.inflight != nullptr )
+   {
+      uint64_t now_ns = monotonicNs();
+      for ( struct TxBuf * buf = client->zc.inflight; buf != nullptr; buf = buf->next )
+         buf->orphaned_ns = now_ns;
+
+      bool locked = profLock(&mtxZcOrphans, PROF_SITE);
+      assert(locked);
+      if ( locked )
+      {
+         if ( nullptr == ZcOrphans )
+            ZcOrphans = client->zc.inflight;
+         else
+            ZcOrphansTail->next = client->zc.inflight;
+         ZcOrphansTail = client->zc.inflight_tail;
+
+         // Free whichever earlier orphans have sat out their grace period
+         while ( ZcOrphans != nullptr && now_ns - ZcOrphans->orphaned_ns >= ZC_ORPHAN_GRACE_NS )
+         {
+            struct TxBuf * next = ZcOrphans->next;
+            free(ZcOrphans);
+            ZcOrphans = next;
+         }
+         if ( nullptr == ZcOrphans )
+            ZcOrphansTail = nullptr;
+
+         bool unlocked = profUnlock(&mtxZcOrphans);
+         assert(unlocked);
+         (void)unlocked;
+      }
+      // else: leaked, which beats freeing them under the kernel
+   }
+
+   client->zc = (struct ZcTx){0};
+}
+
+static uint64_t monotonicNs(void)
+{
+   struct timespec ts;
+   int retcode = clock_gettime(CLOCK_MONOTONIC, &ts);
+   assert(retcode == 0); // CLOCK_MONOTONIC is always supported on POSIX.1-2008
+   (void)retcode;
+   return (uint64_t)ts.tv_sec * 1'000'000'000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Set up the shared-memory segment the context threads count into
+ *
+ * Falls back to process-private memory if the segment can't be created, so
+ * counting and the stats command keep working; only scrapers lose out.
+ *
+ * @return false if not even that could be allocated
+ */
+static bool statsInit(void)
+{
+   snprintf( StatsShmName, sizeof StatsShmName, "%s%ld",
+             SP_STATS_SHM_PREFIX, (long)getpid() );
+
+   // Read-only for everyone else. The mode only applies to later opens, so
+   // this descriptor itself is still read-write.
+   int shm_fd = shm_open(StatsShmName, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IRGRP | S_IROTH);
+   if ( shm_fd >= 0 )
+   {
+      if ( 0 == ftruncate(shm_fd, sizeof(struct SpStatsShm)) )
+      {
+         void * mem = mmap( nullptr, sizeof(struct SpStatsShm),
+                            PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0 );
+         if ( MAP_FAILED != mem )
+            StatsShm = mem; // zero-filled by ftruncate()
+      }
+      close(shm_fd); // the mapping holds its own reference
+   }
+
+   if ( nullptr == StatsShm )
+   {
+      fprintf( stderr,
+               "Warning: Couldn't publish stats in shared memory at %s.\n"
+               "errno: %s (%d)\n"
+               "The stats command still works, but scrapers won't see anything.\n",
+               StatsShmName, strerror(errno), errno );
+      if ( shm_fd >= 0 )
+         shm_unlink(StatsShmName);
+      StatsShmName[0] = '\0';
+
+      StatsShm = calloc(1, sizeof *StatsShm);
+      if ( nullptr == StatsShm )
+      {
+         fprintf(stderr, "Error: Failed to allocate stats.\n");
+         return false;
+      }
+   }
+
+   StatsShm->version = SP_STATS_VERSION;
+   StatsShm->max_ctxs = (uint32_t)SP_STATS_MAX_CTXS;
+   StatsShm->nslots = SP_STATS_NSLOTS;
+   atomic_store_explicit(&StatsShm->nctxs, 0, memory_order_relaxed);
+   // Magic last, so a scraper that sees it sees the rest of the header too
+   atomic_thread_fence(memory_order_release);
+   StatsShm->magic = SP_STATS_MAGIC;
+
+   if ( StatsShmName[0] != '\0' )
+      printf("Publishing stats in shared memory at /dev/shm%s\n", StatsShmName);
+   return true;
+}
+
+/**
+ * @brief Take the stats segment's name down, so it doesn't outlive us
+ *
+ * @note The segment stays mapped, since context threads may still be counting.
+ */
+static void statsDeinit(void)
+{
+   if ( StatsShmName[0] != '\0' )
+      shm_unlink(StatsShmName);
+   StatsShmName[0] = '\0';
+}
+
+/**
+ * @brief Print every context's counters, summed over its threads
+ */
+static void printStats(void)
+{
+   if ( 0 == NContexts )
+   {
+      printf("No listening contexts yet.\n");
+      return;
+   }
+
+#define SP_STAT(stat_enum, stat_name, stat_desc) stat_name,
+   static const char * const stat_names[SP_STAT_N] = { SP_STATS_COUNTERS(SP_STAT) };
+#undef SP_STAT
+
+   uint64_t totals[SP_STAT_N] = {0};
+   for ( size_t i = 0; i < NContexts; ++i )
+   {
+      const struct StreamContext * ctx = Contexts[i];
+      uint64_t sums[SP_STAT_N];
+      for ( size_t s = 0; s < SP_STAT_N; ++s )
+      {
+         sums[s] = spStatSum(ctx->stats, (enum SpStat)s);
+         totals[s] += sums[s];
+      }
+
+      char addrstr[INET_ADDRSTRLEN];
+      const char * rc = inet_ntop(AF_INET, &ctx->listening_addr, addrstr, sizeof addrstr);
+      assert(rc != nullptr);
+      (void)rc;
+      printf( "Context %zu (%s:%u)", i, addrstr, ntohs(ctx->listening_port) );
+      if ( ctx->cpu >= 0 )
+         printf(" [core %d]", ctx->cpu);
+      if ( ctx->mux != nullptr )
+         printf(" [mux %zu]", (size_t)(ctx->mux - MuxWorkers));
+      if ( SOCK_DGRAM == ctx->sock_type )
+         printf(" [udp]");
+      bool enabled = atomic_load(&ctx->enabled);
+      printf("%s\n", enabled ? "" : " [disabled]");
+
+      // Gauges, derived from the counters (the acceptor and responder each
+      // only count their half of a client's life)
+      uint64_t active = sums[SP_STAT_ACCEPTS] - sums[SP_STAT_ACCEPTS_REJECTED]
+                        - sums[SP_STAT_CLIENTS_DROPPED];
+      printf("   %-18s %" PRIu64 "\n", "active_clients", active);
+      printf( "   %-18s %.2f\n", "poll_ready_avg",
+              sums[SP_STAT_POLL_WAKEUPS] > 0
+                 ? (double)sums[SP_STAT_POLL_READY] / (double)sums[SP_STAT_POLL_WAKEUPS]
+                 : 0.0 );
+#ifdef __linux__
+      // For a listening socket, Linux reports the accept queue's current
+      // length in tcpi_unacked and its limit in tcpi_sacked
+      struct tcp_info info;
+      socklen_t info_len = sizeof info;
+      if ( enabled && SOCK_STREAM == ctx->sock_type
+           && 0 == getsockopt(ctx->listening_sfd, IPPROTO_TCP, TCP_INFO, &info, &info_len) )
+         printf( "   %-18s %u / %u\n", "accept_queue", info.tcpi_unacked, info.tcpi_sacked );
+#endif
+
+      for ( size_t s = 0; s < SP_STAT_N; ++s )
+         printf("   %-18s %" PRIu64 "\n", stat_names[s], sums[s]);
+   }
+
+   if ( NContexts > 1 )
+   {
+      printf("All %zu contexts\n", NContexts);
+      for ( size_t s = 0; s < SP_STAT_N; ++s )
+         printf("   %-18s %" PRIu64 "\n", stat_names[s], totals[s]);
+   }
+}
+
+static size_t latHistBucket(uint64_t ns)
+{
+   if ( ns > LAT_HIST_MAX_NS )
+      ns = LAT_HIST_MAX_NS;
+   if ( ns < LAT_HIST_NSUB )
+      return (size_t)ns; // exact below the first split
+
+   // Position of the leading 1 picks the power of two, the next
+   // LAT_HIST_SUB_BITS bits pick the sub-bucket within it
+   unsigned msb = 63u - (unsigned)__builtin_clzll(ns);
+   unsigned shift = msb - LAT_HIST_SUB_BITS;
+   return (size_t)(shift + 1) * LAT_HIST_NSUB + (size_t)((ns >> shift) - LAT_HIST_NSUB);
+}
+
+/**
+ * @brief Largest value that lands in bucket, which is what percentiles report
+ */
+static uint64_t latHistBucketMaxNs(size_t bucket)
+{
+   if ( bucket < LAT_HIST_NSUB )
+      return bucket;
+   unsigned shift = (unsigned)(bucket / LAT_HIST_NSUB) - 1;
+   uint64_t sub = bucket % LAT_HIST_NSUB;
+   return ((LAT_HIST_NSUB + sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Count one ns-long sample
+ *
+ * @note Only one thread may record into a given histogram, which is what lets
+ *       this be a plain load and store rather than an atomic increment.
+ */
+static void latHistRecord(struct LatencyHist * hist, uint64_t ns)
+{
+   _Atomic uint64_t * count = &hist->counts[latHistBucket(ns)];
+   atomic_store_explicit( count,
+                          atomic_load_explicit(count, memory_order_relaxed) + 1,
+                          memory_order_relaxed );
+}
+
+/**
+ * @brief Print each command's service-time percentiles since the last reset,
+ *        merged across every context and executor worker
+ *
+ * @param[in] reset : start a new window after printing
+ */
+static void printLatency(bool reset)
+{
+#define SP_CMD(cmd_enum, cmd_str, cmd_char, cmd_args) cmd_str,
+   static const char * const cmd_names[UCMD_UNKNOWN + 1] = {
+#  include "misc-practice/sp-cmds.h"
+      "(unknown)"
+   };
+#undef SP_CMD
+   static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+   constexpr size_t NPERCENTILES = sizeof percentiles / sizeof percentiles[0];
+
+   static uint64_t merged[UCMD_UNKNOWN + 1][LAT_HIST_NBUCKETS];
+   memset(merged, 0x00, sizeof merged);
+   for ( size_t i = 0; i < NContexts; ++i )
+      cmdLatencyMerge(merged, Contexts[i]->latency, Contexts[i]->latency_base, reset);
+   for ( size_t i = 0; i < ExecNWorkers; ++i )
+      cmdLatencyMerge(merged, ExecWorkers[i].latency, ExecWorkers[i].latency_base, reset);
+
+   printf("Service time per command (us)%s\n", reset ? ", window now reset" : "");
+   printf("   %-16s %12s", "command", "count");
+   for ( size_t p = 0; p < NPERCENTILES; ++p )
+      printf(" %9.2f%%", percentiles[p]);
+   printf(" %10s\n", "max");
+
+   for ( size_t cmd = 0; cmd <= UCMD_UNKNOWN; ++cmd )
+   {
+      uint64_t total = 0;
+      size_t last = 0;
+      for ( size_t b = 0; b < LAT_HIST_NBUCKETS; ++b )
+      {
+         total += merged[cmd][b];
+         if ( merged[cmd][b] > 0 )
+            last = b;
+      }
+      if ( 0 == total )
+         continue;
+
+      printf("   %-16s %12" PRIu64, cmd_names[cmd], total);
+      for ( size_t p = 0; p < NPERCENTILES; ++p )
+         printf(" %10.3f", (double)latHistPercentileNs(merged[cmd], total, percentiles[p]) / 1e3);
+      printf(" %10.3f\n", (double)latHistBucketMaxNs(last) / 1e3);
+   }
+}
+
+/**
+ * @brief Add one thread's counts since its last reset into merged, and start
+ *        it a new window if reset
+ */
+static void cmdLatencyMerge( uint64_t merged[UCMD_UNKNOWN + 1][LAT_HIST_NBUCKETS],
+                             const struct CmdLatency * curr,
+                             struct CmdLatency * base,
+                             bool reset )
+{
+   for ( size_t cmd = 0; cmd <= UCMD_UNKNOWN; ++cmd )
+   {
+      for ( size_t b = 0; b < LAT_HIST_NBUCKETS; ++b )
+      {
+         uint64_t now = atomic_load_explicit(&curr->cmds[cmd].counts[b], memory_order_relaxed);
+         uint64_t then = atomic_load_explicit(&base->cmds[cmd].counts[b], memory_order_relaxed);
+         merged[cmd][b] += now - then;
+         if ( reset )
+            atomic_store_explicit(&base->cmds[cmd].counts[b], now, memory_order_relaxed);
+      }
+   }
+}
+
+/**
+ * @brief Value at or below which percentile % of a histogram's total samples
+ *        fall, to the precision of its buckets
+ */
+static uint64_t latHistPercentileNs( const uint64_t counts[LAT_HIST_NBUCKETS],
+                                     uint64_t total,
+                                     double percentile )
+{
+   double rank = percentile / 100.0 * (double)total;
+   uint64_t seen = 0;
+   size_t b = 0;
+   while ( b < LAT_HIST_NBUCKETS - 1 && (double)(seen + counts[b]) < rank )
+      seen += counts[b++];
+   return latHistBucketMaxNs(b);
+}
+
+static void profMutexInit(struct ProfMutex * pm, const char * name, time_t max_wait_sec)
+{
+   memset(pm, 0x00, sizeof *pm);
+   pthread_mutex_init(&pm->mtx, nullptr); // default mutex attributes
+   pm->name = name;
+   pm->max_wait_sec = max_wait_sec;
+}
+
+static void profMutexDeinit(struct ProfMutex * pm)
+{
+   int retcode = pthread_mutex_destroy(&pm->mtx);
+   assert(retcode == 0); // Nobody may still hold it, or be waiting on it
+   (void)retcode;
+}
+
+/**
+ * @brief Lock pm, waiting up to its max_wait_sec
+ *
+ * @param[in] site : where it's being locked from (PROF_SITE)
+ *
+ * @return false if the lock couldn't be had, in which case who held it (and
+ *         from where, and for how long) has been printed to stderr
+ */
+static bool profLock(struct ProfMutex * pm, const char * site)
+{
+   uint64_t start_ns = monotonicNs();
+
+   // Only pay for the timeout (and count a contention) if it's actually held
+   int retcode = pthread_mutex_trylock(&pm->mtx);
+   bool contended = (EBUSY == retcode);
+   if ( contended )
+   {
+      SP_PROBE1(mtx_wait, &pm->mtx);
+      struct timespec lock_timeout;
+      retcode = clock_gettime(CLOCK_REALTIME, &lock_timeout);
+      if ( 0 == retcode )
+      {
+         lock_timeout.tv_sec += pm->max_wait_sec;
+         retcode = pthread_mutex_timedlock(&pm->mtx, &lock_timeout);
+      }
+   }
+   if ( retcode != 0 )
+   {
+      // Racy snapshot of the owner, but it's only for the report, and each
+      // field on its own is consistent
+      const char * owner = atomic_load_explicit(&pm->owner_name, memory_order_relaxed);
+      const char * owner_site = atomic_load_explicit(&pm->owner_site, memory_order_relaxed);
+      uint64_t since_ns = atomic_load_explicit(&pm->owner_since_ns, memory_order_relaxed);
+      fprintf( stderr,
+               "Error: %s failed to lock %s at %s after %.3f s: %s (%d)\n"
+               "\tHeld by %s, locked at %s, %.3f s ago\n",
+               tlsThreadName, pm->name, site,
+               (double)(monotonicNs() - start_ns) / 1e9, strerror(retcode), retcode,
+               owner ? owner : "(nobody?)", owner_site ? owner_site : "?",
+               since_ns ? (double)(monotonicNs() - since_ns) / 1e9 : 0.0 );
+#if LOCK_PROFILING
+      atomic_fetch_add_explicit(&pm->ntimeouts, 1, memory_order_relaxed);
+#endif
+      frRecord(FR_LOCK_TIMEOUT, 0, retcode, monotonicNs() - start_ns);
+      return false;
+   }
+
+   uint64_t now_ns = monotonicNs();
+   atomic_store_explicit(&pm->owner_name, tlsThreadName, memory_order_relaxed);
+   atomic_store_explicit(&pm->owner_site, site, memory_order_relaxed);
+   atomic_store_explicit(&pm->owner_since_ns, now_ns, memory_order_relaxed);
+   SP_PROBE1(mtx_acquire, &pm->mtx);
+
+#if LOCK_PROFILING
+   // We hold the lock, so we're the only writer of everything below: plain
+   // loads and stores are enough
+#define PROF_INC(counter, n) \
+   atomic_store_explicit( &(counter), \
+                          atomic_load_explicit(&(counter), memory_order_relaxed) + (n), \
+                          memory_order_relaxed )
+   uint64_t wait_ns = now_ns - start_ns;
+   PROF_INC(pm->nacquired, 1);
+   PROF_INC(pm->ncontended, contended);
+   latHistRecord(&pm->wait, wait_ns);
+
+   struct LockSiteStats * site_stats = nullptr;
+   for ( size_t i = 0; i < LOCKPROF_MAX_SITES && nullptr == site_stats; ++i )
+   {
+      const char * slot_site = atomic_load_explicit(&pm->sites[i].site, memory_order_relaxed);
+      if ( nullptr == slot_site )
+      {
+         // Sites only get added, never removed
+         slot_site = site;
+         atomic_store_explicit(&pm->sites[i].site, site, memory_order_release);
+      }
+      if ( site == slot_site )
+         site_stats = &pm->sites[i];
+   }
+   if ( nullptr == site_stats )
+   {
+      PROF_INC(pm->nsites_overflowed, 1);
+   }
+   else
+   {
+      PROF_INC(site_stats->nacquired, 1);
+      PROF_INC(site_stats->ncontended, contended);
+      PROF_INC(site_stats->wait_ns, wait_ns);
+   }
+#undef PROF_INC
+#endif
+
+   return true;
+}
+
+/**
+ * @brief Unlock pm, which the calling thread must have locked /w profLock()
+ */
+static bool profUnlock(struct ProfMutex * pm)
+{
+#if LOCK_PROFILING
+   uint64_t hold_ns = monotonicNs() - atomic_load_explicit(&pm->owner_since_ns, memory_order_relaxed);
+   latHistRecord(&pm->hold, hold_ns);
+   const char * site = atomic_load_explicit(&pm->owner_site, memory_order_relaxed);
+   for ( size_t i = 0; i < LOCKPROF_MAX_SITES; ++i )
+   {
+      const char * slot_site = atomic_load_explicit(&pm->sites[i].site, memory_order_relaxed);
+      if ( nullptr == slot_site )
+         break;
+      if ( site == slot_site )
+      {
+         _Atomic uint64_t * total = &pm->sites[i].hold_ns;
+         atomic_store_explicit( total,
+                                atomic_load_explicit(total, memory_order_relaxed) + hold_ns,
+                                memory_order_relaxed );
+         break;
+      }
+   }
+#endif
+   atomic_store_explicit(&pm->owner_name, nullptr, memory_order_relaxed);
+   atomic_store_explicit(&pm->owner_site, nullptr, memory_order_relaxed);
+   atomic_store_explicit(&pm->owner_since_ns, 0, memory_order_relaxed);
+
+   SP_PROBE1(mtx_release, &pm->mtx);
+   return 0 == pthread_mutex_unlock(&pm->mtx);
+}
+
+/**
+ * @brief Print one lock's contention profile: how often it had to be waited
+ *        for, wait and hold time percentiles, and the same per locking site
+ */
+static void printLockProfile(const struct ProfMutex * pm)
+{
+   const char * owner = atomic_load_explicit(&pm->owner_name, memory_order_relaxed);
+   const char * owner_site = atomic_load_explicit(&pm->owner_site, memory_order_relaxed);
+   printf( "%s: held by %s%s%s\n", pm->name, owner ? owner : "nobody",
+           owner ? " at " : "", owner ? owner_site : "" );
+
+#if LOCK_PROFILING
+   uint64_t nacquired = atomic_load_explicit(&pm->nacquired, memory_order_relaxed);
+   uint64_t ncontended = atomic_load_explicit(&pm->ncontended, memory_order_relaxed);
+   printf( "   acquired %" PRIu64 " times, contended %" PRIu64 " (%.2f%%), "
+           "timed out %" PRIu64 "\n",
+           nacquired, ncontended,
+           nacquired ? 100.0 * (double)ncontended / (double)nacquired : 0.0,
+           atomic_load_explicit(&pm->ntimeouts, memory_order_relaxed) );
+   if ( 0 == nacquired )
+      return;
+
+   static const double percentiles[] = { 50.0, 99.0, 99.9 };
+   constexpr size_t NPERCENTILES = sizeof percentiles / sizeof percentiles[0];
+   const struct LatencyHist * hists[] = { &pm->wait, &pm->hold };
+   const char * hist_names[] = { "wait", "hold" };
+   printf("   %-6s %10s %10s %10s %10s\n", "(us)", "p50", "p99", "p99.9", "max");
+   for ( size_t h = 0; h < 2; ++h )
+   {
+      uint64_t counts[LAT_HIST_NBUCKETS];
+      uint64_t total = 0;
+      size_t last = 0;
+      for ( size_t b = 0; b < LAT_HIST_NBUCKETS; ++b )
+      {
+         counts[b] = atomic_load_explicit(&hists[h]->counts[b], memory_order_relaxed);
+         total += counts[b];
+         if ( counts[b] > 0 )
+            last = b;
+      }
+      printf("   %-6s", hist_names[h]);
+      for ( size_t p = 0; p < NPERCENTILES; ++p )
+         printf(" %10.3f", (double)latHistPercentileNs(counts, total, percentiles[p]) / 1e3);
+      printf(" %10.3f\n", (double)latHistBucketMaxNs(last) / 1e3);
+   }
+
+   printf( "   %-28s %12s %12s %14s %14s\n",
+           "site", "acquired", "contended", "avg wait (us)", "avg hold (us)" );
+   for ( size_t i = 0; i < LOCKPROF_MAX_SITES; ++i )
+   {
+      const struct LockSiteStats * site = &pm->sites[i];
+      const char * site_name = atomic_load_explicit(&site->site, memory_order_acquire);
+      if ( nullptr == site_name )
+         break;
+      uint64_t n = atomic_load_explicit(&site->nacquired, memory_order_relaxed);
+      if ( 0 == n )
+         continue;
+      printf( "   %-28s %12" PRIu64 " %12" PRIu64 " %14.3f %14.3f\n",
+              site_name, n, atomic_load_explicit(&site->ncontended, memory_order_relaxed),
+              (double)atomic_load_explicit(&site->wait_ns, memory_order_relaxed) / (double)n / 1e3,
+              (double)atomic_load_explicit(&site->hold_ns, memory_order_relaxed) / (double)n / 1e3 );
+   }
+   uint64_t noverflow = atomic_load_explicit(&pm->nsites_overflowed, memory_order_relaxed);
+   if ( noverflow > 0 )
+      printf("   (+%" PRIu64 " acquisitions from sites past the first %zu)\n",
+             noverflow, LOCKPROF_MAX_SITES);
+#endif
+}
+
+static void printLocks(void)
+{
+#if !LOCK_PROFILING
+   printf("Built /w LOCK_PROFILING=0; only showing current owners.\n");
+#endif
+   printLockProfile(&mtxPrintf);
+   printLockProfile(&mtxZcOrphans);
+   for ( size_t i = 0; i < NContexts; ++i )
+   {
+      printf("Context %zu ", i);
+      printLockProfile(&Contexts[i]->mtx);
+   }
+}
+
+/**
+ * @brief Get the REPL's ring going and hook the crash signals
+ */
+static void frInit(void)
+{
+   snprintf( FrDumpPath, sizeof FrDumpPath, "%s%ld%s",
+             FR_DUMP_PREFIX, (long)getpid(), FR_DUMP_SUFFIX );
+   frThreadStart();
+
+   struct sigaction sa_cfg;
+   memset(&sa_cfg, 0x00, sizeof sa_cfg);
+   sigemptyset(&sa_cfg.sa_mask);
+   sa_cfg.sa_handler = handleCrashSignal;
+   sa_cfg.sa_flags = SA_RESETHAND; // the handler re-raises into the default action
+   static const int crash_signals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+   for ( size_t i = 0; i < sizeof crash_signals / sizeof crash_signals[0]; ++i )
+   {
+      if ( sigaction(crash_signals[i], &sa_cfg, nullptr) != 0 )
+      {
+         fprintf( stderr,
+                  "Warning: sigaction() failed for signal %d: %s (%d)\n"
+                  "The flight recorder won't be dumped if it happens.\n",
+                  crash_signals[i], strerror(errno), errno );
+      }
+   }
+}
+
+/**
+ * @brief Give the calling thread a ring, named after its tlsThreadName
+ *
+ * If there's no memory or no room left for one, the thread simply doesn't
+ * record anything.
+ */
+static void frThreadStart(void)
+{
+   struct FrRing * ring = calloc(1, sizeof *ring);
+   if ( nullptr == ring )
+      return;
+
+   size_t idx = atomic_fetch_add(&FrNRings, 1);
+   if ( idx >= FR_MAX_RINGS )
+   {
+      free(ring);
+      return;
+   }
+   memcpy(ring->name, tlsThreadName, sizeof ring->name);
+   atomic_store_explicit(&FrRings[idx], ring, memory_order_release);
+
+   tlsRing = ring;
+   frRecord(FR_THREAD_START, 0, 0, 0);
+}
+
+/**
+ * @brief Record one event into the calling thread's ring
+ *
+ * @note The fields are plain stores. A dump racing /w this can catch the
+ *       slot being written half-updated, which the decoder just shows as is.
+ */
+static inline void frRecord(enum FrEventType type, uint16_t aux, int32_t a, uint64_t b)
+{
+   struct FrRing * ring = tlsRing;
+   if ( nullptr == ring )
+      return;
+
+   uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   struct FrEvent * ev = &ring->events[head & (FR_RING_NEVENTS - 1)];
+   ev->ts_ns = monotonicNs();
+   ev->type = (uint16_t)type;
+   ev->aux = aux;
+   ev->a = a;
+   ev->b = b;
+   atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static bool frWriteAll(int fd, const void * buf, size_t len)
+{
+   const uint8_t * bytes = buf;
+   while ( len > 0 )
+   {
+      ssize_t nbytes = write(fd, bytes, len);
+      if ( nbytes < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         return false;
+      }
+      bytes += nbytes;
+      len -= (size_t)nbytes;
+   }
+   return true;
+}
+
+/**
+ * @brief Write every ring to FrDumpPath (format in sp-flightrec.h)
+ *
+ * @param[in] signo : signal that triggered the dump, 0 if none
+ *
+ * @note Async-signal-safe, since the crash handler calls it
+ */
+static bool frDump(int signo)
+{
+   int saved_errno = errno;
+
+   int fd = open(FrDumpPath, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+   if ( fd < 0 )
+      return false;
+
+   size_t nrings = atomic_load_explicit(&FrNRings, memory_order_acquire);
+   if ( nrings > FR_MAX_RINGS )
+      nrings = FR_MAX_RINGS;
+   // A ring registered but not stored yet gets skipped, so count them first
+   uint32_t nready = 0;
+   for ( size_t i = 0; i < nrings; ++i )
+      if ( atomic_load_explicit(&FrRings[i], memory_order_acquire) != nullptr )
+         nready++;
+
+   struct timespec mono_ts = {0};
+   struct timespec real_ts = {0};
+   clock_gettime(CLOCK_MONOTONIC, &mono_ts);
+   clock_gettime(CLOCK_REALTIME, &real_ts);
+   struct FrFileHdr file_hdr = {
+      .magic = FR_MAGIC,
+      .version = FR_VERSION,
+      .nrings = nready,
+      .ring_nevents = FR_RING_NEVENTS,
+      .signo = signo,
+      .dump_mono_ns = (uint64_t)mono_ts.tv_sec * 1'000'000'000u + (uint64_t)mono_ts.tv_nsec,
+      .dump_real_ns = (uint64_t)real_ts.tv_sec * 1'000'000'000u + (uint64_t)real_ts.tv_nsec,
+   };
+   bool ok = frWriteAll(fd, &file_hdr, sizeof file_hdr);
+
+   for ( size_t i = 0; i < nrings && ok && nready > 0; ++i )
+   {
+      const struct FrRing * ring = atomic_load_explicit(&FrRings[i], memory_order_acquire);
+      if ( nullptr == ring )
+         continue;
+      nready--;
+
+      struct FrRingHdr ring_hdr;
+      memcpy(ring_hdr.name, ring->name, sizeof ring_hdr.name);
+      ring_hdr.head = atomic_load_explicit(&ring->head, memory_order_acquire);
+      ok = frWriteAll(fd, &ring_hdr, sizeof ring_hdr)
+           && frWriteAll(fd, ring->events, sizeof ring->events);
+   }
+
+   ok = (0 == close(fd)) && ok;
+   if ( ok )
+      errno = saved_errno;
+   return ok;
+}
+
+/**
+ * @brief Start the request executor's workers
+ *
+ * Every worker owns a deque, and so does every responder. Responders push
+ * their clients' requests onto their own deques, and workers take work from
+ * wherever there is some: their own deque first (newest first, while it's
+ * still in cache), then by stealing the oldest task off any other deque. So a
+ * worker stuck on a slow request (e.g., a get-addr-info waiting on DNS) only
+ * holds up the one client it's serving, and everything else goes to whoever's
+ * free.
+ *
+ * @return false if no workers could be started
+ */
+static bool execInit(void)
+{
+   long nworkers = EXEC_NWORKERS;
+   if ( nworkers <= 0 )
+   {
+      nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+      if ( nworkers < (long)EXEC_MIN_WORKERS )
+         nworkers = EXEC_MIN_WORKERS;
+   }
+   if ( (size_t)nworkers > EXEC_MAX_WORKERS )
+      nworkers = EXEC_MAX_WORKERS;
+
+   if ( sem_init(&ExecNPending, 0, 0) != 0 )
+   {
+      fprintf(stderr, "Error: sem_init() failed: %s (%d)\n", strerror(errno), errno);
+      return false;
+   }
+   ExecWorkers = calloc((size_t)nworkers, sizeof *ExecWorkers);
+   if ( nullptr == ExecWorkers )
+   {
+      fprintf(stderr, "Error: Failed to allocate %ld executor workers.\n", nworkers);
+      return false;
+   }
+
+   for ( size_t i = 0; i < (size_t)nworkers; ++i )
+   {
+      struct ExecWorker * worker = &ExecWorkers[i];
+      worker->latency = calloc(1, sizeof *worker->latency);
+      worker->latency_base = calloc(1, sizeof *worker->latency_base);
+      if ( nullptr == worker->latency || nullptr == worker->latency_base
+           || !spWsDequeInit(&worker->deque, EXEC_DEQUE_CAP) )
+      {
+         free(worker->latency);
+         free(worker->latency_base);
+         break;
+      }
+      int retcode = pthread_create(&worker->thread, nullptr, execWorkerThread, worker);
+      if ( retcode != 0 )
+      {
+         fprintf( stderr, "Error: Failed to create executor worker %zu: %s (%d)\n",
+                  i, strerror(retcode), retcode );
+         spWsDequeDeinit(&worker->deque);
+         free(worker->latency);
+         free(worker->latency_base);
+         break;
+      }
+      // Registering after the fact is fine: only the worker itself pushes
+      // onto its deque, and it always checks there first
+      bool registered = execRegisterDeque(&worker->deque);
+      assert(registered); // EXEC_MAX_DEQUES counts every worker
+      (void)registered;
+      ExecNWorkers++;
+   }
+
+   if ( 0 == ExecNWorkers )
+   {
+      free(ExecWorkers);
+      ExecWorkers = nullptr;
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief Make dq one of the deques workers steal from
+ *
+ * @return false if there's no room for it
+ */
+static bool execRegisterDeque(struct SpWsDeque * dq)
+{
+   size_t idx = atomic_fetch_add(&ExecNDeques, 1);
+   if ( idx >= EXEC_MAX_DEQUES )
+      return false;
+   atomic_store_explicit(&ExecDeques[idx], dq, memory_order_release);
+   return true;
+}
+
+/**
+ * @brief Hand task to the executor, through the calling thread's deque
+ *
+ * If this thread has no deque, or it's full, the task runs right here.
+ */
+static void execSubmit(struct ExecTask * task)
+{
+   if ( nullptr == tlsDeque || !spWsDequePush(tlsDeque, task) )
+   {
+      task->run(task->arg);
+      return;
+   }
+   int retcode = sem_post(&ExecNPending);
+   assert(retcode == 0); // only fails on overflow, way past EXEC_MAX_DEQUES * EXEC_DEQUE_CAP
+   (void)retcode;
+}
+
+static void * execWorkerThread(void * arg)
+{
+   struct ExecWorker * self = arg;
+   size_t self_idx = (size_t)(self - ExecWorkers);
+   snprintf(tlsThreadName, sizeof tlsThreadName, "worker:%zu", self_idx);
+   frThreadStart();
+   tlsDeque = &self->deque;
+   tlsWorker = self;
+   // xorshift64 state for picking where to start looking for work, so the
+   // workers don't all pile onto the same victims
+   uint64_t rng = 0x9E37'79B9'7F4A'7C15u * (self_idx + 1);
+
+   for ( ;; )
+   {
+      // Claim a pending task, then go find it
+      if ( sem_wait(&ExecNPending) != 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         fprintf(stderr, "Error: sem_wait() failed: %s (%d)\n", strerror(errno), errno);
+         break;
+      }
+
+      struct ExecTask * task = spWsDequePop(&self->deque);
+      bool stolen = false;
+      while ( nullptr == task )
+      {
+         size_t ndeques = atomic_load_explicit(&ExecNDeques, memory_order_acquire);
+         if ( ndeques > EXEC_MAX_DEQUES )
+            ndeques = EXEC_MAX_DEQUES;
+         rng ^= rng << 13;
+         rng ^= rng >> 7;
+         rng ^= rng << 17;
+         size_t start = (size_t)(rng % ndeques);
+
+         for ( size_t i = 0; i < ndeques && nullptr == task; ++i )
+         {
+            struct SpWsDeque * victim = atomic_load_explicit( &ExecDeques[(start + i) % ndeques],
+                                                              memory_order_acquire );
+            void * item = nullptr;
+            enum SpWsStealResult result = victim ? spWsDequeSteal(victim, &item) : SP_WS_EMPTY;
+            if ( SP_WS_STOLEN == result )
+            {
+               task = item;
+               stolen = (victim != &self->deque);
+            }
+            else if ( SP_WS_ABORT == result )
+            {
+               atomic_fetch_add_explicit(&self->nsteal_aborts, 1, memory_order_relaxed);
+            }
+         }
+
+         // Whoever beat us to it left ours somewhere; give them a moment
+         if ( nullptr == task )
+            sched_yield();
+      }
+
+      uint64_t start_ns = monotonicNs();
+      task->run(task->arg);
+      atomic_fetch_add_explicit(&self->busy_ns, monotonicNs() - start_ns, memory_order_relaxed);
+      atomic_fetch_add_explicit(&self->nrun, 1, memory_order_relaxed);
+      if ( stolen )
+         atomic_fetch_add_explicit(&self->nstolen, 1, memory_order_relaxed);
+   }
+
+   frRecord(FR_THREAD_EXIT, 0, 0, atomic_load(&self->nrun));
+   return nullptr;
+}
+
+/**
+ * @brief Print what each executor worker has been up to
+ */
+static void printExecutor(void)
+{
+   if ( 0 == ExecNWorkers )
+   {
+      printf("No executor workers; responders carry out requests themselves.\n");
+      return;
+   }
+
+   size_t ndeques = atomic_load_explicit(&ExecNDeques, memory_order_acquire);
+   if ( ndeques > EXEC_MAX_DEQUES )
+      ndeques = EXEC_MAX_DEQUES;
+   size_t nqueued = 0;
+   for ( size_t i = 0; i < ndeques; ++i )
+   {
+      struct SpWsDeque * dq = atomic_load_explicit(&ExecDeques[i], memory_order_acquire);
+      if ( dq != nullptr )
+         nqueued += spWsDequeSize(dq);
+   }
+   printf( "Executor: %zu workers, %zu deques, ~%zu tasks queued\n",
+           ExecNWorkers, ndeques, nqueued );
+
+   printf( "   %-10s %12s %12s %8s %13s %10s\n",
+           "worker", "tasks", "stolen", "stolen%", "steal-aborts", "busy-s" );
+   for ( size_t i = 0; i < ExecNWorkers; ++i )
+   {
+      const struct ExecWorker * worker = &ExecWorkers[i];
+      uint64_t nrun = atomic_load_explicit(&worker->nrun, memory_order_relaxed);
+      uint64_t nstolen = atomic_load_explicit(&worker->nstolen, memory_order_relaxed);
+      printf( "   %-10zu %12" PRIu64 " %12" PRIu64 " %7.1f%% %13" PRIu64 " %10.3f\n",
+              i, nrun, nstolen, nrun ? 100.0 * (double)nstolen / (double)nrun : 0.0,
+              atomic_load_explicit(&worker->nsteal_aborts, memory_order_relaxed),
+              (double)atomic_load_explicit(&worker->busy_ns, memory_order_relaxed) / 1e9 );
+   }
+}
+
+static bool addClient( struct StreamContext * ctx,
+                       const struct Client * client_info )
+{
+   assert(ctx != nullptr);
+   assert(client_info != nullptr);
+   assert( ctx->clients.head != nullptr
+           || (ctx->clients.head == nullptr && ctx->clients.len == 0) );
+   assert(client_info->sfd >= 0);
+   assert(client_info->next == nullptr);
+
+   if ( ctx->clients.len >= MAX_CLIENTS )
+   {
+      fprintf( stderr, "Clientelle is full! %zu is the max.\n"
+                       "Please close a connection first.\n", MAX_CLIENTS);
+      return false;
+   }
+
+   // It is assumed that the client object is temporary and we need to
+   // dynamically allocate a client object here to then place in the client list
+   struct Client * new_client = malloc( sizeof(struct Client) );
+   if ( nullptr == new_client )
+   {
+      // TODO: Log error in library log that user can choose to read/print from?
+      return false;
+   }
+   *new_client = *client_info;
+   new_client->ctx = ctx;
+
+   // Add to shared list
+   bool locked = profLock(&ctx->mtx, PROF_SITE);
+   // Pretty much any reason the timed mutex lock fails is cause for redesign
+   // (e.g., different timeout, excessively long critical section elsewhere,
+   // etc.), so call assert() to indicate this failure and abort. profLock()
+   // has already reported who held the lock.
+   assert(locked);
+   if ( !locked )
+   {
+      free(new_client);
+      return false;
+   }
+
+   if ( 0 == ctx->clients.len )
    {
       ctx->clients.head = new_client;
       ctx->clients.tail = new_client;
@@ -726,10 +4467,13 @@ static bool addClient( struct StreamContext * ctx,
       ctx->clients.tail = ctx->clients.tail->next;
    }
    ctx->clients.len++;
+   SP_PROBE2(client_add, new_client->sfd, ctx->clients.len);
+   frRecord(FR_CLIENT_ADD, 0, new_client->sfd, ctx->clients.len);
 
-   retcode = pthread_mutex_unlock(&ctx->mtx);
+   bool unlocked = profUnlock(&ctx->mtx);
    // Similarly, any error in unlocking signals a redesign to me. Assert!
-   assert(retcode == 0);
+   assert(unlocked);
+   (void)unlocked;
 
    assert(new_client->next == nullptr);
    assert(ctx->clients.head != nullptr);
@@ -753,31 +4497,23 @@ static bool rmvClient( struct StreamContext * ctx,
    
    // Find client in list based on IP and port
    // First, lock list
-   struct timespec lock_timeout;
-   int retcode = clock_gettime(CLOCK_REALTIME, &lock_timeout);
-   if ( retcode != 0 )
-   {
-      // TODO: lib log...
-      return false;
-   }
-   lock_timeout.tv_sec += MAX_MTX_LOCK_WAIT_SEC;
-   retcode = pthread_mutex_timedlock(&ctx->mtx, &lock_timeout);
+   bool locked = profLock(&ctx->mtx, PROF_SITE);
    // Pretty much any reason the timed mutex lock fails is cause for redesign
    // (e.g., different timeout, excessively long critical section elsewhere,
-   // etc.), so call assert() to indicate this failure and abort.
-   assert(retcode == 0); // FIXME: It'd be good to print out _who_ owned the lock at failure...
+   // etc.), so call assert() to indicate this failure and abort. profLock()
+   // has already reported who held the lock.
+   assert(locked);
+   if ( !locked )
+      return false;
 
    struct Client * old_client = nullptr;
-   struct Client * prv_node = ctx->clients.head;
+   struct Client * prv_node = nullptr; // stays nullptr if old_client is the head
    size_t iter = 1;
 
    for ( struct Client * curr = ctx->clients.head;
          curr != nullptr && iter <= ctx->clients.len;
-         curr = curr->next, ++iter )
+         prv_node = curr, curr = curr->next, ++iter )
    {
-      if ( iter > 2 )
-         prv_node = prv_node->next;
-
       if ( ip == curr->addr && port == curr->port )
       {
          old_client = curr;
@@ -788,31 +4524,36 @@ static bool rmvClient( struct StreamContext * ctx,
    // If we failed to find a match in the list...
    if ( nullptr == old_client )
    {
-      retcode = pthread_mutex_unlock(&ctx->mtx);
-      assert(retcode == 0); // If unlock fails, I screwed up
+      bool unlocked = profUnlock(&ctx->mtx);
+      assert(unlocked); // If unlock fails, I screwed up
+      (void)unlocked;
       return false;
    }
 
-   // Remove from list
-   if ( 1 == ctx->clients.len )
-   {
-      ctx->clients.head = nullptr;
-      ctx->clients.tail = nullptr;
-   }
+   // Remove from list. The head and tail have to follow when it's one of
+   // them, or they'd be left pointing at the freed client.
+   if ( nullptr == prv_node )
+      ctx->clients.head = old_client->next;
    else
-   {
       prv_node->next = old_client->next;
-   }
+   if ( ctx->clients.tail == old_client )
+      ctx->clients.tail = prv_node;
    ctx->clients.len--;
+   SP_PROBE2(client_rmv, old_client->sfd, ctx->clients.len);
+   frRecord(FR_CLIENT_RMV, 0, old_client->sfd, ctx->clients.len);
 
-   retcode = pthread_mutex_unlock(&ctx->mtx);
-   assert(retcode == 0); // If unlock fails, I screwed up
+   bool unlocked = profUnlock(&ctx->mtx);
+   assert(unlocked); // If unlock fails, I screwed up
+   (void)unlocked;
 
    // Close socket line /w client
+   clientRelease(old_client);
+   int retcode;
    size_t close_nreps = 0;
    while ( (retcode = close(old_client->sfd)) != 0 && close_nreps++ < 10 );
    if ( close_nreps >= 10 )
    {
+      frRecord(FR_CLOSE_ERROR, 0, old_client->sfd, (uint64_t)errno);
       fprintf( stderr,
                "%s:%d : Error: Unable to close socket %d!\n"
                "Aborting program.\n",
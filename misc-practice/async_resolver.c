@@ -0,0 +1,471 @@
+/**
+ * @file async_resolver.c
+ * @brief Asynchronous getaddrinfo() on a bounded pool of resolver threads
+ *
+ * getaddrinfo() blocks for as long as the slowest DNS server it talks to, so
+ * calling it inline stalls whatever REPL or worker thread called it. This
+ * module takes lookups from any number of callers, coalesces identical
+ * in-flight queries into one getaddrinfo() call, and delivers the result to
+ * every interested caller through a callback.
+ *
+ * If the process-wide resolver cache has been enabled (resolverCacheInit()),
+ * submissions are answered from it when possible and every completed lookup
+ * is stored in it.
+ *
+ * @note Unity-build module, like the ai_*_lookup.c tables: #include this .c
+ *       file from the program that uses it, and link /w -pthread. It pulls in
+ *       resolver_cache.c itself.
+ * @note glibc's getaddrinfo_a() was considered, but it is GNU-only, spawns a
+ *       thread per request internally, and does no de-duplication.
+ */
+
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "resolver_cache.c"
+
+/*************************** Constants and Types ******************************/
+constexpr size_t RSV_MAX_WORKERS = 16;
+constexpr size_t RSV_MAX_INFLIGHT = 64;  // distinct queries queued or resolving
+constexpr size_t RSV_MAX_WAITERS = 256;  // callbacks awaiting a result
+constexpr size_t RSV_MAX_NODE_STRLEN = 256; // DNS names are at most 253 chars
+constexpr size_t RSV_MAX_SERVICE_STRLEN = 32; // NI_MAXSERV, which needs _DEFAULT_SOURCE
+
+/**
+ * @brief Completion callback for an asynchronous lookup
+ * @note Runs on a resolver thread, or on the submitting thread itself when
+ *       the lookup is answered from the cache. result is only valid for the
+ *       duration of the call and may be shared /w other callers of the same
+ *       query, so copy out whatever is needed and do not freeaddrinfo() it.
+ *
+ * @param[in] gai_retcode : getaddrinfo() return code (0 on success)
+ * @param[in] result : resolved address list, nullptr on failure
+ * @param[in] user_arg : pointer given at submission
+ */
+typedef void (*ResolveCallback)( int gai_retcode,
+                                 const struct addrinfo * result,
+                                 void * user_arg );
+
+enum ResolverRetCode
+{
+   RSV_QUEUED,        // new query queued for a resolver thread
+   RSV_COALESCED,     // attached to an identical query already in flight
+   RSV_CACHE_HIT,     // answered from the cache; cb has already been called
+   RSV_QUEUE_FULL,    // too many distinct queries or waiters in flight
+   RSV_INVALID_INPUT, // bad arguments (e.g., node string too long)
+   RSV_SHUT_DOWN      // resolver is shutting down, no more submissions
+};
+
+struct ResolveWaiter
+{
+   ResolveCallback cb;
+   void * user_arg;
+   struct ResolveWaiter * next;
+};
+
+struct ResolveQuery
+{
+   bool in_use;
+   bool has_node;
+   bool has_service;
+   bool has_hints;
+   char node[RSV_MAX_NODE_STRLEN];
+   char service[RSV_MAX_SERVICE_STRLEN];
+   struct addrinfo hints; // only flags, family, socktype and protocol are used
+   struct ResolveWaiter * waiters;
+   struct ResolveQuery * next_pending; // FIFO of queries not yet picked up
+};
+
+struct AsyncResolver
+{
+   pthread_mutex_t mtx;
+   pthread_cond_t work_avail;
+   pthread_cond_t all_done;
+   bool shutting_down;
+   size_t nworkers;
+   pthread_t workers[RSV_MAX_WORKERS];
+
+   // Fixed-size pools so that a submission never has to malloc()
+   struct ResolveQuery queries[RSV_MAX_INFLIGHT];
+   struct ResolveWaiter waiter_pool[RSV_MAX_WAITERS];
+   struct ResolveWaiter * free_waiters;
+
+   struct ResolveQuery * pending_head;
+   struct ResolveQuery * pending_tail;
+   size_t ninflight;
+
+   // Running totals, protected by mtx
+   size_t nsubmitted;
+   size_t ncoalesced;
+   size_t ncompleted;
+};
+
+/************************** Public Declarations *******************************/
+[[nodiscard]] bool asyncResolverInit( struct AsyncResolver * rsv, size_t nworkers );
+[[nodiscard]] enum ResolverRetCode asyncResolverSubmit( struct AsyncResolver * rsv,
+                                                        const char * node,
+                                                        const char * service,
+                                                        const struct addrinfo * hints,
+                                                        ResolveCallback cb,
+                                                        void * user_arg );
+void asyncResolverWait( struct AsyncResolver * rsv );
+void asyncResolverShutdown( struct AsyncResolver * rsv );
+
+/*************************** Local Declarations *******************************/
+static void * resolverThread( void * arg );
+static bool queryMatches( const struct ResolveQuery * q,
+                          const char * node,
+                          const char * service,
+                          const struct addrinfo * hints );
+
+/************************** Function Implementations **************************/
+
+/**
+ * @brief Initialize the resolver and spawn its worker threads
+ *
+ * @param[out] rsv : resolver object to initialize
+ * @param[in] nworkers : number of resolver threads, 1 to RSV_MAX_WORKERS
+ *
+ * @return true if at least one worker thread was started, false otherwise
+ */
+[[nodiscard]] bool asyncResolverInit( struct AsyncResolver * rsv, size_t nworkers )
+{
+   assert(rsv != nullptr);
+
+   if ( 0 == nworkers || nworkers > RSV_MAX_WORKERS )
+      return false;
+
+   memset(rsv, 0x00, sizeof *rsv);
+   pthread_mutex_init(&rsv->mtx, nullptr);
+   pthread_cond_init(&rsv->work_avail, nullptr);
+   pthread_cond_init(&rsv->all_done, nullptr);
+
+   for ( size_t i = 0; i < RSV_MAX_WAITERS; ++i )
+   {
+      rsv->waiter_pool[i].next = rsv->free_waiters;
+      rsv->free_waiters = &rsv->waiter_pool[i];
+   }
+
+   for ( size_t i = 0; i < nworkers; ++i )
+   {
+      int retcode = pthread_create( &rsv->workers[i],
+                                    nullptr, // default thread attributes
+                                    resolverThread,
+                                    rsv );
+      if ( retcode != 0 )
+      {
+         fprintf( stderr,
+                  "Warning: Failed to create resolver thread %zu of %zu.\n"
+                  "pthread_create() returned: %d : %s\n",
+                  i + 1, nworkers, retcode, strerror(retcode) );
+         break;
+      }
+      rsv->nworkers++;
+   }
+
+   if ( 0 == rsv->nworkers )
+   {
+      pthread_cond_destroy(&rsv->all_done);
+      pthread_cond_destroy(&rsv->work_avail);
+      pthread_mutex_destroy(&rsv->mtx);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Submit a lookup. Arguments are the same as getaddrinfo()'s.
+ * @note If an identical query (same node, service and hints) is already queued
+ *       or resolving, the caller is attached to it instead of issuing another
+ *       getaddrinfo(). Strings are copied, so they need not outlive the call.
+ *
+ * @return enum ResolverRetCode
+ *    - RSV_QUEUED / RSV_COALESCED: cb will be called exactly once
+ *    - RSV_CACHE_HIT: cb was called before returning
+ *    - anything else: cb will not be called
+ */
+[[nodiscard]] enum ResolverRetCode asyncResolverSubmit( struct AsyncResolver * rsv,
+                                                        const char * node,
+                                                        const char * service,
+                                                        const struct addrinfo * hints,
+                                                        ResolveCallback cb,
+                                                        void * user_arg )
+{
+   assert(rsv != nullptr);
+
+   if ( nullptr == cb
+        || (nullptr == node && nullptr == service)
+        || (node != nullptr && strlen(node) >= RSV_MAX_NODE_STRLEN)
+        || (service != nullptr && strlen(service) >= RSV_MAX_SERVICE_STRLEN) )
+   {
+      return RSV_INVALID_INPUT;
+   }
+
+   struct CachedResult * cached = nullptr;
+   if ( resolverCacheLookup(node, service, hints, &cached) != RC_MISS )
+   {
+      cb(cached->gai_retcode, cached->list, user_arg);
+      resolverCacheRelease(cached);
+      return RSV_CACHE_HIT;
+   }
+
+   int retcode = pthread_mutex_lock(&rsv->mtx);
+   assert(retcode == 0);
+
+   enum ResolverRetCode rsv_retcode = RSV_QUEUED;
+   struct ResolveQuery * query = nullptr;
+   struct ResolveQuery * free_query = nullptr;
+
+   if ( rsv->shutting_down )
+   {
+      rsv_retcode = RSV_SHUT_DOWN;
+      goto unlock;
+   }
+
+   if ( nullptr == rsv->free_waiters )
+   {
+      rsv_retcode = RSV_QUEUE_FULL;
+      goto unlock;
+   }
+
+   // Look for an identical query in flight, remembering a free slot on the way
+   for ( size_t i = 0; i < RSV_MAX_INFLIGHT; ++i )
+   {
+      struct ResolveQuery * q = &rsv->queries[i];
+      if ( !q->in_use )
+      {
+         if ( nullptr == free_query )
+            free_query = q;
+      }
+      else if ( queryMatches(q, node, service, hints) )
+      {
+         query = q;
+         rsv_retcode = RSV_COALESCED;
+         break;
+      }
+   }
+
+   if ( nullptr == query )
+   {
+      if ( nullptr == free_query )
+      {
+         rsv_retcode = RSV_QUEUE_FULL;
+         goto unlock;
+      }
+
+      query = free_query;
+      memset(query, 0x00, sizeof *query);
+      query->in_use = true;
+      if ( node != nullptr )
+      {
+         query->has_node = true;
+         strcpy(query->node, node); // length checked above
+      }
+      if ( service != nullptr )
+      {
+         query->has_service = true;
+         strcpy(query->service, service); // length checked above
+      }
+      if ( hints != nullptr )
+      {
+         query->has_hints = true;
+         query->hints.ai_flags    = hints->ai_flags;
+         query->hints.ai_family   = hints->ai_family;
+         query->hints.ai_socktype = hints->ai_socktype;
+         query->hints.ai_protocol = hints->ai_protocol;
+      }
+
+      if ( nullptr == rsv->pending_tail )
+         rsv->pending_head = query;
+      else
+         rsv->pending_tail->next_pending = query;
+      rsv->pending_tail = query;
+
+      rsv->ninflight++;
+      pthread_cond_signal(&rsv->work_avail);
+   }
+   else
+   {
+      rsv->ncoalesced++;
+   }
+
+   struct ResolveWaiter * waiter = rsv->free_waiters;
+   rsv->free_waiters = waiter->next;
+   waiter->cb = cb;
+   waiter->user_arg = user_arg;
+   waiter->next = query->waiters;
+   query->waiters = waiter;
+
+   rsv->nsubmitted++;
+
+unlock:
+   retcode = pthread_mutex_unlock(&rsv->mtx);
+   assert(retcode == 0);
+
+   return rsv_retcode;
+}
+
+/**
+ * @brief Block until every submitted query has completed and its callbacks
+ *        have returned
+ */
+void asyncResolverWait( struct AsyncResolver * rsv )
+{
+   assert(rsv != nullptr);
+
+   int retcode = pthread_mutex_lock(&rsv->mtx);
+   assert(retcode == 0);
+
+   while ( rsv->ninflight > 0 )
+      pthread_cond_wait(&rsv->all_done, &rsv->mtx);
+
+   retcode = pthread_mutex_unlock(&rsv->mtx);
+   assert(retcode == 0);
+}
+
+/**
+ * @brief Stop accepting submissions, let the workers finish what is already
+ *        queued, and join them
+ */
+void asyncResolverShutdown( struct AsyncResolver * rsv )
+{
+   assert(rsv != nullptr);
+
+   int retcode = pthread_mutex_lock(&rsv->mtx);
+   assert(retcode == 0);
+   rsv->shutting_down = true;
+   pthread_cond_broadcast(&rsv->work_avail);
+   retcode = pthread_mutex_unlock(&rsv->mtx);
+   assert(retcode == 0);
+
+   for ( size_t i = 0; i < rsv->nworkers; ++i )
+      pthread_join(rsv->workers[i], nullptr);
+
+   assert(0 == rsv->ninflight);
+
+   pthread_cond_destroy(&rsv->all_done);
+   pthread_cond_destroy(&rsv->work_avail);
+   pthread_mutex_destroy(&rsv->mtx);
+}
+
+static void * resolverThread( void * arg )
+{
+   struct AsyncResolver * rsv = arg;
+
+   int retcode = pthread_mutex_lock(&rsv->mtx);
+   assert(retcode == 0);
+
+   while ( true )
+   {
+      while ( nullptr == rsv->pending_head && !rsv->shutting_down )
+         pthread_cond_wait(&rsv->work_avail, &rsv->mtx);
+
+      if ( nullptr == rsv->pending_head )
+         break; // shutting down and nothing left to do
+
+      struct ResolveQuery * query = rsv->pending_head;
+      rsv->pending_head = query->next_pending;
+      if ( nullptr == rsv->pending_head )
+         rsv->pending_tail = nullptr;
+      query->next_pending = nullptr;
+
+      // The query stays in_use while resolving so that identical submissions
+      // keep coalescing onto it. Its strings are not modified until the slot
+      // is released below, so they're safe to read /wo the lock.
+      retcode = pthread_mutex_unlock(&rsv->mtx);
+      assert(retcode == 0);
+
+      struct addrinfo * result = nullptr;
+      int gai_retcode = getaddrinfo( query->has_node ? query->node : nullptr,
+                                     query->has_service ? query->service : nullptr,
+                                     query->has_hints ? &query->hints : nullptr,
+                                     &result );
+      if ( gai_retcode != 0 )
+         result = nullptr;
+
+      // Hand out the cache's flattened copy when there is one, so every
+      // waiter sees exactly what later cache hits will see
+      struct CachedResult * cached = resolverCacheInsert( query->has_node ? query->node : nullptr,
+                                                          query->has_service ? query->service : nullptr,
+                                                          query->has_hints ? &query->hints : nullptr,
+                                                          gai_retcode,
+                                                          result );
+      const struct addrinfo * delivered = result;
+      if ( cached != nullptr )
+         delivered = cached->list;
+
+      // Detach the waiters and release the slot before calling back, so that
+      // a callback can resubmit the same query and get a fresh lookup
+      retcode = pthread_mutex_lock(&rsv->mtx);
+      assert(retcode == 0);
+      struct ResolveWaiter * waiters = query->waiters;
+      query->waiters = nullptr;
+      query->in_use = false;
+      retcode = pthread_mutex_unlock(&rsv->mtx);
+      assert(retcode == 0);
+
+      struct ResolveWaiter * last = nullptr;
+      size_t nwaiters = 0;
+      for ( struct ResolveWaiter * w = waiters; w != nullptr; w = w->next )
+      {
+         w->cb(gai_retcode, delivered, w->user_arg);
+         last = w;
+         nwaiters++;
+      }
+
+      if ( result != nullptr )
+         freeaddrinfo(result);
+      resolverCacheRelease(cached);
+
+      retcode = pthread_mutex_lock(&rsv->mtx);
+      assert(retcode == 0);
+      if ( last != nullptr )
+      {
+         last->next = rsv->free_waiters;
+         rsv->free_waiters = waiters;
+      }
+      rsv->ncompleted += nwaiters;
+      assert(rsv->ninflight > 0);
+      if ( --rsv->ninflight == 0 )
+         pthread_cond_broadcast(&rsv->all_done);
+   }
+
+   retcode = pthread_mutex_unlock(&rsv->mtx);
+   assert(retcode == 0);
+
+   return nullptr;
+}
+
+static bool queryMatches( const struct ResolveQuery * q,
+                          const char * node,
+                          const char * service,
+                          const struct addrinfo * hints )
+{
+   if ( q->has_node != (node != nullptr)
+        || q->has_service != (service != nullptr)
+        || q->has_hints != (hints != nullptr) )
+   {
+      return false;
+   }
+
+   if ( node != nullptr && strcmp(q->node, node) != 0 )
+      return false;
+   if ( service != nullptr && strcmp(q->service, service) != 0 )
+      return false;
+
+   if ( hints != nullptr
+        && ( q->hints.ai_flags    != hints->ai_flags
+             || q->hints.ai_family   != hints->ai_family
+             || q->hints.ai_socktype != hints->ai_socktype
+             || q->hints.ai_protocol != hints->ai_protocol ) )
+   {
+      return false;
+   }
+
+   return true;
+}
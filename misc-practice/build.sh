@@ -1,5 +1,14 @@
 # gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -D_POSIX_C_SOURCE=200809L -Og -g3 -o sp-client sp-client.c
 
-# gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -D_POSIX_C_SOURCE=200809L -Og -g3 -o getaddrinfo-demo getaddrinfo-demo.c
+# gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -D_POSIX_C_SOURCE=200809L -Og -g3 -o sp-stats sp-stats.c
+
+# gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -D_POSIX_C_SOURCE=200809L -Og -g3 -o sp-flightrec sp-flightrec.c
+
+# gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -D_POSIX_C_SOURCE=200809L -Og -g3 -pthread -o getaddrinfo-demo getaddrinfo-demo.c
+
+# gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -Og -g3 -pthread -o dns-responder dns-responder.c
 
 gcc -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize-trap -fsanitize=enum -fsanitize=bool -fsanitize=bounds -fsanitize=address -fanalyzer -std=c23 -D_POSIX_C_SOURCE=200809L -Og -g3 -o inet_pton_demo inet_pton_demo.c
+# g++ -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize=address -std=c++20 -Og -g3 -pthread -o udp-checksum udp-checksum.cpp
+
+# g++ -Wall -Wextra -Wpedantic -pedantic-errors -fsanitize=undefined -fsanitize=address -std=c++20 -Og -g3 -o sp-coro-server sp-coro-server.cpp
@@ -0,0 +1,914 @@
+/**
+ * @file dns-responder.c
+ * @brief Minimal authoritative UDP DNS responder that serves A/AAAA records
+ *        from a zone file, for offline and repeatable resolver benchmarks
+ *
+ * The zone is parsed once at start-up and compiled into an immutable,
+ * open-addressed hash table keyed by the lower-cased wire-format name. Every
+ * name's answer records are pre-encoded (owner name as a compression pointer
+ * to the question), so answering a query is a hash lookup plus two memcpy()'s.
+ * Each worker thread owns an SO_REUSEPORT socket and moves datagrams in
+ * batches /w recvmmsg()/sendmmsg().
+ *
+ * Zone file format, one record per line ('#' or ';' start a comment):
+ *
+ *    <name> [ttl] [IN] <A|AAAA> <address>
+ *
+ * Names are case-insensitive and the trailing dot is optional. The ttl
+ * defaults to DNS_DEFAULT_TTL_SEC.
+ *
+ * Pointing getaddrinfo() at it: glibc's stub resolver always talks to port 53
+ * of the nameservers in /etc/resolv.conf, so run the responder on e.g.
+ * 127.0.0.1:53 and list that as the only nameserver (a private mount
+ * namespace /w a bind-mounted resolv.conf keeps this away from the rest of
+ * the system). Names present in /etc/hosts are answered before DNS is asked.
+ * E.g., as root:
+ *
+ *    echo "nameserver 127.0.0.1" > /tmp/resolv.bench
+ *    unshare -m sh -c 'mount --bind /tmp/resolv.bench /etc/resolv.conf &&
+ *                      (./dns-responder dns-responder.zone 127.0.0.1 53 &) &&
+ *                      ./getaddrinfo-demo'
+ *
+ * Usage: dns-responder <zone-file> [ip_address] [port] [nthreads]
+ *
+ * @note Linux-specific: recvmmsg()/sendmmsg() and SO_REUSEPORT.
+ * @note No EDNS(0), so responses are capped at 512 bytes and set TC if the
+ *       records don't fit.
+ */
+
+/*************************** File Header Inclusions ***************************/
+#define _GNU_SOURCE // recvmmsg(), sendmmsg()
+
+// Socket-Specific Headers
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+// Signal and Thread System Headers
+#include <signal.h>
+#include <pthread.h>
+// General-Purpose Headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+
+/*************************** Constants and Types ******************************/
+constexpr char DNS_DEFAULT_ADDR[] = "127.0.0.1";
+constexpr char DNS_DEFAULT_PORT[] = "5353";
+constexpr uint32_t DNS_DEFAULT_TTL_SEC = 300;
+constexpr size_t DNS_MAX_THREADS = 64;
+constexpr size_t DNS_BATCH_SZ = 64; // datagrams per recvmmsg()/sendmmsg()
+constexpr size_t DNS_MAX_UDP_MSG_SZ = 512; // RFC 1035 limit /wo EDNS(0)
+constexpr size_t DNS_RX_BUF_SZ = 1'500; // accept (and then reject) oversize queries
+constexpr size_t DNS_HDR_SZ = 12;
+constexpr size_t DNS_MAX_NAME_SZ = 255; // wire format, including the root label
+constexpr size_t DNS_MAX_LABEL_SZ = 63;
+constexpr size_t DNS_MAX_LINE_STRLEN = 512;
+constexpr int DNS_RCV_TIMEOUT_MS = 250; // how often workers check for Ctrl+C
+
+enum DnsType
+{
+   DNS_TYPE_A    = 1,
+   DNS_TYPE_AAAA = 28,
+   DNS_TYPE_ANY  = 255,
+};
+
+constexpr uint16_t DNS_CLASS_IN = 1;
+constexpr uint16_t DNS_CLASS_ANY = 255;
+
+enum DnsRcode
+{
+   DNS_RCODE_NOERROR  = 0,
+   DNS_RCODE_FORMERR  = 1,
+   DNS_RCODE_NXDOMAIN = 3,
+   DNS_RCODE_NOTIMP   = 4,
+   DNS_RCODE_REFUSED  = 5,
+};
+
+// Header flag bits
+constexpr uint16_t DNS_FLAG_QR = 0x8000;
+constexpr uint16_t DNS_FLAG_AA = 0x0400;
+constexpr uint16_t DNS_FLAG_TC = 0x0200;
+constexpr uint16_t DNS_FLAG_RD = 0x0100;
+constexpr uint16_t DNS_OPCODE_MASK = 0x7800;
+
+// Pre-encoded answer records per name are laid out A's first, then AAAA's,
+// so an ANY query is answered by the two runs back to back.
+enum ZoneRRSetIdx
+{
+   ZONE_RRSET_A,
+   ZONE_RRSET_AAAA,
+   ZONE_NUM_RRSETS
+};
+
+struct ZoneRecord // parsed zone file line, only used while compiling the zone
+{
+   uint8_t name[DNS_MAX_NAME_SZ];
+   uint8_t name_len;
+   uint8_t rrset_idx; // enum ZoneRRSetIdx
+   uint8_t rdata_len;
+   uint8_t rdata[16];
+   uint32_t ttl;
+   size_t lineno;
+};
+
+struct ZoneEntry
+{
+   const uint8_t * name; // lower-cased wire format; nullptr for an empty slot
+   uint8_t name_len;
+   uint32_t hash;
+   const uint8_t * rrs; // this name's pre-encoded answer records
+   uint16_t rrs_len[ZONE_NUM_RRSETS];
+   uint16_t rrs_count[ZONE_NUM_RRSETS];
+};
+
+struct ZoneTable
+{
+   struct ZoneEntry * entries;
+   size_t capacity; // power of 2
+   size_t nnames;
+   size_t nrecords;
+   uint8_t * arena; // names and records, so the table is two allocations
+};
+
+struct WorkerStats
+{
+   alignas(64) size_t nqueries; // own cache line per worker
+   size_t nanswered;
+   size_t nnxdomain;
+   size_t nerrors;    // FORMERR/NOTIMP/REFUSED
+   size_t ndropped;   // not worth a response (too short, or a response itself)
+   size_t ntruncated;
+   size_t nbatches;
+};
+
+struct Worker
+{
+   pthread_t thread;
+   int sfd;
+   struct WorkerStats stats;
+};
+
+/***************************** Local Declarations *****************************/
+static volatile sig_atomic_t UserEndedSession = false;
+
+static struct ZoneTable Zone;
+static struct Worker Workers[DNS_MAX_THREADS];
+
+static void handleSIGINT(int sig_num);
+[[nodiscard]] static bool loadZone(const char * path, struct ZoneTable * zone);
+[[nodiscard]] static bool parseZoneLine( char * line,
+                                         size_t lineno,
+                                         struct ZoneRecord * rec );
+[[nodiscard]] static bool nameToWire( const char * str,
+                                      uint8_t wire[static DNS_MAX_NAME_SZ],
+                                      uint8_t * wire_len );
+static int compareZoneRecords(const void * a, const void * b);
+static uint32_t hashName(const uint8_t * name, size_t len);
+static const struct ZoneEntry * lookupName( const struct ZoneTable * zone,
+                                            const uint8_t * name,
+                                            size_t len );
+static size_t answerQuery( const uint8_t * query,
+                           size_t query_len,
+                           uint8_t response[static DNS_MAX_UDP_MSG_SZ],
+                           struct WorkerStats * stats );
+static size_t errorResponse( const uint8_t * query,
+                             uint8_t response[static DNS_MAX_UDP_MSG_SZ],
+                             enum DnsRcode rcode );
+[[nodiscard]] static int openWorkerSocket(const struct addrinfo * bind_addr);
+static void * workerThread(void * arg);
+static uint16_t getU16(const uint8_t * buf);
+static void putU16(uint8_t * buf, uint16_t val);
+static uint64_t monotonicNs(void);
+
+/******************************************************************************/
+int main(int argc, char * argv[])
+{
+   if ( argc < 2 || argc > 5 )
+   {
+      fprintf( stderr,
+               "Usage: %s <zone-file> [ip_address (default %s)] [port (default %s)]"
+               " [nthreads (default 1)]\n",
+               argv[0], DNS_DEFAULT_ADDR, DNS_DEFAULT_PORT );
+      return 1;
+   }
+   const char * zone_path = argv[1];
+   const char * addr = argc > 2 ? argv[2] : DNS_DEFAULT_ADDR;
+   const char * port = argc > 3 ? argv[3] : DNS_DEFAULT_PORT;
+   size_t nthreads = 1;
+   if ( argc > 4 )
+   {
+      char * end_ptr;
+      nthreads = strtoul(argv[4], &end_ptr, 10);
+      if ( *end_ptr != '\0' || nthreads < 1 || nthreads > DNS_MAX_THREADS )
+      {
+         fprintf( stderr, "Error: nthreads must be 1 to %zu.\n", DNS_MAX_THREADS );
+         return 1;
+      }
+   }
+
+   struct sigaction sa_cfg;
+   memset( &sa_cfg, 0x00, sizeof(sa_cfg) );
+   sa_cfg.sa_handler = handleSIGINT;
+   sigemptyset(&sa_cfg.sa_mask);
+   sa_cfg.sa_flags = 0; // No SA_RESTART, so blocked recvmmsg() calls return
+   sigaction(SIGINT, &sa_cfg, nullptr);
+
+   if ( !loadZone(zone_path, &Zone) )
+      return 1;
+   printf( "Loaded %zu records for %zu names from %s.\n",
+           Zone.nrecords, Zone.nnames, zone_path );
+
+   struct addrinfo hints;
+   memset(&hints, 0x00, sizeof hints);
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_DGRAM;
+   hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+   struct addrinfo * bind_addr;
+   int retcode = getaddrinfo(addr, port, &hints, &bind_addr);
+   if ( retcode != 0 )
+   {
+      fprintf( stderr, "Error: Invalid address %s port %s: %s\n",
+               addr, port, gai_strerror(retcode) );
+      return 1;
+   }
+
+   // Open every socket before starting any thread, so a bind failure doesn't
+   // leave threads to clean up
+   size_t nopened = 0;
+   for ( ; nopened < nthreads; ++nopened )
+   {
+      Workers[nopened].sfd = openWorkerSocket(bind_addr);
+      if ( Workers[nopened].sfd < 0 )
+         break;
+   }
+   freeaddrinfo(bind_addr);
+   if ( nopened < nthreads )
+   {
+      for ( size_t i = 0; i < nopened; ++i )
+         close(Workers[i].sfd);
+      return 1;
+   }
+
+   size_t nstarted = 0;
+   for ( ; nstarted < nthreads; ++nstarted )
+   {
+      retcode = pthread_create( &Workers[nstarted].thread,
+                                nullptr,
+                                workerThread,
+                                &Workers[nstarted] );
+      if ( retcode != 0 )
+      {
+         fprintf( stderr, "Error: pthread_create() returned: %s\n", strerror(retcode) );
+         UserEndedSession = true; // stop the workers already started
+         break;
+      }
+   }
+
+   printf( "Serving on %s port %s /w %zu thread(s). Ctrl+C to stop.\n",
+           addr, port, nstarted );
+   uint64_t start_ns = monotonicNs();
+
+   struct WorkerStats total = {0};
+   for ( size_t i = 0; i < nstarted; ++i )
+   {
+      pthread_join(Workers[i].thread, nullptr);
+      total.nqueries   += Workers[i].stats.nqueries;
+      total.nanswered  += Workers[i].stats.nanswered;
+      total.nnxdomain  += Workers[i].stats.nnxdomain;
+      total.nerrors    += Workers[i].stats.nerrors;
+      total.ndropped   += Workers[i].stats.ndropped;
+      total.ntruncated += Workers[i].stats.ntruncated;
+      total.nbatches   += Workers[i].stats.nbatches;
+   }
+   for ( size_t i = 0; i < nthreads; ++i )
+      close(Workers[i].sfd);
+
+   double elapsed_sec = (double)(monotonicNs() - start_ns) / 1e9;
+   printf( "\nQueries: %zu (%.0f/s), answered: %zu, NXDOMAIN: %zu, errors: %zu,"
+           " dropped: %zu, truncated: %zu, avg batch: %.1f\n",
+           total.nqueries,
+           elapsed_sec > 0.0 ? (double)total.nqueries / elapsed_sec : 0.0,
+           total.nanswered, total.nnxdomain, total.nerrors,
+           total.ndropped, total.ntruncated,
+           total.nbatches > 0 ? (double)total.nqueries / (double)total.nbatches : 0.0 );
+
+   free(Zone.entries);
+   free(Zone.arena);
+
+   return nstarted == nthreads ? 0 : 1;
+}
+
+/*********************** Local Function Implementations ***********************/
+
+static void handleSIGINT(int sig_num)
+{
+   (void)sig_num; // this signal handler is only for SIGINT
+   UserEndedSession = true;
+}
+
+/**
+ * @brief Parse the zone file and compile it into the lookup table
+ * @return false on any invalid line, after reporting it
+ */
+[[nodiscard]] static bool loadZone(const char * path, struct ZoneTable * zone)
+{
+   FILE * fp = fopen(path, "r");
+   if ( nullptr == fp )
+   {
+      fprintf(stderr, "Error: Unable to open zone file %s: %s\n", path, strerror(errno));
+      return false;
+   }
+
+   struct ZoneRecord * recs = nullptr;
+   size_t nrecs = 0;
+   size_t recs_capacity = 0;
+   bool success = true;
+   char line[DNS_MAX_LINE_STRLEN];
+   for ( size_t lineno = 1; fgets(line, sizeof line, fp) != nullptr; ++lineno )
+   {
+      if ( nrecs == recs_capacity )
+      {
+         size_t new_capacity = recs_capacity > 0 ? 2 * recs_capacity : 64;
+         struct ZoneRecord * new_recs = realloc(recs, new_capacity * sizeof recs[0]);
+         if ( nullptr == new_recs )
+         {
+            fprintf(stderr, "Error: Out of memory loading zone.\n");
+            success = false;
+            break;
+         }
+         recs = new_recs;
+         recs_capacity = new_capacity;
+      }
+
+      if ( nullptr == memchr(line, '\n', sizeof line) && !feof(fp) )
+      {
+         fprintf(stderr, "Error: %s:%zu: Line too long.\n", path, lineno);
+         success = false;
+         break;
+      }
+
+      if ( !parseZoneLine(line, lineno, &recs[nrecs]) )
+      {
+         success = false;
+         break;
+      }
+      if ( recs[nrecs].name_len > 0 ) // skip blank/comment lines
+         nrecs++;
+   }
+   fclose(fp);
+
+   if ( success && 0 == nrecs )
+   {
+      fprintf(stderr, "Error: No records in zone file %s.\n", path);
+      success = false;
+   }
+   if ( !success )
+   {
+      free(recs);
+      return false;
+   }
+
+   // Sort so each name's records are contiguous, A's before AAAA's, and total
+   // up what the compiled table needs
+   qsort(recs, nrecs, sizeof recs[0], compareZoneRecords);
+   size_t nnames = 0;
+   size_t arena_sz = 0;
+   for ( size_t i = 0; i < nrecs; ++i )
+   {
+      if ( 0 == i
+           || recs[i - 1].name_len != recs[i].name_len
+           || memcmp(recs[i - 1].name, recs[i].name, recs[i].name_len) != 0 )
+      {
+         nnames++;
+         arena_sz += recs[i].name_len;
+      }
+      arena_sz += 2 + 2 + 2 + 4 + 2 + recs[i].rdata_len; // ptr, type, class, ttl, rdlen
+   }
+
+   size_t capacity = 16;
+   while ( capacity < 2 * nnames )
+      capacity *= 2;
+   zone->entries = calloc(capacity, sizeof zone->entries[0]);
+   zone->arena = malloc(arena_sz);
+   if ( nullptr == zone->entries || nullptr == zone->arena )
+   {
+      fprintf(stderr, "Error: Out of memory compiling zone.\n");
+      free(zone->entries);
+      free(zone->arena);
+      free(recs);
+      return false;
+   }
+   zone->capacity = capacity;
+   zone->nnames = nnames;
+   zone->nrecords = nrecs;
+
+   uint8_t * arena_ptr = zone->arena;
+   struct ZoneEntry * entry = nullptr;
+   for ( size_t i = 0; i < nrecs; ++i )
+   {
+      const struct ZoneRecord * rec = &recs[i];
+      if ( nullptr == entry
+           || entry->name_len != rec->name_len
+           || memcmp(entry->name, rec->name, rec->name_len) != 0 )
+      {
+         // New name: copy it into the arena, then claim its slot
+         memcpy(arena_ptr, rec->name, rec->name_len);
+         const uint8_t * name = arena_ptr;
+         arena_ptr += rec->name_len;
+
+         uint32_t hash = hashName(name, rec->name_len);
+         size_t idx = hash & (capacity - 1);
+         while ( zone->entries[idx].name != nullptr )
+            idx = (idx + 1) & (capacity - 1);
+
+         entry = &zone->entries[idx];
+         entry->name = name;
+         entry->name_len = rec->name_len;
+         entry->hash = hash;
+         entry->rrs = arena_ptr;
+      }
+
+      // Owner name is always a compression pointer to the question's QNAME,
+      // which immediately follows the header
+      uint8_t * rr = arena_ptr;
+      putU16(&rr[0], 0xC000 | DNS_HDR_SZ);
+      putU16(&rr[2], ZONE_RRSET_A == rec->rrset_idx ? DNS_TYPE_A : DNS_TYPE_AAAA);
+      putU16(&rr[4], DNS_CLASS_IN);
+      putU16(&rr[6], (uint16_t)(rec->ttl >> 16));
+      putU16(&rr[8], (uint16_t)rec->ttl);
+      putU16(&rr[10], rec->rdata_len);
+      memcpy(&rr[12], rec->rdata, rec->rdata_len);
+      size_t rr_len = 12u + rec->rdata_len;
+      arena_ptr += rr_len;
+
+      entry->rrs_len[rec->rrset_idx] += (uint16_t)rr_len;
+      entry->rrs_count[rec->rrset_idx]++;
+   }
+   assert( (size_t)(arena_ptr - zone->arena) == arena_sz );
+
+   free(recs);
+   return true;
+}
+
+/**
+ * @brief Parse one zone file line
+ * @note rec->name_len is left 0 for blank and comment-only lines.
+ */
+[[nodiscard]] static bool parseZoneLine( char * line,
+                                         size_t lineno,
+                                         struct ZoneRecord * rec )
+{
+   memset(rec, 0x00, sizeof *rec);
+   rec->lineno = lineno;
+   rec->ttl = DNS_DEFAULT_TTL_SEC;
+
+   char * comment = strpbrk(line, "#;");
+   if ( comment != nullptr )
+      *comment = '\0';
+
+   constexpr size_t MAX_TOKENS = 5;
+   char * tokens[MAX_TOKENS + 1];
+   size_t ntokens = 0;
+   char * save_ptr;
+   for ( char * tok = strtok_r(line, " \t\r\n", &save_ptr);
+         tok != nullptr && ntokens <= MAX_TOKENS;
+         tok = strtok_r(nullptr, " \t\r\n", &save_ptr) )
+   {
+      tokens[ntokens++] = tok;
+   }
+   if ( 0 == ntokens )
+      return true;
+
+   // name [ttl] [IN] type value
+   size_t tok_idx = 1;
+   if ( tok_idx < ntokens && isdigit((unsigned char)tokens[tok_idx][0]) )
+   {
+      char * end_ptr;
+      unsigned long ttl = strtoul(tokens[tok_idx], &end_ptr, 10);
+      if ( *end_ptr != '\0' || ttl > INT32_MAX ) // RFC 2181: TTL is 31 bits
+      {
+         fprintf(stderr, "Error: Zone line %zu: Invalid TTL %s.\n", lineno, tokens[tok_idx]);
+         return false;
+      }
+      rec->ttl = (uint32_t)ttl;
+      tok_idx++;
+   }
+   if ( tok_idx < ntokens && strcasecmp(tokens[tok_idx], "IN") == 0 )
+      tok_idx++;
+   if ( ntokens - tok_idx != 2 )
+   {
+      fprintf( stderr,
+               "Error: Zone line %zu: Expected <name> [ttl] [IN] <A|AAAA> <address>.\n",
+               lineno );
+      return false;
+   }
+
+   const char * type = tokens[tok_idx];
+   const char * value = tokens[tok_idx + 1];
+   int af;
+   if ( strcasecmp(type, "A") == 0 )
+   {
+      af = AF_INET;
+      rec->rrset_idx = ZONE_RRSET_A;
+      rec->rdata_len = sizeof(struct in_addr);
+   }
+   else if ( strcasecmp(type, "AAAA") == 0 )
+   {
+      af = AF_INET6;
+      rec->rrset_idx = ZONE_RRSET_AAAA;
+      rec->rdata_len = sizeof(struct in6_addr);
+   }
+   else
+   {
+      fprintf(stderr, "Error: Zone line %zu: Unsupported type %s.\n", lineno, type);
+      return false;
+   }
+
+   if ( inet_pton(af, value, rec->rdata) != 1 )
+   {
+      fprintf(stderr, "Error: Zone line %zu: Invalid %s address %s.\n", lineno, type, value);
+      return false;
+   }
+
+   if ( !nameToWire(tokens[0], rec->name, &rec->name_len) )
+   {
+      fprintf(stderr, "Error: Zone line %zu: Invalid name %s.\n", lineno, tokens[0]);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Convert a dotted name into lower-cased, uncompressed wire format
+ */
+[[nodiscard]] static bool nameToWire( const char * str,
+                                      uint8_t wire[static DNS_MAX_NAME_SZ],
+                                      uint8_t * wire_len )
+{
+   size_t len = 0;
+   const char * label = str;
+   while ( *label != '\0' )
+   {
+      const char * dot = strchr(label, '.');
+      size_t label_len = dot != nullptr ? (size_t)(dot - label) : strlen(label);
+      if ( 0 == label_len || label_len > DNS_MAX_LABEL_SZ
+           || len + 1 + label_len + 1 > DNS_MAX_NAME_SZ )
+         return false;
+
+      wire[len++] = (uint8_t)label_len;
+      for ( size_t i = 0; i < label_len; ++i )
+         wire[len++] = (uint8_t)tolower((unsigned char)label[i]);
+
+      if ( nullptr == dot )
+         break;
+      label = dot + 1; // a trailing dot ends the loop on the empty remainder
+   }
+   if ( 0 == len )
+      return false; // the root itself isn't served
+
+   wire[len++] = 0;
+   *wire_len = (uint8_t)len;
+   return true;
+}
+
+static int compareZoneRecords(const void * a, const void * b)
+{
+   const struct ZoneRecord * x = a;
+   const struct ZoneRecord * y = b;
+   if ( x->name_len != y->name_len )
+      return x->name_len < y->name_len ? -1 : 1;
+   int cmp = memcmp(x->name, y->name, x->name_len);
+   if ( cmp != 0 )
+      return cmp;
+   if ( x->rrset_idx != y->rrset_idx )
+      return x->rrset_idx < y->rrset_idx ? -1 : 1;
+   // Keep zone file order within an RRset
+   return (x->lineno > y->lineno) - (x->lineno < y->lineno);
+}
+
+static uint32_t hashName(const uint8_t * name, size_t len)
+{
+   // FNV-1a
+   uint32_t hash = 2'166'136'261u;
+   for ( size_t i = 0; i < len; ++i )
+   {
+      hash ^= name[i];
+      hash *= 16'777'619u;
+   }
+   return hash;
+}
+
+static const struct ZoneEntry * lookupName( const struct ZoneTable * zone,
+                                            const uint8_t * name,
+                                            size_t len )
+{
+   uint32_t hash = hashName(name, len);
+   for ( size_t idx = hash & (zone->capacity - 1);
+         zone->entries[idx].name != nullptr;
+         idx = (idx + 1) & (zone->capacity - 1) )
+   {
+      const struct ZoneEntry * entry = &zone->entries[idx];
+      if ( entry->hash == hash
+           && entry->name_len == len
+           && memcmp(entry->name, name, len) == 0 )
+         return entry;
+   }
+   return nullptr;
+}
+
+/**
+ * @brief Build the response to one query
+ * @return response length, or 0 if the datagram should be dropped
+ */
+static size_t answerQuery( const uint8_t * query,
+                           size_t query_len,
+                           uint8_t response[static DNS_MAX_UDP_MSG_SZ],
+                           struct WorkerStats * stats )
+{
+   stats->nqueries++;
+
+   // Anything too short to carry an ID, or that is itself a response, gets no
+   // reply (answering responses invites reflection loops)
+   if ( query_len < DNS_HDR_SZ || (getU16(&query[2]) & DNS_FLAG_QR) )
+   {
+      stats->ndropped++;
+      return 0;
+   }
+
+   uint16_t flags = getU16(&query[2]);
+   if ( (flags & DNS_OPCODE_MASK) != 0 ) // only standard queries
+   {
+      stats->nerrors++;
+      return errorResponse(query, response, DNS_RCODE_NOTIMP);
+   }
+   if ( getU16(&query[4]) != 1 || query_len > DNS_MAX_UDP_MSG_SZ )
+   {
+      stats->nerrors++;
+      return errorResponse(query, response, DNS_RCODE_FORMERR);
+   }
+
+   // Parse the QNAME, lower-casing it into the lookup key as we go
+   uint8_t name[DNS_MAX_NAME_SZ];
+   size_t name_len = 0;
+   size_t off = DNS_HDR_SZ;
+   for ( ;; )
+   {
+      if ( off >= query_len )
+      {
+         stats->nerrors++;
+         return errorResponse(query, response, DNS_RCODE_FORMERR);
+      }
+      uint8_t label_len = query[off];
+      // No compression pointers in a question /w nothing to point back at
+      if ( label_len > DNS_MAX_LABEL_SZ
+           || off + 1 + label_len > query_len
+           || name_len + 1 + label_len > DNS_MAX_NAME_SZ )
+      {
+         stats->nerrors++;
+         return errorResponse(query, response, DNS_RCODE_FORMERR);
+      }
+      name[name_len++] = label_len;
+      off++;
+      if ( 0 == label_len )
+         break;
+      for ( size_t i = 0; i < label_len; ++i )
+         name[name_len++] = (uint8_t)tolower(query[off + i]);
+      off += label_len;
+   }
+   if ( off + 4 > query_len )
+   {
+      stats->nerrors++;
+      return errorResponse(query, response, DNS_RCODE_FORMERR);
+   }
+   uint16_t qtype = getU16(&query[off]);
+   uint16_t qclass = getU16(&query[off + 2]);
+   size_t question_end = off + 4;
+
+   if ( qclass != DNS_CLASS_IN && qclass != DNS_CLASS_ANY )
+   {
+      stats->nerrors++;
+      return errorResponse(query, response, DNS_RCODE_REFUSED);
+   }
+
+   // Echo the header and question, then append the pre-encoded answers
+   memcpy(response, query, question_end);
+   enum DnsRcode rcode = DNS_RCODE_NOERROR;
+   uint16_t resp_flags = DNS_FLAG_QR | DNS_FLAG_AA | (flags & DNS_FLAG_RD);
+   uint16_t ancount = 0;
+   size_t resp_len = question_end;
+
+   const struct ZoneEntry * entry = lookupName(&Zone, name, name_len);
+   if ( nullptr == entry )
+   {
+      rcode = DNS_RCODE_NXDOMAIN;
+      stats->nnxdomain++;
+   }
+   else
+   {
+      const uint8_t * rrs = entry->rrs;
+      size_t rrs_len = 0;
+      if ( DNS_TYPE_A == qtype )
+      {
+         rrs_len = entry->rrs_len[ZONE_RRSET_A];
+      }
+      else if ( DNS_TYPE_AAAA == qtype )
+      {
+         rrs += entry->rrs_len[ZONE_RRSET_A];
+         rrs_len = entry->rrs_len[ZONE_RRSET_AAAA];
+      }
+      else if ( DNS_TYPE_ANY == qtype )
+      {
+         rrs_len = entry->rrs_len[ZONE_RRSET_A] + entry->rrs_len[ZONE_RRSET_AAAA];
+      }
+      // else: name exists /wo records of that type, i.e. NODATA
+
+      // Copy whole records while they fit
+      size_t rr_off = 0;
+      while ( rr_off < rrs_len )
+      {
+         size_t rr_len = 12u + getU16(&rrs[rr_off + 10]);
+         if ( resp_len + (rr_off + rr_len) > DNS_MAX_UDP_MSG_SZ )
+         {
+            resp_flags |= DNS_FLAG_TC;
+            stats->ntruncated++;
+            break;
+         }
+         rr_off += rr_len;
+         ancount++;
+      }
+      memcpy(&response[resp_len], rrs, rr_off);
+      resp_len += rr_off;
+      stats->nanswered++;
+   }
+
+   putU16(&response[2], resp_flags | rcode);
+   putU16(&response[6], ancount);
+   putU16(&response[8], 0); // NSCOUNT
+   putU16(&response[10], 0); // ARCOUNT: any OPT record in the query is ignored
+
+   return resp_len;
+}
+
+/**
+ * @brief Header-only error response echoing the query's ID and RD bit
+ */
+static size_t errorResponse( const uint8_t * query,
+                             uint8_t response[static DNS_MAX_UDP_MSG_SZ],
+                             enum DnsRcode rcode )
+{
+   memset(response, 0x00, DNS_HDR_SZ);
+   memcpy(response, query, 2); // ID
+   uint16_t flags = getU16(&query[2]);
+   putU16( &response[2],
+           DNS_FLAG_QR | (flags & (DNS_OPCODE_MASK | DNS_FLAG_RD)) | rcode );
+   return DNS_HDR_SZ;
+}
+
+[[nodiscard]] static int openWorkerSocket(const struct addrinfo * bind_addr)
+{
+   int sfd = socket(bind_addr->ai_family, bind_addr->ai_socktype, bind_addr->ai_protocol);
+   if ( sfd < 0 )
+   {
+      fprintf(stderr, "Error: socket() failed: %s\n", strerror(errno));
+      return -1;
+   }
+
+   // Every worker binds the same address; the kernel spreads datagrams
+   // across the sockets by flow hash
+   int optval = 1;
+   struct timeval rcv_timeout = { .tv_sec = 0, .tv_usec = DNS_RCV_TIMEOUT_MS * 1'000 };
+   if ( setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) != 0
+        || setsockopt(sfd, SOL_SOCKET, SO_RCVTIMEO, &rcv_timeout, sizeof rcv_timeout) != 0 )
+   {
+      fprintf(stderr, "Error: setsockopt() failed: %s\n", strerror(errno));
+      close(sfd);
+      return -1;
+   }
+
+   if ( bind(sfd, bind_addr->ai_addr, bind_addr->ai_addrlen) != 0 )
+   {
+      fprintf(stderr, "Error: bind() failed: %s\n", strerror(errno));
+      close(sfd);
+      return -1;
+   }
+
+   return sfd;
+}
+
+static void * workerThread(void * arg)
+{
+   struct Worker * worker = arg;
+
+   // Large enough for the thread stack to be a poor home
+   struct WorkerBuffers
+   {
+      struct mmsghdr rx_msgs[DNS_BATCH_SZ];
+      struct mmsghdr tx_msgs[DNS_BATCH_SZ];
+      struct iovec rx_iovs[DNS_BATCH_SZ];
+      struct iovec tx_iovs[DNS_BATCH_SZ];
+      struct sockaddr_storage peers[DNS_BATCH_SZ];
+      uint8_t rx_bufs[DNS_BATCH_SZ][DNS_RX_BUF_SZ];
+      uint8_t tx_bufs[DNS_BATCH_SZ][DNS_MAX_UDP_MSG_SZ];
+   };
+   struct WorkerBuffers * bufs = calloc(1, sizeof *bufs);
+   if ( nullptr == bufs )
+   {
+      fprintf(stderr, "Error: Out of memory for worker buffers.\n");
+      return nullptr;
+   }
+
+   for ( size_t i = 0; i < DNS_BATCH_SZ; ++i )
+   {
+      bufs->rx_iovs[i] = (struct iovec){ .iov_base = bufs->rx_bufs[i],
+                                         .iov_len = DNS_RX_BUF_SZ };
+      bufs->tx_iovs[i].iov_base = bufs->tx_bufs[i];
+   }
+
+   while ( !UserEndedSession )
+   {
+      for ( size_t i = 0; i < DNS_BATCH_SZ; ++i )
+      {
+         bufs->rx_msgs[i].msg_hdr = (struct msghdr){ .msg_name = &bufs->peers[i],
+                                                     .msg_namelen = sizeof bufs->peers[i],
+                                                     .msg_iov = &bufs->rx_iovs[i],
+                                                     .msg_iovlen = 1 };
+      }
+
+      // Block for the first datagram, then take whatever else is queued
+      int nrx = recvmmsg(worker->sfd, bufs->rx_msgs, DNS_BATCH_SZ, MSG_WAITFORONE, nullptr);
+      if ( nrx < 0 )
+      {
+         if ( EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno )
+            continue; // receive timeout or Ctrl+C; re-check the session flag
+         fprintf(stderr, "Error: recvmmsg() failed: %s\n", strerror(errno));
+         break;
+      }
+      worker->stats.nbatches++;
+
+      unsigned ntx = 0;
+      for ( int i = 0; i < nrx; ++i )
+      {
+         size_t resp_len = answerQuery( bufs->rx_bufs[i],
+                                        bufs->rx_msgs[i].msg_len,
+                                        bufs->tx_bufs[ntx],
+                                        &worker->stats );
+         if ( 0 == resp_len )
+            continue;
+
+         bufs->tx_iovs[ntx].iov_len = resp_len;
+         bufs->tx_msgs[ntx].msg_hdr = (struct msghdr){
+            .msg_name = &bufs->peers[i],
+            .msg_namelen = bufs->rx_msgs[i].msg_hdr.msg_namelen,
+            .msg_iov = &bufs->tx_iovs[ntx],
+            .msg_iovlen = 1
+         };
+         ntx++;
+      }
+
+      // sendmmsg() stops at the first datagram that fails; skip that one
+      // (e.g., an unreachable peer) and carry on /w the rest
+      for ( unsigned sent = 0; sent < ntx; )
+      {
+         int nsent = sendmmsg(worker->sfd, &bufs->tx_msgs[sent], ntx - sent, 0);
+         if ( nsent < 0 )
+         {
+            if ( EINTR == errno )
+               continue;
+            sent++;
+         }
+         else
+         {
+            sent += (unsigned)nsent;
+         }
+      }
+   }
+
+   free(bufs);
+   return nullptr;
+}
+
+static uint16_t getU16(const uint8_t * buf)
+{
+   return (uint16_t)((buf[0] << 8) | buf[1]);
+}
+
+static void putU16(uint8_t * buf, uint16_t val)
+{
+   buf[0] = (uint8_t)(val >> 8);
+   buf[1] = (uint8_t)val;
+}
+
+static uint64_t monotonicNs(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1'000'000'000u + (uint64_t)ts.tv_nsec;
+}
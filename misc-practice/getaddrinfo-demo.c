@@ -4,8 +4,9 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
-// Signal System Headers
+// Signal and Thread System Headers
 #include <signal.h>
+#include <pthread.h>
 // General-Purpose Headers
 #include <stdio.h>
 #include <string.h>
@@ -17,21 +18,40 @@
 #include "ai_family_lookup.c"
 #include "ai_protocol_lookup.c"
 #include "ai_socktype_lookup.c"
+// Asynchronous getaddrinfo() Src Inclusion for Unity Build
+#include "async_resolver.c"
 
 constexpr int GETADDRINFO_SUCCESS = 0;
 constexpr int SOCKET_CREATION_FAILURE = -1;
 constexpr int BINDING_FAILURE = -1;
 constexpr int CLOSURE_FAILURE = -1;
+constexpr size_t NUM_RESOLVER_THREADS = 4;
+
+struct LookupLabel
+{
+   const char * title;
+};
 
 static volatile sig_atomic_t UserEndedSession = false;
 static volatile sig_atomic_t NestedSession = false;
 static volatile sig_atomic_t UserEndedNestedSession = false;
 
+static struct AsyncResolver Resolver;
+// Lookups complete on resolver threads, so keep each result's printout together
+static pthread_mutex_t mtxPrintf = PTHREAD_MUTEX_INITIALIZER;
+
 void handleSIGINT(int sig_num);
+void submitLookup( const char * node,
+                   const char * service,
+                   const struct addrinfo * hints,
+                   struct LookupLabel * label );
+void printLookupResult( int gai_retcode,
+                        const struct addrinfo * result,
+                        void * user_arg );
 #ifndef NDEBUG
 bool checkNullTermination(char arr[], size_t len);
 #endif // NDEBUG
-void printAddrInfoObject( struct addrinfo * obj, size_t idx );
+void printAddrInfoObject( const struct addrinfo * obj, size_t idx );
 void printSockAddrInObject( struct sockaddr_in * obj );
 
 /******************************************************************************/
@@ -45,11 +65,21 @@ int main(void)
                         // if system call was interrupted by signal.
    sigaction(SIGINT, &sa_cfg, NULL);
 
+   if ( !resolverCacheInit(RC_DEFAULT_TTL_SEC, RC_DEFAULT_NEGATIVE_TTL_SEC) )
+      fprintf(stderr, "Warning: Failed to enable the resolver cache.\n");
+
+   if ( !asyncResolverInit(&Resolver, NUM_RESOLVER_THREADS) )
+   {
+      fprintf(stderr, "Error: Failed to start the resolver threads.\n");
+      return 1;
+   }
+
    printf("Enter one of the following commands:\n"
           "- service <service_name>\n"
-          "- hostname <hostname>\n"
+          "- hostname <hostname> [hostname ...]\n"
           "- local\n"
-          "- listen\n" );
+          "- listen\n"
+          "- cache\n" );
 
    size_t nreps = 0;
    constexpr size_t NREPS_MAX = 1'000;
@@ -59,7 +89,7 @@ int main(void)
       printf("> ");
       fflush(stdout);
 
-      constexpr size_t MAX_STRLEN = 30;
+      constexpr size_t MAX_STRLEN = 128;
       char buf[MAX_STRLEN];
 
       if ( fgets(buf, sizeof(buf), stdin) == NULL )
@@ -108,77 +138,56 @@ int main(void)
 
          // TODO: Check past first argument of the service cmd!
 
-         // Begin the getaddrinfo() action
-         printf("----------------------------------------------------------------------\n");
-         printf("First, let's do a NULL node argument.\n");
-         printf("----------------------------------------------------------------------\n");
-         struct addrinfo * result;
-         int retcode = getaddrinfo( NULL, // node
-                                    service,
-                                    NULL, // hints
-                                    &result );
-         if ( retcode != GETADDRINFO_SUCCESS )
-         {
-            fprintf( stderr,
-                     "Error: getaddrinfo() returned: %s\n",
-                     gai_strerror(retcode) );
-            continue;
-         }
-
-         size_t i = 1;
-         for ( struct addrinfo * it = result; it != NULL; it = it->ai_next, ++i )
-            printAddrInfoObject(it, i);
-
-         freeaddrinfo(result);
-
-         printf("----------------------------------------------------------------------\n");
-         printf("Now, let's try google.com.\n");
-         printf("----------------------------------------------------------------------\n");
-         retcode = getaddrinfo( "google.com", // node
-                                service,
-                                NULL, // hints
-                                &result );
-         if ( retcode != GETADDRINFO_SUCCESS )
-         {
-            fprintf( stderr,
-                     "Error: getaddrinfo() returned: %s\n",
-                     gai_strerror(retcode) );
-            continue;
-         }
-
-         i = 1;
-         for ( struct addrinfo * it = result; it != NULL; it = it->ai_next, ++i )
-            printAddrInfoObject(it, i);
-
-         freeaddrinfo(result);
-
-         printf("----------------------------------------------------------------------\n");
-         printf("Now, let's try AI_PASSIVE, suitable for server listening across all NICs.\n");
-         printf("----------------------------------------------------------------------\n");
+         // Begin the getaddrinfo() actions. All three lookups go out at once
+         // and print as they complete, rather than one after the other.
          struct addrinfo hints;
          memset(&hints, 0x00, sizeof hints);
          hints.ai_flags = AI_PASSIVE;
-         retcode = getaddrinfo( NULL, // node
-                                service,
-                                &hints,
-                                &result );
-         if ( retcode != GETADDRINFO_SUCCESS )
+
+         struct LookupLabel labels[] =
          {
-            fprintf( stderr,
-                     "Error: getaddrinfo() returned: %s\n",
-                     gai_strerror(retcode) );
+            { .title = "NULL node argument" },
+            { .title = "google.com" },
+            { .title = "AI_PASSIVE, suitable for server listening across all NICs" },
+         };
+
+         submitLookup( nullptr, service, nullptr, &labels[0] );
+         submitLookup( "google.com", service, nullptr, &labels[1] );
+         submitLookup( nullptr, service, &hints, &labels[2] );
+         asyncResolverWait(&Resolver);
+      }
+      else if ( strncmp( buf, "hostname", sizeof("hostname")-1 ) == 0 )
+      {
+         // Any number of space-separated hostnames, resolved concurrently
+         char * saveptr = nullptr;
+         char * hostname = strtok_r( buf + sizeof("hostname")-1, " ", &saveptr );
+         if ( nullptr == hostname )
+         {
+            fprintf(stderr, "No argument for hostname command found. Try again.\n");
             continue;
          }
 
-         i = 1;
-         for ( struct addrinfo * it = result; it != NULL; it = it->ai_next, ++i )
-            printAddrInfoObject(it, i);
+         constexpr size_t MAX_HOSTNAMES = 16;
+         struct LookupLabel labels[MAX_HOSTNAMES];
+         size_t nhostnames = 0;
+         for ( ; hostname != nullptr && nhostnames < MAX_HOSTNAMES;
+               hostname = strtok_r(nullptr, " ", &saveptr) )
+         {
+            labels[nhostnames].title = hostname; // points into buf, which
+                                                 // outlives the wait below
+            submitLookup( hostname, nullptr, nullptr, &labels[nhostnames] );
+            nhostnames++;
+         }
+         if ( hostname != nullptr )
+            fprintf( stderr,
+                     "Warning: Only the first %zu hostnames will be resolved.\n",
+                     MAX_HOSTNAMES );
 
-         freeaddrinfo(result);
+         asyncResolverWait(&Resolver);
       }
-      else if ( strncmp( buf, "hostname", sizeof("hostname")-1 ) == 0 )
+      else if ( strncmp( buf, "cache", sizeof("cache")-1 ) == 0 )
       {
-         // TODO: hostname cmd
+         resolverCachePrintStats(stdout);
       }
       else if ( strncmp( buf, "local", sizeof("local")-1 ) == 0 )
       {
@@ -281,6 +290,8 @@ int main(void)
       puts("User ended session.");
    puts("See ya again soon! Goodbye for now :).");
 
+   asyncResolverShutdown(&Resolver);
+
    return 0;
 }
 /******************************************************************************/
@@ -295,6 +306,79 @@ void handleSIGINT(int sig_num)
       UserEndedSession = true;
 }
 
+/**
+ * @brief Hand a lookup to the resolver, reporting why if it wasn't accepted
+ */
+void submitLookup( const char * node,
+                   const char * service,
+                   const struct addrinfo * hints,
+                   struct LookupLabel * label )
+{
+   enum ResolverRetCode retcode = asyncResolverSubmit( &Resolver,
+                                                       node,
+                                                       service,
+                                                       hints,
+                                                       printLookupResult,
+                                                       label );
+   switch ( retcode )
+   {
+      case RSV_QUEUED:
+         // fallthrough
+      case RSV_COALESCED:
+         // fallthrough
+      case RSV_CACHE_HIT:
+         break;
+
+      case RSV_QUEUE_FULL:
+         fprintf(stderr, "Error: Too many lookups in flight for: %s\n", label->title);
+         break;
+
+      case RSV_INVALID_INPUT:
+         fprintf(stderr, "Error: Invalid lookup arguments for: %s\n", label->title);
+         break;
+
+      case RSV_SHUT_DOWN:
+         // fallthrough
+      default:
+         fprintf(stderr, "Error: Resolver is not running.\n");
+         break;
+   }
+}
+
+/**
+ * @brief Resolver callback: print one lookup's results as a single block
+ */
+void printLookupResult( int gai_retcode,
+                        const struct addrinfo * result,
+                        void * user_arg )
+{
+   const struct LookupLabel * label = user_arg;
+
+   int retcode = pthread_mutex_lock(&mtxPrintf);
+   assert(retcode == 0);
+
+   printf("----------------------------------------------------------------------\n");
+   printf("%s\n", label->title);
+   printf("----------------------------------------------------------------------\n");
+   if ( gai_retcode != GETADDRINFO_SUCCESS )
+   {
+      fflush(stdout); // keep the error under its header
+      fprintf( stderr,
+               "Error: getaddrinfo() returned: %s\n",
+               gai_strerror(gai_retcode) );
+   }
+   else
+   {
+      size_t i = 1;
+      for ( const struct addrinfo * it = result; it != NULL; it = it->ai_next, ++i )
+         printAddrInfoObject(it, i);
+   }
+   fflush(stdout);
+
+   retcode = pthread_mutex_unlock(&mtxPrintf);
+   assert(retcode == 0);
+}
+
 #ifndef NDEBUG
 bool checkNullTermination(char arr[], size_t len)
 {
@@ -307,7 +391,7 @@ bool checkNullTermination(char arr[], size_t len)
 }
 #endif // NDEBUG
 
-void printAddrInfoObject( struct addrinfo * obj, size_t idx )
+void printAddrInfoObject( const struct addrinfo * obj, size_t idx )
 {
    assert(obj != nullptr);
 
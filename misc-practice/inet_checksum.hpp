@@ -0,0 +1,461 @@
+/**
+ * @file inet_checksum.hpp
+ * @brief Internet checksum (RFC 1071) /w SSE2/AVX2 kernels and runtime CPU
+ *        dispatch
+ *
+ * The one's-complement sum doesn't care which byte order it's computed in,
+ * as long as the result is swapped back at the end (RFC 1071, section 2(B)),
+ * and it can be accumulated in any word width that's a multiple of 16 bits,
+ * as long as carries wrap around. So the kernels sum native-order words as
+ * wide as the hardware allows, and only the final 16-bit value is converted
+ * to network-order arithmetic.
+ *
+ * Results are identical to the straightforward 16-bit big-endian word loop
+ * (sum_reference()), which is kept as the definition of "correct" for
+ * comparing and benchmarking the kernels against.
+ *
+ * @note Header-only; the SIMD kernels use per-function target attributes, so
+ *       no -mavx2 or similar is needed (or wanted, since dispatch already
+ *       picks the best kernel the running CPU supports).
+ */
+#ifndef INET_CHECKSUM_HPP
+#define INET_CHECKSUM_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define INET_CHECKSUM_X86 1
+#else
+#  define INET_CHECKSUM_X86 0
+#endif
+
+namespace netsp::checksum
+{
+
+/**
+ * @brief Fold a wide one's-complement sum down to 16 bits
+ */
+[[nodiscard]] constexpr std::uint16_t fold(std::uint64_t sum)
+{
+   while ( (sum >> 16) != 0 )
+      sum = (sum & 0xFFFF) + (sum >> 16);
+   return static_cast<std::uint16_t>(sum);
+}
+
+/**
+ * @brief One's-complement 64-bit add, i.e. /w end-around carry
+ */
+[[nodiscard]] constexpr std::uint64_t add64(std::uint64_t a, std::uint64_t b)
+{
+   std::uint64_t sum = a + b;
+   return sum + (sum < a);
+}
+
+/**
+ * @brief The textbook algorithm: big-endian 16-bit words, one at a time, an
+ *        odd trailing byte padded /w a zero byte
+ * @return folded (not complemented) sum
+ */
+[[nodiscard]] inline std::uint16_t sum_reference(std::span<const std::uint8_t> data)
+{
+   std::uint64_t sum = 0;
+   std::size_t i = 0;
+   for ( ; (i + 1) < data.size(); i += 2 )
+      sum += (static_cast<std::uint16_t>(data[i]) << 8) | data[i + 1];
+   if ( i < data.size() )
+      sum += static_cast<std::uint16_t>(data[i]) << 8;
+   return fold(sum);
+}
+
+/**
+ * @brief Summation kernels
+ *
+ * Each returns an unfolded sum of the buffer's native-order 16-bit words
+ * (odd trailing byte zero-padded), which only means anything once folded and
+ * byte-swapped by sum(). They're exposed for benchmarking and verification;
+ * everything else should go through sum()/checksum() and copy_and_sum()/
+ * copy_and_checksum().
+ *
+ * Every kernel comes in a summing and a fused copy-and-sum flavor, generated
+ * from the same implementation: the fused one stores each block to dst right
+ * after loading it, so the data crosses the memory bus once instead of twice.
+ */
+namespace kernel
+{
+
+using SumFn = std::uint64_t (*)(const std::uint8_t * data, std::size_t len);
+using CopySumFn = std::uint64_t (*)( std::uint8_t * dst,
+                                     const std::uint8_t * src,
+                                     std::size_t len );
+
+namespace detail
+{
+
+/**
+ * @brief Portable kernel: 64-bit words /w end-around carry, 4 at a time
+ */
+template <bool COPY>
+[[nodiscard]] inline std::uint64_t scalar64( std::uint8_t * dst,
+                                             const std::uint8_t * src,
+                                             std::size_t len )
+{
+   std::uint64_t acc = 0;
+   for ( ; len >= 32; src += 32, dst += (COPY ? 32 : 0), len -= 32 )
+   {
+      std::uint64_t w[4];
+      std::memcpy(w, src, sizeof w);
+      if constexpr ( COPY )
+         std::memcpy(dst, w, sizeof w);
+      // Two independent carry chains keep the adds from serializing
+      std::uint64_t a = add64(w[0], w[1]);
+      std::uint64_t b = add64(w[2], w[3]);
+      acc = add64(acc, add64(a, b));
+   }
+   for ( ; len >= 8; src += 8, dst += (COPY ? 8 : 0), len -= 8 )
+   {
+      std::uint64_t w;
+      std::memcpy(&w, src, sizeof w);
+      if constexpr ( COPY )
+         std::memcpy(dst, &w, sizeof w);
+      acc = add64(acc, w);
+   }
+   if ( len > 0 )
+   {
+      // Zero padding after the last bytes is exactly RFC 1071's odd-byte
+      // padding, in either byte order
+      std::uint64_t w = 0;
+      std::memcpy(&w, src, len);
+      if constexpr ( COPY )
+         std::memcpy(dst, &w, len);
+      acc = add64(acc, w);
+   }
+   return acc;
+}
+
+#if INET_CHECKSUM_X86
+/**
+ * @brief SSE2 kernel: 16-bit words zero-extended into 32-bit lanes
+ */
+template <bool COPY>
+[[gnu::target("sse2")]] [[nodiscard]]
+inline std::uint64_t sse2( std::uint8_t * dst,
+                           const std::uint8_t * src,
+                           std::size_t len )
+{
+   // A lane takes two words per block, so it holds 2^15 blocks' worth of
+   // 0xFFFF's before it could overflow
+   constexpr std::size_t BLOCK_SZ = 16;
+   constexpr std::size_t MAX_BLOCKS_PER_FLUSH = 1 << 15;
+
+   const __m128i low_words = _mm_set1_epi32(0x0000FFFF);
+   std::uint64_t acc = 0;
+   while ( len >= BLOCK_SZ )
+   {
+      std::size_t nblocks = len / BLOCK_SZ;
+      if ( nblocks > MAX_BLOCKS_PER_FLUSH )
+         nblocks = MAX_BLOCKS_PER_FLUSH;
+
+      __m128i lanes = _mm_setzero_si128();
+      for ( std::size_t i = 0; i < nblocks; ++i, src += BLOCK_SZ )
+      {
+         __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+         if constexpr ( COPY )
+         {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), v);
+            dst += BLOCK_SZ;
+         }
+         lanes = _mm_add_epi32(lanes, _mm_and_si128(v, low_words));
+         lanes = _mm_add_epi32(lanes, _mm_srli_epi32(v, 16));
+      }
+      len -= nblocks * BLOCK_SZ;
+
+      alignas(16) std::uint32_t lane_sums[4];
+      _mm_store_si128(reinterpret_cast<__m128i *>(lane_sums), lanes);
+      for ( std::uint32_t lane_sum : lane_sums )
+         acc += lane_sum; // can't overflow: at most 2^34 per flush
+   }
+   return add64(acc, scalar64<COPY>(dst, src, len));
+}
+
+/**
+ * @brief AVX2 kernel: same as sse2(), at twice the width
+ */
+template <bool COPY>
+[[gnu::target("avx2")]] [[nodiscard]]
+inline std::uint64_t avx2( std::uint8_t * dst,
+                           const std::uint8_t * src,
+                           std::size_t len )
+{
+   constexpr std::size_t BLOCK_SZ = 32;
+   constexpr std::size_t MAX_BLOCKS_PER_FLUSH = 1 << 15;
+
+   const __m256i low_words = _mm256_set1_epi32(0x0000FFFF);
+   std::uint64_t acc = 0;
+   while ( len >= BLOCK_SZ )
+   {
+      std::size_t nblocks = len / BLOCK_SZ;
+      if ( nblocks > MAX_BLOCKS_PER_FLUSH )
+         nblocks = MAX_BLOCKS_PER_FLUSH;
+
+      // Two accumulators to cover the add latency
+      __m256i lanes0 = _mm256_setzero_si256();
+      __m256i lanes1 = _mm256_setzero_si256();
+      std::size_t i = 0;
+      for ( ; (i + 1) < nblocks; i += 2, src += 2 * BLOCK_SZ )
+      {
+         __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+         __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + BLOCK_SZ));
+         if constexpr ( COPY )
+         {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), v0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + BLOCK_SZ), v1);
+            dst += 2 * BLOCK_SZ;
+         }
+         lanes0 = _mm256_add_epi32(lanes0, _mm256_and_si256(v0, low_words));
+         lanes0 = _mm256_add_epi32(lanes0, _mm256_srli_epi32(v0, 16));
+         lanes1 = _mm256_add_epi32(lanes1, _mm256_and_si256(v1, low_words));
+         lanes1 = _mm256_add_epi32(lanes1, _mm256_srli_epi32(v1, 16));
+      }
+      if ( i < nblocks )
+      {
+         __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+         if constexpr ( COPY )
+         {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), v0);
+            dst += BLOCK_SZ;
+         }
+         lanes0 = _mm256_add_epi32(lanes0, _mm256_and_si256(v0, low_words));
+         lanes0 = _mm256_add_epi32(lanes0, _mm256_srli_epi32(v0, 16));
+         src += BLOCK_SZ;
+      }
+      len -= nblocks * BLOCK_SZ;
+
+      // Each lane is still < 2^32 on its own, but the two together may not be
+      alignas(32) std::uint32_t lane_sums[2][8];
+      _mm256_store_si256(reinterpret_cast<__m256i *>(lane_sums[0]), lanes0);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(lane_sums[1]), lanes1);
+      for ( const auto & sums : lane_sums )
+         for ( std::uint32_t lane_sum : sums )
+            acc += lane_sum;
+   }
+   return add64(acc, scalar64<COPY>(dst, src, len));
+}
+#endif // INET_CHECKSUM_X86
+
+} // namespace detail
+
+[[nodiscard]] inline std::uint64_t scalar64(const std::uint8_t * data, std::size_t len)
+{
+   return detail::scalar64<false>(nullptr, data, len);
+}
+
+[[nodiscard]] inline std::uint64_t copy_scalar64( std::uint8_t * dst,
+                                                  const std::uint8_t * src,
+                                                  std::size_t len )
+{
+   return detail::scalar64<true>(dst, src, len);
+}
+
+#if INET_CHECKSUM_X86
+[[nodiscard]] inline std::uint64_t sse2(const std::uint8_t * data, std::size_t len)
+{
+   return detail::sse2<false>(nullptr, data, len);
+}
+
+[[nodiscard]] inline std::uint64_t copy_sse2( std::uint8_t * dst,
+                                              const std::uint8_t * src,
+                                              std::size_t len )
+{
+   return detail::sse2<true>(dst, src, len);
+}
+
+[[nodiscard]] inline std::uint64_t avx2(const std::uint8_t * data, std::size_t len)
+{
+   return detail::avx2<false>(nullptr, data, len);
+}
+
+[[nodiscard]] inline std::uint64_t copy_avx2( std::uint8_t * dst,
+                                              const std::uint8_t * src,
+                                              std::size_t len )
+{
+   return detail::avx2<true>(dst, src, len);
+}
+#endif // INET_CHECKSUM_X86
+
+/**
+ * @brief Best kernels for the running CPU
+ */
+[[nodiscard]] inline SumFn best()
+{
+#if INET_CHECKSUM_X86
+   __builtin_cpu_init();
+   if ( __builtin_cpu_supports("avx2") )
+      return avx2;
+   if ( __builtin_cpu_supports("sse2") )
+      return sse2;
+#endif
+   return scalar64;
+}
+
+[[nodiscard]] inline CopySumFn best_copy()
+{
+#if INET_CHECKSUM_X86
+   __builtin_cpu_init();
+   if ( __builtin_cpu_supports("avx2") )
+      return copy_avx2;
+   if ( __builtin_cpu_supports("sse2") )
+      return copy_sse2;
+#endif
+   return copy_scalar64;
+}
+
+/**
+ * @brief Kernels picked once, on first use
+ */
+[[nodiscard]] inline SumFn dispatched()
+{
+   static const SumFn fn = best();
+   return fn;
+}
+
+[[nodiscard]] inline CopySumFn dispatched_copy()
+{
+   static const CopySumFn fn = best_copy();
+   return fn;
+}
+
+} // namespace kernel
+
+/**
+ * @brief Turn a kernel's native-order sum into a network-order folded sum,
+ *        and add on a previous sum
+ */
+[[nodiscard]] inline std::uint16_t finish(std::uint64_t native_sum, std::uint32_t initial)
+{
+   std::uint16_t native = fold(native_sum);
+   std::uint16_t network = native;
+   if constexpr ( std::endian::native == std::endian::little )
+      network = static_cast<std::uint16_t>((native << 8) | (native >> 8));
+   return fold(static_cast<std::uint64_t>(network) + initial);
+}
+
+/**
+ * @brief One's-complement sum of data, continuing from a previous sum
+ * @note To chain sums over several buffers, every buffer but the last must be
+ *       of even length (as the pieces of a pseudo-header + segment are).
+ *
+ * @param[in] data : bytes to sum, in network order
+ * @param[in] initial : previous sum() result, or any other network-order
+ *                      partial sum (e.g. of pseudo-header fields)
+ * @return folded (not complemented) sum
+ */
+[[nodiscard]] inline std::uint16_t sum( std::span<const std::uint8_t> data,
+                                        std::uint32_t initial = 0 )
+{
+   return finish(kernel::dispatched()(data.data(), data.size()), initial);
+}
+
+/**
+ * @brief Internet checksum of data: the complement of sum()
+ * @return checksum as a number; store it big-endian
+ */
+[[nodiscard]] inline std::uint16_t checksum( std::span<const std::uint8_t> data,
+                                             std::uint32_t initial = 0 )
+{
+   return static_cast<std::uint16_t>(~sum(data, initial));
+}
+
+/**
+ * @brief memcpy() src to dst and return sum() of the bytes copied, in one
+ *        pass over memory
+ * @note dst and src must not overlap.
+ */
+[[nodiscard]] inline std::uint16_t copy_and_sum( std::uint8_t * dst,
+                                                 const std::uint8_t * src,
+                                                 std::size_t len,
+                                                 std::uint32_t initial = 0 )
+{
+   return finish(kernel::dispatched_copy()(dst, src, len), initial);
+}
+
+/**
+ * @brief memcpy() src to dst and return checksum() of the bytes copied, in
+ *        one pass over memory
+ * @note dst and src must not overlap.
+ */
+[[nodiscard]] inline std::uint16_t copy_and_checksum( std::uint8_t * dst,
+                                                      const std::uint8_t * src,
+                                                      std::size_t len,
+                                                      std::uint32_t initial = 0 )
+{
+   return static_cast<std::uint16_t>(~copy_and_sum(dst, src, len, initial));
+}
+
+/**
+ * @brief Incrementally update a checksum for a changed 16-bit field, without
+ *        touching the rest of the data (RFC 1624, eqn. 3)
+ * @note Fields are numbers as read big-endian off the wire, like checksum()'s
+ *       result. For UDP, leave a checksum field of 0 ("no checksum") alone,
+ *       and send a result of 0x0000 as 0xFFFF.
+ *
+ * @param[in] checksum : checksum currently in the header
+ * @param[in] old_field : field's value the checksum was computed over
+ * @param[in] new_field : field's new value
+ * @return checksum over the data /w the new field value
+ */
+[[nodiscard]] constexpr std::uint16_t update16( std::uint16_t checksum,
+                                                std::uint16_t old_field,
+                                                std::uint16_t new_field )
+{
+   // HC' = ~(~HC + ~m + m'). Unlike eqn. 2, this never produces -0 (0xFFFF's
+   // complement) from a field that didn't actually change.
+   std::uint64_t sum = static_cast<std::uint16_t>(~checksum);
+   sum += static_cast<std::uint16_t>(~old_field);
+   sum += new_field;
+   return static_cast<std::uint16_t>(~fold(sum));
+}
+
+/**
+ * @brief update16() for a 32-bit field, e.g. an IPv4 address (host order)
+ */
+[[nodiscard]] constexpr std::uint16_t update32( std::uint16_t checksum,
+                                                std::uint32_t old_field,
+                                                std::uint32_t new_field )
+{
+   std::uint64_t sum = static_cast<std::uint16_t>(~checksum);
+   sum += static_cast<std::uint16_t>(~(old_field >> 16));
+   sum += static_cast<std::uint16_t>(~old_field);
+   sum += new_field >> 16;
+   sum += new_field & 0xFFFF;
+   return static_cast<std::uint16_t>(~fold(sum));
+}
+
+/**
+ * @brief update16() for a field of any even length, as wire bytes (e.g. an
+ *        IPv6 address)
+ * @note old_field and new_field must be the same length, and the field must
+ *       start at an even offset into the checksummed data.
+ */
+[[nodiscard]] constexpr std::uint16_t update( std::uint16_t checksum,
+                                              std::span<const std::uint8_t> old_field,
+                                              std::span<const std::uint8_t> new_field )
+{
+   std::uint64_t sum = static_cast<std::uint16_t>(~checksum);
+   for ( std::size_t i = 0; (i + 1) < old_field.size() && (i + 1) < new_field.size(); i += 2 )
+   {
+      std::uint16_t old_word = static_cast<std::uint16_t>((old_field[i] << 8) | old_field[i + 1]);
+      std::uint16_t new_word = static_cast<std::uint16_t>((new_field[i] << 8) | new_field[i + 1]);
+      sum += static_cast<std::uint16_t>(~old_word);
+      sum += new_word;
+   }
+   return static_cast<std::uint16_t>(~fold(sum));
+}
+
+} // namespace netsp::checksum
+
+#endif // INET_CHECKSUM_HPP
@@ -0,0 +1,138 @@
+/**
+ * @file l4_checksum.hpp
+ * @brief TCP/UDP checksums over IPv4/IPv6, /w the pseudo-header specialized
+ *        at compile time
+ *
+ * The pseudo-header (RFC 768/793 for IPv4, RFC 8200 section 8.1 for IPv6)
+ * only contributes a handful of 16-bit words to the sum, none of which
+ * depend on the payload:
+ *
+ *    - the protocol number, fixed per L4Checksum type (a constexpr term)
+ *    - the source and destination addresses, fixed per flow (summed once,
+ *      when the L4Checksum is constructed, which can itself be constexpr)
+ *    - the upper-layer length, which is just the segment's length
+ *
+ * So per segment only the length is added to the precomputed partial sum,
+ * and the segment itself goes through the dispatched SIMD kernel. Nothing on
+ * that path branches on IP version or protocol.
+ */
+#ifndef L4_CHECKSUM_HPP
+#define L4_CHECKSUM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "inet_checksum.hpp"
+
+namespace netsp::checksum
+{
+
+enum class IpVersion
+{
+   V4,
+   V6
+};
+
+enum class L4Proto : std::uint8_t
+{
+   TCP = 6,  // IPPROTO_TCP
+   UDP = 17  // IPPROTO_UDP
+};
+
+/**
+ * @brief Checksum engine for one flow, i.e. one (source, destination) pair
+ *
+ * @tparam IP : IP version, which sets the address size
+ * @tparam PROTO : L4 protocol, whose number goes into the pseudo-header
+ */
+template <IpVersion IP, L4Proto PROTO>
+class L4Checksum
+{
+public:
+   static constexpr std::size_t ADDR_SZ = (IpVersion::V4 == IP) ? 4 : 16;
+   using Addr = std::array<std::uint8_t, ADDR_SZ>; // network byte order
+
+   // Zero byte(s) + protocol number/next header. In both versions this lands
+   // as a single 16-bit word /w the protocol in the low byte.
+   static constexpr std::uint32_t PROTO_SUM = static_cast<std::uint8_t>(PROTO);
+
+   /**
+    * @param[in] src_addr : source address, as in the IP header
+    * @param[in] dst_addr : destination address, as in the IP header
+    */
+   constexpr L4Checksum(const Addr & src_addr, const Addr & dst_addr)
+      : m_base_sum(PROTO_SUM + sumAddr(src_addr) + sumAddr(dst_addr))
+   {
+   }
+
+   /**
+    * @brief Checksum to put in the segment's header
+    *
+    * @param[in] segment : L4 header + payload, /w the checksum field zeroed
+    * @return checksum as a number; store it big-endian. For UDP, a computed
+    *         0x0000 comes back as 0xFFFF, since 0 means "no checksum".
+    */
+   [[nodiscard]] std::uint16_t compute(std::span<const std::uint8_t> segment) const
+   {
+      std::uint16_t result = checksum(segment, partialSum(segment.size()));
+      if constexpr ( L4Proto::UDP == PROTO )
+      {
+         if ( 0x0000 == result )
+            result = 0xFFFF;
+      }
+      return result;
+   }
+
+   /**
+    * @brief Check a received segment's checksum
+    *
+    * @param[in] segment : L4 header + payload as received, checksum included
+    * @return true if the checksum is valid (or, for UDP, absent)
+    */
+   [[nodiscard]] bool verify(std::span<const std::uint8_t> segment) const
+   {
+      if constexpr ( L4Proto::UDP == PROTO )
+      {
+         constexpr std::size_t UDP_CHECKSUM_OFFSET = 6;
+         if ( segment.size() >= UDP_CHECKSUM_OFFSET + 2
+              && 0 == segment[UDP_CHECKSUM_OFFSET]
+              && 0 == segment[UDP_CHECKSUM_OFFSET + 1] )
+            return true;
+      }
+      return 0xFFFF == sum(segment, partialSum(segment.size()));
+   }
+
+   /**
+    * @brief Pseudo-header's contribution for a segment of segment_len bytes,
+    *        to pass as sum()'s initial value
+    */
+   [[nodiscard]] constexpr std::uint32_t partialSum(std::size_t segment_len) const
+   {
+      // IPv4 carries a 16-bit length, IPv6 a 32-bit one; splitting it into
+      // two words covers both
+      std::uint32_t len = static_cast<std::uint32_t>(segment_len);
+      return m_base_sum + (len >> 16) + (len & 0xFFFF);
+   }
+
+private:
+   static constexpr std::uint32_t sumAddr(const Addr & addr)
+   {
+      std::uint32_t addr_sum = 0;
+      for ( std::size_t i = 0; i < ADDR_SZ; i += 2 )
+         addr_sum += (static_cast<std::uint32_t>(addr[i]) << 8) | addr[i + 1];
+      return addr_sum;
+   }
+
+   std::uint32_t m_base_sum; // protocol + addresses, unfolded (< 2^21)
+};
+
+using UdpV4Checksum = L4Checksum<IpVersion::V4, L4Proto::UDP>;
+using UdpV6Checksum = L4Checksum<IpVersion::V6, L4Proto::UDP>;
+using TcpV4Checksum = L4Checksum<IpVersion::V4, L4Proto::TCP>;
+using TcpV6Checksum = L4Checksum<IpVersion::V6, L4Proto::TCP>;
+
+} // namespace netsp::checksum
+
+#endif // L4_CHECKSUM_HPP
@@ -0,0 +1,657 @@
+/**
+ * @file pcap_verify.hpp
+ * @brief Multithreaded TCP/UDP (and IPv4 header) checksum verification over
+ *        pcap and pcapng captures, read in place through mmap()
+ *
+ * A first pass over the mapped file walks record/block headers only, which
+ * splits the file into record-aligned chunks of roughly CHUNK_TARGET_SZ bytes
+ * and, for pcapng, collects each section's interface link types. Worker
+ * threads then claim chunks off an atomic counter and verify every packet in
+ * them straight out of the mapping, so nothing is copied or allocated per
+ * packet.
+ *
+ * @note Captures taken on the sending host often show bad checksums for
+ *       outgoing packets, since the NIC fills them in after the capture
+ *       point (checksum offload). Those aren't corruption.
+ */
+#ifndef PCAP_VERIFY_HPP
+#define PCAP_VERIFY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "l4_checksum.hpp"
+
+namespace netsp::pcap
+{
+
+constexpr std::size_t CHUNK_TARGET_SZ = 8 << 20;
+
+// Link-layer header types (https://www.tcpdump.org/linktypes.html)
+constexpr std::uint32_t LINKTYPE_NULL       = 0;   // BSD loopback
+constexpr std::uint32_t LINKTYPE_ETHERNET   = 1;
+constexpr std::uint32_t LINKTYPE_RAW        = 101;
+constexpr std::uint32_t LINKTYPE_LOOP       = 108; // OpenBSD loopback
+constexpr std::uint32_t LINKTYPE_LINUX_SLL  = 113;
+constexpr std::uint32_t LINKTYPE_IPV4       = 228;
+constexpr std::uint32_t LINKTYPE_IPV6       = 229;
+constexpr std::uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+struct VerifyStats
+{
+   alignas(64) std::uint64_t npackets = 0; // own cache line per worker
+   std::uint64_t nbytes = 0;           // captured packet bytes
+   std::uint64_t nipv4 = 0;
+   std::uint64_t nipv6 = 0;
+   std::uint64_t nipv4_hdr_bad = 0;
+   std::uint64_t nudp_ok = 0;
+   std::uint64_t nudp_bad = 0;
+   std::uint64_t nudp_no_checksum = 0;
+   std::uint64_t ntcp_ok = 0;
+   std::uint64_t ntcp_bad = 0;
+   std::uint64_t nskipped = 0;         // non-IP, fragments, snapped or malformed
+
+   void add(const VerifyStats & other)
+   {
+      npackets += other.npackets;
+      nbytes += other.nbytes;
+      nipv4 += other.nipv4;
+      nipv6 += other.nipv6;
+      nipv4_hdr_bad += other.nipv4_hdr_bad;
+      nudp_ok += other.nudp_ok;
+      nudp_bad += other.nudp_bad;
+      nudp_no_checksum += other.nudp_no_checksum;
+      ntcp_ok += other.ntcp_ok;
+      ntcp_bad += other.ntcp_bad;
+      nskipped += other.nskipped;
+   }
+};
+
+namespace detail
+{
+
+enum class Format
+{
+   PCAP,
+   PCAPNG
+};
+
+struct Section
+{
+   bool swapped; // file's byte order differs from ours
+   std::vector<std::uint32_t> if_linktypes; // pcap: the one global link type
+};
+
+struct Chunk
+{
+   std::size_t begin;
+   std::size_t end;
+   std::size_t section_idx;
+};
+
+struct Index
+{
+   Format format;
+   std::vector<Section> sections;
+   std::vector<Chunk> chunks;
+};
+
+constexpr std::uint32_t PCAP_MAGIC_US = 0xA1B2C3D4;
+constexpr std::uint32_t PCAP_MAGIC_NS = 0xA1B23C4D;
+constexpr std::size_t PCAP_FILE_HDR_SZ = 24;
+constexpr std::size_t PCAP_REC_HDR_SZ = 16;
+
+constexpr std::uint32_t PCAPNG_SHB = 0x0A0D0D0A;
+constexpr std::uint32_t PCAPNG_IDB = 1;
+constexpr std::uint32_t PCAPNG_PB  = 2; // obsolete Packet Block
+constexpr std::uint32_t PCAPNG_SPB = 3;
+constexpr std::uint32_t PCAPNG_EPB = 6;
+constexpr std::uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+
+inline std::uint32_t bswap32(std::uint32_t val)
+{
+   return __builtin_bswap32(val);
+}
+
+// File header fields, in the capture's byte order
+inline std::uint32_t fileU32(const std::uint8_t * ptr, bool swapped)
+{
+   std::uint32_t val;
+   std::memcpy(&val, ptr, sizeof val);
+   return swapped ? bswap32(val) : val;
+}
+
+inline std::uint16_t fileU16(const std::uint8_t * ptr, bool swapped)
+{
+   std::uint16_t val;
+   std::memcpy(&val, ptr, sizeof val);
+   return swapped ? static_cast<std::uint16_t>((val << 8) | (val >> 8)) : val;
+}
+
+// Packet fields, in network byte order
+inline std::uint16_t netU16(const std::uint8_t * ptr)
+{
+   return static_cast<std::uint16_t>((ptr[0] << 8) | ptr[1]);
+}
+
+/**
+ * @brief Verify one IPv4 or IPv6 packet's checksums
+ */
+inline void verifyIp(const std::uint8_t * ip, std::size_t len, VerifyStats & stats)
+{
+   using namespace netsp::checksum;
+
+   if ( len < 1 )
+   {
+      stats.nskipped++;
+      return;
+   }
+
+   std::uint8_t proto;
+   std::span<const std::uint8_t> segment;
+   bool is_ipv4 = (4 == (ip[0] >> 4));
+   if ( is_ipv4 )
+   {
+      std::size_t ihl = static_cast<std::size_t>(ip[0] & 0x0F) * 4;
+      if ( len < 20 || ihl < 20 || netU16(&ip[2]) < ihl || netU16(&ip[2]) > len )
+      {
+         stats.nskipped++; // malformed, or cut short by the snapshot length
+         return;
+      }
+      stats.nipv4++;
+      if ( sum(std::span(ip, ihl)) != 0xFFFF )
+         stats.nipv4_hdr_bad++;
+
+      if ( (netU16(&ip[6]) & 0x3FFF) != 0 )
+      {
+         stats.nskipped++; // fragment: its L4 checksum covers the whole datagram
+         return;
+      }
+      proto = ip[9];
+      segment = std::span(ip + ihl, netU16(&ip[2]) - ihl);
+   }
+   else if ( 6 == (ip[0] >> 4) )
+   {
+      constexpr std::size_t IPV6_HDR_SZ = 40;
+      if ( len < IPV6_HDR_SZ || 0 == netU16(&ip[4])
+           || IPV6_HDR_SZ + netU16(&ip[4]) > len )
+      {
+         stats.nskipped++; // malformed, jumbogram, or snapped
+         return;
+      }
+      stats.nipv6++;
+
+      // Skip extension headers to the upper-layer header
+      std::size_t end = IPV6_HDR_SZ + netU16(&ip[4]);
+      std::size_t off = IPV6_HDR_SZ;
+      proto = ip[6];
+      // Hop-by-hop options, destination options, authentication header
+      while ( 0 == proto || 60 == proto || 51 == proto )
+      {
+         if ( off + 2 > end )
+         {
+            stats.nskipped++;
+            return;
+         }
+         std::size_t ext_len = (51 == proto) // authentication header
+                               ? (static_cast<std::size_t>(ip[off + 1]) + 2) * 4
+                               : (static_cast<std::size_t>(ip[off + 1]) + 1) * 8;
+         if ( off + ext_len > end )
+         {
+            stats.nskipped++;
+            return;
+         }
+         proto = ip[off];
+         off += ext_len;
+      }
+      // Fragments can't be checked on their own, and a routing header's
+      // final destination (which the pseudo-header uses) isn't the one in
+      // the IPv6 header
+      if ( 43 == proto || 44 == proto )
+      {
+         stats.nskipped++;
+         return;
+      }
+      segment = std::span(ip + off, end - off);
+   }
+   else
+   {
+      stats.nskipped++;
+      return;
+   }
+
+   if ( 17 == proto ) // UDP
+   {
+      if ( segment.size() < 8 || netU16(&segment[4]) < 8
+           || netU16(&segment[4]) > segment.size() )
+      {
+         stats.nskipped++;
+         return;
+      }
+      segment = segment.first(netU16(&segment[4]));
+      if ( 0 == netU16(&segment[6]) )
+      {
+         stats.nudp_no_checksum++;
+         return;
+      }
+
+      bool ok;
+      if ( is_ipv4 )
+      {
+         UdpV4Checksum::Addr src, dst;
+         std::memcpy(src.data(), ip + 12, src.size());
+         std::memcpy(dst.data(), ip + 16, dst.size());
+         ok = UdpV4Checksum(src, dst).verify(segment);
+      }
+      else
+      {
+         UdpV6Checksum::Addr src, dst;
+         std::memcpy(src.data(), ip + 8, src.size());
+         std::memcpy(dst.data(), ip + 24, dst.size());
+         ok = UdpV6Checksum(src, dst).verify(segment);
+      }
+      ok ? stats.nudp_ok++ : stats.nudp_bad++;
+   }
+   else if ( 6 == proto ) // TCP
+   {
+      if ( segment.size() < 20 )
+      {
+         stats.nskipped++;
+         return;
+      }
+
+      bool ok;
+      if ( is_ipv4 )
+      {
+         TcpV4Checksum::Addr src, dst;
+         std::memcpy(src.data(), ip + 12, src.size());
+         std::memcpy(dst.data(), ip + 16, dst.size());
+         ok = TcpV4Checksum(src, dst).verify(segment);
+      }
+      else
+      {
+         TcpV6Checksum::Addr src, dst;
+         std::memcpy(src.data(), ip + 8, src.size());
+         std::memcpy(dst.data(), ip + 24, dst.size());
+         ok = TcpV6Checksum(src, dst).verify(segment);
+      }
+      ok ? stats.ntcp_ok++ : stats.ntcp_bad++;
+   }
+   else
+   {
+      stats.nskipped++;
+   }
+}
+
+/**
+ * @brief Strip the link-layer header and verify what's inside
+ */
+inline void verifyPacket( std::uint32_t linktype,
+                          const std::uint8_t * pkt,
+                          std::size_t caplen,
+                          VerifyStats & stats )
+{
+   stats.npackets++;
+   stats.nbytes += caplen;
+
+   constexpr std::uint16_t ETHERTYPE_IPV4 = 0x0800;
+   constexpr std::uint16_t ETHERTYPE_IPV6 = 0x86DD;
+
+   std::size_t l3_off;
+   std::uint16_t ethertype = 0; // 0: tell by the IP version nibble
+   switch ( linktype )
+   {
+      case LINKTYPE_ETHERNET:
+         l3_off = 14;
+         if ( caplen < l3_off )
+            break;
+         ethertype = netU16(&pkt[12]);
+         // 802.1Q/802.1ad VLAN tags
+         while ( (0x8100 == ethertype || 0x88A8 == ethertype || 0x9100 == ethertype)
+                 && caplen >= l3_off + 4 )
+         {
+            ethertype = netU16(&pkt[l3_off + 2]);
+            l3_off += 4;
+         }
+         break;
+
+      case LINKTYPE_LINUX_SLL:
+         l3_off = 16;
+         if ( caplen >= l3_off )
+            ethertype = netU16(&pkt[14]);
+         break;
+
+      case LINKTYPE_LINUX_SLL2:
+         l3_off = 20;
+         if ( caplen >= l3_off )
+            ethertype = netU16(&pkt[0]);
+         break;
+
+      case LINKTYPE_NULL:
+      case LINKTYPE_LOOP:
+         l3_off = 4;
+         break;
+
+      case LINKTYPE_RAW:
+      case LINKTYPE_IPV4:
+      case LINKTYPE_IPV6:
+         l3_off = 0;
+         break;
+
+      default:
+         stats.nskipped++;
+         return;
+   }
+
+   if ( caplen < l3_off
+        || (ethertype != 0 && ethertype != ETHERTYPE_IPV4 && ethertype != ETHERTYPE_IPV6) )
+   {
+      stats.nskipped++;
+      return;
+   }
+   verifyIp(pkt + l3_off, caplen - l3_off, stats);
+}
+
+/**
+ * @brief Walk record/block headers, splitting the file into record-aligned
+ *        chunks and collecting pcapng interface link types
+ * @return false if the file isn't a capture we understand. A truncated or
+ *         corrupt tail ends the walk early /w a warning instead.
+ */
+inline bool buildIndex(std::span<const std::uint8_t> file, Index & index)
+{
+   if ( file.size() < 12 )
+   {
+      std::fprintf(stderr, "Error: File too small to be a capture.\n");
+      return false;
+   }
+
+   std::uint32_t magic = fileU32(file.data(), false);
+   std::size_t off;
+   if ( PCAP_MAGIC_US == magic || PCAP_MAGIC_NS == magic
+        || PCAP_MAGIC_US == bswap32(magic) || PCAP_MAGIC_NS == bswap32(magic) )
+   {
+      index.format = Format::PCAP;
+      bool swapped = (PCAP_MAGIC_US != magic && PCAP_MAGIC_NS != magic);
+      if ( file.size() < PCAP_FILE_HDR_SZ )
+      {
+         std::fprintf(stderr, "Error: Truncated pcap file header.\n");
+         return false;
+      }
+      // Upper bits of the link type field carry FCS info
+      std::uint32_t linktype = fileU32(&file[20], swapped) & 0xFFFF;
+      index.sections.push_back({ swapped, { linktype } });
+      off = PCAP_FILE_HDR_SZ;
+   }
+   else if ( PCAPNG_SHB == magic )
+   {
+      index.format = Format::PCAPNG;
+      off = 0;
+   }
+   else
+   {
+      std::fprintf(stderr, "Error: Not a pcap or pcapng file.\n");
+      return false;
+   }
+
+   std::size_t chunk_begin = off;
+   auto close_chunk = [&](std::size_t at)
+   {
+      if ( at > chunk_begin )
+         index.chunks.push_back({ chunk_begin, at, index.sections.size() - 1 });
+      chunk_begin = at;
+   };
+
+   while ( off < file.size() )
+   {
+      std::size_t rec_sz;
+      if ( Format::PCAP == index.format )
+      {
+         bool swapped = index.sections.back().swapped;
+         if ( file.size() - off < PCAP_REC_HDR_SZ )
+            break;
+         rec_sz = PCAP_REC_HDR_SZ + fileU32(&file[off + 8], swapped);
+      }
+      else
+      {
+         if ( file.size() - off < 12 )
+            break;
+         std::uint32_t type = fileU32(&file[off], false); // palindromic for SHB
+         if ( PCAPNG_SHB == type )
+         {
+            // New section: new byte order and interfaces. Chunks never span
+            // sections.
+            std::uint32_t bom = fileU32(&file[off + 8], false);
+            if ( bom != PCAPNG_BYTE_ORDER_MAGIC && bswap32(bom) != PCAPNG_BYTE_ORDER_MAGIC )
+            {
+               std::fprintf(stderr, "Error: Bad pcapng byte-order magic at offset %zu.\n", off);
+               return false;
+            }
+            close_chunk(off);
+            index.sections.push_back({ bom != PCAPNG_BYTE_ORDER_MAGIC, {} });
+         }
+         if ( index.sections.empty() )
+            break;
+         bool swapped = index.sections.back().swapped;
+         type = fileU32(&file[off], swapped);
+         rec_sz = fileU32(&file[off + 4], swapped);
+         if ( rec_sz < 12 || (rec_sz % 4) != 0 )
+         {
+            std::fprintf(stderr, "Warning: Bad block length at offset %zu; stopping there.\n", off);
+            break;
+         }
+         if ( PCAPNG_IDB == type && rec_sz >= 20 && file.size() - off >= rec_sz )
+            index.sections.back().if_linktypes.push_back(fileU16(&file[off + 8], swapped));
+      }
+
+      if ( rec_sz > file.size() - off )
+      {
+         std::fprintf(stderr, "Warning: Capture truncated at offset %zu.\n", off);
+         break;
+      }
+      off += rec_sz;
+      if ( off - chunk_begin >= CHUNK_TARGET_SZ )
+         close_chunk(off);
+   }
+   close_chunk(off);
+   return true;
+}
+
+/**
+ * @brief Verify every packet in one chunk
+ */
+inline void verifyChunk( std::span<const std::uint8_t> file,
+                         const Index & index,
+                         const Chunk & chunk,
+                         VerifyStats & stats )
+{
+   const Section & section = index.sections[chunk.section_idx];
+   const bool swapped = section.swapped;
+
+   for ( std::size_t off = chunk.begin; off < chunk.end; )
+   {
+      const std::uint8_t * rec = &file[off];
+      if ( Format::PCAP == index.format )
+      {
+         std::uint32_t caplen = fileU32(&rec[8], swapped);
+         verifyPacket(section.if_linktypes[0], rec + PCAP_REC_HDR_SZ, caplen, stats);
+         off += PCAP_REC_HDR_SZ + caplen;
+         continue;
+      }
+
+      std::uint32_t type = fileU32(&rec[0], swapped);
+      std::uint32_t block_len = fileU32(&rec[4], swapped);
+      std::uint32_t if_id = 0;
+      const std::uint8_t * pkt = nullptr;
+      std::size_t caplen = 0;
+      if ( PCAPNG_EPB == type && block_len >= 32 )
+      {
+         if_id = fileU32(&rec[8], swapped);
+         caplen = fileU32(&rec[20], swapped);
+         pkt = rec + 28;
+         if ( caplen > block_len - 32 )
+            pkt = nullptr;
+      }
+      else if ( PCAPNG_SPB == type && block_len >= 16 )
+      {
+         // Original length, capped at what the block holds
+         caplen = std::min<std::size_t>(fileU32(&rec[8], swapped), block_len - 16);
+         pkt = rec + 12;
+      }
+      else if ( PCAPNG_PB == type && block_len >= 32 )
+      {
+         if_id = fileU16(&rec[8], swapped);
+         caplen = fileU32(&rec[20], swapped);
+         pkt = rec + 28;
+         if ( caplen > block_len - 32 )
+            pkt = nullptr;
+      }
+
+      if ( pkt != nullptr )
+      {
+         if ( if_id < section.if_linktypes.size() )
+         {
+            verifyPacket(section.if_linktypes[if_id], pkt, caplen, stats);
+         }
+         else
+         {
+            stats.npackets++;
+            stats.nskipped++; // no such interface
+         }
+      }
+      off += block_len;
+   }
+}
+
+/**
+ * @brief Memory-map a file read-only, for the lifetime of this object
+ */
+class MappedFile
+{
+public:
+   explicit MappedFile(const char * path)
+   {
+      m_fd = open(path, O_RDONLY);
+      if ( m_fd < 0 )
+      {
+         std::fprintf(stderr, "Error: Unable to open %s: %s\n", path, std::strerror(errno));
+         return;
+      }
+      struct stat st;
+      if ( fstat(m_fd, &st) != 0 || st.st_size <= 0 )
+      {
+         std::fprintf(stderr, "Error: Unable to size %s, or it's empty.\n", path);
+         return;
+      }
+      m_len = static_cast<std::size_t>(st.st_size);
+      void * map = mmap(nullptr, m_len, PROT_READ, MAP_PRIVATE, m_fd, 0);
+      if ( MAP_FAILED == map )
+      {
+         std::fprintf(stderr, "Error: mmap() of %s failed: %s\n", path, std::strerror(errno));
+         m_len = 0;
+         return;
+      }
+      m_data = static_cast<const std::uint8_t *>(map);
+      // Each thread reads its chunk front to back. The advice values aren't
+      // flags, so each needs its own call.
+      madvise(map, m_len, MADV_SEQUENTIAL);
+      madvise(map, m_len, MADV_WILLNEED);
+   }
+
+   ~MappedFile()
+   {
+      if ( m_data != nullptr )
+         munmap(const_cast<std::uint8_t *>(m_data), m_len);
+      if ( m_fd >= 0 )
+         close(m_fd);
+   }
+
+   MappedFile(const MappedFile &) = delete;
+   MappedFile & operator=(const MappedFile &) = delete;
+
+   [[nodiscard]] bool ok() const { return m_data != nullptr; }
+   [[nodiscard]] std::span<const std::uint8_t> bytes() const { return { m_data, m_len }; }
+
+private:
+   int m_fd = -1;
+   const std::uint8_t * m_data = nullptr;
+   std::size_t m_len = 0;
+};
+
+} // namespace detail
+
+/**
+ * @brief Verify every TCP/UDP checksum (and IPv4 header checksum) in a
+ *        pcap/pcapng capture
+ *
+ * @param[in] path : capture file
+ * @param[in] nthreads : worker threads; 0 for one per hardware thread
+ * @param[out] total : summed counts
+ * @param[out] elapsed_sec : wall time for indexing + verification
+ * @return false if the file couldn't be mapped or isn't a capture
+ */
+inline bool verifyFile( const char * path,
+                        unsigned nthreads,
+                        VerifyStats & total,
+                        double & elapsed_sec )
+{
+   auto start = std::chrono::steady_clock::now();
+
+   detail::MappedFile file(path);
+   if ( !file.ok() )
+      return false;
+
+   detail::Index index;
+   if ( !detail::buildIndex(file.bytes(), index) )
+      return false;
+
+   if ( 0 == nthreads )
+      nthreads = std::max(1u, std::thread::hardware_concurrency());
+   if ( nthreads > index.chunks.size() )
+      nthreads = static_cast<unsigned>(std::max<std::size_t>(1, index.chunks.size()));
+
+   std::vector<VerifyStats> stats(nthreads);
+   std::atomic<std::size_t> next_chunk{0};
+   auto worker = [&](VerifyStats & my_stats)
+   {
+      for ( std::size_t i = next_chunk.fetch_add(1, std::memory_order_relaxed);
+            i < index.chunks.size();
+            i = next_chunk.fetch_add(1, std::memory_order_relaxed) )
+      {
+         detail::verifyChunk(file.bytes(), index, index.chunks[i], my_stats);
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for ( unsigned i = 1; i < nthreads; ++i )
+      threads.emplace_back(worker, std::ref(stats[i]));
+   worker(stats[0]); // this thread does its share too
+   for ( auto & thread : threads )
+      thread.join();
+
+   total = VerifyStats{};
+   for ( const auto & thread_stats : stats )
+      total.add(thread_stats);
+
+   elapsed_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   return true;
+}
+
+} // namespace netsp::pcap
+
+#endif // PCAP_VERIFY_HPP
@@ -0,0 +1,582 @@
+/**
+ * @file resolver_cache.c
+ * @brief Process-wide, TTL-aware cache of getaddrinfo() results
+ *
+ * Keyed by (node, service, hints). Each cached result is flattened into a
+ * single allocation - the addrinfo nodes, their sockaddrs, canonical names and
+ * the key strings - so a hit hands back a pointer instead of walking and
+ * copying an ai_next list, and the whole thing is released /w one free().
+ *
+ * The table is set-associative: a key hashes to exactly one set of
+ * RC_WAYS_PER_SET entries, so a lookup is a hash plus a scan of a handful of
+ * adjacent slots. Sets are guarded by a striped array of reader-writer locks.
+ * Hits only take the read lock; recency is tracked /w a relaxed atomic store
+ * so readers never serialize on each other. A full set evicts its least
+ * recently used entry, which bounds the cache at RC_NUM_SETS * RC_WAYS_PER_SET
+ * entries.
+ *
+ * getaddrinfo() does not report DNS record TTLs, so the TTLs here are fixed
+ * policy set at init time. Failures that mean "this name doesn't exist"
+ * (EAI_NONAME, EAI_NODATA) are cached negatively, usually for a shorter TTL.
+ * Transient failures like EAI_AGAIN are never cached.
+ *
+ * @note Unity-build module: #include this .c file and link /w -pthread.
+ */
+
+#include <netdb.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+/*************************** Constants and Types ******************************/
+constexpr size_t RC_NUM_SETS = 256;
+constexpr size_t RC_WAYS_PER_SET = 8;
+constexpr size_t RC_NUM_LOCK_STRIPES = 32; // must divide RC_NUM_SETS
+constexpr time_t RC_DEFAULT_TTL_SEC = 60;
+constexpr time_t RC_DEFAULT_NEGATIVE_TTL_SEC = 10;
+
+static_assert( RC_NUM_SETS % RC_NUM_LOCK_STRIPES == 0,
+               "Each lock stripe must guard the same number of sets" );
+
+enum ResolverCacheRetCode
+{
+   RC_HIT,          // positive entry, result holds the address list
+   RC_NEGATIVE_HIT, // cached "no such name", result holds the gai error code
+   RC_MISS
+};
+
+/**
+ * @brief One flattened, reference-counted getaddrinfo() result
+ * @note Everything the entry points to lives inside the same allocation.
+ */
+struct CachedResult
+{
+   atomic_uint refs;
+   int gai_retcode;        // 0, or the negative-cached getaddrinfo() error
+   uint64_t key_hash;
+   const char * node;      // nullptr if the lookup had no node
+   const char * service;   // nullptr if the lookup had no service
+   bool has_hints;
+   struct addrinfo hints;  // only flags, family, socktype and protocol are kept
+   size_t naddrs;
+   struct addrinfo * list; // nullptr for negative entries
+   alignas(max_align_t) unsigned char storage[];
+};
+
+struct CacheWay
+{
+   struct CachedResult * entry; // nullptr if the way is empty
+   struct timespec expiry;
+   atomic_uint_least64_t last_used_ns;
+};
+
+struct CacheLockStripe
+{
+   alignas(64) pthread_rwlock_t lock; // one stripe per cache line
+};
+
+struct ResolverCache
+{
+   bool initialized;
+   time_t ttl_sec;
+   time_t negative_ttl_sec;
+   struct CacheLockStripe stripes[RC_NUM_LOCK_STRIPES];
+   struct CacheWay sets[RC_NUM_SETS][RC_WAYS_PER_SET];
+
+   atomic_size_t nhits;
+   atomic_size_t nnegative_hits;
+   atomic_size_t nmisses;
+   atomic_size_t nexpired;
+   atomic_size_t nevictions;
+};
+
+/************************** Public Declarations *******************************/
+[[nodiscard]] bool resolverCacheInit( time_t ttl_sec, time_t negative_ttl_sec );
+bool resolverCacheIsEnabled( void );
+[[nodiscard]] enum ResolverCacheRetCode resolverCacheLookup( const char * node,
+                                                             const char * service,
+                                                             const struct addrinfo * hints,
+                                                             struct CachedResult ** result );
+[[nodiscard]] struct CachedResult * resolverCacheInsert( const char * node,
+                                                         const char * service,
+                                                         const struct addrinfo * hints,
+                                                         int gai_retcode,
+                                                         const struct addrinfo * list );
+void resolverCacheRelease( struct CachedResult * result );
+void resolverCachePrintStats( FILE * stream );
+
+/*************************** Local Declarations *******************************/
+static struct ResolverCache Cache;
+
+static uint64_t hashKey( const char * node,
+                         const char * service,
+                         const struct addrinfo * hints );
+static bool keyMatches( const struct CachedResult * entry,
+                        uint64_t key_hash,
+                        const char * node,
+                        const char * service,
+                        const struct addrinfo * hints );
+static bool isNegativeCacheable( int gai_retcode );
+static struct CachedResult * flattenResult( const char * node,
+                                            const char * service,
+                                            const struct addrinfo * hints,
+                                            int gai_retcode,
+                                            const struct addrinfo * list );
+static bool hasExpired( const struct timespec * expiry, const struct timespec * now );
+static pthread_rwlock_t * lockForSet( size_t set_idx );
+
+/************************** Function Implementations **************************/
+
+/**
+ * @brief Enable the process-wide cache
+ *
+ * @param[in] ttl_sec : lifetime of successful lookups (<= 0 for the default)
+ * @param[in] negative_ttl_sec : lifetime of cached EAI_NONAME / EAI_NODATA
+ *                               (< 0 for the default, 0 to disable)
+ *
+ * @return true on success or if already enabled
+ */
+[[nodiscard]] bool resolverCacheInit( time_t ttl_sec, time_t negative_ttl_sec )
+{
+   if ( Cache.initialized )
+      return true;
+
+   Cache.ttl_sec = ttl_sec > 0 ? ttl_sec : RC_DEFAULT_TTL_SEC;
+   Cache.negative_ttl_sec = negative_ttl_sec >= 0 ? negative_ttl_sec
+                                                  : RC_DEFAULT_NEGATIVE_TTL_SEC;
+
+   for ( size_t i = 0; i < RC_NUM_LOCK_STRIPES; ++i )
+   {
+      int retcode = pthread_rwlock_init(&Cache.stripes[i].lock, nullptr);
+      if ( retcode != 0 )
+      {
+         fprintf( stderr,
+                  "Error: pthread_rwlock_init() returned: %d : %s\n",
+                  retcode, strerror(retcode) );
+         while ( i-- > 0 )
+            pthread_rwlock_destroy(&Cache.stripes[i].lock);
+         return false;
+      }
+   }
+
+   Cache.initialized = true;
+   return true;
+}
+
+bool resolverCacheIsEnabled( void )
+{
+   return Cache.initialized;
+}
+
+/**
+ * @brief Look up a cached result. Arguments are the same as getaddrinfo()'s.
+ *
+ * @param[out] result : on RC_HIT / RC_NEGATIVE_HIT, a referenced entry that
+ *                      the caller must give back /w resolverCacheRelease()
+ *
+ * @return enum ResolverCacheRetCode
+ */
+[[nodiscard]] enum ResolverCacheRetCode resolverCacheLookup( const char * node,
+                                                             const char * service,
+                                                             const struct addrinfo * hints,
+                                                             struct CachedResult ** result )
+{
+   assert(result != nullptr);
+   *result = nullptr;
+
+   if ( !Cache.initialized )
+      return RC_MISS;
+
+   uint64_t key_hash = hashKey(node, service, hints);
+   size_t set_idx = key_hash % RC_NUM_SETS;
+   pthread_rwlock_t * lock = lockForSet(set_idx);
+
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   int retcode = pthread_rwlock_rdlock(lock);
+   assert(retcode == 0);
+
+   enum ResolverCacheRetCode rc_retcode = RC_MISS;
+   for ( size_t way = 0; way < RC_WAYS_PER_SET; ++way )
+   {
+      struct CacheWay * w = &Cache.sets[set_idx][way];
+      if ( nullptr == w->entry
+           || !keyMatches(w->entry, key_hash, node, service, hints) )
+      {
+         continue;
+      }
+
+      if ( hasExpired(&w->expiry, &now) )
+      {
+         // Leave it for the next insert into this set to reclaim
+         atomic_fetch_add_explicit(&Cache.nexpired, 1, memory_order_relaxed);
+         break;
+      }
+
+      atomic_store_explicit( &w->last_used_ns,
+                             (uint_least64_t)now.tv_sec * 1'000'000'000u
+                              + (uint_least64_t)now.tv_nsec,
+                             memory_order_relaxed );
+      atomic_fetch_add_explicit(&w->entry->refs, 1, memory_order_relaxed);
+      *result = w->entry;
+      rc_retcode = (0 == w->entry->gai_retcode) ? RC_HIT : RC_NEGATIVE_HIT;
+      break;
+   }
+
+   retcode = pthread_rwlock_unlock(lock);
+   assert(retcode == 0);
+
+   switch ( rc_retcode )
+   {
+      case RC_HIT:
+         atomic_fetch_add_explicit(&Cache.nhits, 1, memory_order_relaxed);
+         break;
+      case RC_NEGATIVE_HIT:
+         atomic_fetch_add_explicit(&Cache.nnegative_hits, 1, memory_order_relaxed);
+         break;
+      case RC_MISS:
+         // fallthrough
+      default:
+         atomic_fetch_add_explicit(&Cache.nmisses, 1, memory_order_relaxed);
+         break;
+   }
+
+   return rc_retcode;
+}
+
+/**
+ * @brief Cache the outcome of a getaddrinfo() call
+ * @note list is copied; the caller still owns (and must freeaddrinfo()) it.
+ *
+ * @return A referenced entry holding the flattened result, for the caller to
+ *         use in place of list and then resolverCacheRelease(). nullptr if the
+ *         outcome isn't cacheable (e.g., EAI_AGAIN) or allocation failed.
+ */
+[[nodiscard]] struct CachedResult * resolverCacheInsert( const char * node,
+                                                         const char * service,
+                                                         const struct addrinfo * hints,
+                                                         int gai_retcode,
+                                                         const struct addrinfo * list )
+{
+   if ( !Cache.initialized )
+      return nullptr;
+
+   time_t ttl_sec;
+   if ( 0 == gai_retcode )
+      ttl_sec = Cache.ttl_sec;
+   else if ( isNegativeCacheable(gai_retcode) && Cache.negative_ttl_sec > 0 )
+      ttl_sec = Cache.negative_ttl_sec;
+   else
+      return nullptr;
+
+   // Build the entry before taking the lock to keep the critical section short
+   struct CachedResult * entry = flattenResult( node, service, hints,
+                                                gai_retcode, list );
+   if ( nullptr == entry )
+      return nullptr;
+   atomic_store_explicit(&entry->refs, 2, memory_order_relaxed); // cache + caller
+
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   uint_least64_t now_ns = (uint_least64_t)now.tv_sec * 1'000'000'000u
+                           + (uint_least64_t)now.tv_nsec;
+
+   size_t set_idx = entry->key_hash % RC_NUM_SETS;
+   pthread_rwlock_t * lock = lockForSet(set_idx);
+
+   int retcode = pthread_rwlock_wrlock(lock);
+   assert(retcode == 0);
+
+   // Pick a way: the same key if present, else an empty or expired way, else
+   // the least recently used one
+   struct CacheWay * victim = nullptr;
+   uint_least64_t victim_last_used = UINT_LEAST64_MAX;
+   bool victim_is_free = false;
+   for ( size_t way = 0; way < RC_WAYS_PER_SET; ++way )
+   {
+      struct CacheWay * w = &Cache.sets[set_idx][way];
+      if ( w->entry != nullptr
+           && keyMatches(w->entry, entry->key_hash, node, service, hints) )
+      {
+         victim = w;
+         victim_is_free = true; // replacing, not evicting
+         break;
+      }
+
+      if ( victim_is_free )
+         continue;
+
+      if ( nullptr == w->entry || hasExpired(&w->expiry, &now) )
+      {
+         victim = w;
+         victim_is_free = true;
+         continue;
+      }
+
+      uint_least64_t last_used = atomic_load_explicit( &w->last_used_ns,
+                                                       memory_order_relaxed );
+      if ( last_used < victim_last_used )
+      {
+         victim = w;
+         victim_last_used = last_used;
+      }
+   }
+   assert(victim != nullptr);
+
+   struct CachedResult * old_entry = victim->entry;
+   victim->entry = entry;
+   victim->expiry = now;
+   victim->expiry.tv_sec += ttl_sec;
+   atomic_store_explicit(&victim->last_used_ns, now_ns, memory_order_relaxed);
+
+   retcode = pthread_rwlock_unlock(lock);
+   assert(retcode == 0);
+
+   if ( !victim_is_free )
+      atomic_fetch_add_explicit(&Cache.nevictions, 1, memory_order_relaxed);
+   if ( old_entry != nullptr )
+      resolverCacheRelease(old_entry);
+
+   return entry;
+}
+
+/**
+ * @brief Drop a reference obtained from resolverCacheLookup() or
+ *        resolverCacheInsert()
+ */
+void resolverCacheRelease( struct CachedResult * result )
+{
+   if ( nullptr == result )
+      return;
+
+   if ( atomic_fetch_sub_explicit(&result->refs, 1, memory_order_acq_rel) == 1 )
+      free(result);
+}
+
+void resolverCachePrintStats( FILE * stream )
+{
+   size_t nentries = 0;
+   size_t nnegative = 0;
+   for ( size_t set_idx = 0; set_idx < RC_NUM_SETS; ++set_idx )
+   {
+      pthread_rwlock_t * lock = lockForSet(set_idx);
+      if ( Cache.initialized )
+         pthread_rwlock_rdlock(lock);
+      for ( size_t way = 0; way < RC_WAYS_PER_SET; ++way )
+      {
+         const struct CachedResult * entry = Cache.sets[set_idx][way].entry;
+         if ( entry != nullptr )
+         {
+            nentries++;
+            if ( entry->gai_retcode != 0 )
+               nnegative++;
+         }
+      }
+      if ( Cache.initialized )
+         pthread_rwlock_unlock(lock);
+   }
+
+   fprintf( stream,
+            "Resolver cache: %s, TTL %llds (negative %llds)\n"
+            "\tEntries: %zu / %zu (%zu negative)\n"
+            "\tHits: %zu, Negative hits: %zu, Misses: %zu\n"
+            "\tExpired on lookup: %zu, Evictions: %zu\n",
+            Cache.initialized ? "enabled" : "disabled",
+            (long long)Cache.ttl_sec, (long long)Cache.negative_ttl_sec,
+            nentries, RC_NUM_SETS * RC_WAYS_PER_SET, nnegative,
+            atomic_load(&Cache.nhits), atomic_load(&Cache.nnegative_hits),
+            atomic_load(&Cache.nmisses),
+            atomic_load(&Cache.nexpired), atomic_load(&Cache.nevictions) );
+}
+
+/**
+ * @brief FNV-1a over every part of the key, /w separators so that
+ *        ("ab", "c") and ("a", "bc") don't collide trivially
+ */
+static uint64_t hashKey( const char * node,
+                         const char * service,
+                         const struct addrinfo * hints )
+{
+   constexpr uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325u;
+   constexpr uint64_t FNV_PRIME = 0x00000100000001B3u;
+
+   uint64_t hash = FNV_OFFSET_BASIS;
+   const char * parts[] = { node, service };
+   for ( size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i )
+   {
+      if ( parts[i] != nullptr )
+      {
+         for ( const char * c = parts[i]; *c != '\0'; ++c )
+            hash = (hash ^ (unsigned char)*c) * FNV_PRIME;
+      }
+      hash = (hash ^ (parts[i] != nullptr ? 0xFFu : 0xFEu)) * FNV_PRIME;
+   }
+
+   if ( hints != nullptr )
+   {
+      int fields[] = { hints->ai_flags, hints->ai_family,
+                       hints->ai_socktype, hints->ai_protocol };
+      for ( size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i )
+         hash = (hash ^ (uint32_t)fields[i]) * FNV_PRIME;
+   }
+
+   return hash;
+}
+
+static bool keyMatches( const struct CachedResult * entry,
+                        uint64_t key_hash,
+                        const char * node,
+                        const char * service,
+                        const struct addrinfo * hints )
+{
+   if ( entry->key_hash != key_hash
+        || (entry->node != nullptr) != (node != nullptr)
+        || (entry->service != nullptr) != (service != nullptr)
+        || entry->has_hints != (hints != nullptr) )
+   {
+      return false;
+   }
+
+   if ( node != nullptr && strcmp(entry->node, node) != 0 )
+      return false;
+   if ( service != nullptr && strcmp(entry->service, service) != 0 )
+      return false;
+
+   if ( hints != nullptr
+        && ( entry->hints.ai_flags    != hints->ai_flags
+             || entry->hints.ai_family   != hints->ai_family
+             || entry->hints.ai_socktype != hints->ai_socktype
+             || entry->hints.ai_protocol != hints->ai_protocol ) )
+   {
+      return false;
+   }
+
+   return true;
+}
+
+static bool isNegativeCacheable( int gai_retcode )
+{
+   if ( EAI_NONAME == gai_retcode )
+      return true;
+#ifdef EAI_NODATA
+   if ( EAI_NODATA == gai_retcode )
+      return true;
+#endif
+   return false;
+}
+
+/**
+ * @brief Copy a key and an ai_next list into one contiguous allocation
+ *
+ * Layout after the header: the addrinfo array, then each sockaddr (aligned to
+ * max_align_t), then the canonical names and key strings.
+ */
+static struct CachedResult * flattenResult( const char * node,
+                                            const char * service,
+                                            const struct addrinfo * hints,
+                                            int gai_retcode,
+                                            const struct addrinfo * list )
+{
+   constexpr size_t ALIGN = alignof(max_align_t);
+
+   size_t naddrs = 0;
+   size_t addrs_sz = 0;
+   size_t strings_sz = 0;
+   if ( 0 == gai_retcode )
+   {
+      for ( const struct addrinfo * it = list; it != nullptr; it = it->ai_next )
+      {
+         naddrs++;
+         addrs_sz += ((size_t)it->ai_addrlen + ALIGN - 1) / ALIGN * ALIGN;
+         if ( it->ai_canonname != nullptr )
+            strings_sz += strlen(it->ai_canonname) + 1;
+      }
+   }
+   if ( node != nullptr )
+      strings_sz += strlen(node) + 1;
+   if ( service != nullptr )
+      strings_sz += strlen(service) + 1;
+
+   size_t list_sz = (naddrs * sizeof(struct addrinfo) + ALIGN - 1) / ALIGN * ALIGN;
+   struct CachedResult * entry = malloc( sizeof(struct CachedResult)
+                                         + list_sz + addrs_sz + strings_sz );
+   if ( nullptr == entry )
+      return nullptr;
+
+   memset(entry, 0x00, sizeof *entry);
+   entry->gai_retcode = gai_retcode;
+   entry->key_hash = hashKey(node, service, hints);
+   entry->naddrs = naddrs;
+
+   unsigned char * addr_cursor = entry->storage + list_sz;
+   char * str_cursor = (char *)(addr_cursor + addrs_sz);
+
+   if ( naddrs > 0 )
+   {
+      entry->list = (struct addrinfo *)(void *)entry->storage;
+      size_t i = 0;
+      for ( const struct addrinfo * it = list; it != nullptr; it = it->ai_next, ++i )
+      {
+         struct addrinfo * dst = &entry->list[i];
+         *dst = *it;
+
+         dst->ai_addr = (struct sockaddr *)(void *)addr_cursor;
+         memcpy(addr_cursor, it->ai_addr, it->ai_addrlen);
+         addr_cursor += ((size_t)it->ai_addrlen + ALIGN - 1) / ALIGN * ALIGN;
+
+         if ( it->ai_canonname != nullptr )
+         {
+            size_t len = strlen(it->ai_canonname) + 1;
+            memcpy(str_cursor, it->ai_canonname, len);
+            dst->ai_canonname = str_cursor;
+            str_cursor += len;
+         }
+
+         dst->ai_next = (i + 1 < naddrs) ? &entry->list[i + 1] : nullptr;
+      }
+   }
+
+   if ( node != nullptr )
+   {
+      size_t len = strlen(node) + 1;
+      memcpy(str_cursor, node, len);
+      entry->node = str_cursor;
+      str_cursor += len;
+   }
+   if ( service != nullptr )
+   {
+      size_t len = strlen(service) + 1;
+      memcpy(str_cursor, service, len);
+      entry->service = str_cursor;
+      str_cursor += len;
+   }
+   if ( hints != nullptr )
+   {
+      entry->has_hints = true;
+      entry->hints.ai_flags    = hints->ai_flags;
+      entry->hints.ai_family   = hints->ai_family;
+      entry->hints.ai_socktype = hints->ai_socktype;
+      entry->hints.ai_protocol = hints->ai_protocol;
+   }
+
+   return entry;
+}
+
+static bool hasExpired( const struct timespec * expiry, const struct timespec * now )
+{
+   return now->tv_sec > expiry->tv_sec
+          || (now->tv_sec == expiry->tv_sec && now->tv_nsec >= expiry->tv_nsec);
+}
+
+static pthread_rwlock_t * lockForSet( size_t set_idx )
+{
+   return &Cache.stripes[set_idx % RC_NUM_LOCK_STRIPES].lock;
+}
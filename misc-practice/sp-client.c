@@ -7,6 +7,9 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
 // General-Purpose System Headers
 #include <errno.h>
 #include <string.h>
@@ -14,7 +17,12 @@
 #include <sys/wait.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 #include <assert.h>
+// Socket Practice (SP) Protocol
+#include "sp-proto.h"
 
 /* Macro Functions */
 #define LAST_ELEMENT(arr) (arr[ (sizeof(arr)/sizeof(arr[0])) - 1])
@@ -35,13 +43,38 @@ enum InputParseRetCode
    IPARSE_UNABLE_TO_PARSE
 };
 
-#define SP_CMD(cmd_enum, cmd_str, cmd_char, cmd_args) cmd_enum,
-enum UserCmdCode
+constexpr char SP_DEFAULT_HOST[] = "127.0.0.1";
+constexpr char SP_DEFAULT_PORT[] = "8080";
+
+// Happy Eyeballs connect (RFC 8305)
+constexpr size_t HE_MAX_ADDRS = 16;
+constexpr uint64_t HE_CONNECT_ATTEMPT_DELAY_NS = 250'000'000u; // RFC's recommended default
+constexpr uint64_t HE_TOTAL_TIMEOUT_NS = 10'000'000'000u;
+
+// marco latency probe
+constexpr size_t MARCO_WINDOW_SZ = 1'024; // samples kept for rolling percentiles
+constexpr uint64_t MARCO_REPORT_PERIOD_NS = 1'000'000'000u; // continuous mode
+constexpr uint64_t MARCO_REPLY_TIMEOUT_NS = 2'000'000'000u;
+constexpr unsigned long MARCO_DEFAULT_INTERVAL_MS = 1'000;
+
+// inet-pton/get-addr-info: the server may have to wait on DNS
+constexpr uint64_t LOOKUP_REPLY_TIMEOUT_NS = 30'000'000'000u;
+
+struct MarcoSample
 {
-#  include "sp-cmds.h"
-   UCMD_UNKNOWN
+   uint64_t rtt_ns;       // client send to client receive
+   uint64_t residence_ns; // server receive to server send
+   uint64_t network_ns;   // rtt minus residence: time spent on the wire/stacks
+};
+
+struct MarcoWindow
+{
+   struct MarcoSample samples[MARCO_WINDOW_SZ]; // ring of the latest samples
+   size_t nsamples;
+   size_t next;
+   size_t nsent;
+   size_t nreceived;
 };
-#undef SP_CMD
 
 struct UserCmd
 {
@@ -66,11 +99,27 @@ static const struct UserCmd UserCmdTbl[] =
 
 /* Local Variables */
 static volatile sig_atomic_t UserCancelledSession = false;
+static volatile sig_atomic_t NestedSession = false;
+static volatile sig_atomic_t UserEndedNestedSession = false;
 
 /* Local Function Declarations */
 void handleSIGINT(int sig_num);
 void printUsageInfo(void);
 [[nodiscard]] enum InputParseRetCode getCmdNumber(char str[], enum UserCmdCode * cmd);
+[[nodiscard]] int connectToServer(const char * host, const char * port);
+size_t orderAddrsForRace( const struct addrinfo * result,
+                          const struct addrinfo * addrs[static HE_MAX_ADDRS] );
+[[nodiscard]] int startConnect(const struct addrinfo * ai);
+void runMarco(int sfd, const char * args);
+void runLookup(int sfd, enum UserCmdCode cmd, const char * args);
+[[nodiscard]] bool sendMsg( int sfd,
+                            enum UserCmdCode cmd,
+                            const uint8_t * payload,
+                            size_t payload_len );
+[[nodiscard]] bool recvExact(int sfd, uint8_t * buf, size_t len, uint64_t deadline_ns);
+void recordMarcoSample(struct MarcoWindow * window, const struct MarcoSample * sample);
+void printMarcoPercentiles(const struct MarcoWindow * window);
+uint64_t monotonicNs(void);
 
 #ifndef NDEBUG
 [[nodiscard]] bool checkNullTermination(char char_arr[], size_t len);
@@ -79,7 +128,7 @@ void printUsageInfo(void);
 /******************************************************************************/
 
 /* Meat of the Program */
-int main(void)
+int main(int argc, char * argv[])
 {
    // TODO: assertions on UserCmdTbl
 
@@ -93,11 +142,16 @@ int main(void)
    sigaction(SIGINT, &sa_cfg, NULL);
    
    // Connect to the Socket Practice (SP) server
-   // TODO
-   if ( /* connection failed */ false )
+   const char * host = argc > 1 ? argv[1] : SP_DEFAULT_HOST;
+   const char * port = argc > 2 ? argv[2] : SP_DEFAULT_PORT;
+   int sfd = connectToServer(host, port);
+   if ( sfd < 0 )
+   {
+      fprintf(stderr, "Unable to connect to SP server at %s:%s.\n", host, port);
       return MAIN_RETCODE_UNABLE_TO_CONNECT;
-   
-   printf("Connected to SP server!");
+   }
+
+   printf("Connected to SP server at %s:%s!", host, port);
    puts("");
 
    // Start REPL interface
@@ -117,6 +171,7 @@ int main(void)
       {
          // Either EOF was reached or a signal interrupt + errno == EINTR
          // Time to gracefully stop
+         break;
       }
 
       // fgets() also takes in the newline character. Replace /w NULL terminator.
@@ -140,17 +195,26 @@ int main(void)
 
       // Pattern match on command
       enum UserCmdCode cmd = UCMD_UNKNOWN;
+      const char * cmd_args = "";
       // First, see if input was just a number...
       enum InputParseRetCode iparse_retcode = getCmdNumber(buf, &cmd);
-      if ( iparse_retcode != IPARSE_SUCCESS )
+      if ( iparse_retcode == IPARSE_SUCCESS )
       {
-         // Not a number, check for command strings...
+         cmd_args = buf + 1;
+      }
+      else
+      {
+         // Not a number, check for command strings, which may be followed by
+         // space-separated arguments...
          for ( size_t i=0; i < sizeof(UserCmdTbl) / sizeof(UserCmdTbl[0]); ++i )
          {
-            if ( strcmp(buf, UserCmdTbl[i].str) == 0 )
+            size_t cmd_strlen = strlen(UserCmdTbl[i].str);
+            if ( strncmp(buf, UserCmdTbl[i].str, cmd_strlen) == 0
+                 && (buf[cmd_strlen] == ' ' || buf[cmd_strlen] == '\0') )
             {
                // Found match
                cmd = UserCmdTbl[i].code;
+               cmd_args = buf + cmd_strlen;
                break;
             }
          }
@@ -169,15 +233,13 @@ int main(void)
       switch(cmd)
       {
          case UCMD_MARCO:
-            // TODO
+            runMarco(sfd, cmd_args);
             break;
 
          case UCMD_INET_PTON:
-            // TODO
-            break;
-
+            // fallthrough
          case UCMD_GETADDRINFO:
-            // TODO
+            runLookup(sfd, cmd, cmd_args);
             break;
 
          case UCMD_UNKNOWN:
@@ -200,7 +262,8 @@ int main(void)
    puts("See ya again soon! Goodbye for now :).");
 
    // Close the connection
-   // TODO
+   if ( close(sfd) != 0 )
+      fprintf(stderr, "Warning: close() failed: %s\n", strerror(errno));
 
    return (int)MAIN_RETCODE_GOOD;
 }
@@ -215,7 +278,12 @@ int main(void)
 void handleSIGINT(int sig_num)
 {
    (void)sig_num; // this signal handler is only for SIGINT
-   UserCancelledSession = true;
+
+   // While a command is running, Ctrl+C only stops that command
+   if ( NestedSession )
+      UserEndedNestedSession = true;
+   else
+      UserCancelledSession = true;
 }
 
 /**
@@ -267,6 +335,576 @@ void printUsageInfo(void)
    return IPARSE_SUCCESS;
 }
 
+/**
+ * @brief Resolve the SP server's address and race connects across every
+ *        result, "Happy Eyeballs" style (RFC 8305)
+ *
+ * Addresses are interleaved by family (keeping getaddrinfo()'s preference
+ * order within each family), and a new non-blocking connect is started every
+ * HE_CONNECT_ATTEMPT_DELAY_NS, or as soon as the previous attempt fails,
+ * while earlier attempts keep going. The first connect to complete wins and
+ * the rest are closed, so a dead address costs one attempt delay instead of a
+ * full connect timeout.
+ *
+ * @note getaddrinfo() resolves AAAA and A together, so RFC 8305's
+ *       asynchronous resolution (section 3) isn't done here.
+ *
+ * @return connected (blocking) socket descriptor, or -1 on failure
+ */
+[[nodiscard]] int connectToServer(const char * host, const char * port)
+{
+   assert(host != nullptr && port != nullptr);
+
+   struct addrinfo hints;
+   memset(&hints, 0x00, sizeof hints);
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = AI_ADDRCONFIG;
+
+   struct addrinfo * result;
+   int retcode = getaddrinfo(host, port, &hints, &result);
+   if ( retcode != 0 )
+   {
+      fprintf(stderr, "Error: getaddrinfo() returned: %s\n", gai_strerror(retcode));
+      return -1;
+   }
+
+   const struct addrinfo * addrs[HE_MAX_ADDRS];
+   size_t naddrs = orderAddrsForRace(result, addrs);
+
+   struct pollfd attempts[HE_MAX_ADDRS];
+   size_t attempt_addr_idx[HE_MAX_ADDRS]; // which of addrs each attempt is for
+   size_t nattempts = 0;   // in flight
+   size_t next_addr = 0;   // next address to try
+   int winner_sfd = -1;
+   int last_errno = 0;
+   uint64_t deadline_ns = monotonicNs() + HE_TOTAL_TIMEOUT_NS;
+   uint64_t next_attempt_ns = 0; // start the first attempt right away
+
+   while ( winner_sfd < 0 && !UserCancelledSession )
+   {
+      uint64_t now_ns = monotonicNs();
+      if ( now_ns >= deadline_ns )
+      {
+         last_errno = ETIMEDOUT;
+         break;
+      }
+
+      // Start the next attempt once its turn comes up, or straight away if
+      // nothing else is in flight
+      if ( next_addr < naddrs && (now_ns >= next_attempt_ns || 0 == nattempts) )
+      {
+         const struct addrinfo * ai = addrs[next_addr];
+         int sfd = startConnect(ai);
+         if ( sfd >= 0 )
+         {
+            attempts[nattempts] = (struct pollfd){ .fd = sfd, .events = POLLOUT };
+            attempt_addr_idx[nattempts] = next_addr;
+            nattempts++;
+         }
+         else
+         {
+            last_errno = errno;
+         }
+         next_addr++;
+         next_attempt_ns = now_ns + HE_CONNECT_ATTEMPT_DELAY_NS;
+         continue;
+      }
+
+      if ( 0 == nattempts )
+         break; // every address failed
+
+      // Wait for an attempt to finish, or for the next one to be due
+      uint64_t wake_ns = next_addr < naddrs && next_attempt_ns < deadline_ns
+                         ? next_attempt_ns : deadline_ns;
+      int timeout_ms = (int)((wake_ns - now_ns + 999'999u) / 1'000'000u);
+      int nready = poll(attempts, nattempts, timeout_ms);
+      if ( nready < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         last_errno = errno;
+         break;
+      }
+
+      for ( size_t i = 0; i < nattempts && nready > 0; )
+      {
+         if ( 0 == attempts[i].revents )
+         {
+            ++i;
+            continue;
+         }
+         nready--;
+
+         int so_error = 0;
+         socklen_t so_error_len = sizeof so_error;
+         if ( getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &so_error, &so_error_len) != 0 )
+            so_error = errno;
+
+         if ( 0 == so_error )
+         {
+            winner_sfd = attempts[i].fd;
+#ifndef NDEBUG
+            char addrstr[INET6_ADDRSTRLEN];
+            const struct addrinfo * ai = addrs[attempt_addr_idx[i]];
+            const void * ip = AF_INET6 == ai->ai_family
+                              ? (const void *)&((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr
+                              : (const void *)&((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+            if ( inet_ntop(ai->ai_family, ip, addrstr, sizeof addrstr) != nullptr )
+               printf( "Connected via %s (attempt %zu of %zu addresses).\n",
+                       addrstr, attempt_addr_idx[i] + 1, naddrs );
+#endif
+            // Remove the winner so that only the losers are left to close
+            attempts[i] = attempts[--nattempts];
+            attempt_addr_idx[i] = attempt_addr_idx[nattempts];
+            break;
+         }
+
+         // This attempt failed: drop it, and don't wait out the attempt delay
+         // before trying the next address
+         last_errno = so_error;
+         close(attempts[i].fd);
+         attempts[i] = attempts[--nattempts];
+         attempt_addr_idx[i] = attempt_addr_idx[nattempts];
+         next_attempt_ns = 0;
+      }
+   }
+
+   // Cancel the attempts still in flight
+   for ( size_t i = 0; i < nattempts; ++i )
+      close(attempts[i].fd);
+   freeaddrinfo(result);
+
+   if ( winner_sfd < 0 )
+   {
+      if ( last_errno != 0 )
+         fprintf(stderr, "Error: connect() failed: %s\n", strerror(last_errno));
+      return -1;
+   }
+
+   // The rest of the client expects blocking I/O
+   int flags = fcntl(winner_sfd, F_GETFL);
+   if ( flags < 0 || fcntl(winner_sfd, F_SETFL, flags & ~O_NONBLOCK) != 0 )
+   {
+      fprintf(stderr, "Error: fcntl() failed: %s\n", strerror(errno));
+      close(winner_sfd);
+      return -1;
+   }
+
+   return winner_sfd;
+}
+
+/**
+ * @brief Order getaddrinfo() results for the connect race: alternate address
+ *        families, starting /w the most preferred one (RFC 8305 section 4)
+ *
+ * @return number of addresses written to addrs (at most HE_MAX_ADDRS)
+ */
+size_t orderAddrsForRace( const struct addrinfo * result,
+                          const struct addrinfo * addrs[static HE_MAX_ADDRS] )
+{
+   const struct addrinfo * preferred[HE_MAX_ADDRS];
+   const struct addrinfo * others[HE_MAX_ADDRS];
+   size_t npreferred = 0;
+   size_t nothers = 0;
+   for ( const struct addrinfo * it = result; it != nullptr; it = it->ai_next )
+   {
+      if ( it->ai_family == result->ai_family )
+      {
+         if ( npreferred < HE_MAX_ADDRS )
+            preferred[npreferred++] = it;
+      }
+      else if ( nothers < HE_MAX_ADDRS )
+      {
+         others[nothers++] = it;
+      }
+   }
+
+   size_t naddrs = 0;
+   for ( size_t i = 0; naddrs < HE_MAX_ADDRS && (i < npreferred || i < nothers); ++i )
+   {
+      if ( i < npreferred )
+         addrs[naddrs++] = preferred[i];
+      if ( i < nothers && naddrs < HE_MAX_ADDRS )
+         addrs[naddrs++] = others[i];
+   }
+   return naddrs;
+}
+
+/**
+ * @brief Start a non-blocking connect
+ * @return socket descriptor /w the connect in progress (or already done), or
+ *         -1 /w errno set if the attempt failed outright
+ */
+[[nodiscard]] int startConnect(const struct addrinfo * ai)
+{
+   int sfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+   if ( sfd < 0 )
+      return -1;
+
+   int flags = fcntl(sfd, F_GETFL);
+   if ( flags < 0 || fcntl(sfd, F_SETFL, flags | O_NONBLOCK) != 0 )
+   {
+      int saved_errno = errno;
+      close(sfd);
+      errno = saved_errno;
+      return -1;
+   }
+
+   // A loopback connect may complete immediately; poll() reports it as
+   // writable just the same
+   if ( connect(sfd, ai->ai_addr, ai->ai_addrlen) != 0 && errno != EINPROGRESS )
+   {
+      int saved_errno = errno;
+      close(sfd);
+      errno = saved_errno;
+      return -1;
+   }
+
+   return sfd;
+}
+
+/**
+ * @brief marco latency probe: ping the server /w sequence-numbered, timestamped
+ *        marco's and break each polo's round trip into server residence time
+ *        (the server's own receive-to-send) and network time (the rest)
+ * @note The one-way estimate assumes a symmetric path, i.e. network time / 2,
+ *       since client and server monotonic clocks aren't comparable across hosts.
+ *
+ * @param[in] args : "[count] [interval-ms]". count 0 runs until Ctrl+C and
+ *                   reports rolling percentiles once a second instead of
+ *                   printing every probe.
+ */
+void runMarco(int sfd, const char * args)
+{
+   assert(args != nullptr);
+
+   char * end_ptr = nullptr;
+   unsigned long count = strtoul(args, &end_ptr, 10);
+   if ( end_ptr == args )
+      count = 1; // no count given
+   const char * interval_arg = end_ptr;
+   unsigned long interval_ms = strtoul(interval_arg, &end_ptr, 10);
+   if ( end_ptr == interval_arg )
+      interval_ms = MARCO_DEFAULT_INTERVAL_MS;
+   while ( *end_ptr == ' ' )
+      ++end_ptr;
+   if ( *end_ptr != '\0' )
+   {
+      fprintf(stderr, "Invalid marco arguments: %s\n", args);
+      return;
+   }
+
+   bool continuous = (0 == count);
+   static struct MarcoWindow window; // too big for the stack
+   memset(&window, 0x00, sizeof window);
+
+   NestedSession = true;
+   uint64_t next_report_ns = monotonicNs() + MARCO_REPORT_PERIOD_NS;
+   for ( uint64_t seq = 1;
+         (continuous || seq <= count) && !UserEndedNestedSession;
+         ++seq )
+   {
+      uint8_t marco_buf[SP_MARCO_PAYLOAD_SZ];
+      uint64_t tx_ns = monotonicNs();
+      spPackMarco(marco_buf, &(struct SpMarco){ .seq = seq, .client_tx_ns = tx_ns });
+      if ( !sendMsg(sfd, UCMD_MARCO, marco_buf, sizeof marco_buf) )
+      {
+         fprintf(stderr, "Error: Failed to send marco: %s\n", strerror(errno));
+         break;
+      }
+      window.nsent++;
+
+      // Wait for the polo matching this seq, discarding late replies to
+      // earlier probes that timed out
+      bool got_polo = false;
+      bool conn_failed = false;
+      uint64_t deadline_ns = tx_ns + MARCO_REPLY_TIMEOUT_NS;
+      while ( !got_polo && !UserEndedNestedSession )
+      {
+         uint8_t hdr_buf[SP_HDR_SZ];
+         uint8_t payload[SP_MAX_PAYLOAD_SZ];
+         struct SpMsgHdr hdr;
+         if ( !recvExact(sfd, hdr_buf, sizeof hdr_buf, deadline_ns) )
+         {
+            conn_failed = (errno != ETIMEDOUT && errno != EINTR);
+            break;
+         }
+         spUnpackHdr(hdr_buf, &hdr);
+         if ( hdr.magic != SP_MAGIC || hdr.len > SP_MAX_PAYLOAD_SZ
+              || !recvExact(sfd, payload, hdr.len, deadline_ns) )
+         {
+            conn_failed = true;
+            break;
+         }
+         uint64_t rx_ns = monotonicNs();
+
+         if ( hdr.flags & SP_FLAG_ERROR )
+         {
+            fprintf( stderr, "Server error: %.*s\n", (int)hdr.len, (const char *)payload );
+            conn_failed = true; // nothing to wait for
+            break;
+         }
+         if ( hdr.cmd != UCMD_MARCO || hdr.len != SP_POLO_PAYLOAD_SZ )
+            continue;
+
+         struct SpPolo polo;
+         spUnpackPolo(payload, &polo);
+         if ( polo.seq != seq || polo.client_tx_ns != tx_ns )
+            continue; // late reply to an earlier probe
+
+         got_polo = true;
+         window.nreceived++;
+
+         struct MarcoSample sample;
+         sample.rtt_ns = rx_ns - tx_ns;
+         sample.residence_ns = polo.server_tx_ns - polo.server_rx_ns;
+         sample.network_ns = sample.rtt_ns > sample.residence_ns
+                             ? sample.rtt_ns - sample.residence_ns : 0;
+         recordMarcoSample(&window, &sample);
+
+         if ( !continuous )
+         {
+            printf( "polo seq=%llu rtt=%.1f us server=%.1f us network=%.1f us "
+                    "one-way~%.1f us\n",
+                    (unsigned long long)seq,
+                    (double)sample.rtt_ns / 1e3,
+                    (double)sample.residence_ns / 1e3,
+                    (double)sample.network_ns / 1e3,
+                    (double)sample.network_ns / 2e3 );
+         }
+      }
+
+      if ( conn_failed )
+         break;
+      if ( !got_polo && !UserEndedNestedSession )
+         printf("marco seq=%llu: no polo (timed out)\n", (unsigned long long)seq);
+
+      if ( continuous && monotonicNs() >= next_report_ns )
+      {
+         printMarcoPercentiles(&window);
+         next_report_ns += MARCO_REPORT_PERIOD_NS;
+      }
+
+      if ( interval_ms > 0 && (continuous || seq < count) )
+      {
+         struct timespec interval = { .tv_sec = (time_t)(interval_ms / 1'000),
+                                      .tv_nsec = (long)(interval_ms % 1'000) * 1'000'000L };
+         nanosleep(&interval, nullptr); // Ctrl+C cuts this short, which is fine
+      }
+   }
+   NestedSession = false;
+   UserEndedNestedSession = false;
+
+   printMarcoPercentiles(&window);
+}
+
+/**
+ * @brief Frame and send an SP request in full
+ */
+[[nodiscard]] bool sendMsg( int sfd,
+                            enum UserCmdCode cmd,
+                            const uint8_t * payload,
+                            size_t payload_len )
+{
+   assert(payload_len <= SP_MAX_PAYLOAD_SZ);
+
+   uint8_t msg[SP_MAX_MSG_SZ];
+   spPackHdr( msg, &(struct SpMsgHdr){ .magic = SP_MAGIC,
+                                       .cmd = (uint8_t)cmd,
+                                       .flags = SP_FLAG_NONE,
+                                       .len = (uint32_t)payload_len } );
+   if ( payload_len > 0 )
+      memcpy(msg + SP_HDR_SZ, payload, payload_len);
+
+   size_t total = SP_HDR_SZ + payload_len;
+   for ( size_t sent = 0; sent < total; )
+   {
+      ssize_t nbytes = send(sfd, msg + sent, total - sent, MSG_NOSIGNAL);
+      if ( nbytes < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         return false;
+      }
+      sent += (size_t)nbytes;
+   }
+   return true;
+}
+
+/**
+ * @brief Receive exactly len bytes, giving up at deadline_ns (CLOCK_MONOTONIC)
+ * @return true on success. On failure, errno is ETIMEDOUT for the deadline,
+ *         EINTR for Ctrl+C, ECONNRESET for the server hanging up, or whatever
+ *         poll()/recv() failed /w.
+ */
+[[nodiscard]] bool recvExact(int sfd, uint8_t * buf, size_t len, uint64_t deadline_ns)
+{
+   size_t received = 0;
+   while ( received < len )
+   {
+      uint64_t now_ns = monotonicNs();
+      if ( now_ns >= deadline_ns )
+      {
+         errno = ETIMEDOUT;
+         return false;
+      }
+
+      int timeout_ms = (int)((deadline_ns - now_ns + 999'999u) / 1'000'000u);
+      int nready = poll(&(struct pollfd){ .fd = sfd, .events = POLLIN }, 1, timeout_ms);
+      if ( nready < 0 )
+      {
+         if ( EINTR == errno && !UserEndedNestedSession )
+            continue;
+         return false;
+      }
+      if ( 0 == nready )
+         continue; // deadline check at the top of the loop
+
+      ssize_t nbytes = recv(sfd, buf + received, len - received, 0);
+      if ( 0 == nbytes )
+      {
+         errno = ECONNRESET;
+         return false;
+      }
+      if ( nbytes < 0 )
+      {
+         if ( EINTR == errno )
+            continue;
+         return false;
+      }
+      received += (size_t)nbytes;
+   }
+   return true;
+}
+
+/**
+ * @brief inet-pton/get-addr-info: have the server do the lookup on args and
+ *        print what it came back /w
+ */
+void runLookup(int sfd, enum UserCmdCode cmd, const char * args)
+{
+   assert(args != nullptr);
+   while ( *args == ' ' )
+      ++args;
+   size_t args_len = strlen(args);
+   if ( args_len > SP_MAX_PAYLOAD_SZ )
+   {
+      fprintf(stderr, "Arguments too long. The limit is %zu characters.\n", SP_MAX_PAYLOAD_SZ);
+      return;
+   }
+
+   if ( !sendMsg(sfd, cmd, (const uint8_t *)args, args_len) )
+   {
+      fprintf(stderr, "Error: Failed to send request: %s\n", strerror(errno));
+      return;
+   }
+
+   uint64_t deadline_ns = monotonicNs() + LOOKUP_REPLY_TIMEOUT_NS;
+   for ( ;; )
+   {
+      uint8_t hdr_buf[SP_HDR_SZ];
+      uint8_t payload[SP_MAX_PAYLOAD_SZ];
+      struct SpMsgHdr hdr;
+      if ( !recvExact(sfd, hdr_buf, sizeof hdr_buf, deadline_ns) )
+      {
+         fprintf(stderr, "Error: No reply: %s\n", strerror(errno));
+         return;
+      }
+      spUnpackHdr(hdr_buf, &hdr);
+      if ( hdr.magic != SP_MAGIC || hdr.len > SP_MAX_PAYLOAD_SZ
+           || !recvExact(sfd, payload, hdr.len, deadline_ns) )
+      {
+         fprintf(stderr, "Error: Malformed reply from server.\n");
+         return;
+      }
+      if ( hdr.cmd != cmd )
+         continue; // e.g., a polo that showed up after its marco timed out
+
+      if ( hdr.flags & SP_FLAG_ERROR )
+      {
+         fprintf( stderr, "Server error: %.*s\n", (int)hdr.len, (const char *)payload );
+      }
+      else if ( UCMD_INET_PTON == cmd )
+      {
+         printf( "%s (%u bytes, network byte order):",
+                 4 == hdr.len ? "IPv4" : "IPv6", (unsigned)hdr.len );
+         for ( size_t i = 0; i < hdr.len; ++i )
+            printf(" %02x", payload[i]);
+         printf("\n");
+      }
+      else
+      {
+         printf("%.*s", (int)hdr.len, (const char *)payload);
+      }
+      return;
+   }
+}
+
+void recordMarcoSample(struct MarcoWindow * window, const struct MarcoSample * sample)
+{
+   window->samples[window->next] = *sample;
+   window->next = (window->next + 1) % MARCO_WINDOW_SZ;
+   if ( window->nsamples < MARCO_WINDOW_SZ )
+      window->nsamples++;
+}
+
+static int compareU64(const void * a, const void * b)
+{
+   uint64_t x = *(const uint64_t *)a;
+   uint64_t y = *(const uint64_t *)b;
+   return (x > y) - (x < y);
+}
+
+/**
+ * @brief Print p50/p90/p99/p99.9/max of RTT, server residence and network time over
+ *        the samples currently in the window
+ */
+void printMarcoPercentiles(const struct MarcoWindow * window)
+{
+   printf( "--- marco: %zu sent, %zu received (%.1f%% loss), last %zu samples ---\n",
+           window->nsent, window->nreceived,
+           window->nsent > 0
+              ? 100.0 * (double)(window->nsent - window->nreceived) / (double)window->nsent
+              : 0.0,
+           window->nsamples );
+   if ( 0 == window->nsamples )
+      return;
+
+   static uint64_t sorted[MARCO_WINDOW_SZ];
+   const char * names[] = { "rtt", "server", "network" };
+   for ( size_t metric = 0; metric < sizeof(names) / sizeof(names[0]); ++metric )
+   {
+      for ( size_t i = 0; i < window->nsamples; ++i )
+      {
+         const struct MarcoSample * smp = &window->samples[i];
+         sorted[i] = (0 == metric) ? smp->rtt_ns
+                   : (1 == metric) ? smp->residence_ns
+                   : smp->network_ns;
+      }
+      qsort(sorted, window->nsamples, sizeof sorted[0], compareU64);
+
+      // Nearest-rank percentiles
+      const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+      const char * pct_names[] = { "p50", "p90", "p99", "p99.9" };
+      printf("%-8s", names[metric]);
+      for ( size_t p = 0; p < sizeof(pcts) / sizeof(pcts[0]); ++p )
+      {
+         size_t rank = (size_t)((pcts[p] / 100.0) * (double)window->nsamples + 0.999999);
+         size_t idx = rank > 0 ? rank - 1 : 0;
+         printf( " %s %9.1f us", pct_names[p], (double)sorted[idx] / 1e3 );
+      }
+      printf( " max %9.1f us\n", (double)sorted[window->nsamples - 1] / 1e3 );
+   }
+}
+
+uint64_t monotonicNs(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1'000'000'000u + (uint64_t)ts.tv_nsec;
+}
+
 #ifndef NDEBUG
 /**
  * @brief Check if the character array is null-terminated within len specified
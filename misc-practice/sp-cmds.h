@@ -1,5 +1,5 @@
 // NOTE: Write command codes in ascending order!!
 //      Enum               Cmd String        Cmd Num as Char  String Args for Cmd
-SP_CMD( UCMD_MARCO,        "marco",          '0',             ""                   )
-SP_CMD( UCMD_INET_PTON,    "inet-pton",      '1',             "<ipv4-address-str>" )
-SP_CMD( UCMD_GETADDRINFO,  "get-addr-info",  '2',             ""                   )
+SP_CMD( UCMD_MARCO,        "marco",          '0',             "[count (0 = until Ctrl+C)] [interval-ms]" )
+SP_CMD( UCMD_INET_PTON,    "inet-pton",      '1',             "<ipv4-address-str>"                       )
+SP_CMD( UCMD_GETADDRINFO,  "get-addr-info",  '2',             "<node> [service]"                         )
@@ -0,0 +1,383 @@
+/**
+ * @brief A small SP server written against sp-coro.hpp: one straight-line
+ *        coroutine per connection, all of them on one thread
+ *
+ * Answers marco and inet-pton like the demo server does (anything else gets
+ * an error reply), hangs up on clients that go quiet for longer than the
+ * idle timeout, and prints a line of counters every few seconds whenever
+ * they've changed. Ctrl+C to stop.
+ *
+ * Usage: sp-coro-server <ip> <port> [idle-timeout-s]
+ */
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <span>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "sp-coro.hpp"
+
+using namespace netsp::coro;
+using namespace std::chrono_literals;
+
+// The SP wire format, as in sp-proto.h, which C++ can't include as-is (its
+// [static N] array parameters are C-only). The command codes are shared.
+#define SP_CMD(cmd_enum, cmd_str, cmd_char, cmd_args) cmd_enum,
+enum UserCmdCode : std::uint8_t
+{
+#  include "sp-cmds.h"
+   UCMD_UNKNOWN
+};
+#undef SP_CMD
+
+constexpr std::uint16_t SP_MAGIC = 0x5350; // "SP"
+constexpr std::size_t SP_HDR_SZ = 8;
+constexpr std::size_t SP_MAX_PAYLOAD_SZ = 1024;
+constexpr std::size_t SP_MAX_MSG_SZ = SP_HDR_SZ + SP_MAX_PAYLOAD_SZ;
+constexpr std::uint8_t SP_FLAG_REPLY = 0x01;
+constexpr std::uint8_t SP_FLAG_ERROR = 0x02;
+constexpr std::size_t SP_MARCO_PAYLOAD_SZ = 16;
+constexpr std::size_t SP_POLO_PAYLOAD_SZ = 32;
+
+constexpr auto DEFAULT_IDLE_TIMEOUT = 60s;
+constexpr auto REPORT_INTERVAL = 5s;
+// How long to back off when accept() fails for lack of resources (EMFILE,
+// ENOBUFS, ...), rather than spin on a listener that stays readable
+constexpr auto ACCEPT_RETRY_DELAY = 100ms;
+
+struct SpMsgHdr
+{
+   std::uint16_t magic;
+   std::uint8_t cmd;
+   std::uint8_t flags;
+   std::uint32_t len;
+};
+
+struct Counters
+{
+   std::uint64_t nconns;
+   std::uint64_t nactive;
+   std::uint64_t nrequests;
+   std::uint64_t nerrors; // malformed requests and failed sends
+   std::uint64_t nidle;   // hung up on for going quiet
+
+   bool operator==(const Counters &) const = default;
+};
+
+static Reactor * gReactor; // for the SIGINT handler
+
+/* Function Declarations */
+static Task<> acceptClients(Listener & listener, Counters & counters, Clock::duration idle_timeout);
+static Task<> serveClient(Conn conn, Counters & counters, Clock::duration idle_timeout);
+static Task<bool> reply( Conn & conn,
+                         const SpMsgHdr & hdr,
+                         std::span<const std::byte> payload,
+                         std::uint64_t rx_ns );
+static Task<bool> sendMsg( Conn & conn,
+                           std::uint8_t cmd,
+                           std::uint8_t flags,
+                           std::span<const std::byte> payload );
+static Task<> reportCounters(const Counters & counters);
+static void handleSIGINT(int sig_num);
+static std::uint64_t monotonicNs();
+static void putBE(std::byte * buf, std::uint64_t val, std::size_t nbytes);
+static std::uint64_t getBE(const std::byte * buf, std::size_t nbytes);
+
+/* Main Function */
+int main(int argc, char * argv[])
+{
+   if ( argc < 3 || argc > 4 )
+   {
+      std::fprintf(stderr, "Usage: %s <ip> <port> [idle-timeout-s]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   in_addr addr;
+   if ( inet_pton(AF_INET, argv[1], &addr) != 1 )
+   {
+      std::fprintf(stderr, "Error: Invalid IPv4 address: %s\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+   char * end_ptr = nullptr;
+   unsigned long port = std::strtoul(argv[2], &end_ptr, 10);
+   if ( *end_ptr != '\0' || port > UINT16_MAX )
+   {
+      std::fprintf(stderr, "Error: Invalid port: %s\n", argv[2]);
+      return EXIT_FAILURE;
+   }
+   Clock::duration idle_timeout = DEFAULT_IDLE_TIMEOUT;
+   if ( 4 == argc )
+   {
+      unsigned long secs = std::strtoul(argv[3], &end_ptr, 10);
+      if ( *end_ptr != '\0' || 0 == secs )
+      {
+         std::fprintf(stderr, "Error: Invalid idle timeout: %s\n", argv[3]);
+         return EXIT_FAILURE;
+      }
+      idle_timeout = std::chrono::seconds{ secs };
+   }
+
+   int sfd = socket(AF_INET, SOCK_STREAM, 0);
+   if ( sfd < 0 )
+   {
+      std::fprintf(stderr, "Error: socket() failed: %s (%d)\n", std::strerror(errno), errno);
+      return EXIT_FAILURE;
+   }
+   int reuse = 1;
+   sockaddr_in bind_addr{};
+   bind_addr.sin_family = AF_INET;
+   bind_addr.sin_port = htons(static_cast<std::uint16_t>(port));
+   bind_addr.sin_addr = addr;
+   if ( setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse) != 0
+        || bind(sfd, reinterpret_cast<const sockaddr *>(&bind_addr), sizeof bind_addr) != 0
+        || listen(sfd, SOMAXCONN) != 0 )
+   {
+      std::fprintf( stderr, "Error: Can't listen on %s:%lu: %s (%d)\n",
+                    argv[1], port, std::strerror(errno), errno );
+      close(sfd);
+      return EXIT_FAILURE;
+   }
+   Listener listener{ sfd };
+
+   Reactor & reactor = Reactor::current();
+   gReactor = &reactor;
+   struct sigaction sa_cfg{};
+   sigemptyset(&sa_cfg.sa_mask);
+   sa_cfg.sa_handler = handleSIGINT;
+   if ( sigaction(SIGINT, &sa_cfg, nullptr) != 0 )
+      std::fprintf(stderr, "Warning: Ctrl+C won't stop the server gracefully.\n");
+
+   Counters counters{};
+   reactor.spawn(acceptClients(listener, counters, idle_timeout));
+   reactor.spawn(reportCounters(counters));
+   std::printf("Listening on %s:%lu\n", argv[1], port);
+
+   bool ran = reactor.run();
+   if ( !ran )
+      std::fprintf(stderr, "Error: poll() failed: %s (%d)\n", std::strerror(errno), errno);
+
+   // Hang up on everyone still connected
+   reactor.cancelAll();
+   const FramePool::Stats & pool = FramePool::local().stats();
+   std::printf( "\nServed %" PRIu64 " connections, %" PRIu64 " requests. "
+                "Coroutine frames: %" PRIu64 " allocated, %" PRIu64 " reused from the pool.\n",
+                counters.nconns, counters.nrequests, pool.nallocs, pool.nreused );
+   return ran ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Function Implementations */
+
+static Task<> acceptClients(Listener & listener, Counters & counters, Clock::duration idle_timeout)
+{
+   for ( ;; )
+   {
+      Listener::Accepted accepted = co_await listener.accept();
+      if ( accepted.error != 0 )
+      {
+         std::fprintf( stderr, "Error: accept() failed: %s (%d)\n",
+                       std::strerror(accepted.error), accepted.error );
+         co_await sleepFor(ACCEPT_RETRY_DELAY);
+         continue;
+      }
+      counters.nconns++;
+      Reactor::current().spawn(serveClient(std::move(accepted.conn), counters, idle_timeout));
+   }
+}
+
+/**
+ * @brief Read a client's requests and answer each in turn, until it hangs up,
+ *        misbehaves or goes quiet
+ */
+static Task<> serveClient(Conn conn, Counters & counters, Clock::duration idle_timeout)
+{
+   counters.nactive++;
+   std::array<std::byte, SP_MAX_MSG_SZ> rx_buf;
+   std::size_t rx_len = 0;
+
+   for ( ;; )
+   {
+      IoResult rd = co_await conn.read(std::span{ rx_buf }.subspan(rx_len), idle_timeout);
+      // Timestamp as close to the bytes coming off the socket as possible
+      std::uint64_t rx_ns = monotonicNs();
+      if ( !rd || 0 == rd.nbytes )
+      {
+         if ( ETIMEDOUT == rd.error )
+            counters.nidle++;
+         break;
+      }
+      rx_len += rd.nbytes;
+
+      std::size_t consumed = 0;
+      bool hang_up = false;
+      while ( rx_len - consumed >= SP_HDR_SZ )
+      {
+         const std::byte * msg = rx_buf.data() + consumed;
+         SpMsgHdr hdr{ static_cast<std::uint16_t>(getBE(msg, 2)),
+                       static_cast<std::uint8_t>(msg[2]),
+                       static_cast<std::uint8_t>(msg[3]),
+                       static_cast<std::uint32_t>(getBE(msg + 4, 4)) };
+         if ( hdr.magic != SP_MAGIC || hdr.len > SP_MAX_PAYLOAD_SZ )
+         {
+            counters.nerrors++;
+            hang_up = true;
+            break;
+         }
+         if ( rx_len - consumed < SP_HDR_SZ + hdr.len )
+            break; // rest of the message hasn't arrived yet
+
+         counters.nrequests++;
+         if ( !co_await reply(conn, hdr, std::span{ msg + SP_HDR_SZ, hdr.len }, rx_ns) )
+         {
+            counters.nerrors++;
+            hang_up = true;
+            break;
+         }
+         consumed += SP_HDR_SZ + hdr.len;
+      }
+      if ( hang_up )
+         break;
+
+      // Shift any partial message to the front of the buffer
+      std::memmove(rx_buf.data(), rx_buf.data() + consumed, rx_len - consumed);
+      rx_len -= consumed;
+   }
+
+   counters.nactive--;
+}
+
+/**
+ * @brief Carry out one SP request and send its reply
+ * @return false if the reply couldn't be sent
+ */
+static Task<bool> reply( Conn & conn,
+                         const SpMsgHdr & hdr,
+                         std::span<const std::byte> payload,
+                         std::uint64_t rx_ns )
+{
+   if ( hdr.flags & SP_FLAG_REPLY )
+      co_return true; // clients have no business sending replies; ignore
+
+   auto error = [&](std::string_view errmsg)
+   {
+      return sendMsg( conn, hdr.cmd, SP_FLAG_REPLY | SP_FLAG_ERROR,
+                      std::as_bytes(std::span{ errmsg.data(), errmsg.size() }) );
+   };
+
+   switch ( hdr.cmd )
+   {
+      case UCMD_MARCO:
+      {
+         if ( payload.size() != SP_MARCO_PAYLOAD_SZ )
+            co_return co_await error("marco: malformed payload");
+
+         // seq and client_tx_ns are echoed as-is
+         std::array<std::byte, SP_POLO_PAYLOAD_SZ> polo;
+         std::memcpy(polo.data(), payload.data(), SP_MARCO_PAYLOAD_SZ);
+         putBE(polo.data() + 16, rx_ns, 8);
+         putBE(polo.data() + 24, monotonicNs(), 8);
+         co_return co_await sendMsg(conn, UCMD_MARCO, SP_FLAG_REPLY, polo);
+      }
+
+      case UCMD_INET_PTON:
+      {
+         char addrstr[INET6_ADDRSTRLEN];
+         std::array<std::byte, sizeof(in6_addr)> addr;
+         if ( !payload.empty() && payload.size() < sizeof addrstr )
+         {
+            std::memcpy(addrstr, payload.data(), payload.size());
+            addrstr[payload.size()] = '\0';
+            if ( 1 == inet_pton(AF_INET, addrstr, addr.data()) )
+               co_return co_await sendMsg( conn, UCMD_INET_PTON, SP_FLAG_REPLY,
+                                           std::span{ addr }.first(sizeof(in_addr)) );
+            if ( 1 == inet_pton(AF_INET6, addrstr, addr.data()) )
+               co_return co_await sendMsg(conn, UCMD_INET_PTON, SP_FLAG_REPLY, addr);
+         }
+         co_return co_await error("inet-pton: not an IPv4 or IPv6 address");
+      }
+
+      default:
+         co_return co_await error("command not supported by this server");
+   }
+}
+
+/**
+ * @brief Frame and send an SP message in full
+ */
+static Task<bool> sendMsg( Conn & conn,
+                           std::uint8_t cmd,
+                           std::uint8_t flags,
+                           std::span<const std::byte> payload )
+{
+   std::array<std::byte, SP_MAX_MSG_SZ> msg;
+   putBE(msg.data(), SP_MAGIC, 2);
+   msg[2] = static_cast<std::byte>(cmd);
+   msg[3] = static_cast<std::byte>(flags);
+   putBE(msg.data() + 4, payload.size(), 4);
+   std::memcpy(msg.data() + SP_HDR_SZ, payload.data(), payload.size());
+
+   IoResult wr = co_await conn.write(std::span{ msg }.first(SP_HDR_SZ + payload.size()));
+   co_return static_cast<bool>(wr);
+}
+
+/**
+ * @brief Every REPORT_INTERVAL, print the counters if they've changed
+ */
+static Task<> reportCounters(const Counters & counters)
+{
+   Counters last{};
+   for ( ;; )
+   {
+      co_await sleepFor(REPORT_INTERVAL);
+      if ( counters == last )
+         continue;
+      last = counters;
+      const FramePool::Stats & pool = FramePool::local().stats();
+      std::printf( "conns %" PRIu64 " (%" PRIu64 " active), requests %" PRIu64
+                   ", errors %" PRIu64 ", idle hang-ups %" PRIu64
+                   ", frames %" PRIu64 " (%" PRIu64 " reused)\n",
+                   counters.nconns, counters.nactive, counters.nrequests,
+                   counters.nerrors, counters.nidle, pool.nallocs, pool.nreused );
+      std::fflush(stdout);
+   }
+}
+
+static void handleSIGINT(int sig_num)
+{
+   (void)sig_num;
+   gReactor->stop();
+}
+
+static std::uint64_t monotonicNs()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000u
+          + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+static void putBE(std::byte * buf, std::uint64_t val, std::size_t nbytes)
+{
+   for ( std::size_t i = 0; i < nbytes; ++i )
+      buf[i] = static_cast<std::byte>(val >> (8 * (nbytes - 1 - i)));
+}
+
+static std::uint64_t getBE(const std::byte * buf, std::size_t nbytes)
+{
+   std::uint64_t val = 0;
+   for ( std::size_t i = 0; i < nbytes; ++i )
+      val = (val << 8) | static_cast<std::uint8_t>(buf[i]);
+   return val;
+}
@@ -0,0 +1,808 @@
+/**
+ * @file sp-coro.hpp
+ * @brief C++20 coroutines on a single-threaded, poll()-based reactor, for
+ *        writing connection handlers as straight-line code
+ *
+ * A handler is a coroutine returning Task<>; every socket operation it
+ * co_awaits is non-blocking underneath:
+ *
+ *    Task<> echo(Conn conn)
+ *    {
+ *       std::array<std::byte, 1024> buf;
+ *       for ( ;; )
+ *       {
+ *          IoResult rd = co_await conn.read(buf, std::chrono::seconds{30});
+ *          if ( !rd || 0 == rd.nbytes )
+ *             co_return; // error, idle timeout, or the peer hung up
+ *          if ( !co_await conn.write(std::span{buf}.first(rd.nbytes)) )
+ *             co_return;
+ *       }
+ *    }
+ *
+ * Each operation first just tries the syscall. Only if it would block does
+ * the coroutine suspend, parking its fd (and/or deadline) /w the reactor,
+ * which retries the operation itself once poll() says it can go ahead and
+ * only resumes the coroutine when it's done. So a coroutine never sees
+ * EAGAIN, and costs nothing but its frame while it waits: one thread serves
+ * as many connections as it has fds, like the demo server's event-loop
+ * workers, /wo callbacks.
+ *
+ * Frames come from a per-thread pool of size-classed blocks (FramePool), so
+ * a connection coming and going doesn't go through malloc() in the steady
+ * state.
+ *
+ * @note Everything here belongs to the thread running the reactor: spawn,
+ *       await and resume coroutines from that thread only. Errors are
+ *       returned (as errno values), never thrown.
+ */
+#ifndef SP_CORO_HPP
+#define SP_CORO_HPP
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <map>
+#include <new>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace netsp::coro
+{
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Per-thread free lists of coroutine frame blocks, in power-of-two
+ *        size classes
+ *
+ * Handlers' frames are all about the same size, and a server creates and
+ * destroys one per connection, so recycling blocks by size class turns
+ * nearly every frame allocation into a free-list pop. Frames bigger than the
+ * largest class go straight to operator new.
+ */
+class FramePool
+{
+public:
+   static constexpr std::size_t MIN_BLOCK_SZ = 64;
+   static constexpr std::size_t NCLASSES = 8; // 64 B .. 8 KiB
+   // Kept per class, beyond which freed blocks go back to the heap, so one
+   // burst of connections doesn't pin its peak memory forever
+   static constexpr std::size_t MAX_CACHED = 1'024;
+
+   struct Stats
+   {
+      std::uint64_t nallocs;
+      std::uint64_t nreused; // ... of which came off a free list
+      std::uint64_t nlarge;  // ... of which were too big to pool
+   };
+
+   FramePool() = default;
+   FramePool(const FramePool &) = delete;
+   FramePool & operator=(const FramePool &) = delete;
+
+   ~FramePool()
+   {
+      for ( FreeBlock * & head : free_ )
+      {
+         while ( head != nullptr )
+         {
+            FreeBlock * next = head->next;
+            ::operator delete(head);
+            head = next;
+         }
+      }
+   }
+
+   [[nodiscard]] static FramePool & local()
+   {
+      static thread_local FramePool pool;
+      return pool;
+   }
+
+   [[nodiscard]] void * allocate(std::size_t sz)
+   {
+      stats_.nallocs++;
+      std::size_t cls = sizeClass(sz);
+      if ( cls >= NCLASSES )
+      {
+         stats_.nlarge++;
+         return ::operator new(sz);
+      }
+      if ( FreeBlock * block = free_[cls] )
+      {
+         free_[cls] = block->next;
+         ncached_[cls]--;
+         stats_.nreused++;
+         return block;
+      }
+      return ::operator new(MIN_BLOCK_SZ << cls);
+   }
+
+   void deallocate(void * ptr, std::size_t sz) noexcept
+   {
+      std::size_t cls = sizeClass(sz);
+      if ( cls >= NCLASSES || ncached_[cls] >= MAX_CACHED )
+      {
+         ::operator delete(ptr);
+         return;
+      }
+      free_[cls] = ::new (ptr) FreeBlock{ free_[cls] };
+      ncached_[cls]++;
+   }
+
+   [[nodiscard]] const Stats & stats() const { return stats_; }
+
+private:
+   struct FreeBlock
+   {
+      FreeBlock * next;
+   };
+
+   [[nodiscard]] static std::size_t sizeClass(std::size_t sz)
+   {
+      std::size_t cls = 0;
+      while ( cls < NCLASSES && (MIN_BLOCK_SZ << cls) < sz )
+         ++cls;
+      return cls;
+   }
+
+   std::array<FreeBlock *, NCLASSES> free_{};
+   std::array<std::size_t, NCLASSES> ncached_{};
+   Stats stats_{};
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail
+{
+
+// What every Task's promise has in common: a pooled frame, a lazy start,
+// and handing control back to whoever's awaiting it (if anyone) at the end
+struct PromiseBase
+{
+   std::coroutine_handle<> continuation;
+   bool detached = false; // spawned: nobody awaits it, so it frees itself
+   // Spawned coroutines still running, so Reactor::cancelAll() can find them
+   std::coroutine_handle<> self;
+   PromiseBase * prev_spawned = nullptr;
+   PromiseBase * next_spawned = nullptr;
+
+   [[nodiscard]] static PromiseBase * & spawnedHead()
+   {
+      static thread_local PromiseBase * head = nullptr;
+      return head;
+   }
+
+   void linkSpawned(std::coroutine_handle<> handle)
+   {
+      detached = true;
+      self = handle;
+      next_spawned = spawnedHead();
+      if ( next_spawned != nullptr )
+         next_spawned->prev_spawned = this;
+      spawnedHead() = this;
+   }
+
+   void unlinkSpawned() noexcept
+   {
+      if ( prev_spawned != nullptr )
+         prev_spawned->next_spawned = next_spawned;
+      else
+         spawnedHead() = next_spawned;
+      if ( next_spawned != nullptr )
+         next_spawned->prev_spawned = prev_spawned;
+      prev_spawned = next_spawned = nullptr;
+   }
+
+   static void * operator new(std::size_t sz) { return FramePool::local().allocate(sz); }
+   static void operator delete(void * ptr, std::size_t sz) noexcept
+   {
+      FramePool::local().deallocate(ptr, sz);
+   }
+
+   std::suspend_always initial_suspend() noexcept { return {}; }
+
+   struct FinalAwaiter
+   {
+      bool await_ready() noexcept { return false; }
+
+      template <typename Promise>
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> self) noexcept
+      {
+         PromiseBase & promise = self.promise();
+         if ( promise.continuation )
+            return promise.continuation; // symmetric transfer: no stack growth
+         if ( promise.detached )
+         {
+            promise.unlinkSpawned();
+            self.destroy();
+         }
+         return std::noop_coroutine();
+      }
+
+      void await_resume() noexcept {}
+   };
+
+   FinalAwaiter final_suspend() noexcept { return {}; }
+
+   // Handlers report errors by value; an escaped exception is a bug
+   void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase
+{
+   std::optional<T> value;
+
+   Task<T> get_return_object();
+   template <typename U>
+   void return_value(U && val) { value.emplace(std::forward<U>(val)); }
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+   Task<void> get_return_object();
+   void return_void() noexcept {}
+};
+
+} // namespace detail
+
+/**
+ * @brief A lazily started coroutine. co_await it to run it and get its
+ *        result, or hand a Task<> to Reactor::spawn() to run it on its own.
+ */
+template <typename T>
+class [[nodiscard]] Task
+{
+public:
+   using promise_type = detail::Promise<T>;
+
+   Task() = default;
+   explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+   Task(Task && other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+   Task & operator=(Task && other) noexcept
+   {
+      if ( this != &other )
+      {
+         if ( handle_ )
+            handle_.destroy();
+         handle_ = std::exchange(other.handle_, {});
+      }
+      return *this;
+   }
+   ~Task()
+   {
+      if ( handle_ )
+         handle_.destroy();
+   }
+
+   auto operator co_await() && noexcept
+   {
+      struct Awaiter
+      {
+         std::coroutine_handle<promise_type> handle;
+
+         bool await_ready() noexcept { return !handle || handle.done(); }
+         std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+         {
+            handle.promise().continuation = awaiting;
+            return handle;
+         }
+         T await_resume()
+         {
+            if constexpr ( !std::is_void_v<T> )
+               return std::move(*handle.promise().value);
+         }
+      };
+      return Awaiter{ handle_ };
+   }
+
+   // For Reactor::spawn(): the frame's on its own from here
+   [[nodiscard]] std::coroutine_handle<promise_type> release() noexcept
+   {
+      return std::exchange(handle_, {});
+   }
+
+private:
+   std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+Task<T> detail::Promise<T>::get_return_object()
+{
+   return Task<T>{ std::coroutine_handle<Promise<T>>::from_promise(*this) };
+}
+
+inline Task<void> detail::Promise<void>::get_return_object()
+{
+   return Task<void>{ std::coroutine_handle<Promise<void>>::from_promise(*this) };
+}
+
+class Reactor;
+
+/**
+ * @brief An operation parked /w the reactor: waiting on an fd, a deadline,
+ *        or both, whichever comes first
+ *
+ * Lives in the suspended coroutine's frame (it's the awaiter), so parking
+ * one allocates nothing beyond the reactor's own bookkeeping.
+ */
+struct Waiter
+{
+   static constexpr std::size_t NO_SLOT = SIZE_MAX;
+
+   std::coroutine_handle<> handle;
+   int fd = -1;
+   short events = 0;
+   std::size_t slot = NO_SLOT; // index in the reactor's poll set
+   std::optional<std::multimap<Clock::time_point, Waiter *>::iterator> timer;
+   bool timed_out = false;
+
+   Waiter() = default;
+   Waiter(const Waiter &) = delete;
+   Waiter & operator=(const Waiter &) = delete;
+
+   /**
+    * @brief Attempt the operation now that poll() says the fd's ready
+    * @return false if it would still block, to keep waiting
+    */
+   virtual bool tryComplete() { return true; }
+
+protected:
+   ~Waiter() = default;
+};
+
+/**
+ * @brief The event loop: a poll set of parked fds, a timer queue, and the
+ *        coroutines waiting on them. One per thread (see current()).
+ */
+class Reactor
+{
+public:
+   Reactor()
+   {
+      // [0] is the wake-up pipe, for stop() from a signal handler
+      int retcode = pipe(wake_pipe_);
+      if ( 0 == retcode )
+      {
+         fcntl(wake_pipe_[0], F_SETFL, O_NONBLOCK);
+         fcntl(wake_pipe_[1], F_SETFL, O_NONBLOCK);
+         pfds_.push_back(pollfd{ .fd = wake_pipe_[0], .events = POLLIN, .revents = 0 });
+      }
+      else
+      {
+         wake_pipe_[0] = wake_pipe_[1] = -1;
+         pfds_.push_back(pollfd{ .fd = -1, .events = 0, .revents = 0 });
+      }
+      waiters_.push_back(nullptr);
+   }
+
+   Reactor(const Reactor &) = delete;
+   Reactor & operator=(const Reactor &) = delete;
+
+   ~Reactor()
+   {
+      if ( wake_pipe_[0] >= 0 )
+      {
+         close(wake_pipe_[0]);
+         close(wake_pipe_[1]);
+      }
+   }
+
+   [[nodiscard]] static Reactor & current()
+   {
+      static thread_local Reactor reactor;
+      return reactor;
+   }
+
+   /**
+    * @brief Start task right away, running it until it first suspends. It
+    *        frees itself when it finishes.
+    */
+   void spawn(Task<void> task)
+   {
+      std::coroutine_handle<detail::Promise<void>> handle = task.release();
+      if ( !handle )
+         return;
+      handle.promise().linkSpawned(handle);
+      handle.resume();
+   }
+
+   /**
+    * @brief Destroy every spawned coroutine that hasn't finished, along /w
+    *        whatever it was awaiting, e.g. once run() returns after stop()
+    *
+    * @note Call it while this thread's FramePool is still around (i.e. not
+    *       from a thread_local destructor), since the frames go back to it.
+    */
+   void cancelAll()
+   {
+      pfds_.resize(1);
+      waiters_.resize(1);
+      timers_.clear();
+      while ( detail::PromiseBase * spawned = detail::PromiseBase::spawnedHead() )
+      {
+         spawned->unlinkSpawned();
+         spawned->self.destroy();
+      }
+   }
+
+   /**
+    * @brief Serve parked coroutines until stop(), or until there's nothing
+    *        left that could ever wake one up
+    * @return false if poll() failed
+    */
+   bool run()
+   {
+      stopping_ = false;
+      std::vector<Waiter *> ready;
+      while ( !stopping_ && (pfds_.size() > 1 || !timers_.empty()) )
+      {
+         int timeout_ms = -1;
+         if ( !timers_.empty() )
+         {
+            auto until = timers_.begin()->first - Clock::now();
+            // Round up, so we don't wake a hair early and spin
+            timeout_ms = static_cast<int>(std::max<std::int64_t>(
+               0, std::chrono::ceil<std::chrono::milliseconds>(until).count() ));
+         }
+
+         int nready = poll(pfds_.data(), pfds_.size(), timeout_ms);
+         if ( nready < 0 )
+         {
+            if ( EINTR == errno )
+               continue;
+            return false;
+         }
+
+         // Collect everything that's done before resuming anyone, since
+         // resumed coroutines park and unpark, reshuffling the poll set
+         ready.clear();
+         if ( pfds_[0].revents != 0 )
+         {
+            char drain[64];
+            while ( read(wake_pipe_[0], drain, sizeof drain) > 0 );
+         }
+         for ( std::size_t i = pfds_.size(); i-- > 1; )
+         {
+            if ( 0 == pfds_[i].revents )
+               continue;
+            Waiter * waiter = waiters_[i];
+            if ( !waiter->tryComplete() )
+               continue; // spurious wake-up; keep waiting
+            unpark(*waiter);
+            ready.push_back(waiter);
+         }
+         for ( Clock::time_point now = Clock::now();
+               !timers_.empty() && timers_.begin()->first <= now; )
+         {
+            Waiter * waiter = timers_.begin()->second;
+            waiter->timed_out = true;
+            unpark(*waiter);
+            ready.push_back(waiter);
+         }
+
+         for ( Waiter * waiter : ready )
+            waiter->handle.resume();
+      }
+      return true;
+   }
+
+   /**
+    * @brief Have run() return at its next wake-up. Async-signal-safe.
+    */
+   void stop() noexcept
+   {
+      stopping_ = true;
+      if ( wake_pipe_[1] >= 0 )
+      {
+         ssize_t rc = write(wake_pipe_[1], "", 1);
+         (void)rc;
+      }
+   }
+
+   [[nodiscard]] std::size_t nparked() const { return pfds_.size() - 1 + timers_.size(); }
+
+   /**
+    * @brief Park waiter on its fd (if it has one) and on deadline (if given)
+    */
+   void park(Waiter & waiter, std::optional<Clock::time_point> deadline)
+   {
+      if ( waiter.fd >= 0 )
+      {
+         waiter.slot = pfds_.size();
+         pfds_.push_back(pollfd{ .fd = waiter.fd, .events = waiter.events, .revents = 0 });
+         waiters_.push_back(&waiter);
+      }
+      if ( deadline )
+         waiter.timer = timers_.emplace(*deadline, &waiter);
+   }
+
+   /**
+    * @brief Take waiter out of the poll set and the timer queue
+    */
+   void unpark(Waiter & waiter)
+   {
+      if ( waiter.slot != Waiter::NO_SLOT )
+      {
+         // Fill the hole /w the last entry
+         std::size_t last = pfds_.size() - 1;
+         pfds_[waiter.slot] = pfds_[last];
+         waiters_[waiter.slot] = waiters_[last];
+         waiters_[waiter.slot]->slot = waiter.slot;
+         pfds_.pop_back();
+         waiters_.pop_back();
+         waiter.slot = Waiter::NO_SLOT;
+      }
+      if ( waiter.timer )
+      {
+         timers_.erase(*waiter.timer);
+         waiter.timer.reset();
+      }
+   }
+
+private:
+   std::vector<pollfd> pfds_;
+   std::vector<Waiter *> waiters_; // waiters_[i] is parked on pfds_[i]
+   std::multimap<Clock::time_point, Waiter *> timers_;
+   int wake_pipe_[2];
+   volatile sig_atomic_t stopping_ = false;
+};
+
+/**
+ * @brief Outcome of a read or write. For a read, nbytes == 0 /w no error
+ *        means the peer hung up.
+ */
+struct IoResult
+{
+   std::size_t nbytes;
+   int error; // errno value, ETIMEDOUT if the deadline passed first; 0 if fine
+
+   explicit operator bool() const { return 0 == error; }
+};
+
+/**
+ * @brief Suspend for (at least) duration
+ */
+inline auto sleepFor(Clock::duration duration)
+{
+   struct SleepAwaiter final : Waiter
+   {
+      Clock::time_point deadline;
+
+      explicit SleepAwaiter(Clock::time_point when) : deadline(when) {}
+
+      bool await_ready() const noexcept { return deadline <= Clock::now(); }
+      void await_suspend(std::coroutine_handle<> awaiting)
+      {
+         handle = awaiting;
+         Reactor::current().park(*this, deadline);
+      }
+      void await_resume() noexcept {}
+   };
+
+   // Returned as a prvalue, so it's built right in the awaiting frame
+   return SleepAwaiter{ Clock::now() + duration };
+}
+
+/**
+ * @brief A connected stream socket, owned: closed when the Conn goes away
+ */
+class Conn
+{
+public:
+   Conn() = default;
+   // Takes ownership of fd, and makes it non-blocking
+   explicit Conn(int fd) : fd_(fd)
+   {
+      if ( fd_ >= 0 )
+         fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+   }
+   Conn(Conn && other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+   Conn & operator=(Conn && other) noexcept
+   {
+      if ( this != &other )
+      {
+         if ( fd_ >= 0 )
+            close(fd_);
+         fd_ = std::exchange(other.fd_, -1);
+      }
+      return *this;
+   }
+   ~Conn()
+   {
+      if ( fd_ >= 0 )
+         close(fd_);
+   }
+
+   [[nodiscard]] int fd() const { return fd_; }
+   [[nodiscard]] bool valid() const { return fd_ >= 0; }
+
+   /**
+    * @brief Read whatever's there, up to buf.size() bytes, waiting for at
+    *        least one byte (or the peer hanging up) if need be
+    */
+   [[nodiscard]] auto read(std::span<std::byte> buf,
+                           std::optional<Clock::duration> timeout = std::nullopt)
+   {
+      struct ReadAwaiter final : Waiter
+      {
+         std::span<std::byte> buf;
+         std::optional<Clock::duration> timeout;
+         IoResult result{};
+
+         ReadAwaiter(int sfd, std::span<std::byte> dst, std::optional<Clock::duration> limit)
+            : buf(dst), timeout(limit)
+         {
+            fd = sfd;
+            events = POLLIN;
+         }
+
+         bool tryComplete() override
+         {
+            ssize_t nbytes = recv(fd, buf.data(), buf.size(), MSG_DONTWAIT);
+            if ( nbytes < 0 && (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) )
+               return false;
+            result = (nbytes < 0) ? IoResult{ 0, errno } : IoResult{ static_cast<std::size_t>(nbytes), 0 };
+            return true;
+         }
+         bool await_ready() { return tryComplete(); }
+         void await_suspend(std::coroutine_handle<> awaiting)
+         {
+            handle = awaiting;
+            Reactor::current().park( *this, timeout ? std::optional{ Clock::now() + *timeout }
+                                                    : std::nullopt );
+         }
+         IoResult await_resume() const
+         {
+            return timed_out ? IoResult{ 0, ETIMEDOUT } : result;
+         }
+      };
+
+      return ReadAwaiter{ fd_, buf, timeout };
+   }
+
+   /**
+    * @brief Write all of buf, waiting for room in the socket's send buffer as
+    *        many times as it takes
+    * @note On a timeout or error, nbytes is how much did get written.
+    */
+   [[nodiscard]] auto write(std::span<const std::byte> buf,
+                            std::optional<Clock::duration> timeout = std::nullopt)
+   {
+      struct WriteAwaiter final : Waiter
+      {
+         std::span<const std::byte> buf;
+         std::optional<Clock::duration> timeout;
+         IoResult result{};
+
+         WriteAwaiter(int sfd, std::span<const std::byte> src, std::optional<Clock::duration> limit)
+            : buf(src), timeout(limit)
+         {
+            fd = sfd;
+            events = POLLOUT;
+         }
+
+         bool tryComplete() override
+         {
+            while ( result.nbytes < buf.size() )
+            {
+               ssize_t nbytes = send( fd, buf.data() + result.nbytes, buf.size() - result.nbytes,
+                                      MSG_DONTWAIT | MSG_NOSIGNAL );
+               if ( nbytes < 0 )
+               {
+                  if ( EINTR == errno )
+                     continue;
+                  if ( EAGAIN == errno || EWOULDBLOCK == errno )
+                     return false;
+                  result.error = errno;
+                  return true;
+               }
+               result.nbytes += static_cast<std::size_t>(nbytes);
+            }
+            return true;
+         }
+         bool await_ready() { return tryComplete(); }
+         void await_suspend(std::coroutine_handle<> awaiting)
+         {
+            handle = awaiting;
+            Reactor::current().park( *this, timeout ? std::optional{ Clock::now() + *timeout }
+                                                    : std::nullopt );
+         }
+         IoResult await_resume() const
+         {
+            return timed_out ? IoResult{ result.nbytes, ETIMEDOUT } : result;
+         }
+      };
+
+      return WriteAwaiter{ fd_, buf, timeout };
+   }
+
+private:
+   int fd_ = -1;
+};
+
+/**
+ * @brief A listening stream socket, owned
+ */
+class Listener
+{
+public:
+   struct Accepted
+   {
+      Conn conn; // invalid on error
+      sockaddr_in peer;
+      int error; // errno value, 0 if fine
+   };
+
+   // Takes ownership of an already listen()ing fd, and makes it non-blocking
+   explicit Listener(int fd) : conn_(fd) {}
+
+   [[nodiscard]] int fd() const { return conn_.fd(); }
+
+   /**
+    * @brief Wait for the next connection
+    */
+   [[nodiscard]] auto accept()
+   {
+      struct AcceptAwaiter final : Waiter
+      {
+         Accepted result{};
+
+         explicit AcceptAwaiter(int listen_fd)
+         {
+            fd = listen_fd;
+            events = POLLIN;
+         }
+
+         bool tryComplete() override
+         {
+            socklen_t peer_len = sizeof result.peer;
+            int conn_fd = ::accept(fd, reinterpret_cast<sockaddr *>(&result.peer), &peer_len);
+            if ( conn_fd < 0 )
+            {
+               if ( EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno
+                    || ECONNABORTED == errno )
+                  return false;
+               result.error = errno;
+               return true;
+            }
+            result.conn = Conn{ conn_fd };
+            return true;
+         }
+         bool await_ready() { return tryComplete(); }
+         void await_suspend(std::coroutine_handle<> awaiting)
+         {
+            handle = awaiting;
+            Reactor::current().park(*this, std::nullopt);
+         }
+         Accepted await_resume() { return std::move(result); }
+      };
+
+      return AcceptAwaiter{ conn_.fd() };
+   }
+
+private:
+   Conn conn_; // same ownership and non-blocking setup, just never read
+};
+
+} // namespace netsp::coro
+
+#endif // SP_CORO_HPP
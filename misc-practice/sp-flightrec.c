@@ -0,0 +1,253 @@
+/**
+ * @brief Decoder for the demo server's flight recorder dumps (see sp-flightrec.h)
+ *
+ * Merges every thread's ring into one timeline, oldest event first, and
+ * prints each event relative to the moment of the dump, so the last lines
+ * are what the server was doing right before it crashed.
+ *
+ * Usage: sp-flightrec <netsp-flightrec-PID.bin> [last-n-events]
+ */
+
+// General-Purpose System Headers
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+// Socket Practice (SP) Protocol and flight recorder format
+#include "sp-proto.h"
+#include "sp-flightrec.h"
+
+/* Constant and Type Definitions */
+constexpr uint32_t MAX_RINGS = 4'096;
+constexpr uint32_t MAX_RING_NEVENTS = 1u << 24;
+
+// An event, plus which ring it came from
+struct TimelineEvent
+{
+   struct FrEvent ev;
+   uint32_t ring;
+};
+
+struct FrEventDesc
+{
+   const char * name;
+   const char * a_desc;
+   const char * b_desc;
+};
+
+#define SP_FR_EVENT(ev_enum, ev_name, ev_a, ev_b) \
+   [ev_enum] = { .name = ev_name, .a_desc = ev_a, .b_desc = ev_b },
+static const struct FrEventDesc EventDescs[FR_NEVENT_TYPES] = { SP_FR_EVENTS(SP_FR_EVENT) };
+#undef SP_FR_EVENT
+
+#define SP_CMD(cmd_enum, cmd_str, cmd_char, cmd_args) cmd_str,
+static const char * const CmdNames[] =
+{
+#  include "sp-cmds.h"
+};
+#undef SP_CMD
+
+/* Function Declarations */
+static int cmpTimelineEvents(const void * lhs, const void * rhs);
+static void printEvent( const struct TimelineEvent * tev,
+                        const char (*ring_names)[FR_THREAD_NAME_SZ],
+                        uint64_t dump_mono_ns );
+static void printField(const char * desc, uint64_t val);
+
+/* Main Function */
+int main(int argc, char * argv[])
+{
+   if ( argc < 2 || argc > 3 )
+   {
+      fprintf(stderr, "Usage: %s <netsp-flightrec-PID.bin> [last-n-events]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   size_t last_n = SIZE_MAX;
+   if ( 3 == argc )
+   {
+      char * end_ptr = nullptr;
+      last_n = strtoul(argv[2], &end_ptr, 10);
+      if ( *end_ptr != '\0' || 0 == last_n )
+      {
+         fprintf(stderr, "Error: Invalid event count: %s\n", argv[2]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   FILE * dump = fopen(argv[1], "rb");
+   if ( nullptr == dump )
+   {
+      fprintf(stderr, "Error: Can't open %s: %s (%d)\n", argv[1], strerror(errno), errno);
+      return EXIT_FAILURE;
+   }
+
+   struct FrFileHdr file_hdr;
+   if ( fread(&file_hdr, sizeof file_hdr, 1, dump) != 1
+        || file_hdr.magic != FR_MAGIC || file_hdr.version != FR_VERSION )
+   {
+      fprintf(stderr, "Error: %s isn't a flight recording this decoder understands.\n", argv[1]);
+      fclose(dump);
+      return EXIT_FAILURE;
+   }
+   if ( file_hdr.nrings > MAX_RINGS || 0 == file_hdr.ring_nevents
+        || file_hdr.ring_nevents > MAX_RING_NEVENTS )
+   {
+      fprintf( stderr, "Error: %s has an implausible header (%" PRIu32 " rings of %" PRIu32
+                       " events).\n",
+               argv[1], file_hdr.nrings, file_hdr.ring_nevents );
+      fclose(dump);
+      return EXIT_FAILURE;
+   }
+
+   char (*ring_names)[FR_THREAD_NAME_SZ] = calloc(file_hdr.nrings + 1, sizeof *ring_names);
+   struct FrEvent * ring_events = calloc(file_hdr.ring_nevents, sizeof *ring_events);
+   struct TimelineEvent * timeline = calloc( (size_t)file_hdr.nrings * file_hdr.ring_nevents + 1,
+                                             sizeof *timeline );
+   if ( nullptr == ring_names || nullptr == ring_events || nullptr == timeline )
+   {
+      fprintf(stderr, "Error: Out of memory.\n");
+      free(ring_names);
+      free(ring_events);
+      free(timeline);
+      fclose(dump);
+      return EXIT_FAILURE;
+   }
+
+   // Pull each ring's valid events out, oldest first
+   size_t nevents = 0;
+   uint64_t nlost = 0; // overwritten before the dump
+   uint32_t nrings = 0;
+   for ( ; nrings < file_hdr.nrings; ++nrings )
+   {
+      struct FrRingHdr ring_hdr;
+      if ( fread(&ring_hdr, sizeof ring_hdr, 1, dump) != 1
+           || fread(ring_events, sizeof *ring_events, file_hdr.ring_nevents, dump)
+              != file_hdr.ring_nevents )
+      {
+         fprintf( stderr, "Warning: %s is truncated after %" PRIu32 " of %" PRIu32 " rings.\n",
+                  argv[1], nrings, file_hdr.nrings );
+         break;
+      }
+      memcpy(ring_names[nrings], ring_hdr.name, sizeof ring_names[nrings]);
+      ring_names[nrings][FR_THREAD_NAME_SZ - 1] = '\0';
+
+      uint64_t nvalid = ring_hdr.head < file_hdr.ring_nevents ? ring_hdr.head
+                                                              : file_hdr.ring_nevents;
+      nlost += ring_hdr.head - nvalid;
+      for ( uint64_t i = ring_hdr.head - nvalid; i < ring_hdr.head; ++i )
+      {
+         timeline[nevents++] = (struct TimelineEvent){
+            .ev = ring_events[i % file_hdr.ring_nevents],
+            .ring = nrings
+         };
+      }
+   }
+   fclose(dump);
+
+   // Merge the rings by timestamp (ties stay in ring order)
+   qsort(timeline, nevents, sizeof *timeline, cmpTimelineEvents);
+
+   time_t dump_sec = (time_t)(file_hdr.dump_real_ns / 1'000'000'000u);
+   char datestr[64] = "?";
+   struct tm dump_tm;
+   if ( localtime_r(&dump_sec, &dump_tm) != nullptr )
+      strftime(datestr, sizeof datestr, "%F %T %z", &dump_tm);
+   printf("Dumped at %s, ", datestr);
+   if ( file_hdr.signo != 0 )
+      printf("on signal %" PRId32 " (%s)\n", file_hdr.signo, strsignal(file_hdr.signo));
+   else
+      printf("on request\n");
+   printf( "%" PRIu32 " thread(s), %zu event(s) kept, %" PRIu64 " older one(s) overwritten\n\n",
+           nrings, nevents, nlost );
+
+   printf("%14s  %-20s %-14s %s\n", "t-dump (ms)", "thread", "event", "fields");
+   size_t first = (last_n < nevents) ? nevents - last_n : 0;
+   for ( size_t i = first; i < nevents; ++i )
+      printEvent(&timeline[i], ring_names, file_hdr.dump_mono_ns);
+
+   free(ring_names);
+   free(ring_events);
+   free(timeline);
+   return EXIT_SUCCESS;
+}
+
+/* Function Implementations */
+
+static int cmpTimelineEvents(const void * lhs, const void * rhs)
+{
+   const struct TimelineEvent * l = lhs;
+   const struct TimelineEvent * r = rhs;
+   if ( l->ev.ts_ns != r->ev.ts_ns )
+      return (l->ev.ts_ns < r->ev.ts_ns) ? -1 : 1;
+   return (l->ring > r->ring) - (l->ring < r->ring);
+}
+
+/**
+ * @brief Print one event on one line, timestamped in ms before the dump
+ */
+static void printEvent( const struct TimelineEvent * tev,
+                        const char (*ring_names)[FR_THREAD_NAME_SZ],
+                        uint64_t dump_mono_ns )
+{
+   const struct FrEvent * ev = &tev->ev;
+   double rel_ms = ((double)ev->ts_ns - (double)dump_mono_ns) / 1e6;
+   printf("%14.3f  %-20s ", rel_ms, ring_names[tev->ring]);
+
+   if ( ev->type >= FR_NEVENT_TYPES )
+   {
+      // Most likely a slot caught mid-write by the dump
+      printf( "%-14s type=%" PRIu16 " aux=%" PRIu16 " a=%" PRId32 " b=%" PRIu64 "\n",
+              "(garbled)", ev->type, ev->aux, ev->a, ev->b );
+      return;
+   }
+
+   const struct FrEventDesc * desc = &EventDescs[ev->type];
+   printf("%-14s", desc->name);
+   if ( FR_DISPATCH == ev->type || FR_DISPATCH_FAIL == ev->type )
+   {
+      printf( " cmd=%s", (ev->aux < sizeof CmdNames / sizeof CmdNames[0])
+                         ? CmdNames[ev->aux] : "(unknown)" );
+   }
+   printField(desc->a_desc, (uint64_t)(int64_t)ev->a);
+   printField(desc->b_desc, ev->b);
+   printf("\n");
+}
+
+/**
+ * @brief Print one of an event's fields, formatted according to what it holds
+ */
+static void printField(const char * desc, uint64_t val)
+{
+   if ( '\0' == desc[0] )
+      return;
+
+   if ( strcmp(desc, "peer") == 0 )
+   {
+      char addrstr[INET_ADDRSTRLEN] = "?";
+      struct in_addr addr = { .s_addr = (uint32_t)(val >> 32) };
+      inet_ntop(AF_INET, &addr, addrstr, sizeof addrstr);
+      printf(" peer=%s:%u", addrstr, ntohs((uint16_t)val));
+   }
+   else if ( strcmp(desc, "errno") == 0 || strcmp(desc, "error") == 0 )
+   {
+      printf(" %s=%s (%d)", desc, strerror((int)val), (int)val);
+   }
+   else if ( strcmp(desc, "magic_len") == 0 )
+   {
+      printf( " magic=0x%04" PRIx32 " len=%" PRIu32,
+              (uint32_t)(val >> 32), (uint32_t)val );
+   }
+   else if ( strcmp(desc, "fd") == 0 )
+   {
+      printf(" fd=%" PRId32, (int32_t)val);
+   }
+   else
+   {
+      printf(" %s=%" PRIu64, desc, val);
+   }
+}
@@ -0,0 +1,85 @@
+/**
+ * @file sp-flightrec.h
+ * @brief Binary format of the demo server's flight recorder dumps, shared by
+ *        the server and the offline decoder (sp-flightrec)
+ *
+ * Every server thread records what it does into its own fixed-size ring of
+ * events, overwriting the oldest once it wraps. When the server crashes
+ * (SIGSEGV, SIGABRT, ...) or is asked to /w the flightrec command, it writes
+ * all of the rings out to netsp-flightrec-<pid>.bin:
+ *
+ *    struct FrFileHdr
+ *    nrings * { struct FrRingHdr, ring_nevents * struct FrEvent }
+ *
+ * A ring's events are in ring order: the newest is at (head - 1) % ring_nevents,
+ * and there are min(head, ring_nevents) valid ones. Everything is in the
+ * recording host's byte order.
+ */
+#ifndef SP_FLIGHTREC_H
+#define SP_FLIGHTREC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// What each event's fields mean. "peer" is the IPv4 address in the upper 32
+// bits and the port in the lower 16, both in network byte order.
+//                  Enum                 Name              a        b
+#define SP_FR_EVENTS(SP_FR_EVENT) \
+        SP_FR_EVENT( FR_THREAD_START,    "thread_start",   "",      "" ) \
+        SP_FR_EVENT( FR_THREAD_EXIT,     "thread_exit",    "",      "iterations" ) \
+        SP_FR_EVENT( FR_ACCEPT,          "accept",         "fd",    "peer" ) \
+        SP_FR_EVENT( FR_ACCEPT_ERROR,    "accept_error",   "errno", "" ) \
+        SP_FR_EVENT( FR_ACCEPT_REJECT,   "accept_reject",  "fd",    "" ) \
+        SP_FR_EVENT( FR_CLIENT_ADD,      "client_add",     "fd",    "nclients" ) \
+        SP_FR_EVENT( FR_CLIENT_RMV,      "client_rmv",     "fd",    "nclients" ) \
+        SP_FR_EVENT( FR_CLOSE_ERROR,     "close_error",    "fd",    "errno" ) \
+        SP_FR_EVENT( FR_DISPATCH,        "dispatch",       "fd",    "ns" ) \
+        SP_FR_EVENT( FR_DISPATCH_FAIL,   "dispatch_fail",  "fd",    "ns" ) \
+        SP_FR_EVENT( FR_MSG_ERROR,       "msg_error",      "fd",    "magic_len" ) \
+        SP_FR_EVENT( FR_SEND_ERROR,      "send_error",     "fd",    "errno" ) \
+        SP_FR_EVENT( FR_POLL_ERROR,      "poll_error",     "errno", "" ) \
+        SP_FR_EVENT( FR_LOCK_TIMEOUT,    "lock_timeout",   "error", "wait_ns" )
+
+#define SP_FR_EVENT(ev_enum, ev_name, a_desc, b_desc) ev_enum,
+enum FrEventType
+{
+   SP_FR_EVENTS(SP_FR_EVENT)
+   FR_NEVENT_TYPES
+};
+#undef SP_FR_EVENT
+
+constexpr uint32_t FR_MAGIC = 0x5350'4652; // "SPFR"
+constexpr uint32_t FR_VERSION = 1;
+constexpr size_t FR_THREAD_NAME_SZ = 32;
+constexpr char FR_DUMP_PREFIX[] = "netsp-flightrec-"; // + pid + FR_DUMP_SUFFIX
+constexpr char FR_DUMP_SUFFIX[] = ".bin";
+
+struct FrEvent
+{
+   uint64_t ts_ns; // CLOCK_MONOTONIC
+   uint16_t type;  // enum FrEventType
+   uint16_t aux;   // dispatch*: the command (enum UserCmdCode)
+   int32_t a;
+   uint64_t b;
+};
+static_assert(sizeof(struct FrEvent) == 24, "Dumps are read back /w this exact layout");
+
+struct FrFileHdr
+{
+   uint32_t magic;   // FR_MAGIC
+   uint32_t version; // FR_VERSION
+   uint32_t nrings;
+   uint32_t ring_nevents;
+   int32_t signo;    // what triggered the dump, 0 if it was asked for
+   uint32_t reserved;
+   uint64_t dump_mono_ns; // CLOCK_MONOTONIC at dump time, to line events up
+   uint64_t dump_real_ns; // ... and CLOCK_REALTIME, to put a date on them
+};
+
+struct FrRingHdr
+{
+   char name[FR_THREAD_NAME_SZ]; // owning thread, e.g., "responder:8080"
+   uint64_t head; // total events ever recorded
+};
+
+#endif // SP_FLIGHTREC_H
@@ -0,0 +1,137 @@
+/**
+ * @file sp-proto.h
+ * @brief Wire format of the Socket Practice (SP) protocol, shared by the SP
+ *        client and the demo server
+ *
+ * Every message is a fixed 8-byte header followed by len bytes of payload.
+ * All multi-byte fields are in network byte order. Requests carry one of the
+ * command codes from sp-cmds.h; the server answers /w the same command code
+ * and SP_FLAG_REPLY set (plus SP_FLAG_ERROR if the request failed, in which
+ * case the payload is a human-readable error string).
+ */
+#ifndef SP_PROTO_H
+#define SP_PROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SP_CMD(cmd_enum, cmd_str, cmd_char, cmd_args) cmd_enum,
+enum UserCmdCode
+{
+#  include "sp-cmds.h"
+   UCMD_UNKNOWN
+};
+#undef SP_CMD
+
+constexpr uint16_t SP_MAGIC = 0x5350; // "SP"
+constexpr size_t SP_HDR_SZ = 8;
+constexpr size_t SP_MAX_PAYLOAD_SZ = 1024;
+constexpr size_t SP_MAX_MSG_SZ = SP_HDR_SZ + SP_MAX_PAYLOAD_SZ;
+
+enum SpMsgFlags
+{
+   SP_FLAG_NONE  = 0x00,
+   SP_FLAG_REPLY = 0x01,
+   SP_FLAG_ERROR = 0x02,
+};
+
+struct SpMsgHdr
+{
+   uint16_t magic;
+   uint8_t cmd;   // enum UserCmdCode
+   uint8_t flags; // enum SpMsgFlags
+   uint32_t len;  // payload bytes following the header
+};
+
+/**
+ * @brief marco request / polo reply payloads
+ *
+ * Timestamps are CLOCK_MONOTONIC nanoseconds of whichever host took them, so
+ * client and server timestamps are only directly comparable when both run on
+ * the same machine. The server's own pair is always comparable, and gives its
+ * residence time (receive to send) for the request.
+ */
+constexpr size_t SP_MARCO_PAYLOAD_SZ = 16;
+constexpr size_t SP_POLO_PAYLOAD_SZ = 32;
+
+struct SpMarco
+{
+   uint64_t seq;
+   uint64_t client_tx_ns;
+};
+
+struct SpPolo
+{
+   uint64_t seq;          // echoed
+   uint64_t client_tx_ns; // echoed
+   uint64_t server_rx_ns; // when the request's bytes came off the socket
+   uint64_t server_tx_ns; // just before the reply was handed to the socket
+};
+
+// Byte-by-byte (de)serialization keeps this independent of host endianness
+// and of the non-POSIX.1-2008 <endian.h>.
+static inline void spPutBE( uint8_t * buf, uint64_t val, size_t nbytes )
+{
+   for ( size_t i = 0; i < nbytes; ++i )
+      buf[i] = (uint8_t)(val >> (8 * (nbytes - 1 - i)));
+}
+
+static inline uint64_t spGetBE( const uint8_t * buf, size_t nbytes )
+{
+   uint64_t val = 0;
+   for ( size_t i = 0; i < nbytes; ++i )
+      val = (val << 8) | buf[i];
+   return val;
+}
+
+static inline void spPackHdr( uint8_t buf[static SP_HDR_SZ],
+                              const struct SpMsgHdr * hdr )
+{
+   spPutBE(&buf[0], hdr->magic, sizeof hdr->magic);
+   buf[2] = hdr->cmd;
+   buf[3] = hdr->flags;
+   spPutBE(&buf[4], hdr->len, sizeof hdr->len);
+}
+
+static inline void spUnpackHdr( const uint8_t buf[static SP_HDR_SZ],
+                                struct SpMsgHdr * hdr )
+{
+   hdr->magic = (uint16_t)spGetBE(&buf[0], sizeof hdr->magic);
+   hdr->cmd = buf[2];
+   hdr->flags = buf[3];
+   hdr->len = (uint32_t)spGetBE(&buf[4], sizeof hdr->len);
+}
+
+static inline void spPackMarco( uint8_t buf[static SP_MARCO_PAYLOAD_SZ],
+                                const struct SpMarco * marco )
+{
+   spPutBE(&buf[0], marco->seq, sizeof(uint64_t));
+   spPutBE(&buf[8], marco->client_tx_ns, sizeof(uint64_t));
+}
+
+static inline void spUnpackMarco( const uint8_t buf[static SP_MARCO_PAYLOAD_SZ],
+                                  struct SpMarco * marco )
+{
+   marco->seq = spGetBE(&buf[0], sizeof(uint64_t));
+   marco->client_tx_ns = spGetBE(&buf[8], sizeof(uint64_t));
+}
+
+static inline void spPackPolo( uint8_t buf[static SP_POLO_PAYLOAD_SZ],
+                               const struct SpPolo * polo )
+{
+   spPutBE(&buf[0], polo->seq, sizeof(uint64_t));
+   spPutBE(&buf[8], polo->client_tx_ns, sizeof(uint64_t));
+   spPutBE(&buf[16], polo->server_rx_ns, sizeof(uint64_t));
+   spPutBE(&buf[24], polo->server_tx_ns, sizeof(uint64_t));
+}
+
+static inline void spUnpackPolo( const uint8_t buf[static SP_POLO_PAYLOAD_SZ],
+                                 struct SpPolo * polo )
+{
+   polo->seq = spGetBE(&buf[0], sizeof(uint64_t));
+   polo->client_tx_ns = spGetBE(&buf[8], sizeof(uint64_t));
+   polo->server_rx_ns = spGetBE(&buf[16], sizeof(uint64_t));
+   polo->server_tx_ns = spGetBE(&buf[24], sizeof(uint64_t));
+}
+
+#endif // SP_PROTO_H
@@ -0,0 +1,111 @@
+/**
+ * @file sp-spsc.h
+ * @brief Bounded single-producer/single-consumer message queue, for the demo
+ *        server's per-core mode
+ *
+ * A Lamport ring: the producer only ever writes tail, the consumer only ever
+ * writes head, and each keeps a private copy of the other's index that it
+ * only refreshes when the ring looks full (or empty). So in the steady state
+ * each side touches its own cache line and the message slot, and nothing
+ * else, and no read-modify-writes are needed at all.
+ */
+#ifndef SP_SPSC_H
+#define SP_SPSC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+constexpr size_t SP_SPSC_CACHE_LINE_SZ = 64;
+
+// What the queue carries. type and the fields' meanings are up to the user.
+struct SpSpscMsg
+{
+   uint32_t type;
+   int32_t arg;
+   void * ptr;
+};
+
+struct SpSpscQueue
+{
+   // Consumer's line
+   alignas(SP_SPSC_CACHE_LINE_SZ) _Atomic size_t head;
+   size_t tail_cache;
+   // Producer's line
+   alignas(SP_SPSC_CACHE_LINE_SZ) _Atomic size_t tail;
+   size_t head_cache;
+   // Read-only after init
+   alignas(SP_SPSC_CACHE_LINE_SZ) size_t mask; // capacity - 1
+   struct SpSpscMsg * slots;
+};
+
+/**
+ * @param[in] capacity : must be a power of two
+ *
+ * @return false if the slots couldn't be allocated
+ */
+static inline bool spSpscInit( struct SpSpscQueue * q, size_t capacity )
+{
+   if ( 0 == capacity || (capacity & (capacity - 1)) != 0 )
+      return false;
+
+   q->slots = calloc(capacity, sizeof *q->slots);
+   if ( nullptr == q->slots )
+      return false;
+   q->mask = capacity - 1;
+   atomic_init(&q->head, 0);
+   atomic_init(&q->tail, 0);
+   q->tail_cache = 0;
+   q->head_cache = 0;
+   return true;
+}
+
+static inline void spSpscDeinit( struct SpSpscQueue * q )
+{
+   free(q->slots);
+   q->slots = nullptr;
+}
+
+/**
+ * @brief Producer only: enqueue a copy of msg
+ *
+ * @return false if the queue is full
+ */
+static inline bool spSpscPush( struct SpSpscQueue * q, const struct SpSpscMsg * msg )
+{
+   size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+   if ( tail - q->head_cache > q->mask )
+   {
+      q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+      if ( tail - q->head_cache > q->mask )
+         return false;
+   }
+
+   q->slots[tail & q->mask] = *msg;
+   atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+   return true;
+}
+
+/**
+ * @brief Consumer only: dequeue the oldest message into msg
+ *
+ * @return false if the queue is empty
+ */
+static inline bool spSpscPop( struct SpSpscQueue * q, struct SpSpscMsg * msg )
+{
+   size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+   if ( head == q->tail_cache )
+   {
+      q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+      if ( head == q->tail_cache )
+         return false;
+   }
+
+   *msg = q->slots[head & q->mask];
+   atomic_store_explicit(&q->head, head + 1, memory_order_release);
+   return true;
+}
+
+#endif // SP_SPSC_H
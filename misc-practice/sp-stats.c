@@ -0,0 +1,172 @@
+/**
+ * @brief Scraper for the demo server's live stats (see sp-stats.h)
+ *
+ * Maps a running demo_server's stats segment read-only and prints each
+ * listening context's counters, summed over its threads. Given an interval,
+ * keeps printing, /w per-second rates since the previous print.
+ *
+ * Usage: sp-stats <demo_server-pid> [interval-sec]
+ */
+
+// General-Purpose System Headers
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+// Socket Practice (SP) server stats
+#include "sp-stats.h"
+
+/* Constant and Type Definitions */
+constexpr unsigned long MAX_INTERVAL_SEC = 3'600;
+
+#define SP_STAT(stat_enum, stat_name, stat_desc) stat_name,
+static const char * const StatNames[SP_STAT_N] = { SP_STATS_COUNTERS(SP_STAT) };
+#undef SP_STAT
+
+/* Function Declarations */
+static void printCtx( const struct SpStatsCtx * ctx,
+                      uint32_t ictx,
+                      const uint64_t * prev,
+                      double elapsed_sec );
+
+/* Main Function */
+int main(int argc, char * argv[])
+{
+   if ( argc < 2 || argc > 3 )
+   {
+      fprintf(stderr, "Usage: %s <demo_server-pid> [interval-sec]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   char * end_ptr = nullptr;
+   long pid = strtol(argv[1], &end_ptr, 10);
+   if ( *end_ptr != '\0' || pid <= 0 )
+   {
+      fprintf(stderr, "Error: Invalid pid: %s\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+   unsigned long interval_sec = 0;
+   if ( 3 == argc )
+   {
+      interval_sec = strtoul(argv[2], &end_ptr, 10);
+      if ( *end_ptr != '\0' || 0 == interval_sec || interval_sec > MAX_INTERVAL_SEC )
+      {
+         fprintf( stderr, "Error: Interval must be 1 to %lu seconds: %s\n",
+                  MAX_INTERVAL_SEC, argv[2] );
+         return EXIT_FAILURE;
+      }
+   }
+
+   char shm_name[sizeof SP_STATS_SHM_PREFIX + 3 * sizeof(long)];
+   snprintf(shm_name, sizeof shm_name, "%s%ld", SP_STATS_SHM_PREFIX, pid);
+   int shm_fd = shm_open(shm_name, O_RDONLY, 0);
+   if ( shm_fd < 0 )
+   {
+      fprintf( stderr, "Error: Can't open %s: %s (%d)\n"
+                       "Is demo_server %ld running?\n",
+               shm_name, strerror(errno), errno, pid );
+      return EXIT_FAILURE;
+   }
+   struct stat shm_info;
+   if ( fstat(shm_fd, &shm_info) != 0
+        || (size_t)shm_info.st_size < sizeof(struct SpStatsShm) )
+   {
+      fprintf(stderr, "Error: %s isn't a stats segment this scraper understands.\n", shm_name);
+      close(shm_fd);
+      return EXIT_FAILURE;
+   }
+   const struct SpStatsShm * shm = mmap( nullptr, sizeof(struct SpStatsShm),
+                                         PROT_READ, MAP_SHARED, shm_fd, 0 );
+   close(shm_fd); // the mapping holds its own reference
+   if ( MAP_FAILED == shm )
+   {
+      fprintf(stderr, "Error: mmap() of %s failed: %s (%d)\n", shm_name, strerror(errno), errno);
+      return EXIT_FAILURE;
+   }
+   if ( shm->magic != SP_STATS_MAGIC || shm->version != SP_STATS_VERSION
+        || shm->nslots != SP_STATS_NSLOTS || shm->max_ctxs != SP_STATS_MAX_CTXS )
+   {
+      fprintf( stderr, "Error: %s has an unexpected header (magic 0x%08" PRIx32
+                       ", version %" PRIu32 ").\n",
+               shm_name, shm->magic, shm->version );
+      return EXIT_FAILURE;
+   }
+
+   // Previous totals per context, for the rates
+   static uint64_t prev[SP_STATS_MAX_CTXS][SP_STAT_N];
+   struct timespec prev_ts;
+   clock_gettime(CLOCK_MONOTONIC, &prev_ts);
+   double elapsed_sec = 0.0; // no rates on the first print
+
+   for ( ;; )
+   {
+      uint32_t nctxs = atomic_load_explicit(&shm->nctxs, memory_order_acquire);
+      if ( nctxs > SP_STATS_MAX_CTXS )
+         nctxs = SP_STATS_MAX_CTXS;
+      if ( 0 == nctxs )
+         printf("demo_server %ld has no listening contexts yet.\n", pid);
+
+      for ( uint32_t i = 0; i < nctxs; ++i )
+      {
+         printCtx(&shm->ctxs[i], i, prev[i], elapsed_sec);
+         for ( size_t s = 0; s < SP_STAT_N; ++s )
+            prev[i][s] = spStatSum(&shm->ctxs[i], (enum SpStat)s);
+      }
+
+      if ( 0 == interval_sec )
+         break;
+      fflush(stdout);
+      sleep((unsigned)interval_sec);
+
+      struct timespec now_ts;
+      clock_gettime(CLOCK_MONOTONIC, &now_ts);
+      elapsed_sec = (double)(now_ts.tv_sec - prev_ts.tv_sec)
+                    + (double)(now_ts.tv_nsec - prev_ts.tv_nsec) / 1e9;
+      prev_ts = now_ts;
+      puts("");
+   }
+
+   return EXIT_SUCCESS;
+}
+
+/* Function Implementations */
+
+/**
+ * @brief Print one context's counters, plus rates since prev if elapsed_sec
+ *        is nonzero
+ */
+static void printCtx( const struct SpStatsCtx * ctx,
+                      uint32_t ictx,
+                      const uint64_t * prev,
+                      double elapsed_sec )
+{
+   char addrstr[INET_ADDRSTRLEN] = "?";
+   inet_ntop(AF_INET, &(struct in_addr){ .s_addr = ctx->addr }, addrstr, sizeof addrstr);
+   printf("Context %" PRIu32 " (%s:%u)\n", ictx, addrstr, ntohs(ctx->port));
+
+   uint64_t sums[SP_STAT_N];
+   for ( size_t s = 0; s < SP_STAT_N; ++s )
+      sums[s] = spStatSum(ctx, (enum SpStat)s);
+
+   uint64_t active = sums[SP_STAT_ACCEPTS] - sums[SP_STAT_ACCEPTS_REJECTED]
+                     - sums[SP_STAT_CLIENTS_DROPPED];
+   printf("   %-18s %" PRIu64 "\n", "active_clients", active);
+
+   for ( size_t s = 0; s < SP_STAT_N; ++s )
+   {
+      if ( elapsed_sec > 0.0 )
+         printf( "   %-18s %-14" PRIu64 " %12.1f/s\n", StatNames[s], sums[s],
+                 (double)(sums[s] - prev[s]) / elapsed_sec );
+      else
+         printf("   %-18s %" PRIu64 "\n", StatNames[s], sums[s]);
+   }
+}
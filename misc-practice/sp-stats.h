@@ -0,0 +1,116 @@
+/**
+ * @file sp-stats.h
+ * @brief Layout of the demo server's live statistics, which it publishes in a
+ *        POSIX shared-memory segment for external scrapers (e.g., sp-stats)
+ *
+ * The server creates /dev/shm/netsp-stats-<pid> read-only for everyone but
+ * itself, and its threads count straight into it. Every listening context
+ * gets a SpStatsCtx, and every thread serving that context gets its own
+ * cache-line-sized slot in it, which only that thread ever writes. So counting
+ * is a relaxed load and store to a line no other core is writing: no locks,
+ * no atomic read-modify-writes, no false sharing. That includes the request
+ * executor's workers: each one gets a slot of its own in every context,
+ * whether or not it ever carries out that context's requests.
+ *
+ * Readers aggregate on read, summing a context's slots. Each counter is read
+ * atomically, but different counters (and slots) may be from slightly
+ * different moments.
+ */
+#ifndef SP_STATS_H
+#define SP_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Every counter only ever goes up.
+//                Enum                        Name                Description
+#define SP_STATS_COUNTERS(SP_STAT) \
+        SP_STAT(  SP_STAT_ACCEPTS,            "accepts",          "connections accepted" ) \
+        SP_STAT(  SP_STAT_ACCEPT_ERRORS,      "accept_errors",    "accept() failures" ) \
+        SP_STAT(  SP_STAT_ACCEPTS_REJECTED,   "accepts_rejected", "accepted but not registered (e.g., registry full)" ) \
+        SP_STAT(  SP_STAT_CLIENTS_DROPPED,    "clients_dropped",  "registered clients removed" ) \
+        SP_STAT(  SP_STAT_BYTES_IN,           "bytes_in",         "bytes received from clients" ) \
+        SP_STAT(  SP_STAT_BYTES_OUT,          "bytes_out",        "bytes sent to clients" ) \
+        SP_STAT(  SP_STAT_MSGS_IN,            "msgs_in",          "complete SP requests received" ) \
+        SP_STAT(  SP_STAT_MSGS_OUT,           "msgs_out",         "SP replies sent" ) \
+        SP_STAT(  SP_STAT_MSG_ERRORS,         "msg_errors",       "malformed requests and failed sends" ) \
+        SP_STAT(  SP_STAT_POLL_WAKEUPS,       "poll_wakeups",     "times the responder woke up /w clients ready" ) \
+        SP_STAT(  SP_STAT_POLL_READY,         "poll_ready",       "clients ready, summed over those wake-ups" ) \
+        SP_STAT(  SP_STAT_ZC_SENDS,           "zc_sends",         "sends made /w MSG_ZEROCOPY" ) \
+        SP_STAT(  SP_STAT_ZC_COPIED,          "zc_copied",        "of those, ones the kernel ended up copying anyway" )
+
+#define SP_STAT(stat_enum, stat_name, stat_desc) stat_enum,
+enum SpStat
+{
+   SP_STATS_COUNTERS(SP_STAT)
+   SP_STAT_N
+};
+#undef SP_STAT
+
+constexpr size_t SP_STATS_MAX_EXEC_WORKERS = 64; // the server's EXEC_MAX_WORKERS
+
+// Which of a context's threads owns a slot
+enum SpStatsSlotId
+{
+   SP_STATS_SLOT_ACCEPTOR,
+   SP_STATS_SLOT_RESPONDER,
+   SP_STATS_SLOT_EXECUTOR, // executor worker i's is SP_STATS_SLOT_EXECUTOR + i
+   SP_STATS_NSLOTS = SP_STATS_SLOT_EXECUTOR + SP_STATS_MAX_EXEC_WORKERS
+};
+
+constexpr uint32_t SP_STATS_MAGIC = 0x5350'5354; // "SPST"
+constexpr uint32_t SP_STATS_VERSION = 4;
+constexpr size_t SP_STATS_MAX_CTXS = 1'000; // the server's MAX_SERVERS
+constexpr size_t SP_STATS_CACHE_LINE_SZ = 64;
+constexpr char SP_STATS_SHM_PREFIX[] = "/netsp-stats-"; // + server's pid
+
+struct SpStatsSlot
+{
+   alignas(SP_STATS_CACHE_LINE_SZ) _Atomic uint64_t counters[SP_STAT_N];
+};
+
+struct SpStatsCtx
+{
+   // Written once by the server before the context is published
+   uint32_t addr; // listening IPv4 address, network byte order
+   uint16_t port; // listening port, network byte order
+   struct SpStatsSlot slots[SP_STATS_NSLOTS];
+};
+
+struct SpStatsShm
+{
+   uint32_t magic;   // SP_STATS_MAGIC, once the segment is initialized
+   uint32_t version; // SP_STATS_VERSION
+   uint32_t max_ctxs;
+   uint32_t nslots;
+   // Contexts [0, nctxs) are valid. Stored /w release semantics after the
+   // context itself is filled in, so load it /w acquire semantics.
+   _Atomic uint32_t nctxs;
+   struct SpStatsCtx ctxs[SP_STATS_MAX_CTXS];
+};
+
+/**
+ * @brief Count n more of stat on a slot the calling thread owns
+ */
+static inline void spStatAdd( struct SpStatsSlot * slot, enum SpStat stat, uint64_t n )
+{
+   // Single writer, so no read-modify-write needed: a plain load and store
+   // can't lose updates, and relaxed atomics keep readers from seeing a
+   // torn value.
+   uint64_t val = atomic_load_explicit(&slot->counters[stat], memory_order_relaxed);
+   atomic_store_explicit(&slot->counters[stat], val + n, memory_order_relaxed);
+}
+
+/**
+ * @brief A context's total for stat, across all of its threads' slots
+ */
+static inline uint64_t spStatSum( const struct SpStatsCtx * ctx, enum SpStat stat )
+{
+   uint64_t sum = 0;
+   for ( size_t i = 0; i < SP_STATS_NSLOTS; ++i )
+      sum += atomic_load_explicit(&ctx->slots[i].counters[stat], memory_order_relaxed);
+   return sum;
+}
+
+#endif // SP_STATS_H
@@ -0,0 +1,59 @@
+/**
+ * @file sp-trace.h
+ * @brief USDT (SystemTap/DTrace-style) static tracepoints for the demo server
+ *
+ * With <sys/sdt.h> around at build time (Debian/Ubuntu: systemtap-sdt-dev,
+ * Fedora: systemtap-sdt-devel), each SP_PROBE*() becomes a single nop plus an
+ * ELF note saying where it is and where its arguments live. Nothing is linked
+ * in and nothing runs until a tracer attaches, at which point the nop gets
+ * patched into a breakpoint. Without the header, or /w -DSP_TRACE=0, the
+ * probes compile to nothing at all. Arguments aren't evaluated in that case,
+ * so keep them free of side effects.
+ *
+ * All probes are under the "netsp" provider, e.g.:
+ *
+ *    bpftrace -l 'usdt:./demo_server:netsp:*'
+ *    bpftrace -e 'usdt:./demo_server:netsp:dispatch_done
+ *                 { @ns[arg1] = hist(arg2); }'
+ *    perf buildid-cache --add ./demo_server && perf list sdt_netsp:*
+ *
+ * Probes and their arguments:
+ *    accept(fd, addr, port)          accept() handed us a connection (addr and
+ *                                    port in network byte order)
+ *    accept_error(errno)             accept() failed
+ *    client_add(fd, nclients)        client registered; nclients after adding
+ *    client_rmv(fd, nclients)        client removed; nclients after removing
+ *    mtx_wait(mtx)                   about to block on a mutex
+ *    mtx_acquire(mtx)                got it
+ *    mtx_release(mtx)                about to unlock it
+ *    dispatch_start(fd, cmd, len)    SP request about to be carried out
+ *    dispatch_done(fd, cmd, ns, ok)  ... and done, after ns nanoseconds
+ */
+#ifndef SP_TRACE_H
+#define SP_TRACE_H
+
+#ifndef SP_TRACE
+#  if defined(__has_include)
+#    if __has_include(<sys/sdt.h>)
+#      define SP_TRACE 1
+#    endif
+#  endif
+#endif
+#ifndef SP_TRACE
+#  define SP_TRACE 0
+#endif
+
+#if SP_TRACE
+#  include <sys/sdt.h>
+#  define SP_PROBE1(name, a1)                 DTRACE_PROBE1(netsp, name, a1)
+#  define SP_PROBE2(name, a1, a2)             DTRACE_PROBE2(netsp, name, a1, a2)
+#  define SP_PROBE3(name, a1, a2, a3)         DTRACE_PROBE3(netsp, name, a1, a2, a3)
+#  define SP_PROBE4(name, a1, a2, a3, a4)     DTRACE_PROBE4(netsp, name, a1, a2, a3, a4)
+#else
+#  define SP_PROBE1(name, a1)                 ((void)0)
+#  define SP_PROBE2(name, a1, a2)             ((void)0)
+#  define SP_PROBE3(name, a1, a2, a3)         ((void)0)
+#  define SP_PROBE4(name, a1, a2, a3, a4)     ((void)0)
+#endif
+
+#endif // SP_TRACE_H
@@ -0,0 +1,156 @@
+/**
+ * @file sp-wsdeque.h
+ * @brief Chase-Lev work-stealing deque of pointers, for the demo server's
+ *        request executor
+ *
+ * One thread owns the deque and pushes and pops at the bottom, LIFO, without
+ * ever contending /w anyone unless the deque is down to its last item. Any
+ * number of other threads steal from the top, FIFO, paying a CAS per steal.
+ * This is the C11 formulation from Le, Pop, Cohen and Zappa Nardelli,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP '13),
+ * minus the growing: the capacity is fixed at init, and a push onto a full
+ * deque fails, leaving it to the owner to do something else /w the item
+ * (e.g., run it itself).
+ */
+#ifndef SP_WSDEQUE_H
+#define SP_WSDEQUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+constexpr size_t SP_WSDEQUE_CACHE_LINE_SZ = 64;
+
+struct SpWsDeque
+{
+   // Thieves fight over top, the owner alone moves bottom: keep them on
+   // separate lines so the owner's pushes don't keep knocking thieves' lines
+   // out of their caches (and vice versa)
+   alignas(SP_WSDEQUE_CACHE_LINE_SZ) _Atomic int64_t top;
+   alignas(SP_WSDEQUE_CACHE_LINE_SZ) _Atomic int64_t bottom;
+   size_t mask; // capacity - 1
+   _Atomic(void *) * items;
+};
+
+enum SpWsStealResult
+{
+   SP_WS_STOLEN,
+   SP_WS_EMPTY,
+   SP_WS_ABORT, // lost a race /w another thief (or the owner); worth retrying
+};
+
+/**
+ * @param[in] capacity : must be a power of two
+ *
+ * @return false if the items couldn't be allocated
+ */
+static inline bool spWsDequeInit( struct SpWsDeque * dq, size_t capacity )
+{
+   if ( 0 == capacity || (capacity & (capacity - 1)) != 0 )
+      return false;
+
+   dq->items = calloc(capacity, sizeof *dq->items);
+   if ( nullptr == dq->items )
+      return false;
+   dq->mask = capacity - 1;
+   atomic_init(&dq->top, 0);
+   atomic_init(&dq->bottom, 0);
+   return true;
+}
+
+static inline void spWsDequeDeinit( struct SpWsDeque * dq )
+{
+   free(dq->items);
+   dq->items = nullptr;
+}
+
+/**
+ * @brief Owner only: add item at the bottom
+ *
+ * @return false if the deque is full
+ */
+static inline bool spWsDequePush( struct SpWsDeque * dq, void * item )
+{
+   int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+   int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+   if ( (uint64_t)(b - t) > dq->mask )
+      return false;
+
+   atomic_store_explicit(&dq->items[(uint64_t)b & dq->mask], item, memory_order_relaxed);
+   // Publish the item before the bottom that makes it visible to thieves
+   atomic_thread_fence(memory_order_release);
+   atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+   return true;
+}
+
+/**
+ * @brief Owner only: take the most recently pushed item
+ *
+ * @return nullptr if the deque is empty (or a thief got the last item)
+ */
+static inline void * spWsDequePop( struct SpWsDeque * dq )
+{
+   int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+   atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+   // Claim the bottom item before looking at top; a thief does the reverse,
+   // so at least one of us sees the other
+   atomic_thread_fence(memory_order_seq_cst);
+   int64_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+   if ( t > b )
+   {
+      // Was already empty
+      atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+      return nullptr;
+   }
+
+   void * item = atomic_load_explicit(&dq->items[(uint64_t)b & dq->mask], memory_order_relaxed);
+   if ( t == b )
+   {
+      // Last item: thieves may be going for it too, so race them for it
+      // through top, like they race each other
+      if ( !atomic_compare_exchange_strong_explicit( &dq->top, &t, t + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed ) )
+         item = nullptr;
+      atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+   }
+   return item;
+}
+
+/**
+ * @brief Any thread: take the least recently pushed item
+ *
+ * @param[out] item : what was stolen, only set if SP_WS_STOLEN is returned
+ */
+static inline enum SpWsStealResult spWsDequeSteal( struct SpWsDeque * dq, void ** item )
+{
+   int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+   atomic_thread_fence(memory_order_seq_cst);
+   int64_t b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+   if ( t >= b )
+      return SP_WS_EMPTY;
+
+   void * stolen = atomic_load_explicit(&dq->items[(uint64_t)t & dq->mask], memory_order_relaxed);
+   if ( !atomic_compare_exchange_strong_explicit( &dq->top, &t, t + 1,
+                                                  memory_order_seq_cst,
+                                                  memory_order_relaxed ) )
+      return SP_WS_ABORT;
+
+   *item = stolen;
+   return SP_WS_STOLEN;
+}
+
+/**
+ * @brief Any thread: rough number of items, for reporting
+ */
+static inline size_t spWsDequeSize( struct SpWsDeque * dq )
+{
+   int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+   int64_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+   return b > t ? (size_t)(b - t) : 0;
+}
+
+#endif // SP_WSDEQUE_H
@@ -1,12 +1,25 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <format>
+#include <limits>
+#include <array>
+#include <algorithm>
+#include <span>
+#include <locale>
+#include <stdexcept>
+#include <charconv>
 
 #include <arpa/inet.h>
 #include <cstdint>
+#include <cstring>
 #include <cassert>
 
+#include "inet_checksum.hpp"
+#include "l4_checksum.hpp"
+#include "pcap_verify.hpp"
+
 enum ProgramReturnVals : int
 {
    ALL_IS_WELL = 0,
@@ -14,13 +27,174 @@ enum ProgramReturnVals : int
    INVALID_DST_IP,
    INVALID_SRC_PORT,
    INVALID_DST_PORT,
-   UNKNOWN_ERR
+   UNKNOWN_ERR,
+   INVALID_PCAP,
+   BAD_CHECKSUMS_FOUND,
+   PAYLOAD_TOO_LARGE
 };
 
 constexpr int INET_PTON_SUCCESS = 1;
 
-int main(void)
+// Largest payload whose length still fits UDP's 16-bit length field. Beyond
+// this, only an IPv6 jumbogram (RFC 2675) can carry the datagram.
+constexpr std::size_t UDP_PLD_MAX = 0xFFFF - 8;
+// Bytes/words echoed before the rest is summarized, so that large payload
+// dumps don't flood the terminal
+constexpr std::size_t ECHO_MAX = 64;
+
+struct IpAddr
+{
+   int family; // AF_INET or AF_INET6
+   std::array<std::uint8_t, 16> bytes; // network byte order; IPv4 uses the first 4
+};
+
+/**
+ * @brief Parse an IPv4 or IPv6 address string
+ * @return inet_pton()'s return code for the last family tried
+ */
+static int parseIpAddr(const std::string & str, IpAddr & addr)
+{
+   addr.family = AF_INET;
+   int retcode = inet_pton( AF_INET, str.c_str(), addr.bytes.data() );
+   if ( retcode != INET_PTON_SUCCESS )
+   {
+      addr.family = AF_INET6;
+      retcode = inet_pton( AF_INET6, str.c_str(), addr.bytes.data() );
+   }
+   return retcode;
+}
+
+/**
+ * @brief Decode whitespace-separated hex bytes into bytes, in a single pass
+ *
+ * Each token is either one byte ("a", "0A", "0x0a") or an even-length run of
+ * bytes ("deadbeef", as from xxd -p or a Wireshark hex dump). Invalid tokens
+ * are reported and skipped. Nothing is allocated per token: bytes is sized
+ * once for the worst case up front, and the tokens are parsed in place.
+ *
+ * @param[in] text : payload line
+ * @param[out] bytes : decoded bytes, appended
+ * @return number of invalid tokens skipped
+ */
+static std::size_t parseHexBytes( std::string_view text,
+                                  std::vector<std::uint8_t> & bytes )
 {
+   // A byte takes at least one digit plus a separator (or two digits), so
+   // this bounds the output and no reallocation happens while parsing
+   bytes.reserve( bytes.size() + (text.size() + 1) / 2 );
+
+   constexpr std::string_view WHITESPACE = " \t\r\n";
+   std::size_t nbad = 0;
+   std::size_t pos = text.find_first_not_of(WHITESPACE);
+   while ( pos != std::string_view::npos )
+   {
+      std::size_t end = text.find_first_of(WHITESPACE, pos);
+      if ( std::string_view::npos == end )
+         end = text.size();
+      std::string_view token = text.substr(pos, end - pos);
+      pos = text.find_first_not_of(WHITESPACE, end);
+
+      std::string_view digits = token;
+      if ( digits.size() > 2 && '0' == digits[0] && ('x' == digits[1] || 'X' == digits[1]) )
+         digits.remove_prefix(2);
+
+      // 1-2 digits is a byte, a longer even run is a byte per digit pair
+      std::size_t step = (digits.size() <= 2) ? digits.size() : 2;
+      bool valid = !digits.empty() && (digits.size() <= 2 || 0 == digits.size() % 2);
+      const std::size_t nbytes_before = bytes.size();
+      for ( std::size_t i = 0; valid && i < digits.size(); i += step )
+      {
+         std::uint8_t byte;
+         const char * first = digits.data() + i;
+         const char * last = first + step;
+         auto [ptr, ec] = std::from_chars(first, last, byte, 16);
+         valid = (std::errc{} == ec) && (last == ptr);
+         if ( valid )
+            bytes.push_back(byte);
+      }
+      if ( !valid )
+      {
+         bytes.resize(nbytes_before);
+         std::cerr << "Warning: Failed to process byte: " << token
+                   << " (invalid byte). Continuing..." << std::endl;
+         nbad++;
+      }
+   }
+   return nbad;
+}
+
+/**
+ * @brief UDP checksum through the pseudo-header engine specialized for IP
+ */
+template <netsp::checksum::IpVersion IP>
+static std::uint16_t udpChecksum( const IpAddr & src,
+                                  const IpAddr & dst,
+                                  std::span<const std::uint8_t> datagram )
+{
+   using Engine = netsp::checksum::L4Checksum<IP, netsp::checksum::L4Proto::UDP>;
+   typename Engine::Addr src_addr;
+   typename Engine::Addr dst_addr;
+   std::copy_n( src.bytes.begin(), src_addr.size(), src_addr.begin() );
+   std::copy_n( dst.bytes.begin(), dst_addr.size(), dst_addr.begin() );
+   return Engine(src_addr, dst_addr).compute(datagram);
+}
+
+/**
+ * @brief --pcap mode: verify every checksum in a capture file
+ */
+static int verifyPcap(const char * path, unsigned nthreads)
+{
+   netsp::pcap::VerifyStats stats;
+   double elapsed_sec;
+   if ( !netsp::pcap::verifyFile(path, nthreads, stats, elapsed_sec) )
+      return INVALID_PCAP;
+
+   std::cout << std::format( "Packets: {} ({} bytes) in {:.3f} s: {:.2f} Mpps, {:.2f} GB/s\n",
+                             stats.npackets, stats.nbytes, elapsed_sec,
+                             static_cast<double>(stats.npackets) / elapsed_sec / 1e6,
+                             static_cast<double>(stats.nbytes) / elapsed_sec / 1e9 )
+             << std::format( "IPv4: {} (bad header checksums: {}), IPv6: {}\n",
+                             stats.nipv4, stats.nipv4_hdr_bad, stats.nipv6 )
+             << std::format( "UDP: {} ok, {} bad, {} /wo checksum\n",
+                             stats.nudp_ok, stats.nudp_bad, stats.nudp_no_checksum )
+             << std::format( "TCP: {} ok, {} bad\n", stats.ntcp_ok, stats.ntcp_bad )
+             << std::format( "Skipped (non-IP, fragments, snapped, malformed): {}\n",
+                             stats.nskipped );
+
+   bool any_bad = (stats.nipv4_hdr_bad + stats.nudp_bad + stats.ntcp_bad) > 0;
+   if ( any_bad )
+   {
+      std::cout << "Note: Bad checksums on packets sent by the capturing host are "
+                   "usually checksum offload, not corruption." << std::endl;
+   }
+   return any_bad ? BAD_CHECKSUMS_FOUND : ALL_IS_WELL;
+}
+
+int main(int argc, char * argv[])
+{
+   if ( argc > 1 )
+   {
+      std::string mode = argv[1];
+      if ( mode != "--pcap" || argc < 3 || argc > 4 )
+      {
+         std::cerr << "Usage: " << argv[0] << '\n'
+                   << "       " << argv[0] << " --pcap <capture-file> [nthreads]" << std::endl;
+         return UNKNOWN_ERR;
+      }
+      unsigned nthreads = 0; // one per hardware thread
+      if ( 4 == argc )
+      {
+         try {
+            nthreads = static_cast<unsigned>(std::stoul(argv[3]));
+         }
+         catch ( const std::exception& e ) {
+            std::cerr << "Error: Invalid thread count: " << argv[3] << std::endl;
+            return UNKNOWN_ERR;
+         }
+      }
+      return verifyPcap(argv[2], nthreads);
+   }
+
    std::string src_ip;
    std::string dst_ip;
    std::uint16_t src_port;
@@ -33,9 +207,9 @@ int main(void)
    std::cout << "Let's compute a UDP checksum!" << '\n'
              << "\nProvide the following information:" << '\n'
              <<   "----------------------------------" << '\n';
-   std::cout << "Source IPv4 Address: ";
+   std::cout << "Source IP Address (IPv4 or IPv6): ";
    std::cin >> src_ip;
-   std::cout << "Destination IPv4 Address: ";
+   std::cout << "Destination IP Address (same version): ";
    std::cin >> dst_ip;
    std::cout << "Source Port: ";
    try {
@@ -62,8 +236,8 @@ int main(void)
    std::cout << "----------------------------------" << std::endl;
 
    // Convert IP address strings to network-byte order bytes
-   struct in_addr src_ip_num;
-   int retcode = inet_pton( AF_INET, src_ip.c_str(), &src_ip_num );
+   IpAddr src_ip_num;
+   int retcode = parseIpAddr( src_ip, src_ip_num );
    if ( retcode != INET_PTON_SUCCESS )
    {
       std::cerr << "Error: Unable to convert " << src_ip << " into numerical form. "
@@ -71,53 +245,35 @@ int main(void)
       return INVALID_SRC_IP;
    }
 
-   struct in_addr dst_ip_num;
-   retcode = inet_pton( AF_INET, dst_ip.c_str(), &dst_ip_num );
+   IpAddr dst_ip_num;
+   retcode = parseIpAddr( dst_ip, dst_ip_num );
    if ( retcode != INET_PTON_SUCCESS )
    {
       std::cerr << "Error: Unable to convert " << dst_ip << " into numerical form. "
                    "inet_pton() returned " << retcode << std::endl;
       return INVALID_DST_IP;
    }
+   if ( dst_ip_num.family != src_ip_num.family )
+   {
+      std::cerr << "Error: Source and destination addresses must be of the "
+                   "same IP version." << std::endl;
+      return INVALID_DST_IP;
+   }
+   const bool is_ipv6 = (AF_INET6 == src_ip_num.family);
+   const std::size_t addr_sz = is_ipv6 ? 16 : 4;
 
-   // Split UDP payload string entry by space, and parse individual byte entries into vector.
+   // Decode the hex bytes straight out of the line
    std::vector<std::uint8_t> pld_bytes;
    if ( udp_pld_str.length() > 0 )
    {
       std::cout << "Processing payload bytes..." << std::endl;
-      // First, obtain individual token bytes, by manually doing a split()
-      std::vector<std::string> pld_tokens;
-      std::size_t pos_start = 0;
-      constexpr std::size_t NREPS_MAX = 50;
-      for ( std::size_t nreps = 0, pos_end = udp_pld_str.find(" ", pos_start);
-            (nreps++ < NREPS_MAX && pos_end != std::string::npos);
-            pos_end = udp_pld_str.find(" ", pos_start) )
-      {
-         std::string token = udp_pld_str.substr(pos_start, pos_end - pos_start);
-         pld_tokens.push_back(token);
-         pos_start = pos_end + 1; // 1 for space character
-      }
-      pld_tokens.push_back( udp_pld_str.substr(pos_start) );
+      (void)parseHexBytes(udp_pld_str, pld_bytes);
 
-      // Now parse each hex byte into a uint8 number
       std::cout << "\tBytes parsed: ";
-      for ( auto token : pld_tokens )
-      {
-         assert( token.length() > 0 );
-         try {
-            std::uint8_t pld_byte = std::stoi(token, nullptr, 16);
-            std::cout << std::format("0x{:02X} ", pld_byte);
-            pld_bytes.push_back(pld_byte);
-         }
-         catch (const std::invalid_argument& e) {
-            std::cerr << "Warning: Failed to process byte: " << token
-                      << " (invalid byte). Continuing..." << std::endl;
-         }
-         catch (const std::out_of_range& e) {
-            std::cerr << "Warning: Failed to process byte: " << token
-                      << " (invalid byte). Continuing..." << std::endl;
-         }
-      }
+      for ( std::size_t i = 0; i < std::min(pld_bytes.size(), ECHO_MAX); i++ )
+         std::cout << std::format("0x{:02X} ", pld_bytes[i]);
+      if ( pld_bytes.size() > ECHO_MAX )
+         std::cout << std::format("... ({} more)", pld_bytes.size() - ECHO_MAX);
       std::cout << '\n';
       std::cout << "Processing payload bytes COMPLETE!" << std::endl;
    }
@@ -126,82 +282,103 @@ int main(void)
       std::cout << "No payload bytes given." << std::endl;
    }
 
-   // Now form 16-bit pairs for the sum
-   std::vector<std::uint16_t> pld_byte_pairs;
-   for ( std::size_t i=0; (i+1) < pld_bytes.size(); i+=2 )
+   // IPv6 jumbograms (RFC 2675) set the UDP length field to 0 and carry the
+   // real length in the pseudo-header's 32-bit length; IPv4 has no such escape
+   const bool is_jumbogram = pld_bytes.size() > UDP_PLD_MAX;
+   if ( is_jumbogram && !is_ipv6 )
    {
-      std::uint16_t byte_pair =
-            (static_cast<std::uint16_t>(pld_bytes[i]) << 8)
-          | (static_cast<std::uint16_t>(pld_bytes[i+1]) );
-      pld_byte_pairs.push_back(byte_pair);
+      std::cerr << "Error: " << pld_bytes.size() << " payload bytes exceed the "
+                << UDP_PLD_MAX << " a UDP/IPv4 datagram can carry." << std::endl;
+      return PAYLOAD_TOO_LARGE;
    }
-   if ( pld_bytes.size() % 2 != 0 )
+
+   // Compute what the correct length would be given the UDP payload
+   std::uint32_t udp_len = static_cast<std::uint32_t>(8 + pld_bytes.size());
+   std::uint16_t udp_len_field = is_jumbogram ? 0 : static_cast<std::uint16_t>(udp_len);
+   std::cout << "UDP Packet Length: " << udp_len << " octets"
+             << (is_jumbogram ? " (jumbogram)" : "") << '\n' << std::endl;
+   assert( udp_len >= 8 );
+
+   // Lay out the datagram (checksum field zeroed) as it'd appear on the
+   // wire, i.e. in network byte order. The pseudo-header is laid out too, but
+   // only to show its words; the checksum engine folds it in on its own.
+   std::vector<std::uint8_t> pseudo_hdr;
+   pseudo_hdr.insert( pseudo_hdr.end(),
+                      src_ip_num.bytes.begin(), src_ip_num.bytes.begin() + addr_sz );
+   pseudo_hdr.insert( pseudo_hdr.end(),
+                      dst_ip_num.bytes.begin(), dst_ip_num.bytes.begin() + addr_sz );
+   if ( is_ipv6 )
    {
-      pld_byte_pairs.push_back(static_cast<std::uint16_t>(pld_bytes.back()));
+      // RFC 8200: 32-bit upper-layer length, 3 zero bytes, next header
+      pseudo_hdr.insert( pseudo_hdr.end(),
+                         { static_cast<std::uint8_t>(udp_len >> 24),
+                           static_cast<std::uint8_t>(udp_len >> 16),
+                           static_cast<std::uint8_t>(udp_len >> 8),
+                           static_cast<std::uint8_t>(udp_len),
+                           0x00, 0x00, 0x00, IPPROTO_UDP } );
    }
-
-   std::cout << "\tByte pairs formed: ";
-   for ( auto bpair : pld_byte_pairs )
+   else
    {
-      std::cout << std::format("0x{:04X} ", bpair);
+      // RFC 768: zero byte, protocol, 16-bit UDP length
+      pseudo_hdr.insert( pseudo_hdr.end(),
+                         { 0x00, IPPROTO_UDP,
+                           static_cast<std::uint8_t>(udp_len >> 8),
+                           static_cast<std::uint8_t>(udp_len) } );
    }
-   std::cout << std::endl;
 
-   // Compute what the correct length would be given the UDP payload
-   std::uint16_t udp_len = 8 + pld_bytes.size();
-   std::cout << "UDP Packet Length: " << udp_len << " octets\n" << std::endl;
-   assert( udp_len >= 8 );
+   std::vector<std::uint8_t> datagram = {
+      static_cast<std::uint8_t>(src_port >> 8), static_cast<std::uint8_t>(src_port),
+      static_cast<std::uint8_t>(dst_port >> 8), static_cast<std::uint8_t>(dst_port),
+      static_cast<std::uint8_t>(udp_len_field >> 8),
+      static_cast<std::uint8_t>(udp_len_field),
+      0x00, 0x00 // checksum
+   };
+   datagram.insert(datagram.end(), pld_bytes.begin(), pld_bytes.end());
 
-   // Compute one's complement sum
+   // Show the 16-bit words going into the sum. An odd trailing byte is
+   // padded /w a zero byte to form the last word (RFC 768).
    std::cout << "Summing 16-bit Words: " << '\n'
-             << "---------------------"  << '\n'
-             << std::format( "0x{:04X}", htons(src_ip_num.s_addr  & 0x0000FFFF) ) << '\n'
-             << std::format( "0x{:04X}", htons(src_ip_num.s_addr >> 16) ) << '\n'
-             << std::format( "0x{:04X}", htons(dst_ip_num.s_addr  & 0x0000FFFF) ) << '\n'
-             << std::format( "0x{:04X}", htons(dst_ip_num.s_addr >> 16) ) << '\n'
-             << "0x0011" << '\n'
-             << std::format("0x{:04X}", udp_len) << '\n'
-             << std::format( "0x{:04X}", src_port ) << '\n'
-             << std::format( "0x{:04X}", dst_port ) << '\n'
-             << std::format("0x{:04X}", udp_len) << '\n';
-   for ( auto wrd : pld_byte_pairs )
+             << "---------------------"  << '\n';
+   // 64 bits, since a jumbogram's words can overflow a 32-bit running sum
+   std::uint64_t running_sum = 0;
+   auto print_words = [&running_sum]( std::span<const std::uint8_t> bytes )
    {
-      std::cout << std::format("0x{:04X}", wrd) << '\n';
-   }
+      for ( std::size_t i = 0; i < bytes.size(); i += 2 )
+      {
+         std::uint16_t wrd = static_cast<std::uint16_t>(bytes[i]) << 8;
+         if ( (i + 1) < bytes.size() )
+            wrd |= bytes[i + 1];
+         if ( i / 2 < ECHO_MAX )
+            std::cout << std::format("0x{:04X}", wrd) << '\n';
+         running_sum += wrd;
+      }
+      const std::size_t nwords = (bytes.size() + 1) / 2;
+      if ( nwords > ECHO_MAX )
+         std::cout << std::format("... ({} more words)", nwords - ECHO_MAX) << '\n';
+   };
+   print_words(pseudo_hdr);
+   print_words(datagram);
    std::cout << "------" << '\n';
-   std::uint16_t initial_ones_complement_sum = 0;
-   std::uint32_t running_sum = 0;
-   running_sum += htons(src_ip_num.s_addr & 0x0000FFFF);
-   running_sum += htons(src_ip_num.s_addr >> 16);
-   running_sum += htons(dst_ip_num.s_addr & 0x0000FFFF);
-   running_sum += htons(dst_ip_num.s_addr >> 16);
-   running_sum += 0x0011;
-   running_sum += udp_len;
-   running_sum += src_port;
-   running_sum += dst_port;
-   running_sum += udp_len;
-   for ( auto wrd : pld_byte_pairs )
-   {
-      running_sum += wrd;
-   }
    std::cout << std::format("0x{:04X}", running_sum) << std::endl;
-   // Carry wrap-around
-   if ( running_sum > 0xFFFF )
-   {
-      initial_ones_complement_sum = static_cast<std::uint16_t>(
-                                       (running_sum & 0xFFFF) + (running_sum >> 16)
-                                     );
-   }
-   else
-   {
-      initial_ones_complement_sum = static_cast<std::uint16_t>(running_sum);
-   }
 
-   // Complement the result above
-   std::uint16_t checksum = ~initial_ones_complement_sum;
+   std::uint16_t initial_ones_complement_sum = netsp::checksum::fold(running_sum);
+
+   // The complement of the sum above, except that a computed 0x0000 is sent
+   // as 0xFFFF, since 0 means "no checksum" (RFC 768)
+   std::uint16_t checksum =
+         is_ipv6 ? udpChecksum<netsp::checksum::IpVersion::V6>(src_ip_num, dst_ip_num, datagram)
+                 : udpChecksum<netsp::checksum::IpVersion::V4>(src_ip_num, dst_ip_num, datagram);
+   assert( checksum == static_cast<std::uint16_t>(~initial_ones_complement_sum)
+           || (0xFFFF == checksum && 0xFFFF == initial_ones_complement_sum) );
 
    // Print each intermediate result and the final checksum result
-   std::locale::global( std::locale("en_US.UTF-8") );
+   // Digit grouping is nice-to-have; not every system has this locale
+   try {
+      std::locale::global( std::locale("en_US.UTF-8") );
+   }
+   catch ( const std::runtime_error& e ) {
+      std::locale::global( std::locale::classic() );
+   }
    std::cout << "\nCompleted computations!\n\n";
    std::cout << std::format("Initial Sum: {:L} (0x{:02X})\n",
                             running_sum,
@@ -0,0 +1,85 @@
+import json
+import math
+import sys
+
+# Compare two runs of the same benchmark, a baseline and a candidate, and
+# print how much faster the candidate is. Takes either two bench_loopback
+# JSON results or two bench_checksum reports.
+
+# Define colors
+RED = "\033[1;31m"
+GREEN = "\033[1;32m"
+RESET = "\033[0m"
+
+# (section, key, higher is better?) for the bench_loopback JSON
+LOOPBACK_METRICS = [
+    (("connections",), "per_sec", True),
+    (("connections", "connect_to_first_reply_us"), "p50", False),
+    (("requests",), "per_sec", True),
+    (("requests", "rtt_us"), "p50", False),
+    (("requests", "rtt_us"), "p99", False),
+    (("requests", "server_residence_us"), "p50", False),
+    (("requests", "server_residence_us"), "p99", False),
+]
+
+def speedup_str(speedup):
+    color = GREEN if speedup >= 1.0 else RED
+    return f"{color}{speedup:6.3f}x ({(speedup - 1.0) * 100.0:+.1f}%){RESET}"
+
+def lookup(results, path, key):
+    for section in path:
+        results = results[section]
+    return results[key]
+
+def compare_loopback(base_path, cand_path):
+    with open(base_path) as f:
+        base = json.load(f)
+    with open(cand_path) as f:
+        cand = json.load(f)
+
+    print(f"{'metric':45} {'baseline':>12} {'candidate':>12}  speedup")
+    for path, key, higher_is_better in LOOPBACK_METRICS:
+        b = lookup(base, path, key)
+        c = lookup(cand, path, key)
+        if b <= 0 or c <= 0:
+            continue
+        speedup = c / b if higher_is_better else b / c
+        name = ".".join(path + (key,))
+        print(f"{name:45} {b:12.3f} {c:12.3f}  {speedup_str(speedup)}")
+
+def read_checksum_report(path):
+    # kernel bytes align GB/s +/- cyc/B ns/call
+    ns_per_call = {}
+    with open(path) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 7 or not fields[1].isdigit():
+                continue
+            ns_per_call[(fields[0], int(fields[1]), int(fields[2]))] = float(fields[6])
+    return ns_per_call
+
+def compare_checksum(base_path, cand_path):
+    base = read_checksum_report(base_path)
+    cand = read_checksum_report(cand_path)
+
+    # Geometric mean over every size/alignment case each kernel ran
+    log_sums = {}
+    for case, b in base.items():
+        c = cand.get(case)
+        if c is None or b <= 0 or c <= 0:
+            continue
+        total, n = log_sums.get(case[0], (0.0, 0))
+        log_sums[case[0]] = (total + math.log(b / c), n + 1)
+
+    print(f"{'kernel':16} {'cases':>5}  speedup (geomean of ns/call)")
+    for kernel, (total, n) in log_sums.items():
+        print(f"{kernel:16} {n:5}  {speedup_str(math.exp(total / n))}")
+
+if len(sys.argv) != 3:
+    print(f"Usage: {sys.argv[0]} <baseline> <candidate>", file=sys.stderr)
+    sys.exit(1)
+
+if sys.argv[1].endswith(".json"):
+    compare_loopback(sys.argv[1], sys.argv[2])
+else:
+    compare_checksum(sys.argv[1], sys.argv[2])